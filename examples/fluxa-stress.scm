@@ -0,0 +1,23 @@
+; a stress test for fluxa's graph, plays dense patterns of small synths
+; fast enough to keep the node pools recycling. with timing on the fluxa 
+; server prints the mean and worst time it spent in the audio callback
+; about once a second - make sure fluxa is running and connected to jack 
+; [run 'fluxa' on the command line].
+
+(require fluxus-017/fluxa)
+
+(define voices 16)
+
+(max-synths 64)
+(fluxa-timing 1)
+
+(seq
+    (lambda (time clock)
+        (for ((n (in-range 0 voices)))
+            (play (+ time (* n 0.001))
+                (mul (mooglp (add (saw (note (+ n (modulo clock 12))))
+                                  (squ (note (+ n 7))))
+                             (mul (adsr 0 0.05 0.1 0) 0.5) 0.3)
+                     (adsr 0 0.02 0.1 0.1))
+                (- (/ n voices 0.5) 1)))
+        0.05))
@@ -0,0 +1,58 @@
+; times loading the obj meshes which come with fluxus, and a large generated 
+; one (a 300x300 vertex grid of quads). each is parsed from the obj file, 
+; best of 5, and then read back from the .fxm cache it leaves behind. the 
+; caches are written to a temporary directory so the obj is really parsed
+
+(require racket/file)
+
+(clear)
+
+(define meshes (list "octopus.obj" "alien.obj" "bot.obj" "mushroom.obj" 
+                     "rocket.obj" "widget.obj"))
+(define runs 5)
+
+(define cache-dir (build-path (find-system-path 'temp-dir) "fluxus-obj-bench"))
+(make-directory* cache-dir)
+(geometry-cache-directory (path->string cache-dir))
+
+(define (clear-caches)
+    (clear-geometry-cache)
+    (for-each 
+        (lambda (f) (delete-file (build-path cache-dir f)))
+        (directory-list cache-dir)))
+
+(define (time-load filename)
+    (let* ((start (current-inexact-milliseconds))
+           (p (load-primitive filename))
+           (t (- (current-inexact-milliseconds) start)))
+        (destroy p)
+        t))
+
+(define (best-of thunk)
+    (apply min (build-list runs (lambda (n) (thunk)))))
+
+(define (bench filename)
+    (let ((obj (best-of (lambda () (clear-caches) (time-load filename))))
+          (fxm (best-of (lambda () (clear-geometry-cache) (time-load filename)))))
+        (printf "~a: obj ~a ms, fxm ~a ms~n" filename obj fxm)))
+
+(define (write-grid filename size)
+    (with-output-to-file filename #:exists 'replace
+        (lambda ()
+            (for* ((y (in-range 0 size)) (x (in-range 0 size)))
+                (printf "v ~a ~a ~a~n" x (sin (* x y 0.001)) y)
+                (printf "vt ~a ~a~n" (/ x size 1.0) (/ y size 1.0))
+                (printf "vn 0 1 0~n"))
+            (for* ((y (in-range 0 (- size 1))) (x (in-range 0 (- size 1))))
+                (let* ((a (+ (* y size) x 1)) (b (+ a 1)) 
+                       (c (+ b size)) (d (+ a size)))
+                    (printf "f ~a/~a/~a ~a/~a/~a ~a/~a/~a ~a/~a/~a~n" 
+                        a a a b b b c c c d d d))))))
+
+(for-each bench meshes)
+
+(define grid (path->string (build-path (find-system-path 'temp-dir) "fluxus-obj-bench-grid.obj")))
+(write-grid grid 300)
+(bench grid)
+(delete-file grid)
+(clear-caches)
@@ -0,0 +1,54 @@
+; a stress test for the physics, drops piles of cubes with each
+; broadphase and prints the average milliseconds spent finding
+; collisions, stepping and updating the primitives each frame
+
+(clear)
+(collisions 1)
+(set-max-physical 20000)
+(physics-max-contacts 4)
+(ground-plane (vector 0 1 0) 0)
+
+(define counts (list 1000 2500 5000 10000))
+(define broadphases (list 'hash 'sap 'quadtree))
+(define frames 200)
+
+(define (build-bodies count)
+    (build-list count
+        (lambda (i)
+            (with-state
+                (translate (vector (* (- (modulo i 40) 20) 1.5)
+                                   (+ 1 (* (quotient i 1600) 1.5))
+                                   (* (- (modulo (quotient i 40) 40) 20) 1.5)))
+                (let ((ob (build-cube)))
+                    (active-box ob)
+                    ; group them in columns of 4x4
+                    (physics-group ob (+ (quotient (modulo i 40) 4)
+                                         (* 10 (quotient (modulo (quotient i 40) 40) 4))))
+                    ob)))))
+
+(define (run-test broadphase count)
+    (physics-broadphase broadphase (list 'centre (vector 0 0 0)
+                                         'extents (vector 80 80 80) 'depth 6))
+    (let ((obs (build-bodies count)))
+        (let loop ((n 0) (collide 0) (step 0) (writeback 0))
+            (cond
+                ((< n frames)
+                    (tick-physics)
+                    (let ((t (physics-timings)))
+                        (loop (+ n 1) 
+                              (+ collide (list-ref t 0))
+                              (+ step (list-ref t 1))
+                              (+ writeback (list-ref t 2)))))
+                (else
+                    (for-each destroy obs)
+                    (printf "~a ~a bodies: collide ~a step ~a writeback ~a~n"
+                        broadphase count
+                        (/ collide frames) (/ step frames) (/ writeback frames)))))))
+
+(for-each
+    (lambda (broadphase)
+        (for-each
+            (lambda (count)
+                (run-test broadphase count))
+            counts))
+    broadphases)
@@ -0,0 +1,23 @@
+; times smoothing the normals of some large meshes, the first call finds
+; the vertices which share positions (which is cached in the primitive), 
+; the second only has to average the normals
+
+(clear)
+
+(define sizes (list 100 250 500))
+
+(define (time-ms thunk)
+    (let ((start (current-inexact-milliseconds)))
+        (thunk)
+        (- (current-inexact-milliseconds) start)))
+
+(for-each
+    (lambda (size)
+        (let ((p (build-seg-plane size size)))
+            (with-primitive p
+                (let* ((first (time-ms (lambda () (recalc-normals 1))))
+                       (second (time-ms (lambda () (recalc-normals 1)))))
+                    (printf "~a x ~a plane, ~a verts: first ~a ms, cached ~a ms~n"
+                        size size (pdata-size) first second)))
+            (destroy p)))
+    sizes)
@@ -31,6 +31,10 @@ m_Server(server),
 m_GlobalVolume(1.0f),
 m_Pan(0.0f),
 m_Debug(false),
+m_Timing(false),
+m_CallbackTotal(0),
+m_CallbackWorst(0),
+m_CallbackCount(0),
 m_LeftEq(jack->GetSamplerate()),
 m_RightEq(jack->GetSamplerate()),
 m_Comp(jack->GetSamplerate())
@@ -75,8 +79,33 @@ m_Comp(jack->GetSamplerate())
 
 void Fluxa::Run(void *RunContext, unsigned int BufSize)
 { 
-	((Fluxa*)RunContext)->ProcessCommands();
-	((Fluxa*)RunContext)->Process(BufSize);
+	Fluxa *fluxa=(Fluxa*)RunContext;
+	Time start;
+	bool timing=fluxa->m_Timing;
+	if (timing) start.SetToNow();
+	fluxa->ProcessCommands();
+	fluxa->Process(BufSize);
+	if (timing) fluxa->RecordCallbackTime(start,BufSize);
+}
+
+void Fluxa::RecordCallbackTime(const Time &start, unsigned int BufSize)
+{
+	Time now;
+	now.SetToNow();
+	double t=now.GetDifference(start);
+	m_CallbackTotal+=t;
+	if (t>m_CallbackWorst) m_CallbackWorst=t;
+	m_CallbackCount++;
+	
+	if (m_CallbackCount*BufSize>=m_SampleRate)
+	{
+		Trace(RED,YELLOW,"callback time: mean %.1fus worst %.1fus, buffer is %.1fus",
+			m_CallbackTotal/m_CallbackCount*1000000.0,m_CallbackWorst*1000000.0,
+			BufSize/(double)m_SampleRate*1000000.0);
+		m_CallbackTotal=0;
+		m_CallbackWorst=0;
+		m_CallbackCount=0;
+	}
 }
 
 void Fluxa::ProcessCommands()
@@ -224,6 +253,13 @@ void Fluxa::ProcessCommands()
 		{
 			m_Debug=cmd.GetInt(0);
 		}
+		else if (name=="/timing")
+		{
+			m_Timing=cmd.GetInt(0);
+			m_CallbackTotal=0;
+			m_CallbackWorst=0;
+			m_CallbackCount=0;
+		}
 		else if (name=="/addsearchpath")
 		{
 			SearchPaths::Get()->AddPath(cmd.GetString(0));
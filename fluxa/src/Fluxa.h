@@ -38,6 +38,9 @@ private:
 	static void Run(void *RunContext, unsigned int BufSize);
 	void Process(unsigned int BufSize);
 	void ProcessCommands();
+	/// With timing on, prints the mean and worst time spent in the 
+	/// callback about once a second
+	void RecordCallbackTime(const Time &start, unsigned int BufSize);
 	
 	unsigned int m_SampleRate;
 		
@@ -54,6 +57,10 @@ private:
 	float m_GlobalVolume;
 	float m_Pan;
 	bool m_Debug;
+	bool m_Timing;
+	double m_CallbackTotal;
+	double m_CallbackWorst;
+	unsigned int m_CallbackCount;
 	
 	Eq m_LeftEq;
     Eq m_RightEq;
@@ -20,8 +20,14 @@
 #include "ModuleNodes.h"
 #include "Modules.h"
 
+const int Graph::NONE;
+
 Graph::Graph(unsigned int NumNodes, unsigned int SampleRate) :
 m_MaxPlaying(10),
+m_IDMask(0),
+m_RootHead(NONE),
+m_RootTail(NONE),
+m_NumPlaying(0),
 m_NumNodes(NumNodes),
 m_SampleRate(SampleRate)
 {
@@ -33,104 +39,194 @@ Graph::~Graph()
 	Clear();
 }
 
+GraphNode *Graph::MakeNode(Type type)
+{
+	switch(type)
+	{
+		case TERMINAL : return new TerminalNode(0);
+		case SINOSC : return new OscNode((int)WaveTable::SINE,m_SampleRate);
+		case SAWOSC : return new OscNode((int)WaveTable::SAW,m_SampleRate);
+		case TRIOSC : return new OscNode((int)WaveTable::TRIANGLE,m_SampleRate);
+		case SQUOSC : return new OscNode((int)WaveTable::SQUARE,m_SampleRate);
+		case WHITEOSC : return new OscNode((int)WaveTable::NOISE,m_SampleRate);
+		case PINKOSC : return new OscNode((int)WaveTable::PINKNOISE,m_SampleRate);
+		case ADSR : return new ADSRNode(m_SampleRate);
+		case ADD : return new MathNode(MathNode::ADD);
+		case SUB : return new MathNode(MathNode::SUB);
+		case MUL : return new MathNode(MathNode::MUL);
+		case DIV : return new MathNode(MathNode::DIV);
+		case POW : return new MathNode(MathNode::POW);
+		case MOOGLP : return new FilterNode(FilterNode::MOOGLP,m_SampleRate);
+		case MOOGBP : return new FilterNode(FilterNode::MOOGBP,m_SampleRate);
+		case MOOGHP : return new FilterNode(FilterNode::MOOGHP,m_SampleRate);
+		case FORMANT : return new FilterNode(FilterNode::FORMANT,m_SampleRate);
+		case SAMPLER : return new SampleNode(m_SampleRate);
+		case CRUSH : return new EffectNode(EffectNode::CRUSH,m_SampleRate);
+		case DISTORT : return new EffectNode(EffectNode::DISTORT,m_SampleRate);
+		case CLIP : return new EffectNode(EffectNode::CLIP,m_SampleRate);
+		case DELAY : return new EffectNode(EffectNode::DELAY,m_SampleRate);
+		default: assert(0); break;
+	}
+	return NULL;
+}
+
 void Graph::Init()
 {
+	unsigned int total=0;
 	for (unsigned int type=0; type<NUMTYPES; type++)
 	{
-		NodeDescVec *descvec = new NodeDescVec;
-		
 		unsigned int count=m_NumNodes;
-		
 		if (type==TERMINAL) count=2000;
-		
-		for(unsigned int n=0; n<count; n++)
+
+		m_Types[type].m_Start=total;
+		m_Types[type].m_Count=count;
+		m_Types[type].m_Current=0;
+		total+=count;
+	}
+
+	m_Slots.resize(total);
+	for (unsigned int type=0; type<NUMTYPES; type++)
+	{
+		for (unsigned int n=0; n<m_Types[type].m_Count; n++)
 		{
-			NodeDesc *nodedesc = new NodeDesc;
-			
-			switch(type)
-			{
-				case TERMINAL : nodedesc->m_Node = new TerminalNode(0); break;
-				case SINOSC : nodedesc->m_Node = new OscNode((int)WaveTable::SINE,m_SampleRate); break;
-				case SAWOSC : nodedesc->m_Node = new OscNode((int)WaveTable::SAW,m_SampleRate); break;
-				case TRIOSC : nodedesc->m_Node = new OscNode((int)WaveTable::TRIANGLE,m_SampleRate); break;
-				case SQUOSC : nodedesc->m_Node = new OscNode((int)WaveTable::SQUARE,m_SampleRate); break;
-				case WHITEOSC : nodedesc->m_Node = new OscNode((int)WaveTable::NOISE,m_SampleRate); break;
-				case PINKOSC : nodedesc->m_Node = new OscNode((int)WaveTable::PINKNOISE,m_SampleRate); break;
-				case ADSR : nodedesc->m_Node = new ADSRNode(m_SampleRate); break;
-				case ADD : nodedesc->m_Node = new MathNode(MathNode::ADD); break;
-				case SUB : nodedesc->m_Node = new MathNode(MathNode::SUB); break;
-				case MUL : nodedesc->m_Node = new MathNode(MathNode::MUL); break;
-				case DIV : nodedesc->m_Node = new MathNode(MathNode::DIV); break;
-				case POW : nodedesc->m_Node = new MathNode(MathNode::POW); break;
-				case MOOGLP : nodedesc->m_Node = new FilterNode(FilterNode::MOOGLP,m_SampleRate); break;
-				case MOOGBP : nodedesc->m_Node = new FilterNode(FilterNode::MOOGBP,m_SampleRate); break;
-				case MOOGHP : nodedesc->m_Node = new FilterNode(FilterNode::MOOGHP,m_SampleRate); break;
-				case FORMANT : nodedesc->m_Node = new FilterNode(FilterNode::FORMANT,m_SampleRate); break;
-				case SAMPLER : nodedesc->m_Node = new SampleNode(m_SampleRate); break;
-				case CRUSH : nodedesc->m_Node = new EffectNode(EffectNode::CRUSH,m_SampleRate); break;
-				case DISTORT : nodedesc->m_Node = new EffectNode(EffectNode::DISTORT,m_SampleRate); break;
-				case CLIP : nodedesc->m_Node = new EffectNode(EffectNode::CLIP,m_SampleRate); break;
-				case DELAY : nodedesc->m_Node = new EffectNode(EffectNode::DELAY,m_SampleRate); break;				
-				default: assert(0); break;
-			}
-			
-			descvec->m_Vec.push_back(nodedesc);
+			m_Slots[m_Types[type].m_Start+n].m_Node=MakeNode((Type)type);
 		}
-		
-		m_NodeDescMap[(Type)type] = descvec;
 	}
+
+	// at most one id per slot, keep the table under half full
+	unsigned int size=1;
+	while (size<total*2) size<<=1;
+	m_IDTable.assign(size,NONE);
+	m_IDMask=size-1;
+
+	m_RootHead=NONE;
+	m_RootTail=NONE;
+	m_NumPlaying=0;
 }
 
 void Graph::Clear()
 {
-	m_RootNodes.clear();
-	m_NodeMap.clear();
+	for (vector<NodeDesc>::iterator i=m_Slots.begin(); i!=m_Slots.end(); ++i)
+	{
+		delete i->m_Node;
+	}
+	
+	m_Slots.clear();
+	m_IDTable.clear();
+	m_IDMask=0;
+	m_RootHead=NONE;
+	m_RootTail=NONE;
+	m_NumPlaying=0;
+}
+
+int Graph::FindSlot(unsigned int id) const
+{
+	if (m_IDTable.empty()) return NONE;
 	
-	for (map<Type,NodeDescVec*>::iterator i=m_NodeDescMap.begin(); 
-		i!=m_NodeDescMap.end(); ++i)
+	for (unsigned int h=Hash(id); m_IDTable[h]!=NONE; h=(h+1)&m_IDMask)
 	{
-		for (vector<NodeDesc*>::iterator ni=i->second->m_Vec.begin();
-			ni!=i->second->m_Vec.end(); ++ni)
+		if (m_Slots[m_IDTable[h]].m_ID==id) return m_IDTable[h];
+	}
+	return NONE;
+}
+
+void Graph::InsertID(unsigned int id, int slot)
+{
+	unsigned int h=Hash(id);
+	while (m_IDTable[h]!=NONE)
+	{
+		// replace an old node with the same id, and stop it playing
+		// as it can't be found by id any more
+		if (m_Slots[m_IDTable[h]].m_ID==id) 
 		{
-			delete (*ni)->m_Node;
+			int oldslot=m_IDTable[h];
+			m_Slots[oldslot].m_Used=false;
+			RemoveRoot(oldslot);
+			break;
 		}
-		i->second->m_Vec.clear();
+		h=(h+1)&m_IDMask;
 	}
-	
-	m_NodeDescMap.clear();	
+	m_IDTable[h]=slot;
 }
 
-void Graph::Create(unsigned int id, Type t, float v)
+void Graph::RemoveID(unsigned int id)
 {
-	unsigned int index=m_NodeDescMap[t]->NewIndex();
-	unsigned int oldid=m_NodeDescMap[t]->m_Vec[index]->m_ID;
+	unsigned int h=Hash(id);
+	while (m_IDTable[h]!=NONE && m_Slots[m_IDTable[h]].m_ID!=id)
+	{
+		h=(h+1)&m_IDMask;
+	}
+	if (m_IDTable[h]==NONE) return;
 
-//cerr<<"create id:"<<id<<" index:"<<index<<" type:"<<t<<" value:"<<v<<endl;
-	
-	map<unsigned int,GraphNode*>::iterator i=m_NodeMap.find(oldid);
-	if (i!=m_NodeMap.end()) m_NodeMap.erase(i);
-	
-	list<pair<unsigned int,float> >::iterator remove;
-	bool found=false;
-	for (list<pair<unsigned int,float> >::iterator ri=m_RootNodes.begin();
-		ri!=m_RootNodes.end(); ++ri)
+	// shift back the entries after this one which would 
+	// no longer be found, so we don't need tombstones
+	unsigned int hole=h;
+	for (unsigned int n=(h+1)&m_IDMask; m_IDTable[n]!=NONE; n=(n+1)&m_IDMask)
 	{
-		if (ri->first==oldid) 
+		unsigned int home=Hash(m_Slots[m_IDTable[n]].m_ID);
+		// move it if it's home isn't between the hole and here
+		if (((n-home)&m_IDMask) >= ((n-hole)&m_IDMask))
 		{
-			remove=ri;
-			found=true;
+			m_IDTable[hole]=m_IDTable[n];
+			hole=n;
 		}
 	}
-	if (found) m_RootNodes.erase(remove);
+	m_IDTable[hole]=NONE;
+}
+
+void Graph::AddRoot(int slot, float pan)
+{
+	NodeDesc &desc=m_Slots[slot];
+	desc.m_Pan=pan;
+	desc.m_Playing=true;
+	desc.m_Prev=m_RootTail;
+	desc.m_Next=NONE;
+	if (m_RootTail!=NONE) m_Slots[m_RootTail].m_Next=slot;
+	else m_RootHead=slot;
+	m_RootTail=slot;
+	m_NumPlaying++;
+}
+
+void Graph::RemoveRoot(int slot)
+{
+	NodeDesc &desc=m_Slots[slot];
+	if (!desc.m_Playing) return;
 	
-	m_NodeDescMap[t]->m_Vec[index]->m_ID=id;
-	m_NodeDescMap[t]->m_Vec[index]->m_Node->Clear();
-	m_NodeMap[id]=m_NodeDescMap[t]->m_Vec[index]->m_Node;
+	if (desc.m_Prev!=NONE) m_Slots[desc.m_Prev].m_Next=desc.m_Next;
+	else m_RootHead=desc.m_Next;
+	if (desc.m_Next!=NONE) m_Slots[desc.m_Next].m_Prev=desc.m_Prev;
+	else m_RootTail=desc.m_Prev;
+	
+	desc.m_Playing=false;
+	desc.m_Prev=NONE;
+	desc.m_Next=NONE;
+	m_NumPlaying--;
+}
+
+void Graph::Create(unsigned int id, Type t, float v)
+{
+	if ((unsigned int)t>=NUMTYPES || m_Slots.empty()) 
+	{
+		return;
+	}
+
+	int index=m_Types[t].NewIndex();
+	NodeDesc &desc=m_Slots[index];
+
+//cerr<<"create id:"<<id<<" index:"<<index<<" type:"<<t<<" value:"<<v<<endl;
+	
+	// recycle the old node
+	if (desc.m_Used) RemoveID(desc.m_ID);
+	RemoveRoot(index);
+	
+	desc.m_ID=id;
+	desc.m_Used=true;
+	desc.m_Node->Clear();
+	InsertID(id,index);
 		
 	if (t==TERMINAL)
 	{
-		TerminalNode *terminal = dynamic_cast<TerminalNode*>(m_NodeMap[id]);
-		assert(terminal!=NULL);
+		TerminalNode *terminal = static_cast<TerminalNode*>(desc.m_Node);
 		terminal->SetValue(v);
 	}
 }
@@ -138,44 +234,47 @@ void Graph::Create(unsigned int id, Type t, float v)
 void Graph::Connect(unsigned int id, unsigned int arg, unsigned int to)
 {
 //cerr<<"connect id "<<id<<" arg "<<arg<<" to "<<to<<endl;
-	if (m_NodeMap[id]!=NULL && m_NodeMap[to]!=NULL)
+	int slot=FindSlot(id);
+	int toslot=FindSlot(to);
+	if (slot!=NONE && toslot!=NONE)
 	{
-		m_NodeMap[id]->SetChild(arg,m_NodeMap[to]);
+		m_Slots[slot].m_Node->SetChild(arg,m_Slots[toslot].m_Node);
 	}
 }
 
 void Graph::Play(float time, unsigned int id, float pan)
 {
 //cerr<<"play id "<<id<<endl;
-	if (m_NodeMap[id]!=NULL)
+	int slot=FindSlot(id);
+	if (slot!=NONE)
 	{
-		m_NodeMap[id]->Trigger(time);
-		m_RootNodes.push_back(pair<unsigned int, float>(id,pan));
+		m_Slots[slot].m_Node->Trigger(time);
 		
-		while (m_RootNodes.size()>m_MaxPlaying)
+		// playing again moves it to the end of the list
+		RemoveRoot(slot);
+		AddRoot(slot,pan);
+		
+		while (m_NumPlaying>m_MaxPlaying)
 		{
-			m_RootNodes.erase(m_RootNodes.begin());
+			RemoveRoot(m_RootHead);
 		}
 	}
 }
 
 void Graph::Process(unsigned int bufsize, Sample &left, Sample &right)
 {
-	for(list<pair<unsigned int, float> >::iterator i=m_RootNodes.begin();
-		i!=m_RootNodes.end(); ++i)
+	for (int i=m_RootHead; i!=NONE; i=m_Slots[i].m_Next)
 	{        
-		if (m_NodeMap[i->first]!=NULL)
-		{
-			m_NodeMap[i->first]->Process(bufsize);
+		GraphNode *node=m_Slots[i].m_Node;
+		node->Process(bufsize);
 
-            // do stereo panning
-            float pan = i->second;
-            float leftpan=1,rightpan=1;
-            if (pan<0) leftpan=1-pan;
-            else rightpan=1+pan;
-	
-			left.MulMix(m_NodeMap[i->first]->GetOutput(),0.1*leftpan);
-            right.MulMix(m_NodeMap[i->first]->GetOutput(),0.1*rightpan);
-		}
+		// do stereo panning
+		float pan = m_Slots[i].m_Pan;
+		float leftpan=1,rightpan=1;
+		if (pan<0) leftpan=1-pan;
+		else rightpan=1+pan;
+
+		left.MulMix(node->GetOutput(),0.1*leftpan);
+		right.MulMix(node->GetOutput(),0.1*rightpan);
 	}
 }
@@ -15,9 +15,6 @@
 // Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
 
 #include <vector>
-#include <map>
-#include <set>
-#include <list>
 #include <math.h>
 #include "GraphNode.h"
 #include "ModuleNodes.h"
@@ -25,6 +22,13 @@
 #ifndef GRAPH
 #define GRAPH
 
+///////////////////////////////////////////////////
+/// The synth graph. All the nodes are made up front in Init() 
+/// and recycled in order for each type, so nothing here allocates 
+/// or does unbounded work in the audio thread. Ids from the client
+/// are mapped to node slots with a fixed size open addressed table,
+/// and the playing (root) nodes are kept in a list threaded through 
+/// the slots themselves.
 class Graph
 {
 public:
@@ -44,37 +48,70 @@ public:
 	void SetMaxPlaying(int s) { m_MaxPlaying=s; }
 	
 private:
+	static const int NONE = -1;
+	
 	class NodeDesc
 	{
 	public:
-		NodeDesc(): m_Node(NULL), m_ID(0) {}
+		NodeDesc(): m_Node(NULL), m_ID(0), m_Used(false), 
+			m_Playing(false), m_Pan(0), m_Prev(NONE), m_Next(NONE) {}
 		GraphNode *m_Node;
 		unsigned int m_ID;
+		// whether m_ID is in the id table
+		bool m_Used;
+		// root list links
+		bool m_Playing;
+		float m_Pan;
+		int m_Prev;
+		int m_Next;
 	};
 	
-	class NodeDescVec
+	/// The range of slots for one type of node
+	class TypeSlots
 	{
 	public:
+		TypeSlots(): m_Start(0), m_Count(0), m_Current(0) {}
+
 		unsigned int NewIndex()
 		{
 			m_Current++;
-			if (m_Current>=m_Vec.size()) 
+			if (m_Current>=m_Count) 
 			{
 				//cerr<<"going round..."<<endl;
 				m_Current=0;
 			}
-			return m_Current;
+			return m_Start+m_Current;
 		}
 		
-		NodeDescVec(): m_Current(0) {}
+		unsigned int m_Start;
+		unsigned int m_Count;
 		unsigned int m_Current;
-		vector<NodeDesc*> m_Vec;
 	};
 	
+	GraphNode *MakeNode(Type type);
+	
+	/// id table, returns the slot or NONE
+	int FindSlot(unsigned int id) const;
+	void InsertID(unsigned int id, int slot);
+	void RemoveID(unsigned int id);
+	unsigned int Hash(unsigned int id) const { return (id*2654435761u)&m_IDMask; }
+	
+	/// root list
+	void AddRoot(int slot, float pan);
+	void RemoveRoot(int slot);
+	
 	unsigned int m_MaxPlaying;
-	list<pair<unsigned int, float> > m_RootNodes;
-	map<unsigned int,GraphNode*> m_NodeMap;
-	map<Type,NodeDescVec*> m_NodeDescMap;
+	vector<NodeDesc> m_Slots;
+	TypeSlots m_Types[NUMTYPES];
+	
+	// id table entries are slot numbers or NONE
+	vector<int> m_IDTable;
+	unsigned int m_IDMask;
+
+	int m_RootHead;
+	int m_RootTail;
+	unsigned int m_NumPlaying;
+	
 	unsigned int m_NumNodes;
 	unsigned int m_SampleRate;
 };
@@ -0,0 +1,321 @@
+// Copyright (C) 2008 Dave Griffiths
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+
+#include <cstdio>
+#include <cstring>
+#include <stdint.h>
+#include <sys/stat.h>
+
+#include "PolyPrimitive.h"
+#include "ParticlePrimitive.h"
+#include "BinaryPrimitiveIO.h"
+#include "MappedFile.h"
+#include "Trace.h"
+
+using namespace Fluxus;
+
+static const char FXM_MAGIC[4]={'F','X','M','1'};
+static const unsigned int FXM_VERSION=1;
+
+static unsigned int Pad4(unsigned int size)
+{
+	return (size+3)&~3;
+}
+
+// in 64 bits, so lengths near the top of the range don't wrap round
+static uint64_t Pad4Wide(unsigned int size)
+{
+	return ((uint64_t)size+3)&~(uint64_t)3;
+}
+
+// makes a pdata array of the given type from the raw elements
+template<class T>
+static PData *MakeArray(const char *data, unsigned int count)
+{
+	TypedPData<T> *pd = new TypedPData<T>(count);
+	if (count>0) memcpy(pd->RawData(),data,count*sizeof(T));
+	return pd;
+}
+
+static unsigned int TypeElementSize(char type)
+{
+	switch (type)
+	{
+		case 'v': return sizeof(dVector);
+		case 'c': return sizeof(dColour);
+		case 'f': return sizeof(float);
+		case 'm': return sizeof(dMatrix);
+	}
+	return 0;
+}
+
+BinaryPrimitiveIO::BinaryPrimitiveIO()
+{
+}
+
+BinaryPrimitiveIO::~BinaryPrimitiveIO()
+{
+}
+
+Primitive *BinaryPrimitiveIO::FormatRead(const std::string &filename)
+{
+	MappedFile file;
+	if (!file.Open(filename))
+	{
+		Trace::Stream<<"Cannot open .fxm file: "<<filename<<endl;
+		return NULL;
+	}
+	return Read(file,filename);
+}
+
+bool BinaryPrimitiveIO::FormatWrite(const std::string &filename, const Primitive *ob)
+{
+	return Write(filename,ob,0,0);
+}
+
+bool BinaryPrimitiveIO::WriteCache(const std::string &filename, const std::string &source, const Primitive *ob)
+{
+	unsigned int size, stamp;
+	if (!GetSourceStamp(source,size,stamp)) return false;
+	return Write(filename,ob,size,stamp);
+}
+
+Primitive *BinaryPrimitiveIO::ReadCache(const std::string &filename, const std::string &source)
+{
+	unsigned int size, stamp;
+	if (!GetSourceStamp(source,size,stamp)) return NULL;
+
+	MappedFile file;
+	if (!file.Open(filename) || file.GetSize()<sizeof(Header)) return NULL;
+
+	Header header;
+	memcpy(&header,file.GetData(),sizeof(Header));
+	if (header.SourceSize!=size || header.SourceStamp!=stamp) return NULL;
+	return Read(file,filename);
+}
+
+bool BinaryPrimitiveIO::GetSourceStamp(const std::string &source, unsigned int &size, unsigned int &stamp)
+{
+	struct stat info;
+	if (stat(source.c_str(),&info)!=0) return false;
+
+	// a hash of the modification time, as time_t can be bigger than we store
+	unsigned long long mtime=info.st_mtime;
+	size=info.st_size;
+	stamp=2166136261u;
+	for (unsigned int i=0; i<sizeof(mtime); i++)
+	{
+		stamp=(stamp^((mtime>>(i*8))&0xff))*16777619u;
+	}
+	return true;
+}
+
+bool BinaryPrimitiveIO::Write(const std::string &filename, const Primitive *ob, unsigned int sourcesize, unsigned int sourcestamp)
+{
+	Header header;
+	memcpy(header.Magic,FXM_MAGIC,4);
+	header.Version=FXM_VERSION;
+	header.PolyType=0;
+	header.Indexed=0;
+	header.NumIndices=0;
+	header.NumVerts=ob->Size();
+	header.SourceSize=sourcesize;
+	header.SourceStamp=sourcestamp;
+
+	const PolyPrimitive *pp = dynamic_cast<const PolyPrimitive*>(ob);
+	if (pp)
+	{
+		header.Kind=POLY;
+		header.PolyType=pp->GetType();
+		header.Indexed=pp->IsIndexed();
+		header.NumIndices=pp->GetIndexConst().size();
+	}
+	else if (dynamic_cast<const ParticlePrimitive*>(ob))
+	{
+		header.Kind=PARTICLES;
+	}
+	else
+	{
+		Trace::Stream<<"Can only save .fxm files from PolyPrimitives or ParticlePrimitives"<<endl;
+		return false;
+	}
+
+	// only the arrays of types we know about are written
+	vector<string> names;
+	vector<const PData*> arrays;
+	vector<string> allnames;
+	ob->GetDataNames(allnames);
+	for (vector<string>::iterator i=allnames.begin(); i!=allnames.end(); ++i)
+	{
+		const PData *pd = ob->GetDataRawConst(*i);
+		if (pd && PDataContainer::GetDataType(pd)!=0 && pd->Size()==header.NumVerts)
+		{
+			names.push_back(*i);
+			arrays.push_back(pd);
+		}
+	}
+	header.NumArrays=arrays.size();
+
+	FILE *file = fopen(filename.c_str(),"wb");
+	if (file==NULL)
+	{
+		// caches may well be next to read only files, so keep quiet about those
+		if (sourcestamp==0) Trace::Stream<<"Cannot open .fxm file: "<<filename<<endl;
+		return false;
+	}
+
+	bool ok = fwrite(&header,sizeof(Header),1,file)==1;
+	const char padding[4]={0,0,0,0};
+	for (unsigned int i=0; i<arrays.size() && ok; i++)
+	{
+		ArrayHeader ah;
+		ah.NameLength=names[i].size();
+		ah.Type=PDataContainer::GetDataType(arrays[i]);
+		ah.ElementSize=arrays[i]->ElementSize();
+		ok = fwrite(&ah,sizeof(ArrayHeader),1,file)==1 &&
+			 fwrite(names[i].c_str(),1,ah.NameLength,file)==ah.NameLength &&
+			 fwrite(padding,1,Pad4(ah.NameLength)-ah.NameLength,file)==Pad4(ah.NameLength)-ah.NameLength;
+		if (ok && header.NumVerts>0)
+		{
+			ok = fwrite(arrays[i]->RawData(),ah.ElementSize,header.NumVerts,file)==header.NumVerts;
+		}
+	}
+
+	if (ok && header.NumIndices>0)
+	{
+		ok = fwrite(&pp->GetIndexConst()[0],sizeof(unsigned int),header.NumIndices,file)==header.NumIndices;
+	}
+
+	fclose(file);
+	if (!ok)
+	{
+		Trace::Stream<<"Error writing .fxm file: "<<filename<<endl;
+		remove(filename.c_str());
+	}
+	return ok;
+}
+
+Primitive *BinaryPrimitiveIO::Read(const MappedFile &file, const std::string &filename)
+{
+	const char *pos = file.GetData();
+	const char *end = pos+file.GetSize();
+
+	Header header;
+	if (file.GetSize()<sizeof(Header)) 
+	{
+		Trace::Stream<<"Not an .fxm file: "<<filename<<endl;
+		return NULL;
+	}
+	memcpy(&header,pos,sizeof(Header));
+	pos+=sizeof(Header);
+	
+	if (memcmp(header.Magic,FXM_MAGIC,4)!=0 || header.Version!=FXM_VERSION)
+	{
+		Trace::Stream<<"Not an .fxm file, or the wrong version: "<<filename<<endl;
+		return NULL;
+	}
+
+	if ((header.Kind!=POLY || header.PolyType>PolyPrimitive::POLYGON) && header.Kind!=PARTICLES) 
+	{
+		Trace::Stream<<"Unknown primitive in .fxm file: "<<filename<<endl;
+		return NULL;
+	}
+
+	// nothing is allocated until we know the sizes are 
+	// backed by data in the file
+	if (!Validate(header,pos,end))
+	{
+		Trace::Stream<<"Corrupt .fxm file: "<<filename<<endl;
+		return NULL;
+	}
+
+	Primitive *prim = NULL;
+	if (header.Kind==POLY) prim = new PolyPrimitive((PolyPrimitive::Type)header.PolyType);
+	else prim = new ParticlePrimitive;
+
+	prim->Resize(header.NumVerts);
+
+	for (unsigned int i=0; i<header.NumArrays; i++)
+	{
+		ArrayHeader ah;
+		memcpy(&ah,pos,sizeof(ArrayHeader));
+		pos+=sizeof(ArrayHeader);
+
+		unsigned int datasize = ah.ElementSize*header.NumVerts;
+		string name(pos,ah.NameLength);
+		pos+=Pad4(ah.NameLength);
+
+		PData *pd = NULL;
+		switch (ah.Type)
+		{
+			case 'v': pd = MakeArray<dVector>(pos,header.NumVerts); break;
+			case 'c': pd = MakeArray<dColour>(pos,header.NumVerts); break;
+			case 'f': pd = MakeArray<float>(pos,header.NumVerts); break;
+			case 'm': pd = MakeArray<dMatrix>(pos,header.NumVerts); break;
+		}
+		pos+=datasize;
+
+		if (prim->GetDataRawConst(name)!=NULL) prim->SetDataRaw(name,pd);
+		else prim->AddData(name,pd);
+	}
+
+	PolyPrimitive *pp = dynamic_cast<PolyPrimitive*>(prim);
+	if (pp && header.NumIndices>0)
+	{
+		vector<unsigned int> &index = pp->GetIndex();
+		index.resize(header.NumIndices);
+		memcpy(&index[0],pos,header.NumIndices*sizeof(unsigned int));
+	}
+	if (pp) pp->SetIndexMode(header.Indexed!=0);
+
+	return prim;
+}
+
+bool BinaryPrimitiveIO::Validate(const Header &header, const char *pos, const char *end)
+{
+	// every vertex has to be in at least one array
+	if (header.NumVerts>0 && header.NumArrays==0) return false;
+
+	for (unsigned int i=0; i<header.NumArrays; i++)
+	{
+		if ((uint64_t)(end-pos)<sizeof(ArrayHeader)) return false;
+		ArrayHeader ah;
+		memcpy(&ah,pos,sizeof(ArrayHeader));
+		pos+=sizeof(ArrayHeader);
+
+		if (ah.ElementSize==0 || ah.ElementSize!=TypeElementSize(ah.Type)) return false;
+
+		uint64_t remaining = end-pos;
+		uint64_t namesize = Pad4Wide(ah.NameLength);
+		uint64_t datasize = (uint64_t)ah.ElementSize*header.NumVerts;
+		if (namesize>remaining || datasize>remaining-namesize) return false;
+		pos+=namesize+datasize;
+	}
+
+	if (header.Kind==POLY && (uint64_t)header.NumIndices*sizeof(unsigned int)>(uint64_t)(end-pos)) 
+	{
+		return false;
+	}
+
+	// a stale or damaged index would have the renderer reading past the arrays
+	for (unsigned int i=0; header.Kind==POLY && i<header.NumIndices; i++)
+	{
+		unsigned int index;
+		memcpy(&index,pos+i*sizeof(unsigned int),sizeof(unsigned int));
+		if (index>=header.NumVerts) return false;
+	}
+	return true;
+}
@@ -0,0 +1,88 @@
+// Copyright (C) 2008 Dave Griffiths
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ 
+#ifndef FLUX_BINARY_PRIMITIVE_IO
+#define FLUX_BINARY_PRIMITIVE_IO
+
+#include "PrimitiveIO.h"
+
+namespace Fluxus
+{
+
+class MappedFile;
+
+//////////////////////////////////////////////////////
+/// Reads and writes the fluxus binary mesh format 
+/// (.fxm), which is the pdata arrays and index of a 
+/// primitive exactly as they are held in memory, so 
+/// loading is a copy rather than a parse. It's used to 
+/// cache slow to parse formats (see PrimitiveIO::Read), 
+/// and files are only meant to be read back on the 
+/// same sort of machine that wrote them.
+///
+/// The layout is a Header, then for each pdata array an
+/// ArrayHeader, the name padded to 4 bytes and the raw 
+/// elements, followed by the index data.
+class BinaryPrimitiveIO : public PrimitiveIO
+{
+public:
+	BinaryPrimitiveIO();
+	virtual ~BinaryPrimitiveIO();
+	virtual Primitive *FormatRead(const std::string &filename);
+	virtual bool FormatWrite(const std::string &filename, const Primitive *ob);
+
+	/// Writes a cache file for a primitive read from the source 
+	/// file, stamped with the source's size and modification time
+	static bool WriteCache(const std::string &filename, const std::string &source, const Primitive *ob);
+	
+	/// Reads a cache file, returns NULL if it doesn't exist or
+	/// the source has changed since it was written
+	static Primitive *ReadCache(const std::string &filename, const std::string &source);
+	
+private:
+	enum Kind{POLY,PARTICLES};
+
+	struct Header
+	{
+		char Magic[4];
+		unsigned int Version;
+		unsigned int Kind;
+		unsigned int PolyType;
+		unsigned int Indexed;
+		unsigned int NumVerts;
+		unsigned int NumIndices;
+		unsigned int NumArrays;
+		unsigned int SourceSize;
+		unsigned int SourceStamp;
+	};
+
+	struct ArrayHeader
+	{
+		unsigned int NameLength;
+		unsigned int Type;
+		unsigned int ElementSize;
+	};
+
+	static bool GetSourceStamp(const std::string &source, unsigned int &size, unsigned int &stamp);
+	static bool Write(const std::string &filename, const Primitive *ob, unsigned int sourcesize, unsigned int sourcestamp);
+	static Primitive *Read(const MappedFile &file, const std::string &filename);
+	/// Checks the array table and index fit in the data after the header
+	static bool Validate(const Header &header, const char *pos, const char *end);
+};
+
+}
+
+#endif
@@ -14,13 +14,36 @@
 // along with this program; if not, write to the Free Software
 // Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
 
+#include <float.h>
 #include "Renderer.h"
 #include "BlobbyPrimitive.h"
 #include "State.h"
 #include "ImplicitSurface.h"
 
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
 using namespace Fluxus;
 
+// influences are cut off where they fall to this fraction of the isolevel
+static const float BLOBBY_CUTOFF=1/256.0f;
+
+// the corners of each cell, in grid steps
+static const int CornerCoords[8][3] = { {0,1,0}, {0,1,1}, {0,0,1}, {0,0,0}, 
+										{1,1,0}, {1,1,1}, {1,0,1}, {1,0,0} };
+
+// the corners at the end of each of the 12 edges
+static const int EdgeCorners[12][2] = { {0,1}, {1,2}, {2,3}, {3,0}, {4,5}, {5,6}, 
+										{6,7}, {7,4}, {0,4}, {1,5}, {2,6}, {3,7} };
+
+static int ClampIndex(float v, int max)
+{
+	if (v<0) return 0;
+	if (v>max) return max;
+	return (int)v;
+}
+
 BlobbyPrimitive::BlobbyPrimitive(int dimx, int dimy, int dimz, dVector size) :
     m_LockVoxels(false)
 {
@@ -31,50 +54,20 @@ BlobbyPrimitive::BlobbyPrimitive(int dimx, int dimy, int dimz, dVector size) :
 	// setup the direct access for speed
 	PDataDirty();
 
-	float sx=size.x/(float)dimx;
-	float sy=size.y/(float)dimy;
-	float sz=size.z/(float)dimz;
-
 	m_Width = dimx;
 	m_Height = dimy;
 	m_Depth = dimz;
-
-	for (int x=0; x<dimx; x++)
-	{
-		for (int y=0; y<dimy; y++)
-		{
-			for (int z=0; z<dimz; z++)
-			{
-				Cell cell;
-
-				cell.p[0]=dVector(sx*x,sy*y+sy,sz*z);
-				cell.p[1]=dVector(sx*x,sy*y+sy,sz*z+sz);
-				cell.p[2]=dVector(sx*x,sy*y,sz*z+sz);
-				cell.p[3]=dVector(sx*x,sy*y,sz*z);
-
-				cell.p[4]=dVector(sx*x+sx,sy*y+sy,sz*z);
-				cell.p[5]=dVector(sx*x+sx,sy*y+sy,sz*z+sz);
-				cell.p[6]=dVector(sx*x+sx,sy*y,sz*z+sz);
-				cell.p[7]=dVector(sx*x+sx,sy*y,sz*z);
-
-				cell.val[0]=0;
-				cell.val[1]=0;
-				cell.val[2]=0;
-				cell.val[3]=0;
-				cell.val[4]=0;
-				cell.val[5]=0;
-				cell.val[6]=0;
-				cell.val[7]=0;
-
-				m_Voxels.push_back(cell);
-			}
-		}
-	}
+	m_CellSize = dVector(size.x/(float)dimx, size.y/(float)dimy, size.z/(float)dimz);
 }
 
 BlobbyPrimitive::BlobbyPrimitive(const BlobbyPrimitive &other) :
 Primitive(other),
-m_Voxels(other.m_Voxels)
+m_Voxels(other.m_Voxels),
+m_Width(other.m_Width),
+m_Height(other.m_Height),
+m_Depth(other.m_Depth),
+m_CellSize(other.m_CellSize),
+m_LockVoxels(other.m_LockVoxels)
 {
 	PDataDirty();
 }
@@ -103,65 +96,43 @@ void BlobbyPrimitive::AddInfluence(const dVector &Vert, float Strength)
 	m_ColData->push_back(dColour(1,1,1)); 
 }	
 
-float BlobbyPrimitive::Sample(const dVector &pos)
+vector<BlobbyPrimitive::Cell> &BlobbyPrimitive::GetVoxels()
 {
-	float val=0;
-	for (unsigned int n=0; n<m_PosData->size(); n++)
-	{
-		float distance=fabs((*m_PosData)[n].distsq(pos));
-		if (distance>0)
-		{
-			val+=(*m_StrengthData)[n]*(1/distance);
-		}
-	}
-	return val;
+	if (m_Voxels.empty()) BuildVoxels();
+	return m_Voxels;
 }
 
-float BlobbyPrimitive::SampleCol(const dVector &pos, dColour &col)
+void BlobbyPrimitive::BuildVoxels()
 {
-	float val=0;
-	col=dColour(0,0,0);
-	
-	for (unsigned int n=0; n<m_PosData->size(); n++)
+	m_Voxels.resize(m_Width*m_Height*m_Depth);
+	unsigned int i=0;
+	for (unsigned int x=0; x<m_Width; x++)
 	{
-		float distance=fabs((*m_PosData)[n].distsq(pos));
-		if (distance>0)
+		for (unsigned int y=0; y<m_Height; y++)
 		{
-			float mul=1/distance;
-			val+=(*m_StrengthData)[n]*mul;
-			
-			//col+=(*m_ColData)[n]*mul;
-
-			col.r+=(*m_ColData)[n].r*mul;
-			col.g+=(*m_ColData)[n].g*mul;
-			col.b+=(*m_ColData)[n].b*mul;
+			for (unsigned int z=0; z<m_Depth; z++)
+			{
+				Cell &cell=m_Voxels[i++];
+				for (int c=0; c<8; c++)
+				{
+					cell.p[c]=dVector((x+CornerCoords[c][0])*m_CellSize.x,
+									  (y+CornerCoords[c][1])*m_CellSize.y,
+									  (z+CornerCoords[c][2])*m_CellSize.z);
+					cell.val[c]=0;
+				}
+			}
 		}
-	}		
-	return val;	
+	}
 }
 
 void BlobbyPrimitive::Render()
 {
-
-    if (!m_LockVoxels)
-    {
-        for (unsigned int i=0; i<m_Voxels.size(); i++)
-        {
-            for (int c=0; c<8; c++)
-            {
-                dVector pos = m_Voxels[i].p[c];
-                
-                if (m_State.Hints & HINT_VERTCOLS)
-                {
-                    m_Voxels[i].val[c]=SampleCol(pos,m_Voxels[i].col[c]);
-                }
-                else
-                {
-                    m_Voxels[i].val[c]=Sample(pos);
-                }
-            }
-        }
-    }
+	bool colour=m_State.Hints & HINT_VERTCOLS;
+	if (m_State.Hints & (HINT_SOLID|HINT_WIRE))
+	{
+		EvaluateField(1,colour);
+		Polygonise(1,colour);
+	}
 
 	if (m_State.Hints & HINT_SPHERE_MAP)
 	{
@@ -171,15 +142,26 @@ void BlobbyPrimitive::Render()
 		glTexGeni(GL_T, GL_TEXTURE_GEN_MODE, GL_SPHERE_MAP);
 	}
 
+	glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+	
 	if (m_State.Hints & HINT_SOLID)
 	{
-		glBegin(GL_TRIANGLES);
-		Draw(1, true, m_State.Hints & HINT_VERTCOLS);
-		glEnd();
+		if (colour) glEnableClientState(GL_COLOR_ARRAY);
+		else glDisableClientState(GL_COLOR_ARRAY);
+		
+		for (vector<Mesh>::iterator i=m_Slabs.begin(); i!=m_Slabs.end(); ++i)
+		{
+			if (i->Points.empty()) continue;
+			glVertexPointer(3,GL_FLOAT,sizeof(dVector),i->Points[0].arr());
+			glNormalPointer(GL_FLOAT,sizeof(dVector),i->Normals[0].arr());
+			if (colour) glColorPointer(3,GL_FLOAT,sizeof(dColour),i->Colours[0].arr());
+			glDrawArrays(GL_TRIANGLES,0,i->Points.size());
+		}
 	}
 
 	if (m_State.Hints & HINT_WIRE)
 	{
+		glDisableClientState(GL_COLOR_ARRAY);
 		glPolygonOffset(1,1);
 		glColor4fv(m_State.WireColour.arr());
 		glPolygonMode(GL_FRONT_AND_BACK,GL_LINE);
@@ -189,9 +171,13 @@ void BlobbyPrimitive::Render()
 			glEnable(GL_LINE_STIPPLE);
 			glLineStipple(m_State.StippleFactor, m_State.StipplePattern);
 		}
-		glBegin(GL_TRIANGLES);
-		Draw(1, false, false);
-		glEnd();
+		for (vector<Mesh>::iterator i=m_Slabs.begin(); i!=m_Slabs.end(); ++i)
+		{
+			if (i->Points.empty()) continue;
+			glVertexPointer(3,GL_FLOAT,sizeof(dVector),i->Points[0].arr());
+			glNormalPointer(GL_FLOAT,sizeof(dVector),i->Normals[0].arr());
+			glDrawArrays(GL_TRIANGLES,0,i->Points.size());
+		}
 		glPolygonMode(GL_FRONT_AND_BACK,GL_FILL);
 		glEnable(GL_LIGHTING);
 		if ((m_State.Hints & HINT_WIRE_STIPPLED) > HINT_WIRE)
@@ -200,6 +186,9 @@ void BlobbyPrimitive::Render()
 		}
 	}
 
+	glDisableClientState(GL_COLOR_ARRAY);
+	glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+	
 	if (m_State.Hints & HINT_SPHERE_MAP)
 	{
 		glDisable(GL_TEXTURE_GEN_S);
@@ -245,284 +234,332 @@ void BlobbyPrimitive::ApplyTransform(bool ScaleRotOnly)
 
 // this implicit surface implementation is modified from Paul Bourke's which can be found here:
 // http://astronomy.swin.edu.au/~pbourke/modelling/polygonise/
+//
+// the field is sampled once per cell corner rather than eight times per cell,
+// and each influence only adds into the points within it's radius of effect. 
+// the influence is 1/distsq, which never reaches zero, so it's cut off where 
+// it falls to BLOBBY_CUTOFF of the isolevel - lots of tiny overlapping blobs 
+// will come out a little smaller than they used to
 
-void BlobbyPrimitive::Draw(float isolevel, bool calcnormals, bool colour)
+void BlobbyPrimitive::EvaluateField(float isolevel, bool colour)
 {
-   int i;
-   int cubeindex;
-   dVertex vertlist[12];
-
-	for (unsigned int cell=0; cell<m_Voxels.size(); cell++)
-	{ 
-		//  Determine the index into the edge table which
-		//  tells us which vertices are inside of the surface
-		cubeindex = 0;
-		if (m_Voxels[cell].val[0] < isolevel) cubeindex |= 1;
-		if (m_Voxels[cell].val[1] < isolevel) cubeindex |= 2;
-		if (m_Voxels[cell].val[2] < isolevel) cubeindex |= 4;
-		if (m_Voxels[cell].val[3] < isolevel) cubeindex |= 8;
-		if (m_Voxels[cell].val[4] < isolevel) cubeindex |= 16;
-		if (m_Voxels[cell].val[5] < isolevel) cubeindex |= 32;
-		if (m_Voxels[cell].val[6] < isolevel) cubeindex |= 64;
-		if (m_Voxels[cell].val[7] < isolevel) cubeindex |= 128;
+	unsigned int gridsize=(m_Width+1)*(m_Height+1)*(m_Depth+1);
+	if (m_Field.size()!=gridsize)
+	{
+		m_Field.resize(gridsize);
+		m_RowStart.resize((m_Width+1)*(m_Height+1));
+		m_RowEnd.resize((m_Width+1)*(m_Height+1));
+	}
+	if (colour && m_FieldCol.size()!=gridsize) m_FieldCol.resize(gridsize);
+	if (m_LockVoxels && m_Voxels.empty()) BuildVoxels();
 
-		// Cube is entirely in/out of the surface 
-		if (ImplicitSurfaceEdges[cubeindex] != 0)
+	m_Influences.clear();
+	if (!m_LockVoxels)
+	{
+		int max[3] = { (int)m_Width, (int)m_Height, (int)m_Depth };
+		for (unsigned int n=0; n<m_PosData->size(); n++)
 		{
+			Influence inf;
+			inf.Pos=(*m_PosData)[n];
+			inf.Col=(*m_ColData)[n];
+			inf.Strength=(*m_StrengthData)[n];
+			if (inf.Strength==0) continue;
 
-			// Find the vertices where the surface intersects the cube
-			if (ImplicitSurfaceEdges[cubeindex] & 1) Interpolate(vertlist[0],isolevel,cell,0,1);
-			if (ImplicitSurfaceEdges[cubeindex] & 2) Interpolate(vertlist[1],isolevel,cell,1,2);
-			if (ImplicitSurfaceEdges[cubeindex] & 4) Interpolate(vertlist[2],isolevel,cell,2,3);
-			if (ImplicitSurfaceEdges[cubeindex] & 8) Interpolate(vertlist[3],isolevel,cell,3,0);
-			if (ImplicitSurfaceEdges[cubeindex] & 16) Interpolate(vertlist[4],isolevel,cell,4,5);
-			if (ImplicitSurfaceEdges[cubeindex] & 32) Interpolate(vertlist[5],isolevel,cell,5,6);
-			if (ImplicitSurfaceEdges[cubeindex] & 64) Interpolate(vertlist[6],isolevel,cell,6,7);
-			if (ImplicitSurfaceEdges[cubeindex] & 128) Interpolate(vertlist[7],isolevel,cell,7,4);
-			if (ImplicitSurfaceEdges[cubeindex] & 256) Interpolate(vertlist[8],isolevel,cell,0,4);
-			if (ImplicitSurfaceEdges[cubeindex] & 512) Interpolate(vertlist[9],isolevel,cell,1,5);
-			if (ImplicitSurfaceEdges[cubeindex] & 1024) Interpolate(vertlist[10],isolevel,cell,2,6);
-			if (ImplicitSurfaceEdges[cubeindex] & 2048) Interpolate(vertlist[11],isolevel,cell,3,7);
-
-			// Create the triangle 
-			for (i=0; ImplicitSurfaceTriangles[cubeindex][i]!=-1; i+=3) 
+			if (isolevel>0)
+			{
+				inf.RadiusSq=fabs(inf.Strength)/(isolevel*BLOBBY_CUTOFF);
+			}
+			else // no cutoff, everything is inside
 			{
-				dVertex a=vertlist[ImplicitSurfaceTriangles[cubeindex][i]];
-				dVertex b=vertlist[ImplicitSurfaceTriangles[cubeindex][i+1]];
-				dVertex c=vertlist[ImplicitSurfaceTriangles[cubeindex][i+2]];
+				inf.RadiusSq=FLT_MAX;
+			}
 			
-				dVector normal;
-				float val=0;
-				
-				if (calcnormals)
-   				{
-					val=Sample(a.point);
-					normal.x=val-Sample(a.point+dVector(0.001,0,0));
-					normal.y=val-Sample(a.point+dVector(0,0.001,0));
-					normal.z=val-Sample(a.point+dVector(0,0,0.001));
-					normal.normalise();
-					glNormal3fv(normal.arr());
-				}
-				
-				if (colour) glColor3fv(a.col.arr());
-   				glVertex3fv(a.point.arr());
-				
-				if (calcnormals)
-   				{
-					val=Sample(b.point);
-					normal.x=val-Sample(b.point+dVector(0.001,0,0));
-					normal.y=val-Sample(b.point+dVector(0,0.001,0));
-					normal.z=val-Sample(b.point+dVector(0,0,0.001));
-					normal.normalise();
-					glNormal3fv(normal.arr());
-				}
-				
- 				if (colour) glColor3fv(b.col.arr());
-				glVertex3fv(b.point.arr());
-				
-				if (calcnormals)
-   				{
-					val=Sample(c.point);
-					normal.x=val-Sample(c.point+dVector(0.001,0,0));
-					normal.y=val-Sample(c.point+dVector(0,0.001,0));
-					normal.z=val-Sample(c.point+dVector(0,0,0.001));
-					normal.normalise();
-					glNormal3fv(normal.arr());
-				}
-				
-				if (colour) glColor3fv(c.col.arr());
-				glVertex3fv(c.point.arr());
+			// the grid points inside the radius, skipping 
+			// influences which miss the grid entirely
+			float radius=sqrtf(inf.RadiusSq);
+			bool inside=true;
+			for (int a=0; a<3; a++)
+			{
+				float lo=ceilf((inf.Pos.arr()[a]-radius)/m_CellSize.arr()[a]);
+				float hi=floorf((inf.Pos.arr()[a]+radius)/m_CellSize.arr()[a]);
+				if (hi<0 || lo>max[a] || lo>hi) inside=false;
+				inf.Min[a]=ClampIndex(lo,max[a]);
+				inf.Max[a]=ClampIndex(hi,max[a]);
 			}
+			if (inside) m_Influences.push_back(inf);
 		}
 	}
+
+	FieldJob job(*this,colour);
+	WorkerPool::Get()->Run(job,m_Width+1,1);
 }
 
-// generate a poly mesh
-void BlobbyPrimitive::ConvertToPoly(PolyPrimitive &poly, float isolevel)
+void BlobbyPrimitive::FieldJob::Run(unsigned int start, unsigned int end)
 {
-	if (!m_LockVoxels)
+	BlobbyPrimitive &b=m_Blobby;
+	unsigned int planesize=(b.m_Height+1)*(b.m_Depth+1);
+	
+	for (unsigned int x=start; x<end; x++)
 	{
-		// evaluate the field
-		for (unsigned int i=0; i<m_Voxels.size(); i++)
+		float *plane=&b.m_Field[x*planesize];
+		dColour *colplane=m_Colour?&b.m_FieldCol[x*planesize]:NULL;
+		int *rowstart=&b.m_RowStart[x*(b.m_Height+1)];
+		int *rowend=&b.m_RowEnd[x*(b.m_Height+1)];
+	
+		if (b.m_LockVoxels)
 		{
-			for (int c=0; c<8; c++)
-			{
-				dVector pos = m_Voxels[i].p[c];
+			Gather(x);
+			continue;
+		}
 
-				if (m_State.Hints & HINT_VERTCOLS)
-				{
-					m_Voxels[i].val[c]=SampleCol(pos,m_Voxels[i].col[c]);
-				}
-				else
-				{
-					m_Voxels[i].val[c]=Sample(pos);
-				}
+		memset(plane,0,planesize*sizeof(float));
+		if (m_Colour)
+		{
+			for (unsigned int i=0; i<planesize; i++) colplane[i]=dColour(0,0,0);
+		}
+		for (unsigned int y=0; y<=b.m_Height; y++)
+		{
+			rowstart[y]=b.m_Depth+1;
+			rowend[y]=-1;
+		}
+
+		for (vector<Influence>::const_iterator i=b.m_Influences.begin(); i!=b.m_Influences.end(); ++i)
+		{
+			if ((int)x<i->Min[0] || (int)x>i->Max[0]) continue;
+			
+			float dx=x*b.m_CellSize.x-i->Pos.x;
+			for (int y=i->Min[1]; y<=i->Max[1]; y++)
+			{
+				float dy=y*b.m_CellSize.y-i->Pos.y;
+				float distxy=dx*dx+dy*dy;
+				if (distxy>=i->RadiusSq) continue;
+				
+				// just the span of this row inside the radius
+				float dz=sqrtf(i->RadiusSq-distxy);
+				int zstart=ClampIndex(ceilf((i->Pos.z-dz)/b.m_CellSize.z),b.m_Depth);
+				int zend=ClampIndex(floorf((i->Pos.z+dz)/b.m_CellSize.z),b.m_Depth);
+				if (i->Pos.z+dz<0 || zstart>zend) continue;
+
+				unsigned int row=y*(b.m_Depth+1);
+				Accumulate(plane+row,colplane?colplane+row:NULL,zstart,zend+1,distxy,*i);
+				if (zstart<rowstart[y]) rowstart[y]=zstart;
+				if (zend>rowend[y]) rowend[y]=zend;
 			}
 		}
 	}
+}
 
-	int i;
-	int cubeindex;
-	dVertex vertlist[12];
-	dVector grads[12]; // gradient calculated from field values
-
-	for (unsigned int cell=0; cell<m_Voxels.size(); cell++)
+void BlobbyPrimitive::FieldJob::Accumulate(float *field, dColour *col, int start, int end, float distxy, const Influence &inf)
+{
+	float sz=m_Blobby.m_CellSize.z;
+	int z=start;
+	
+#ifdef __SSE__
+	__m128 step=_mm_setr_ps(0,sz,sz*2,sz*3);
+	__m128 dxy=_mm_set1_ps(distxy);
+	__m128 radiussq=_mm_set1_ps(inf.RadiusSq);
+	__m128 strength=_mm_set1_ps(inf.Strength);
+	__m128 zero=_mm_setzero_ps();
+	__m128 one=_mm_set1_ps(1);
+	float weights[4];
+	
+	for (; z+4<=end; z+=4)
 	{
-		//  Determine the index into the edge table which
-		//  tells us which vertices are inside of the surface
-		cubeindex = 0;
-		if (m_Voxels[cell].val[0] < isolevel) cubeindex |= 1;
-		if (m_Voxels[cell].val[1] < isolevel) cubeindex |= 2;
-		if (m_Voxels[cell].val[2] < isolevel) cubeindex |= 4;
-		if (m_Voxels[cell].val[3] < isolevel) cubeindex |= 8;
-		if (m_Voxels[cell].val[4] < isolevel) cubeindex |= 16;
-		if (m_Voxels[cell].val[5] < isolevel) cubeindex |= 32;
-		if (m_Voxels[cell].val[6] < isolevel) cubeindex |= 64;
-		if (m_Voxels[cell].val[7] < isolevel) cubeindex |= 128;
-
-		// Cube is entirely in/out of the surface
-		if (ImplicitSurfaceEdges[cubeindex] != 0)
+		__m128 dz=_mm_add_ps(_mm_set1_ps(z*sz-inf.Pos.z),step);
+		__m128 distsq=_mm_add_ps(dxy,_mm_mul_ps(dz,dz));
+		__m128 inside=_mm_and_ps(_mm_cmpgt_ps(distsq,zero),_mm_cmplt_ps(distsq,radiussq));
+		__m128 w=_mm_and_ps(inside,_mm_div_ps(one,distsq));
+		_mm_storeu_ps(field+z,_mm_add_ps(_mm_loadu_ps(field+z),_mm_mul_ps(w,strength)));
+		
+		if (col!=NULL)
 		{
-			// Find the vertices where the surface intersects the cube
-			if (ImplicitSurfaceEdges[cubeindex] & 1) Interpolate(vertlist[0], grads[0], isolevel, cell, 0, 1);
-			if (ImplicitSurfaceEdges[cubeindex] & 2) Interpolate(vertlist[1], grads[1], isolevel, cell, 1, 2);
-			if (ImplicitSurfaceEdges[cubeindex] & 4) Interpolate(vertlist[2], grads[2], isolevel, cell, 2, 3);
-			if (ImplicitSurfaceEdges[cubeindex] & 8) Interpolate(vertlist[3], grads[3], isolevel, cell, 3, 0);
-			if (ImplicitSurfaceEdges[cubeindex] & 16) Interpolate(vertlist[4], grads[4], isolevel, cell, 4, 5);
-			if (ImplicitSurfaceEdges[cubeindex] & 32) Interpolate(vertlist[5], grads[5], isolevel, cell, 5, 6);
-			if (ImplicitSurfaceEdges[cubeindex] & 64) Interpolate(vertlist[6], grads[6], isolevel, cell, 6, 7);
-			if (ImplicitSurfaceEdges[cubeindex] & 128) Interpolate(vertlist[7], grads[7], isolevel, cell, 7, 4);
-			if (ImplicitSurfaceEdges[cubeindex] & 256) Interpolate(vertlist[8], grads[8], isolevel, cell, 0, 4);
-			if (ImplicitSurfaceEdges[cubeindex] & 512) Interpolate(vertlist[9], grads[9], isolevel, cell, 1, 5);
-			if (ImplicitSurfaceEdges[cubeindex] & 1024) Interpolate(vertlist[10], grads[10], isolevel, cell, 2, 6);
-			if (ImplicitSurfaceEdges[cubeindex] & 2048) Interpolate(vertlist[11], grads[11], isolevel, cell, 3, 7);
-
-			// Create the triangle
-			for (i=0; ImplicitSurfaceTriangles[cubeindex][i]!=-1; i+=3)
+			_mm_storeu_ps(weights,w);
+			for (int n=0; n<4; n++)
 			{
-				int idxa = ImplicitSurfaceTriangles[cubeindex][i];
-				int idxb = ImplicitSurfaceTriangles[cubeindex][i + 1];
-				int idxc = ImplicitSurfaceTriangles[cubeindex][i + 2];
-				dVertex a=vertlist[idxa];
-				dVertex b=vertlist[idxb];
-				dVertex c=vertlist[idxc];
-
-				dVector normal;
-				float val=0;
-
-				if (m_LockVoxels) // when converted from voxels use the cell gradient
-				{
-					normal = grads[idxa];
-				}
-				else
-				{
-					val=Sample(a.point);
-					normal.x=val-Sample(a.point+dVector(0.001,0,0));
-					normal.y=val-Sample(a.point+dVector(0,0.001,0));
-					normal.z=val-Sample(a.point+dVector(0,0,0.001));
-					normal.normalise();
-				}
-
-				poly.AddVertex(dVertex(a.point,normal,a.col));
-
-				if (m_LockVoxels)
-				{
-					normal = grads[idxb];
-				}
-				else
-				{
-					val=Sample(b.point);
-					normal.x=val-Sample(b.point+dVector(0.001,0,0));
-					normal.y=val-Sample(b.point+dVector(0,0.001,0));
-					normal.z=val-Sample(b.point+dVector(0,0,0.001));
-					normal.normalise();
-				}
-
-				poly.AddVertex(dVertex(b.point,normal,b.col));
-
-				if (m_LockVoxels)
-				{
-					normal = grads[idxc];
-				}
-				else
-				{
-					val=Sample(c.point);
-					normal.x=val-Sample(c.point+dVector(0.001,0,0));
-					normal.y=val-Sample(c.point+dVector(0,0.001,0));
-					normal.z=val-Sample(c.point+dVector(0,0,0.001));
-					normal.normalise();
-				}
+				col[z+n].r+=inf.Col.r*weights[n];
+				col[z+n].g+=inf.Col.g*weights[n];
+				col[z+n].b+=inf.Col.b*weights[n];
+			}
+		}
+	}
+#endif
 
-				poly.AddVertex(dVertex(c.point,normal,c.col));
+	for (; z<end; z++)
+	{
+		float dz=z*sz-inf.Pos.z;
+		float distsq=distxy+dz*dz;
+		if (distsq>0 && distsq<inf.RadiusSq)
+		{
+			float w=1/distsq;
+			field[z]+=inf.Strength*w;
+			if (col!=NULL)
+			{
+				col[z].r+=inf.Col.r*w;
+				col[z].g+=inf.Col.g*w;
+				col[z].b+=inf.Col.b*w;
 			}
 		}
 	}
 }
 
-//   Linearly interpolate the position where an isosurface cuts
-//   an edge between two vertices, each with their own scalar value
-void BlobbyPrimitive::Interpolate(dVertex &vert, float isolevel, int cell, int a, int b)
+// copy the locked voxel values into the grid, each grid point 
+// is read from the cell it's the lowest corner of, apart from
+// at the far edges where we use the other corners of the last cell
+void BlobbyPrimitive::FieldJob::Gather(unsigned int x)
+{
+	BlobbyPrimitive &b=m_Blobby;
+	unsigned int cx=x<b.m_Width?x:b.m_Width-1;
+	int ox=x<b.m_Width?0:1;
+	
+	for (unsigned int y=0; y<=b.m_Height; y++)
+	{
+		unsigned int cy=y<b.m_Height?y:b.m_Height-1;
+		int oy=y<b.m_Height?0:1;
+		
+		for (unsigned int z=0; z<=b.m_Depth; z++)
+		{
+			unsigned int cz=z<b.m_Depth?z:b.m_Depth-1;
+			int oz=z<b.m_Depth?0:1;
+			
+			int corner=0;
+			while (CornerCoords[corner][0]!=ox || CornerCoords[corner][1]!=oy || CornerCoords[corner][2]!=oz) corner++;
+			
+			const Cell &cell=b.m_Voxels[(cx*b.m_Height+cy)*b.m_Depth+cz];
+			b.m_Field[b.GridIndex(x,y,z)]=cell.val[corner];
+			if (m_Colour) b.m_FieldCol[b.GridIndex(x,y,z)]=cell.col[corner];
+		}
+		
+		b.m_RowStart[x*(b.m_Height+1)+y]=0;
+		b.m_RowEnd[x*(b.m_Height+1)+y]=b.m_Depth;
+	}
+}
+
+void BlobbyPrimitive::Polygonise(float isolevel, bool colour)
 {
-	float mu;
-
-	dVector posa = m_Voxels[cell].p[a];
-	dVector posb = m_Voxels[cell].p[b];
-	dColour cola = m_Voxels[cell].col[a];
-	dColour colb = m_Voxels[cell].col[b];
-	float vala = m_Voxels[cell].val[a];
-	float valb = m_Voxels[cell].val[b];
-
-	mu = (isolevel - vala) / (valb - vala);
-	vert.point.x = posa.x + mu * (posb.x - posa.x);
-	vert.point.y = posa.y + mu * (posb.y - posa.y);
-	vert.point.z = posa.z + mu * (posb.z - posa.z);
-
-	vert.col.r = cola.r + mu * (colb.r - cola.r);
-	vert.col.g = cola.g + mu * (colb.g - cola.g);
-	vert.col.b = cola.b + mu * (colb.b - cola.b);
+	m_Slabs.resize(m_Width);
+	MeshJob job(*this,isolevel,colour);
+	WorkerPool::Get()->Run(job,m_Width,1);
 }
 
-inline float BlobbyPrimitive::SafeVal(int cell, int a)
+void BlobbyPrimitive::MeshJob::Run(unsigned int start, unsigned int end)
 {
-	if ((cell >= 0) && ((unsigned)cell < m_Voxels.size()))
+	BlobbyPrimitive &b=m_Blobby;
+	for (unsigned int x=start; x<end; x++)
 	{
-		return m_Voxels[cell].val[a];
+		Mesh &mesh=b.m_Slabs[x];
+		mesh.Clear();
+		
+		for (unsigned int y=0; y<b.m_Height; y++)
+		{
+			// the cells which touch any of the four rows at their corners
+			int zstart=b.m_Depth+1;
+			int zend=-1;
+			for (int c=0; c<4; c++)
+			{
+				unsigned int row=(x+(c&1))*(b.m_Height+1)+y+(c>>1);
+				if (b.m_RowStart[row]<zstart) zstart=b.m_RowStart[row];
+				if (b.m_RowEnd[row]>zend) zend=b.m_RowEnd[row];
+			}
+			if (zstart>zend) continue;
+			if (zstart>0) zstart--;
+			if (zend>=(int)b.m_Depth) zend=b.m_Depth-1;
+			
+			Cells(x,y,zstart,zend+1,mesh);
+		}
 	}
-	else
+}
+
+void BlobbyPrimitive::MeshJob::Cells(unsigned int x, unsigned int y, int start, int end, Mesh &mesh)
+{
+	BlobbyPrimitive &b=m_Blobby;
+	
+	unsigned int offset[8];
+	for (int c=0; c<8; c++)
+	{
+		offset[c]=b.GridIndex(x+CornerCoords[c][0],y+CornerCoords[c][1],CornerCoords[c][2]);
+	}
+
+	dVector points[12];
+	dVector normals[12];
+	dColour colours[12];
+
+	for (int z=start; z<end; z++)
 	{
-		return 0;
+		float val[8];
+		int cubeindex=0;
+		for (int c=0; c<8; c++)
+		{
+			val[c]=b.m_Field[offset[c]+z];
+			if (val[c]<m_IsoLevel) cubeindex |= 1<<c;
+		}
+		
+		// Cube is entirely in/out of the surface 
+		int edges=ImplicitSurfaceEdges[cubeindex];
+		if (edges==0) continue;
+		
+		// Find the vertices where the surface intersects the cube
+		for (int e=0; e<12; e++)
+		{
+			if (!(edges & (1<<e))) continue;
+			
+			int ca=EdgeCorners[e][0];
+			int cb=EdgeCorners[e][1];
+			const int *ga=CornerCoords[ca];
+			const int *gb=CornerCoords[cb];
+			float mu=(m_IsoLevel-val[ca])/(val[cb]-val[ca]);
+			
+			dVector posa((x+ga[0])*b.m_CellSize.x,(y+ga[1])*b.m_CellSize.y,(z+ga[2])*b.m_CellSize.z);
+			dVector posb((x+gb[0])*b.m_CellSize.x,(y+gb[1])*b.m_CellSize.y,(z+gb[2])*b.m_CellSize.z);
+			points[e]=lerp(posa,posb,mu);
+			
+			normals[e]=lerp(b.Gradient(x+ga[0],y+ga[1],z+ga[2]),
+							b.Gradient(x+gb[0],y+gb[1],z+gb[2]),mu);
+			normals[e].normalise();
+			
+			if (m_Colour)
+			{
+				const dColour &cola=b.m_FieldCol[offset[ca]+z];
+				const dColour &colb=b.m_FieldCol[offset[cb]+z];
+				colours[e]=dColour(cola.r+mu*(colb.r-cola.r),
+								   cola.g+mu*(colb.g-cola.g),
+								   cola.b+mu*(colb.b-cola.b));
+			}
+		}
+
+		// Create the triangles
+		for (int i=0; ImplicitSurfaceTriangles[cubeindex][i]!=-1; i++) 
+		{
+			int e=ImplicitSurfaceTriangles[cubeindex][i];
+			mesh.Points.push_back(points[e]);
+			mesh.Normals.push_back(normals[e]);
+			if (m_Colour) mesh.Colours.push_back(colours[e]);
+		}
 	}
 }
 
-// Same as above, but also calculate the gradient
-void BlobbyPrimitive::Interpolate(dVertex &vert, dVector &grad, float isolevel, int cell, int a, int b)
+// central differences on the grid, pointing away from the blobs 
+dVector BlobbyPrimitive::Gradient(int x, int y, int z) const
 {
-	float mu;
-
-	dVector posa = m_Voxels[cell].p[a];
-	dVector posb = m_Voxels[cell].p[b];
-	dColour cola = m_Voxels[cell].col[a];
-	dColour colb = m_Voxels[cell].col[b];
-	float vala = m_Voxels[cell].val[a];
-	float valb = m_Voxels[cell].val[b];
-
-	dVector grada(SafeVal(cell - m_Depth * m_Height, a) - SafeVal(cell + m_Depth * m_Height, a),
-				  SafeVal(cell - m_Depth, a) - SafeVal(cell + m_Depth, a),
-				  SafeVal(cell - 1, a) - SafeVal(cell + 1, a));
-	dVector gradb(SafeVal(cell - m_Depth * m_Height, b) - SafeVal(cell + m_Depth * m_Height, b),
-				  SafeVal(cell - m_Depth, b) - SafeVal(cell + m_Depth, b),
-				  SafeVal(cell - 1, b) - SafeVal(cell + 1, b));
-
-	mu = (isolevel - vala) / (valb - vala);
-	vert.point.x = posa.x + mu * (posb.x - posa.x);
-	vert.point.y = posa.y + mu * (posb.y - posa.y);
-	vert.point.z = posa.z + mu * (posb.z - posa.z);
-
-	vert.col.r = cola.r + mu * (colb.r - cola.r);
-	vert.col.g = cola.g + mu * (colb.g - cola.g);
-	vert.col.b = cola.b + mu * (colb.b - cola.b);
-
-	grad = lerp(grada, gradb, mu);
-	grad.normalise();
+	int x0=x>0?x-1:x, x1=x<(int)m_Width?x+1:x;
+	int y0=y>0?y-1:y, y1=y<(int)m_Height?y+1:y;
+	int z0=z>0?z-1:z, z1=z<(int)m_Depth?z+1:z;
+	return dVector((m_Field[GridIndex(x0,y,z)]-m_Field[GridIndex(x1,y,z)])/m_CellSize.x,
+				   (m_Field[GridIndex(x,y0,z)]-m_Field[GridIndex(x,y1,z)])/m_CellSize.y,
+				   (m_Field[GridIndex(x,y,z0)]-m_Field[GridIndex(x,y,z1)])/m_CellSize.z);
 }
 
+// generate a poly mesh
+void BlobbyPrimitive::ConvertToPoly(PolyPrimitive &poly, float isolevel)
+{
+	bool colour=m_State.Hints & HINT_VERTCOLS;
+	EvaluateField(isolevel,colour);
+	Polygonise(isolevel,colour);
+
+	for (vector<Mesh>::iterator i=m_Slabs.begin(); i!=m_Slabs.end(); ++i)
+	{
+		for (unsigned int n=0; n<i->Points.size(); n++)
+		{
+			poly.AddVertex(dVertex(i->Points[n],i->Normals[n],colour?i->Colours[n]:dColour()));
+		}
+	}
+}
@@ -21,6 +21,7 @@
 
 #include "Primitive.h"
 #include "PolyPrimitive.h"
+#include "WorkerPool.h"
 
 namespace Fluxus
 {
@@ -67,21 +68,84 @@ public:
 		dColour col[8];
 	};
 
-	vector<Cell> &GetVoxels() { return m_Voxels; }
+	/// The old per cell voxel data, only used for setting the field
+	/// directly (with LockVoxels) so it's built the first time it's
+	/// asked for
+	vector<Cell> &GetVoxels();
 
     void LockVoxels() { m_LockVoxels=true; }
 
 protected:
 
-	void Draw(float isolevel, bool calcnormals, bool colour);
-	void Interpolate(dVertex &vert, float isolevel, int cell, int a, int b);
-	void Interpolate(dVertex &vert, dVector &grad, float isolevel, int cell, int a, int b);
-	float Sample(const dVector &pos);
-	float SampleCol(const dVector &pos, dColour &col);
-	inline float SafeVal(int cell, int a);
+	/// Sums the influences into the grid of cell corners. Each influence
+	/// only touches the grid points inside it's radius of effect, and 
+	/// the grid is split into x slabs which are run on the worker pool
+	void EvaluateField(float isolevel, bool colour);
+	
+	/// Marching cubes over the cells the field touched, into 
+	/// a triangle list per x slab
+	void Polygonise(float isolevel, bool colour);
+
+	void BuildVoxels();
 
 	virtual void PDataDirty();
 
+	/// Index into the field grid, which has a point per cell corner
+	unsigned int GridIndex(unsigned int x, unsigned int y, unsigned int z) const 
+		{ return (x*(m_Height+1)+y)*(m_Depth+1)+z; }
+	dVector Gradient(int x, int y, int z) const;
+	
+	/// An influence prepared for the field evaluation
+	class Influence
+	{
+	public:
+		dVector Pos;
+		dColour Col;
+		float Strength;
+		float RadiusSq;
+		int Min[3];
+		int Max[3];
+	};
+
+	/// The triangles for one x slab of cells, kept between 
+	/// frames so we don't reallocate them every time
+	class Mesh
+	{
+	public:
+		void Clear() { Points.clear(); Normals.clear(); Colours.clear(); }
+		vector<dVector> Points;
+		vector<dVector> Normals;
+		vector<dColour> Colours;
+	};
+
+	class FieldJob : public WorkerPool::Job
+	{
+	public:
+		FieldJob(BlobbyPrimitive &blobby, bool colour) : m_Blobby(blobby), m_Colour(colour) {}
+		virtual void Run(unsigned int start, unsigned int end);
+	private:
+		void Accumulate(float *field, dColour *col, int start, int end, float dist, const Influence &inf);
+		void Gather(unsigned int x);
+		BlobbyPrimitive &m_Blobby;
+		bool m_Colour;
+	};
+	
+	class MeshJob : public WorkerPool::Job
+	{
+	public:
+		MeshJob(BlobbyPrimitive &blobby, float isolevel, bool colour) : 
+			m_Blobby(blobby), m_IsoLevel(isolevel), m_Colour(colour) {}
+		virtual void Run(unsigned int start, unsigned int end);
+	private:
+		void Cells(unsigned int x, unsigned int y, int start, int end, Mesh &mesh);
+		BlobbyPrimitive &m_Blobby;
+		float m_IsoLevel;
+		bool m_Colour;
+	};
+
+	friend class FieldJob;
+	friend class MeshJob;
+
 	vector<dVector> *m_PosData;
 	vector<float> *m_StrengthData;
 	vector<dColour> *m_ColData;
@@ -90,6 +154,14 @@ protected:
 	unsigned m_Width;
 	unsigned m_Height;
 	unsigned m_Depth;
+	dVector m_CellSize;
+
+	vector<Influence> m_Influences;
+	vector<float> m_Field;
+	vector<dColour> m_FieldCol;
+	vector<int> m_RowStart; // range of z touched on each x,y row of the grid
+	vector<int> m_RowEnd;
+	vector<Mesh> m_Slabs;
 
     bool m_LockVoxels;
 };
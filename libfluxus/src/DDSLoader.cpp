@@ -28,14 +28,14 @@ using namespace Fluxus;
 using namespace std;
 
 void DDSLoader::Load(const string &Filename, TexturePainter::TextureDesc &desc,
-		vector<TexturePainter::TextureDesc> &mipmaps)
+		vector<TexturePainter::TextureDesc> &mipmaps, ostream &log)
 {
 	desc.ImageData = NULL;
 
 	FILE *fp = fopen(Filename.c_str(), "rb");
 	if (!fp || Filename == "")
 	{
-		Trace::Stream << "Couldn't open image [" << Filename << "]" << endl;
+		log << "Couldn't open image [" << Filename << "]" << endl;
 	}
 	else
 	{
@@ -44,7 +44,7 @@ void DDSLoader::Load(const string &Filename, TexturePainter::TextureDesc &desc,
 		fread(magic, 1, 4, fp);
 		if (strncmp(magic, "DDS ", 4) != 0)
 		{
-			Trace::Stream << "Couldn't find DDS filecode in image [" << Filename << "]" << endl;
+			log << "Couldn't find DDS filecode in image [" << Filename << "]" << endl;
 			goto failure;
 		}
 
@@ -108,7 +108,7 @@ void DDSLoader::Load(const string &Filename, TexturePainter::TextureDesc &desc,
 		}
 		else
 		{
-			Trace::Stream << "Couldn't determine image format [" << Filename << "]" << endl;
+			log << "Couldn't determine image format [" << Filename << "]" << endl;
 			goto failure;
 		}
 
@@ -23,6 +23,7 @@
 #include <vector>
 
 #include "TexturePainter.h"
+#include "Trace.h"
 #include "OpenGL.h"
 
 using namespace std;
@@ -33,8 +34,9 @@ namespace Fluxus
 class DDSLoader
 {
 	public:
+		/// Problems are written to log
 		static void Load(const string &Filename, TexturePainter::TextureDesc &desc,
-							vector<TexturePainter::TextureDesc> &mipmaps);
+							vector<TexturePainter::TextureDesc> &mipmaps, ostream &log=Trace::Stream);
 
 	private:
 		struct DDS_PIXELFORMAT
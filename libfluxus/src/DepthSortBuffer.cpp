@@ -0,0 +1,151 @@
+// Copyright (C) 2010 Dave Griffiths
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+
+
+#include "DepthSortBuffer.h"
+
+using namespace Fluxus;
+
+// below this many it's not worth using the worker threads
+static const unsigned int PARALLEL_SORT_SIZE=65536;
+static const unsigned int RADIX_BITS=8;
+static const unsigned int RADIX_SIZE=1<<RADIX_BITS;
+
+void DepthSortBuffer::Sort()
+{
+	unsigned int size=m_Keys.size();
+	m_Items.resize(size);
+	
+	// start from the order we had last frame if we can
+	if (m_Order.size()==size)
+	{
+		for (unsigned int n=0; n<size; n++)
+		{
+			m_Items[n].Key=m_Keys[m_Order[n]];
+			m_Items[n].Index=m_Order[n];
+		}
+		
+		if (!InsertionSort(size*2+16)) RadixSort();
+	}
+	else
+	{
+		for (unsigned int n=0; n<size; n++)
+		{
+			m_Items[n].Key=m_Keys[n];
+			m_Items[n].Index=n;
+		}
+		RadixSort();
+	}
+	
+	m_Order.resize(size);
+	for (unsigned int n=0; n<size; n++)
+	{
+		m_Order[n]=m_Items[n].Index;
+	}
+}
+
+bool DepthSortBuffer::InsertionSort(unsigned int maxmoves)
+{
+	unsigned int moves=0;
+	for (unsigned int i=1; i<m_Items.size(); i++)
+	{
+		Item item=m_Items[i];
+		unsigned int j=i;
+		while (j>0 && m_Items[j-1].Key>item.Key)
+		{
+			m_Items[j]=m_Items[j-1];
+			j--;
+		}
+		m_Items[j]=item;
+		
+		moves+=i-j;
+		if (moves>maxmoves) return false;
+	}
+	return true;
+}
+
+void DepthSortBuffer::RadixSort()
+{
+	unsigned int size=m_Items.size();
+	m_Temp.resize(size);
+	
+	unsigned int chunks=1;
+	if (size>=PARALLEL_SORT_SIZE) chunks=WorkerPool::Get()->GetNumThreads();
+	m_Counts.resize(chunks*RADIX_SIZE);
+	
+	for (unsigned int shift=0; shift<32; shift+=RADIX_BITS)
+	{
+		RadixJob job(*this,chunks,shift);
+		WorkerPool::Get()->Run(job,chunks,1);
+
+		// skip this pass if all the items have the same digit
+		bool same=false;
+		for (unsigned int d=0; d<RADIX_SIZE && !same; d++)
+		{
+			unsigned int total=0;
+			for (unsigned int c=0; c<chunks; c++) total+=m_Counts[c*RADIX_SIZE+d];
+			if (total==size) same=true;
+		}
+		if (same) continue;
+		
+		// turn the counts into where each chunk starts writing each digit
+		unsigned int offset=0;
+		for (unsigned int d=0; d<RADIX_SIZE; d++)
+		{
+			for (unsigned int c=0; c<chunks; c++)
+			{
+				unsigned int count=m_Counts[c*RADIX_SIZE+d];
+				m_Counts[c*RADIX_SIZE+d]=offset;
+				offset+=count;
+			}
+		}
+
+		job.m_Scatter=true;
+		WorkerPool::Get()->Run(job,chunks,1);
+		m_Items.swap(m_Temp);
+	}
+}
+
+void DepthSortBuffer::RadixJob::Run(unsigned int start, unsigned int end)
+{
+	vector<Item> &items=m_Buffer.m_Items;
+	unsigned int chunksize=(items.size()+m_Chunks-1)/m_Chunks;
+	
+	for (unsigned int c=start; c<end; c++)
+	{
+		unsigned int *counts=&m_Buffer.m_Counts[c*RADIX_SIZE];
+		unsigned int from=c*chunksize;
+		unsigned int to=from+chunksize;
+		if (to>items.size()) to=items.size();
+		
+		if (!m_Scatter)
+		{
+			for (unsigned int d=0; d<RADIX_SIZE; d++) counts[d]=0;
+			for (unsigned int n=from; n<to; n++)
+			{
+				counts[(items[n].Key>>m_Shift)&(RADIX_SIZE-1)]++;
+			}
+		}
+		else
+		{
+			vector<Item> &temp=m_Buffer.m_Temp;
+			for (unsigned int n=from; n<to; n++)
+			{
+				temp[counts[(items[n].Key>>m_Shift)&(RADIX_SIZE-1)]++]=items[n];
+			}
+		}
+	}
+}
@@ -0,0 +1,106 @@
+// Copyright (C) 2010 Dave Griffiths
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+
+
+#ifndef N_DEPTH_SORT_BUFFER
+#define N_DEPTH_SORT_BUFFER
+
+#include <vector>
+#include "WorkerPool.h"
+
+using namespace std;
+
+namespace Fluxus
+{
+
+//////////////////////////////////////////////////////
+/// Orders things back to front by their eye space depth,
+/// for rendering transparent primitives and particles.
+/// The buffers are kept from frame to frame, and last 
+/// frame's order is tried first, as it's usually only 
+/// slightly out - otherwise it's radix sorted.
+class DepthSortBuffer
+{
+public:
+	DepthSortBuffer() {}
+	
+	/// Starts a new frame, keeping last frame's order around
+	void Clear() { m_Keys.clear(); }
+	
+	/// Add the depth of the next thing, things are
+	/// numbered in the order they are added
+	void Add(float depth) { m_Keys.push_back(FloatKey(depth)); }
+	
+	/// Sort the depths added since Clear(), smallest first
+	void Sort();
+	
+	unsigned int Size() const { return m_Order.size(); }
+	
+	/// The number of the nth thing in sorted order
+	unsigned int operator[](unsigned int n) const { return m_Order[n]; }
+	
+	/// All of them in sorted order, for use as an index array
+	const vector<unsigned int> &GetOrder() const { return m_Order; }
+	
+private:
+
+	/// Flips the float's bits so they sort the same way as unsigned ints
+	static unsigned int FloatKey(float f)
+	{
+		union { float f; unsigned int i; } u;
+		u.f=f;
+		return (u.i & 0x80000000) ? ~u.i : u.i | 0x80000000;
+	}
+
+	class Item
+	{
+	public:
+		unsigned int Key;
+		unsigned int Index;
+	};
+
+	/// Gives up (returning false) if it's moved more than 
+	/// maxmoves items, when the radix sort would be quicker
+	bool InsertionSort(unsigned int maxmoves);
+	void RadixSort();
+	
+	/// Does a radix pass for each chunk of the items, with each
+	/// chunk counting and then scattering it's own items
+	class RadixJob : public WorkerPool::Job
+	{
+	public:
+		RadixJob(DepthSortBuffer &buffer, unsigned int chunks, unsigned int shift) :
+			m_Buffer(buffer), m_Chunks(chunks), m_Shift(shift), m_Scatter(false) {}
+		virtual void Run(unsigned int start, unsigned int end);
+		
+		DepthSortBuffer &m_Buffer;
+		unsigned int m_Chunks;
+		unsigned int m_Shift;
+		bool m_Scatter;
+	};
+	
+	friend class RadixJob;
+	
+	vector<unsigned int> m_Keys;
+	vector<unsigned int> m_Order;
+	vector<Item> m_Items;
+	vector<Item> m_Temp;
+	vector<unsigned int> m_Counts; // a histogram per chunk
+};
+
+}
+
+#endif
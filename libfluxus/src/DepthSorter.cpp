@@ -29,37 +29,39 @@ DepthSorter::~DepthSorter()
 void DepthSorter::Clear()
 {
 	m_RenderList.clear();
+	m_Sorter.Clear();
 }
 
 void DepthSorter::Add(const dMatrix &globaltransform, Primitive *prim, int id)
 {
-	Item item;
+	m_RenderList.push_back(Item());
+	Item &item=m_RenderList.back();
 	item.Prim=prim;
 	item.GlobalTransform=globaltransform;
 	item.ID=id;
 
-	dMatrix all=globaltransform*prim->GetState()->Transform;
-	dVector pos=all.transform(dVector(0,0,0));
-	item.Depth=pos.z;
-	m_RenderList.push_back(item);
+	// just the z of the primitive's origin
+	const dMatrix &t=prim->GetState()->Transform;
+	m_Sorter.Add(globaltransform.m[0][2]*t.m[3][0] + globaltransform.m[1][2]*t.m[3][1] + 
+				 globaltransform.m[2][2]*t.m[3][2] + globaltransform.m[3][2]*t.m[3][3]);
 }
 
 void DepthSorter::Render()
 {
-	m_RenderList.sort();
+	m_Sorter.Sort();
 
-	for(list<Item>::iterator i=m_RenderList.begin(); i!=m_RenderList.end(); i++)
+	for (unsigned int n=0; n<m_Sorter.Size(); n++)
 	{
+		Item &item=m_RenderList[m_Sorter[n]];
 		glPushMatrix();
-		glPushName(i->ID);
+		glPushName(item.ID);
 		glLoadIdentity();
-		glMultMatrixf(i->GlobalTransform.arr());
-		i->Prim->ApplyState();
-		i->Prim->Prerender();
-		i->Prim->Render();
-		i->Prim->UnapplyState();
+		glMultMatrixf(item.GlobalTransform.arr());
+		item.Prim->ApplyState();
+		item.Prim->Prerender();
+		item.Prim->Render();
+		item.Prim->UnapplyState();
 		glPopName();
 		glPopMatrix();
 	}
 }
-
@@ -0,0 +1,434 @@
+// Copyright (C) 2008 Dave Griffiths
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+
+#include <cstring>
+#include <cstdlib>
+#include <unistd.h>
+#include "OpenGL.h"
+#include "Utils.h"
+#include "Trace.h"
+#include "FrameDumper.h"
+
+using namespace Fluxus;
+
+FrameDumper *FrameDumper::m_Singleton=NULL;
+
+// how many frames to wait before reading back a frame, by 
+// then the card should have finished copying it
+static const unsigned int FRAMEDUMP_LATENCY=2;
+// the most frames we'll hold before waiting for the encoders
+static const unsigned int MAX_SLOTS=16;
+static const unsigned int MAX_ENCODER_THREADS=4;
+
+static string Extension(const string &filename)
+{
+	size_t dot=filename.find_last_of('.');
+	if (dot==string::npos) return "";
+	return filename.substr(dot+1);
+}
+
+FrameDumper::FrameDumper() :
+m_PixelBuffersSupported(false),
+m_Frame(0),
+m_Sequence(0),
+m_Pipe(NULL),
+m_PipeQueued(0),
+m_PipeSequence(0),
+m_Errors(0),
+m_Quit(false)
+{
+	m_PixelBuffersSupported = glewIsSupported("GL_VERSION_2_1") && glMapBuffer!=NULL;
+
+	pthread_mutex_init(&m_Mutex,NULL);
+	pthread_cond_init(&m_JobCond,NULL);
+	pthread_cond_init(&m_DoneCond,NULL);
+}
+
+FrameDumper::~FrameDumper()
+{
+	if (m_Pipe) ClosePipe();
+	else Flush();
+
+	pthread_mutex_lock(&m_Mutex);
+	m_Quit=true;
+	pthread_cond_broadcast(&m_JobCond);
+	pthread_mutex_unlock(&m_Mutex);
+
+	for (vector<pthread_t>::iterator i=m_Threads.begin(); i!=m_Threads.end(); ++i)
+	{
+		pthread_join(*i,NULL);
+	}
+
+	for (vector<Slot*>::iterator i=m_Slots.begin(); i!=m_Slots.end(); ++i)
+	{
+		if ((*i)->Buffer!=0) glDeleteBuffers(1,&(*i)->Buffer);
+		free((*i)->Memory);
+		delete *i;
+	}
+
+	pthread_cond_destroy(&m_DoneCond);
+	pthread_cond_destroy(&m_JobCond);
+	pthread_mutex_destroy(&m_Mutex);
+}
+
+void FrameDumper::Capture(const string &filename, unsigned int width, unsigned int height)
+{
+	string ext=Extension(filename);
+	if (ext!="tif" && ext!="jpg" && ext!="ppm")
+	{
+		Trace::Stream<<"framedump: Unknown image extension "<<ext<<endl;
+		return;
+	}
+	Read(filename,false,width,height);
+}
+
+bool FrameDumper::OpenPipe(const string &command)
+{
+	if (m_Pipe) ClosePipe();
+
+	m_Pipe = popen(command.c_str(),"w");
+	if (m_Pipe==NULL)
+	{
+		Trace::Stream<<"framedump: couldn't run "<<command<<endl;
+		return false;
+	}
+	m_PipeQueued=0;
+	m_PipeSequence=0;
+	return true;
+}
+
+void FrameDumper::CapturePipe(unsigned int width, unsigned int height)
+{
+	if (m_Pipe==NULL) 
+	{
+		Trace::Stream<<"framedump: no pipe open"<<endl;
+		return;
+	}
+	Read("",true,width,height);
+}
+
+void FrameDumper::ClosePipe()
+{
+	Flush();
+	if (m_Pipe) pclose(m_Pipe);
+	m_Pipe=NULL;
+}
+
+void FrameDumper::Read(const string &filename, bool pipe, unsigned int width, unsigned int height)
+{
+	if (width==0 || height==0) return;
+
+	Slot *slot=GetFreeSlot();
+	unsigned int size=width*height*4;
+
+	// BGRA is what the card usually has, so it can be copied 
+	// without converting
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	if (m_PixelBuffersSupported)
+	{
+		if (slot->Buffer==0) glGenBuffers(1,&slot->Buffer);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER,slot->Buffer);
+		if (slot->Size!=size)
+		{
+			glBufferData(GL_PIXEL_PACK_BUFFER,size,NULL,GL_STREAM_READ);
+			slot->Size=size;
+		}
+		// returns straight away, and the card copies it later on
+		glReadPixels(0,0,width,height,GL_BGRA,GL_UNSIGNED_BYTE,NULL);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER,0);
+	}
+	else
+	{
+		if (slot->Size!=size)
+		{
+			free(slot->Memory);
+			slot->Memory=(unsigned char*)malloc(size);
+			slot->Size=size;
+		}
+		glReadPixels(0,0,width,height,GL_BGRA,GL_UNSIGNED_BYTE,slot->Memory);
+	}
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+
+	slot->State=READING;
+	slot->Width=width;
+	slot->Height=height;
+	slot->Frame=m_Frame;
+	slot->Sequence=m_Sequence++;
+	slot->PipeSequence=pipe?m_PipeQueued++:0;
+	slot->Pipe=pipe;
+	slot->Filename=filename;
+
+	// nothing to wait for without pixel buffers
+	if (!m_PixelBuffersSupported) Encode(slot);
+}
+
+FrameDumper::Slot *FrameDumper::GetFreeSlot()
+{
+	while (true)
+	{
+		Recycle();
+		for (vector<Slot*>::iterator i=m_Slots.begin(); i!=m_Slots.end(); ++i)
+		{
+			if ((*i)->State==FREE) return *i;
+		}
+
+		if (m_Slots.size()<MAX_SLOTS)
+		{
+			m_Slots.push_back(new Slot);
+			return m_Slots.back();
+		}
+
+		// we're further ahead than the encoders can keep up with, 
+		// so hand over the oldest frame and wait for one to finish
+		Slot *oldest=NULL;
+		for (vector<Slot*>::iterator i=m_Slots.begin(); i!=m_Slots.end(); ++i)
+		{
+			if ((*i)->State==READING && (oldest==NULL || (*i)->Sequence<oldest->Sequence)) oldest=*i;
+		}
+		if (oldest) Encode(oldest);
+
+		pthread_mutex_lock(&m_Mutex);
+		bool done=false;
+		while (!done)
+		{
+			for (vector<Slot*>::iterator i=m_Slots.begin(); i!=m_Slots.end(); ++i)
+			{
+				if ((*i)->State==DONE) done=true;
+			}
+			if (!done) pthread_cond_wait(&m_DoneCond,&m_Mutex);
+		}
+		pthread_mutex_unlock(&m_Mutex);
+	}
+}
+
+void FrameDumper::Encode(Slot *slot)
+{
+	if (m_PixelBuffersSupported)
+	{
+		glBindBuffer(GL_PIXEL_PACK_BUFFER,slot->Buffer);
+		slot->Mapped=(const unsigned char*)glMapBuffer(GL_PIXEL_PACK_BUFFER,GL_READ_ONLY);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER,0);
+	}
+	else
+	{
+		slot->Mapped=slot->Memory;
+	}
+
+	// failed maps are still queued, so the pipe doesn't wait for them
+	StartEncoderThreads();
+	pthread_mutex_lock(&m_Mutex);
+	slot->State=ENCODING;
+	m_Jobs.push_back(slot);
+	pthread_cond_signal(&m_JobCond);
+	pthread_mutex_unlock(&m_Mutex);
+}
+
+void FrameDumper::Recycle()
+{
+	pthread_mutex_lock(&m_Mutex);
+	for (vector<Slot*>::iterator i=m_Slots.begin(); i!=m_Slots.end(); ++i)
+	{
+		Slot *slot=*i;
+		if (slot->State==DONE)
+		{
+			if (m_PixelBuffersSupported && slot->Mapped!=NULL)
+			{
+				glBindBuffer(GL_PIXEL_PACK_BUFFER,slot->Buffer);
+				glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+				glBindBuffer(GL_PIXEL_PACK_BUFFER,0);
+			}
+			slot->Mapped=NULL;
+			slot->State=FREE;
+		}
+	}
+	pthread_mutex_unlock(&m_Mutex);
+}
+
+void FrameDumper::ReportErrors()
+{
+	pthread_mutex_lock(&m_Mutex);
+	unsigned int errors=m_Errors;
+	m_Errors=0;
+	pthread_mutex_unlock(&m_Mutex);
+
+	if (errors>0) Trace::Stream<<"framedump: couldn't write "<<errors<<" frames"<<endl;
+}
+
+void FrameDumper::Update()
+{
+	m_Frame++;
+	if (m_Slots.empty()) return;
+
+	Recycle();
+
+	// oldest first, so the pipe gets them in order
+	bool found=true;
+	while (found)
+	{
+		Slot *oldest=NULL;
+		for (vector<Slot*>::iterator i=m_Slots.begin(); i!=m_Slots.end(); ++i)
+		{
+			if ((*i)->State==READING && (*i)->Frame+FRAMEDUMP_LATENCY<=m_Frame &&
+				(oldest==NULL || (*i)->Sequence<oldest->Sequence)) 
+			{
+				oldest=*i;
+			}
+		}
+		found=oldest!=NULL;
+		if (found) Encode(oldest);
+	}
+
+	ReportErrors();
+}
+
+void FrameDumper::Flush()
+{
+	// hand everything over, in order
+	bool found=true;
+	while (found)
+	{
+		Slot *oldest=NULL;
+		for (vector<Slot*>::iterator i=m_Slots.begin(); i!=m_Slots.end(); ++i)
+		{
+			if ((*i)->State==READING && (oldest==NULL || (*i)->Sequence<oldest->Sequence)) oldest=*i;
+		}
+		found=oldest!=NULL;
+		if (found) Encode(oldest);
+	}
+
+	pthread_mutex_lock(&m_Mutex);
+	bool busy=true;
+	while (busy)
+	{
+		busy=false;
+		for (vector<Slot*>::iterator i=m_Slots.begin(); i!=m_Slots.end(); ++i)
+		{
+			if ((*i)->State==ENCODING) busy=true;
+		}
+		if (busy) pthread_cond_wait(&m_DoneCond,&m_Mutex);
+	}
+	pthread_mutex_unlock(&m_Mutex);
+
+	Recycle();
+	if (m_Pipe) fflush(m_Pipe);
+	ReportErrors();
+}
+
+void FrameDumper::StartEncoderThreads()
+{
+	if (!m_Threads.empty()) return;
+
+	// leave a core for the render thread
+	long cores=sysconf(_SC_NPROCESSORS_ONLN)-1;
+	if (cores<1) cores=1;
+	if (cores>(long)MAX_ENCODER_THREADS) cores=MAX_ENCODER_THREADS;
+
+	for (long i=0; i<cores; i++)
+	{
+		pthread_t thread;
+		if (pthread_create(&thread,NULL,EncoderThread,this)!=0) break;
+		m_Threads.push_back(thread);
+	}
+}
+
+void *FrameDumper::EncoderThread(void *p)
+{
+	FrameDumper *dumper=static_cast<FrameDumper*>(p);
+
+	pthread_mutex_lock(&dumper->m_Mutex);
+	while (!dumper->m_Quit)
+	{
+		if (dumper->m_Jobs.empty())
+		{
+			pthread_cond_wait(&dumper->m_JobCond,&dumper->m_Mutex);
+			continue;
+		}
+
+		Slot *slot=dumper->m_Jobs.front();
+		dumper->m_Jobs.pop_front();
+		pthread_mutex_unlock(&dumper->m_Mutex);
+
+		if (slot->Pipe) dumper->WritePipe(slot);
+		else dumper->Write(slot);
+
+		pthread_mutex_lock(&dumper->m_Mutex);
+		slot->State=DONE;
+		pthread_cond_broadcast(&dumper->m_DoneCond);
+	}
+	pthread_mutex_unlock(&dumper->m_Mutex);
+	return NULL;
+}
+
+void FrameDumper::Write(Slot *slot)
+{
+	if (slot->Mapped==NULL)
+	{
+		pthread_mutex_lock(&m_Mutex);
+		m_Errors++;
+		pthread_mutex_unlock(&m_Mutex);
+		return;
+	}
+
+	// the writers want RGB, which they free afterwards
+	unsigned int pixels=slot->Width*slot->Height;
+	GLubyte *image=(GLubyte*)malloc(pixels*3);
+	const unsigned char *src=slot->Mapped;
+	for (unsigned int n=0; n<pixels; n++)
+	{
+		image[n*3]=src[n*4+2];
+		image[n*3+1]=src[n*4+1];
+		image[n*3+2]=src[n*4];
+	}
+
+	string ext=Extension(slot->Filename);
+	int err=0;
+	if (ext=="tif") err=WriteTiff(image,slot->Filename.c_str(),"made in fluxus",0,0,slot->Width,slot->Height,1);
+	else if (ext=="jpg") err=WriteJPG(image,slot->Filename.c_str(),"made in fluxus",0,0,slot->Width,slot->Height,80);
+	else err=WritePPM(image,slot->Filename.c_str(),"made in fluxus",0,0,slot->Width,slot->Height,1);
+
+	if (err!=0)
+	{
+		pthread_mutex_lock(&m_Mutex);
+		m_Errors++;
+		pthread_mutex_unlock(&m_Mutex);
+	}
+}
+
+void FrameDumper::WritePipe(Slot *slot)
+{
+	// wait for our turn, so the frames arrive in order
+	pthread_mutex_lock(&m_Mutex);
+	while (m_PipeSequence!=slot->PipeSequence)
+	{
+		pthread_cond_wait(&m_DoneCond,&m_Mutex);
+	}
+	FILE *pipe=m_Pipe;
+	pthread_mutex_unlock(&m_Mutex);
+
+	// flipped, as the screen is bottom row first
+	bool ok=pipe!=NULL && slot->Mapped!=NULL;
+	unsigned int stride=slot->Width*4;
+	for (int y=slot->Height-1; y>=0 && ok; y--)
+	{
+		ok=fwrite(slot->Mapped+y*stride,stride,1,pipe)==1;
+	}
+
+	pthread_mutex_lock(&m_Mutex);
+	if (!ok) m_Errors++;
+	m_PipeSequence++;
+	pthread_cond_broadcast(&m_DoneCond);
+	pthread_mutex_unlock(&m_Mutex);
+}
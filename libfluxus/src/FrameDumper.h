@@ -0,0 +1,133 @@
+// Copyright (C) 2008 Dave Griffiths
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+
+#ifndef N_FRAME_DUMPER
+#define N_FRAME_DUMPER
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <cstdio>
+#include <pthread.h>
+
+using namespace std;
+
+namespace Fluxus
+{
+
+//////////////////////////////////////////////////////
+/// Saves frames to disk, or sends them to another 
+/// program, without holding up the render thread. The 
+/// screen is read into a pixel buffer which is mapped
+/// a few frames later, when the card has finished with 
+/// it, and encoder threads work straight from the mapped
+/// memory. The buffer goes back into the ring once the 
+/// frame has been written.
+class FrameDumper
+{
+public:
+	///\todo stop this being a singleton...
+	static FrameDumper* Get()
+	{
+		if (m_Singleton==NULL) m_Singleton=new FrameDumper;
+		return m_Singleton;
+	}
+
+	static void Shutdown()
+	{
+		if (m_Singleton!=NULL) delete m_Singleton;
+		m_Singleton=NULL;
+	}
+
+	/// Queues the screen to be saved, the format comes from the 
+	/// filename extension, which can be "tif", "jpg" or "ppm"
+	void Capture(const string &filename, unsigned int width, unsigned int height);
+	
+	/// Starts a program which is sent the frames from CapturePipe(), 
+	/// as raw 8 bit BGRA, top row first, on its standard input
+	bool OpenPipe(const string &command);
+	void CapturePipe(unsigned int width, unsigned int height);
+	/// Waits for all the frames to be sent, and closes the program
+	void ClosePipe();
+
+	/// Called once a frame, hands finished read backs to the encoders
+	void Update();
+	
+	/// Waits until all the captured frames are written
+	void Flush();
+
+private:
+	FrameDumper();
+	~FrameDumper();
+
+	enum SlotState{FREE,READING,ENCODING,DONE};
+
+	/// A pixel buffer (or plain memory without them) holding one frame
+	class Slot
+	{
+	public:
+		Slot() : State(FREE), Buffer(0), Memory(NULL), Mapped(NULL), Size(0), 
+			Width(0), Height(0), Frame(0), Sequence(0), PipeSequence(0), Pipe(false) {}
+		
+		SlotState State;
+		unsigned int Buffer;
+		unsigned char *Memory;
+		const unsigned char *Mapped;
+		unsigned int Size;
+		unsigned int Width;
+		unsigned int Height;
+		unsigned int Frame;
+		unsigned int Sequence;
+		unsigned int PipeSequence;
+		bool Pipe;
+		string Filename;
+	};
+
+	void Read(const string &filename, bool pipe, unsigned int width, unsigned int height);
+	Slot *GetFreeSlot();
+	/// Maps the frame and hands it over to the encoders
+	void Encode(Slot *slot);
+	/// Puts slots the encoders have finished with back in the ring
+	void Recycle();
+	void ReportErrors();
+	void StartEncoderThreads();
+	static void *EncoderThread(void *dumper);
+	void Write(Slot *slot);
+	void WritePipe(Slot *slot);
+
+	static FrameDumper *m_Singleton;
+
+	vector<Slot*> m_Slots;
+	bool m_PixelBuffersSupported;
+	unsigned int m_Frame;
+	unsigned int m_Sequence;
+
+	FILE *m_Pipe;
+	unsigned int m_PipeQueued;
+	unsigned int m_PipeSequence;
+
+	vector<pthread_t> m_Threads;
+	pthread_mutex_t m_Mutex;
+	pthread_cond_t m_JobCond;
+	pthread_cond_t m_DoneCond;
+	deque<Slot*> m_Jobs;
+	unsigned int m_Errors;
+	bool m_Quit;
+};
+
+}
+
+#endif
@@ -15,6 +15,7 @@
 // Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
 
 #include <stdio.h>
+#include <string.h>
 #include <iostream>
 
 #include "GLSLShader.h"
@@ -25,6 +26,66 @@ using namespace std;
 using namespace Fluxus;
 
 bool GLSLShader::m_Enabled(false);
+map<string,UniformValue> GLSLShader::m_SharedUniforms;
+unsigned int GLSLShader::m_SharedUniformsVersion(1);
+
+static inline unsigned int HashName(const string &name)
+{
+	unsigned int hash=2166136261u;
+	for (unsigned int i=0; i<name.size(); i++)
+	{
+		hash=(hash^(unsigned char)name[i])*16777619u;
+	}
+	return hash;
+}
+
+/////////////////////////////////////////
+
+UniformValue::UniformValue(int s) { Set(INT,1,&s,1); }
+UniformValue::UniformValue(float s) { Set(FLOAT,1,&s,1); }
+UniformValue::UniformValue(const dColour &s) { Set(VEC4,1,&s.r,4); }
+
+UniformValue::UniformValue(const dVector &s) 
+{ 
+	float v[3]={s.x,s.y,s.z};
+	Set(VEC3,1,v,3); 
+}
+
+UniformValue::UniformValue(const vector<int> &s) 
+{ 
+	Set(INT,s.size(),s.empty()?NULL:&s[0],s.size()); 
+}
+
+UniformValue::UniformValue(const vector<float> &s) 
+{ 
+	Set(FLOAT,s.size(),s.empty()?NULL:&s[0],s.size()); 
+}
+
+// vectors are sent as vec4s, with w
+UniformValue::UniformValue(const vector<dVector> &s) 
+{ 
+	Set(VEC4,s.size(),s.empty()?NULL:&s[0].x,s.size()*4); 
+}
+
+UniformValue::UniformValue(const vector<dColour> &s) 
+{ 
+	Set(VEC4,s.size(),s.empty()?NULL:&s[0].r,s.size()*4); 
+}
+
+void UniformValue::Set(Kind kind, unsigned int count, const void *data, unsigned int words)
+{
+	m_Kind=kind;
+	m_Count=count;
+	m_Data.resize(words);
+	if (words>0) memcpy(&m_Data[0],data,words*sizeof(int));
+}
+
+bool UniformValue::operator==(const UniformValue &other) const
+{
+	return m_Kind==other.m_Kind && m_Count==other.m_Count && 
+		m_Data.size()==other.m_Data.size() &&
+		(m_Data.empty() || !memcmp(&m_Data[0],&other.m_Data[0],m_Data.size()*sizeof(int)));
+}
 
 GLSLShaderPair::GLSLShaderPair(bool load, const string &vertex, const string &fragment) :
 m_VertexShader(0),
@@ -159,7 +220,9 @@ unsigned int GLSLShaderPair::MakeShader(const string &filename, const string &so
 
 GLSLShader::GLSLShader(const GLSLShaderPair &pair) :
 m_Program(0),
-m_RefCount(1)
+m_RefCount(1),
+m_IsValid(false),
+m_SharedVersion(0)
 {
 	#ifdef GLSL
 	if (!m_Enabled) return;
@@ -181,6 +244,7 @@ m_RefCount(1)
 	else
 	{
 		m_IsValid = true;
+		FindUniforms();
 	}
 	#endif
 }
@@ -205,6 +269,7 @@ void GLSLShader::Apply()
 	#ifdef GLSL
 	if (!m_Enabled) return;
 	glUseProgram(m_Program);
+	SendUniforms();
 	#endif
 }
 
@@ -216,76 +281,171 @@ void GLSLShader::Unapply()
 	#endif
 }
 
-void GLSLShader::SetInt(const string &name, int s)
+void GLSLShader::FindUniforms()
 {
 	#ifdef GLSL
-	if (!m_Enabled) return;
-	GLuint param = glGetUniformLocation(m_Program, name.c_str());
-	glUniform1i(param,s);
+	GLint count=0;
+	GLint maxlength=0;
+	glGetProgramiv(m_Program, GL_ACTIVE_UNIFORMS, &count);
+	glGetProgramiv(m_Program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxlength);
+	if (count<=0 || maxlength<=0) return;
+
+	vector<char> buffer(maxlength+1);
+	for (int i=0; i<count; i++)
+	{
+		GLsizei length=0;
+		GLint size=0;
+		GLenum type=0;
+		glGetActiveUniform(m_Program, i, maxlength+1, &length, &size, &type, &buffer[0]);
+		
+		Uniform uniform;
+		uniform.Name=string(&buffer[0],length);
+		// arrays are named after their first element
+		if (uniform.Name.size()>3 && uniform.Name.compare(uniform.Name.size()-3,3,"[0]")==0)
+		{
+			uniform.Name.resize(uniform.Name.size()-3);
+		}
+		uniform.Location=glGetUniformLocation(m_Program, uniform.Name.c_str());
+		// builtin gl_ state doesn't have a location
+		if (uniform.Location<0) continue;
+		uniform.Type=type;
+		uniform.Size=size;
+		m_Uniforms.push_back(uniform);
+	}
+
+	// keep the table under half full
+	unsigned int tablesize=8;
+	while (tablesize<m_Uniforms.size()*2) tablesize*=2;
+	m_UniformTable.assign(tablesize,-1);
+	for (unsigned int i=0; i<m_Uniforms.size(); i++)
+	{
+		unsigned int slot=HashName(m_Uniforms[i].Name)&(tablesize-1);
+		while (m_UniformTable[slot]!=-1) slot=(slot+1)&(tablesize-1);
+		m_UniformTable[slot]=i;
+	}
 	#endif
 }
 
-void GLSLShader::SetFloat(const string &name, float s)
+GLSLShader::Uniform *GLSLShader::GetUniform(const string &name)
+{
+	if (m_UniformTable.empty()) return NULL;
+
+	unsigned int mask=m_UniformTable.size()-1;
+	unsigned int slot=HashName(name)&mask;
+	while (m_UniformTable[slot]!=-1)
+	{
+		Uniform *uniform=&m_Uniforms[m_UniformTable[slot]];
+		if (uniform->Name==name) return uniform;
+		slot=(slot+1)&mask;
+	}
+	// not in the shader, or optimised away
+	return NULL;
+}
+
+void GLSLShader::SetUniform(const string &name, const UniformValue &value)
 {
 	#ifdef GLSL
 	if (!m_Enabled) return;
-	GLuint param = glGetUniformLocation(m_Program, name.c_str());
-	glUniform1f(param,s);
+	Uniform *uniform=GetUniform(name);
+	if (uniform==NULL) return;
+
+	uniform->Pending=value;
+	if (!uniform->Dirty && uniform->Pending!=uniform->Sent)
+	{
+		uniform->Dirty=true;
+		m_Dirty.push_back(uniform-&m_Uniforms[0]);
+	}
 	#endif
 }
 
-void GLSLShader::SetVector(const string &name, dVector s)
+void GLSLShader::SetSharedUniform(const string &name, const UniformValue &value)
+{
+	map<string,UniformValue>::iterator i=m_SharedUniforms.find(name);
+	if (i!=m_SharedUniforms.end())
+	{
+		if (i->second==value) return;
+		i->second=value;
+	}
+	else
+	{
+		m_SharedUniforms[name]=value;
+	}
+	// shaders pick up the changes next time they are applied
+	m_SharedUniformsVersion++;
+}
+
+void GLSLShader::SendUniforms()
 {
 	#ifdef GLSL
-	if (!m_Enabled) return;
-	GLuint param = glGetUniformLocation(m_Program, name.c_str());
-	glUniform3f(param,s.x,s.y,s.z);
+	if (m_SharedVersion!=m_SharedUniformsVersion)
+	{
+		for (map<string,UniformValue>::iterator i=m_SharedUniforms.begin(); 
+			i!=m_SharedUniforms.end(); ++i)
+		{
+			SetUniform(i->first,i->second);
+		}
+		m_SharedVersion=m_SharedUniformsVersion;
+	}
+
+	for (vector<unsigned int>::iterator i=m_Dirty.begin(); i!=m_Dirty.end(); ++i)
+	{
+		Uniform &uniform=m_Uniforms[*i];
+		uniform.Dirty=false;
+		if (uniform.Pending==uniform.Sent) continue;
+
+		const UniformValue &value=uniform.Pending;
+		GLsizei count=min(value.GetCount(),uniform.Size);
+		switch (value.GetKind())
+		{
+			case UniformValue::INT: glUniform1iv(uniform.Location,count,value.GetData()); break;
+			case UniformValue::FLOAT: glUniform1fv(uniform.Location,count,(const float*)value.GetData()); break;
+			case UniformValue::VEC3: glUniform3fv(uniform.Location,count,(const float*)value.GetData()); break;
+			case UniformValue::VEC4: glUniform4fv(uniform.Location,count,(const float*)value.GetData()); break;
+		}
+		uniform.Sent=uniform.Pending;
+	}
+	m_Dirty.clear();
 	#endif
 }
 
+void GLSLShader::SetInt(const string &name, int s)
+{
+	SetUniform(name,UniformValue(s));
+}
+
+void GLSLShader::SetFloat(const string &name, float s)
+{
+	SetUniform(name,UniformValue(s));
+}
+
+void GLSLShader::SetVector(const string &name, dVector s)
+{
+	SetUniform(name,UniformValue(s));
+}
+
 void GLSLShader::SetColour(const string &name, dColour s)
 {
-	#ifdef GLSL
-	if (!m_Enabled) return;
-	GLuint param = glGetUniformLocation(m_Program, name.c_str());
-	glUniform4f(param,s.r,s.g,s.b,s.a);
-	#endif
+	SetUniform(name,UniformValue(s));
 }
 
 void GLSLShader::SetIntArray(const string &name, const vector<int> &s)
 {
-	#ifdef GLSL
-	if (!m_Enabled) return;
-	GLuint param = glGetUniformLocation(m_Program, name.c_str());
-	glUniform1iv(param,s.size(),&(*s.begin()));
-	#endif
+	SetUniform(name,UniformValue(s));
 }
 
 void GLSLShader::SetFloatArray(const string &name, const vector<float> &s)
 {
-	#ifdef GLSL
-	if (!m_Enabled) return;
-	GLuint param = glGetUniformLocation(m_Program, name.c_str());
-	glUniform1fv(param,s.size(),&(*s.begin()));
-	#endif
+	SetUniform(name,UniformValue(s));
 }
 
 void GLSLShader::SetVectorArray(const string &name, const vector<dVector> &s)
 {
-	#ifdef GLSL
-	if (!m_Enabled) return;
-	GLuint param = glGetUniformLocation(m_Program, name.c_str());
-	glUniform4fv(param,s.size(),&s.begin()->x);
-	#endif
+	SetUniform(name,UniformValue(s));
 }
 
 void GLSLShader::SetColourArray(const string &name, const vector<dColour> &s)
 {
-	#ifdef GLSL
-	if (!m_Enabled) return;
-	GLuint param = glGetUniformLocation(m_Program, name.c_str());
-	glUniform4fv(param,s.size(),&s.begin()->r);
-	#endif
+	SetUniform(name,UniformValue(s));
 }
 
 void GLSLShader::SetFloatAttrib(const string &name, const vector<float> &s)
@@ -21,6 +21,7 @@
 
 #include <string>
 #include <vector>
+#include <map>
 #include "dada.h"
 
 using namespace std;
@@ -53,13 +54,48 @@ private:
 	unsigned int m_FragmentShader;
 };
 
+//////////////////////////////////////////////////////
+/// A value for a uniform variable, in the form 
+/// it's sent to the card
+class UniformValue
+{
+public:
+	enum Kind {INT, FLOAT, VEC3, VEC4};
+
+	UniformValue() : m_Kind(INT), m_Count(0) {}
+	UniformValue(int s);
+	UniformValue(float s);
+	UniformValue(const dVector &s);
+	UniformValue(const dColour &s);
+	UniformValue(const vector<int> &s);
+	UniformValue(const vector<float> &s);
+	UniformValue(const vector<dVector> &s);
+	UniformValue(const vector<dColour> &s);
+
+	Kind GetKind() const { return m_Kind; }
+	/// Number of elements, for arrays
+	unsigned int GetCount() const { return m_Count; }
+	/// Ints for INT, floats otherwise
+	const int *GetData() const { return m_Data.empty()?NULL:&m_Data[0]; }
+
+	bool operator==(const UniformValue &other) const;
+	bool operator!=(const UniformValue &other) const { return !(*this==other); }
+
+private:
+	void Set(Kind kind, unsigned int count, const void *data, unsigned int words);
+
+	Kind m_Kind;
+	unsigned int m_Count;
+	vector<int> m_Data;
+};
+
 //////////////////////////////////////////////////////
 /// A hardware shader for use on an object
 class GLSLShader
 {
 public:
 	/// The constructor attempts to load the shader pair immediately
-	GLSLShader() : m_RefCount(1), m_IsValid(false) {}
+	GLSLShader() : m_Program(0), m_RefCount(1), m_IsValid(false), m_SharedVersion(0) {}
 	GLSLShader(const GLSLShaderPair &pair);
 	~GLSLShader();
 
@@ -78,7 +114,10 @@ public:
 
 	/////////////////////////////////////////////
 	///@name Uniform variables
+	/// Values are kept until the next Apply(), when 
+	/// any that have changed are sent to the card
 	///@{
+	void SetUniform(const string &name, const UniformValue &value);
 	void SetInt(const string &name, int s);
 	void SetFloat(const string &name, float s);
 	void SetVector(const string &name, dVector s);
@@ -87,6 +126,9 @@ public:
 	void SetFloatArray(const string &name, const vector<float> &s);
 	void SetVectorArray(const string &name, const vector<dVector> &s);
 	void SetColourArray(const string &name, const vector<dColour> &s);
+	
+	/// Sets a uniform for every shader with a variable of this name
+	static void SetSharedUniform(const string &name, const UniformValue &value);
 	///@}
 
 	/////////////////////////////////////////////
@@ -100,9 +142,37 @@ public:
 	static bool m_Enabled;
 
 private:
+	/// An active uniform variable in the linked program
+	class Uniform
+	{
+	public:
+		Uniform() : Location(-1), Type(0), Size(0), Dirty(false) {}
+		string Name;
+		int Location;
+		unsigned int Type;
+		unsigned int Size;
+		UniformValue Pending;
+		UniformValue Sent;
+		bool Dirty;
+	};
+
+	/// Reads the uniforms from the program, once it's linked
+	void FindUniforms();
+	Uniform *GetUniform(const string &name);
+	void SendUniforms();
+
 	unsigned int m_Program;
 	unsigned int m_RefCount;
 	bool m_IsValid;
+
+	vector<Uniform> m_Uniforms;
+	/// Open addressed table of indices into m_Uniforms, hashed by name
+	vector<int> m_UniformTable;
+	vector<unsigned int> m_Dirty;
+	unsigned int m_SharedVersion;
+
+	static map<string,UniformValue> m_SharedUniforms;
+	static unsigned int m_SharedUniformsVersion;
 };
 
 }
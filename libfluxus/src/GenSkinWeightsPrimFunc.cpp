@@ -35,6 +35,8 @@ void GenSkinWeightsPrimFunc::Run(Primitive &prim, const SceneGraph &world)
 {
 	int rootid = GetArg<int>("skeleton-root",0);
 	float sharpness = GetArg<float>("sharpness",0);
+	bool dense = GetArg<int>("dense",1);
+	bool compact = GetArg<int>("compact",0);
 	vector<dVector> *p = prim.GetDataVec<dVector>("p");
 	vector<TypedPData<float> *> weights;
 	int bone=0;
@@ -104,11 +106,67 @@ void GenSkinWeightsPrimFunc::Run(Primitive &prim, const SceneGraph &world)
 	}
 
 
+	if (compact) MakeCompact(prim,weights);
+
 	// finally, add the weights to the primitive
 	for (unsigned int bone=0; bone<weights.size(); bone++)
 	{
-		char wname[256];
-		snprintf(wname,256,"w%d",bone);
-		prim.AddData(wname, weights[bone]);
+		if (dense)
+		{
+			char wname[256];
+			snprintf(wname,256,"w%d",bone);
+			prim.AddData(wname, weights[bone]);
+		}
+		else
+		{
+			delete weights[bone];
+		}
 	}
 }
+
+void GenSkinWeightsPrimFunc::MakeCompact(Primitive &prim, const vector<TypedPData<float> *> &weights)
+{
+	// make the compact influences, the 4 biggest weights 
+	// for each vertex and the bones they belong to
+	TypedPData<dColour> *boneindices = new TypedPData<dColour>(prim.Size());
+	TypedPData<dColour> *boneweights = new TypedPData<dColour>(prim.Size());
+	for (unsigned int n=0; n<prim.Size(); n++)
+	{
+		float *indices=boneindices->m_Data[n].arr();
+		float *bw=boneweights->m_Data[n].arr();
+		for (int k=0; k<4; k++)
+		{
+			indices[k]=0;
+			bw[k]=0;
+		}
+
+		// insertion sort into the top 4
+		for (unsigned int bone=0; bone<weights.size(); bone++)
+		{
+			float w=weights[bone]->m_Data[n];
+			if (w>bw[3])
+			{
+				int k=3;
+				for (; k>0 && w>bw[k-1]; k--)
+				{
+					bw[k]=bw[k-1];
+					indices[k]=indices[k-1];
+				}
+				bw[k]=w;
+				indices[k]=bone;
+			}
+		}
+
+		// the rest are dropped, so normalise again
+		float m=bw[0]+bw[1]+bw[2]+bw[3];
+		if (m>0) 
+		{
+			for (int k=0; k<4; k++) bw[k]/=m;
+		}
+	}
+
+	if (prim.GetDataRawConst("bi")) prim.SetDataRaw("bi", boneindices);
+	else prim.AddData("bi", boneindices);
+	if (prim.GetDataRawConst("bw")) prim.SetDataRaw("bw", boneweights);
+	else prim.AddData("bw", boneweights);
+}
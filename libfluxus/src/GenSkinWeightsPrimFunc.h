@@ -37,7 +37,9 @@ public:
 	virtual void Run(Primitive &prim, const SceneGraph &world);
 
 private:
-	
+	/// Adds the 4 biggest weights of each vertex as "bw" and the 
+	/// bones they belong to as "bi", for faster skinning
+	void MakeCompact(Primitive &prim, const vector<TypedPData<float> *> &weights);
 };
 
 
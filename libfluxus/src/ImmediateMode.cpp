@@ -19,7 +19,9 @@
 
 using namespace Fluxus;
 
-ImmediateMode::ImmediateMode()
+ImmediateMode::ImmediateMode() :
+m_Count(0),
+m_BatchCount(0)
 {
 }
 
@@ -31,47 +33,113 @@ void ImmediateMode::Add(Primitive *p, State *s, bool del /* = false */)
 {
 	assert(p!=NULL);
 	assert(s!=NULL);
-	IMItem *newitem = new IMItem;
-	newitem->m_State = *s;
-	newitem->m_Primitive = p;
-	newitem->m_DelPrim = del;
-	m_IMRecord.push_back(newitem);
+	
+	// only the last batch can be added to, so the drawing order is kept 
+	// the same, and the whole state is only copied when we start a new one
+	if (m_BatchCount==0 || 
+		m_IMRecord[m_Batches[m_BatchCount-1].m_Start].m_Primitive!=p ||
+		!m_Batches[m_BatchCount-1].m_State.IsCompatible(*s))
+	{
+		if (m_BatchCount==m_Batches.size())
+		{
+			m_Batches.push_back(IMBatch());
+		}
+		IMBatch &newbatch = m_Batches[m_BatchCount++];
+		newbatch.m_State = *s;
+		newbatch.m_Start = m_Count;
+	}
+	
+	if (m_Count==m_IMRecord.size())
+	{
+		m_IMRecord.push_back(IMItem());
+	}
+	IMItem &newitem = m_IMRecord[m_Count++];
+	newitem.m_Transform = s->Transform;
+	newitem.m_Colour = s->Colour;
+	newitem.m_Primitive = p;
+	newitem.m_DelPrim = del;
+	m_Batches[m_BatchCount-1].m_End = m_Count;
 }
 
 void ImmediateMode::Render(unsigned int CamIndex, ShadowVolumeGen *shadowgen)
 {
 	///\todo: not using camera visibility in immediate mode...
-	for(vector<IMItem*>::iterator i=m_IMRecord.begin(); i!=m_IMRecord.end(); ++i)
+	RenderItems(shadowgen,false);
+}
+
+void ImmediateMode::RenderCasters(unsigned int CamIndex)
+{
+	RenderItems(NULL,true);
+}
+
+void ImmediateMode::RenderItems(ShadowVolumeGen *shadowgen, bool castersonly)
+{
+	for (unsigned int i=0; i<m_BatchCount; i++)
 	{
+		// the hints are the same for the whole batch
+		if (!castersonly || m_Batches[i].m_State.Hints & HINT_CAST_SHADOW)
+		{
+			RenderBatch(m_Batches[i],shadowgen);
+		}
+	}
+}
+
+void ImmediateMode::RenderBatch(IMBatch &batch, ShadowVolumeGen *shadowgen)
+{
+	Primitive *prim=m_IMRecord[batch.m_Start].m_Primitive;
+	assert(prim!=NULL);
+	
+	for (unsigned int i=batch.m_Start; i<batch.m_End; i++)
+	{
+		IMItem &item=m_IMRecord[i];
 		glPushMatrix();
-		(*i)->m_State.Apply();
-		// need to set the state to the primitive to update the parts of the state the
-		// render call acts on. need to look at this.
-		assert((*i)->m_Primitive!=NULL);
-	    (*i)->m_Primitive->SetState(&(*i)->m_State);
-		(*i)->m_Primitive->Prerender();
-		(*i)->m_Primitive->Render();
+		if (i==batch.m_Start)
+		{
+			batch.m_State.Apply();
+			// need to set the state to the primitive to update the parts of the state the
+			// render call acts on. need to look at this.
+			prim->SetState(&batch.m_State);
+			prim->Prerender();
+		}
+		else
+		{
+			// everything apart from these is the same as the first item
+			State *state=prim->GetState();
+			state->Transform=item.m_Transform;
+			state->Colour=item.m_Colour;
+			state->ApplyInstance();
+			// these draw things relative to the transform
+			if (state->Hints & (HINT_ORIGIN|HINT_BOUND)) prim->Prerender();
+		}
+		prim->Render();
 
-		if (shadowgen && (*i)->m_Primitive->GetState()->Hints & HINT_CAST_SHADOW)
+		if (shadowgen && prim->GetState()->Hints & HINT_CAST_SHADOW)
 		{
-			shadowgen->Generate((*i)->m_Primitive);
+			shadowgen->Generate(prim);
 		}
-		(*i)->m_State.Unapply();
 		glPopMatrix();
 	}
+	
+	batch.m_State.Unapply();
 }
 
 void ImmediateMode::Clear()
 {
-	for(vector<IMItem*>::iterator i=m_IMRecord.begin(); i!=m_IMRecord.end(); ++i)
+	for (unsigned int i=0; i<m_Count; i++)
 	{
-		if ((*i)->m_DelPrim)
+		if (m_IMRecord[i].m_DelPrim)
 		{
-			delete (*i)->m_Primitive;
+			delete m_IMRecord[i].m_Primitive;
 		}
-		delete *i;
+		m_IMRecord[i].m_Primitive=NULL;
 	}
 
-	m_IMRecord.clear();
-}
+	// let go of the shaders the pooled states are holding
+	for (unsigned int i=0; i<m_BatchCount; i++)
+	{
+		m_Batches[i].m_State=State();
+	}
 
+	m_Count=0;
+	m_BatchCount=0;
+}
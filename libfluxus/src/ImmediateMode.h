@@ -28,7 +28,11 @@ namespace Fluxus
 /// Immediate Mode
 /// A store for immediate mode primitives, which we can
 /// be given at any time, we keep pointers to them and
-/// render them all in one when the renderer is ready
+/// render them all in one when the renderer is ready.
+/// Runs of the same primitive which only differ in
+/// transform and colour are drawn as a batch, with the
+/// rest of the state only applied once. The items are
+/// pooled and reused from frame to frame.
 class ImmediateMode
 {
 public:
@@ -38,16 +42,36 @@ public:
 
 	void Add(Primitive *p, State *s, bool del = false);
 	void Render(unsigned int CamIndex, ShadowVolumeGen *shadowgen = NULL);
+	/// Only renders the items with the cast shadow hint, for shadow maps
+	void RenderCasters(unsigned int CamIndex);
 	void Clear();
 
 private:
+	/// Only the parts of the state which can differ within a batch
 	struct IMItem
 	{
-		State m_State;
+		dMatrix m_Transform;
+		dColour m_Colour;
 		Primitive *m_Primitive;
 		bool m_DelPrim; // delete primitive on clear
 	};
-	vector<IMItem*> m_IMRecord;
+	
+	/// A run of items [m_Start,m_End) which share a primitive and
+	/// have states compatible with m_State, the first item's state
+	struct IMBatch
+	{
+		State m_State;
+		unsigned int m_Start;
+		unsigned int m_End;
+	};
+	
+	void RenderItems(ShadowVolumeGen *shadowgen, bool castersonly);
+	void RenderBatch(IMBatch &batch, ShadowVolumeGen *shadowgen);
+	
+	vector<IMItem> m_IMRecord;
+	unsigned int m_Count; // number of items in use this frame
+	vector<IMBatch> m_Batches;
+	unsigned int m_BatchCount; // number of batches in use this frame
 };
 
 }
@@ -10,6 +10,7 @@ m_Diffuse(1,1,1),
 m_Specular(1,1,1),
 m_Position(0,0,0),
 m_Direction(0,0,0),
+m_SpotAngle(180),
 m_Type(POINT),
 m_CameraLock(false)
 {
@@ -43,6 +44,7 @@ void Light::SetSpecular(dColour s)
 
 void Light::SetSpotAngle(float s)
 {
+	m_SpotAngle=s;
 	if (m_Type==SPOT) glLightf(GL_LIGHT0+m_Index, GL_SPOT_CUTOFF,  s);
 }
 
@@ -55,6 +55,9 @@ public:
 	void SetAttenuation(int type, float s);
 	void SetDirection(dVector s);
 	dVector GetPosition() { return m_Position; }
+	dVector GetDirection() { return m_Direction; }
+	Type GetType() { return m_Type; }
+	float GetSpotAngle() { return m_SpotAngle; }
 	///@}
 	
 	///////////////////////////
@@ -75,6 +78,7 @@ protected:
 	dColour m_Specular;
 	dVector m_Position;
 	dVector m_Direction;
+	float m_SpotAngle;
 	
 	Type m_Type;
 	bool m_CameraLock;
@@ -0,0 +1,95 @@
+// Copyright (C) 2008 Dave Griffiths
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+
+#include <cstdio>
+
+#ifndef WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "MappedFile.h"
+
+using namespace Fluxus;
+
+MappedFile::MappedFile() :
+m_Data(NULL),
+m_Size(0),
+m_Mapped(false)
+{
+}
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+bool MappedFile::Open(const std::string &filename)
+{
+	Close();
+
+	#ifndef WIN32
+	int fd = open(filename.c_str(),O_RDONLY);
+	if (fd<0) return false;
+
+	struct stat info;
+	if (fstat(fd,&info)==0 && info.st_size>0)
+	{
+		void *data = mmap(NULL,info.st_size,PROT_READ,MAP_PRIVATE,fd,0);
+		if (data!=MAP_FAILED)
+		{
+			close(fd);
+			m_Data = static_cast<char*>(data);
+			m_Size = info.st_size;
+			m_Mapped = true;
+			return true;
+		}
+	}
+	close(fd);
+	#endif
+
+	// otherwise just read it in
+	FILE *file = fopen(filename.c_str(),"rb");
+	if (file==NULL) return false;
+
+	fseek(file,0,SEEK_END);
+	m_Size = ftell(file);
+	rewind(file);
+
+	m_Data = new char[m_Size+1];
+	m_Mapped = false;
+	bool ok = m_Size==fread(m_Data,1,m_Size,file);
+	fclose(file);
+	if (!ok) Close();
+	return ok;
+}
+
+void MappedFile::Close()
+{
+	if (m_Data==NULL) return;
+
+	#ifndef WIN32
+	if (m_Mapped) munmap(m_Data,m_Size);
+	else delete[] m_Data;
+	#else
+	delete[] m_Data;
+	#endif
+
+	m_Data = NULL;
+	m_Size = 0;
+}
@@ -0,0 +1,53 @@
+// Copyright (C) 2008 Dave Griffiths
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+
+#ifndef FLUX_MAPPED_FILE
+#define FLUX_MAPPED_FILE
+
+#include <string>
+
+namespace Fluxus
+{
+
+//////////////////////////////////////////////////////
+/// Read only access to a whole file, memory mapped 
+/// where we can, or read into a buffer otherwise. The
+/// data is not null terminated.
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile();
+
+	/// Returns false if the file can't be opened or read
+	bool Open(const std::string &filename);
+	void Close();
+
+	const char *GetData() const { return m_Data; }
+	unsigned int GetSize() const { return m_Size; }
+
+private:
+	MappedFile(const MappedFile &);
+	MappedFile &operator=(const MappedFile &);
+
+	char *m_Data;
+	unsigned int m_Size;
+	bool m_Mapped;
+};
+
+}
+
+#endif
@@ -16,332 +16,346 @@
 
 #include <cstdlib>
 #include <cstdio>
-#include <algorithm>
+#include <cstring>
 
 #include "assert.h"
 #include "PolyPrimitive.h"
 #include "OBJPrimitiveIO.h"
+#include "MappedFile.h"
 #include "Trace.h"
 
 using namespace Fluxus;
 
-OBJPrimitiveIO::OBJPrimitiveIO()
+// the parsing works directly on the file data, which isn't
+// null terminated when it's mapped, so everything checks
+// against the end of the line
+
+static inline bool IsSpace(char c)
 {
+	return c==' ' || c=='\t' || c=='\r';
 }
 
-OBJPrimitiveIO::~OBJPrimitiveIO()
+static inline const char *SkipSpace(const char *pos, const char *end)
 {
-	// clear some mem
-	m_Position.clear();
-	m_Texture.clear();
-	m_Normal.clear();
-	m_Faces.clear();
+	while (pos<end && IsSpace(*pos)) pos++;
+	return pos;
 }
 
-Primitive *OBJPrimitiveIO::FormatRead(const string &filename)
+static inline bool IsDigit(char c)
 {
-	FILE *file = fopen(filename.c_str(),"r");
-	if (file==NULL)
+	return c>='0' && c<='9';
+}
+
+// returns where the number finished, or pos if there wasn't one
+static const char *ParseFloat(const char *pos, const char *end, float &out)
+{
+	const char *start=pos;
+	bool negative=false;
+	if (pos<end && (*pos=='-' || *pos=='+')) negative=(*pos++=='-');
+
+	double value=0;
+	bool digits=false;
+	while (pos<end && IsDigit(*pos))
 	{
-		Trace::Stream<<"Cannot open .obj file: "<<filename<<endl;
-		return NULL;
+		value=value*10+(*pos++-'0');
+		digits=true;
 	}
 
-	fseek(file,0,SEEK_END);
-	m_DataSize = ftell(file);
-	rewind(file);
+	if (pos<end && *pos=='.')
+	{
+		pos++;
+		double scale=0.1;
+		while (pos<end && IsDigit(*pos))
+		{
+			value+=(*pos++-'0')*scale;
+			scale*=0.1;
+			digits=true;
+		}
+	}
+
+	if (!digits) return start;
 
-	m_Data = new char[m_DataSize+1];
-	if (m_DataSize!=fread(m_Data,1,m_DataSize,file))
+	if (pos<end && (*pos=='e' || *pos=='E'))
 	{
-		Trace::Stream<<"Error reading .obj file: "<<filename<<endl;
-		fclose(file);
+		const char *exp=pos+1;
+		bool expnegative=false;
+		if (exp<end && (*exp=='-' || *exp=='+')) expnegative=(*exp++=='-');
+		if (exp<end && IsDigit(*exp))
+		{
+			int e=0;
+			while (exp<end && IsDigit(*exp)) e=e*10+(*exp++-'0');
+			double p=1, base=10;
+			while (e) { if (e&1) p*=base; base*=base; e>>=1; }
+			value=expnegative?value/p:value*p;
+			pos=exp;
+		}
+	}
+
+	out=negative?-value:value;
+	return pos;
+}
+
+static const char *ParseInt(const char *pos, const char *end, int &out)
+{
+	const char *start=pos;
+	bool negative=false;
+	if (pos<end && (*pos=='-' || *pos=='+')) negative=(*pos++=='-');
+	if (pos>=end || !IsDigit(*pos)) return start;
+
+	int value=0;
+	while (pos<end && IsDigit(*pos)) value=value*10+(*pos++-'0');
+	out=negative?-value:value;
+	return pos;
+}
+
+// obj indices start at 1, and negative ones count back from the last vertex
+static unsigned int ResolveIndex(int index, unsigned int count)
+{
+	if (index<0) return count+index;
+	return index-1;
+}
+
+static inline unsigned int HashIndices(unsigned int a, unsigned int b, unsigned int c)
+{
+	unsigned int h=a*73856093u ^ b*19349663u ^ c*83492791u;
+	return h ^ (h>>16);
+}
+
+OBJPrimitiveIO::OBJPrimitiveIO() :
+m_UnifiedIndices(true)
+{
+}
+
+OBJPrimitiveIO::~OBJPrimitiveIO()
+{
+}
+
+Primitive *OBJPrimitiveIO::FormatRead(const string &filename)
+{
+	MappedFile file;
+	if (!file.Open(filename))
+	{
+		Trace::Stream<<"Cannot open .obj file: "<<filename<<endl;
 		return NULL;
 	}
-	fclose(file);
-	m_Data[m_DataSize]='\0';
 
 	m_UnifiedIndices = true;
-	ReadOBJ(m_Position, m_Texture, m_Normal, m_Faces);
+	ReadOBJ(file.GetData(),file.GetSize());
 
 	// now get rid of the text
-	delete[] m_Data;
+	file.Close();
+
+	if (m_Corners.empty())
+	{
+		Trace::Stream<<"obj file needs to contain triangles or quads"<<endl;
+		return NULL;
+	}
 
 	// skip processing if all the indices are the same per vertex
-	if (m_UnifiedIndices)
+	if (m_UnifiedIndices &&
+		(m_Texture.empty() || m_Texture.size()==m_Position.size()) &&
+		(m_Normal.empty() || m_Normal.size()==m_Position.size()))
 	{
-		m_Indices.clear();
-		for (vector<Face>::const_iterator fi=m_Faces.begin();
-				fi!=m_Faces.end(); ++fi)
+		m_Indices.resize(m_Corners.size());
+		for (unsigned int i=0; i<m_Corners.size(); i++)
 		{
-			for (vector<Indices>::const_iterator ii=fi->Index.begin();
-					ii!=fi->Index.end(); ++ii)
-			{
-				m_Indices.push_back(ii->Position);
-			}
+			m_Indices[i]=m_Corners[i].Position;
 		}
 	}
 	else
 	{
 		// shuffle stuff around so we only have one set of indices
-		vector<Indices> unique=RemoveDuplicateIndices();
-		ReorderData(unique);
-		UnifyIndices(unique);
+		RemoveDuplicateIndices();
 	}
 
-	if (m_Faces.empty()) return NULL;
-
 	return MakePrimitive();
 }
 
 Primitive *OBJPrimitiveIO::MakePrimitive()
 {
-	// stick all the data in a primitive
-
-	// what type?
-	PolyPrimitive::Type type;
-	switch (m_Faces[0].Index.size())
-	{
-		case 3: type=PolyPrimitive::TRILIST; break;
-		case 4: type=PolyPrimitive::QUADS; break;
-		default:
-		{
-			Trace::Stream<<"obj file needs to contain triangles or quads"<<endl;
-			return NULL;
-		}
-	}
-
-	PolyPrimitive *prim = new PolyPrimitive(type);
+	// stick all the data in a primitive, faces are always split into
+	// triangles (as the old loader did before choosing the type from 
+	// the first face, so quad files have always loaded as trilists)
+	PolyPrimitive *prim = new PolyPrimitive(PolyPrimitive::TRILIST);
 	prim->Resize(m_Position.size());
 
-	TypedPData<dVector> *pos = new TypedPData<dVector>(m_Position);
+	TypedPData<dVector> *pos = new TypedPData<dVector>;
+	pos->m_Data.swap(m_Position);
 	prim->SetDataRaw("p", pos);
 
 	if (!m_Texture.empty())
 	{
-		assert(m_Texture.size()==m_Position.size());
-		TypedPData<dVector> *tex = new TypedPData<dVector>(m_Texture);
+		TypedPData<dVector> *tex = new TypedPData<dVector>;
+		tex->m_Data.swap(m_Texture);
 		prim->SetDataRaw("t", tex);
 	}
 
 	if (!m_Normal.empty())
 	{
-		assert(m_Normal.size()==m_Position.size());
-		TypedPData<dVector> *nrm = new TypedPData<dVector>(m_Normal);
+		TypedPData<dVector> *nrm = new TypedPData<dVector>;
+		nrm->m_Data.swap(m_Normal);
 		prim->SetDataRaw("n", nrm);
 	}
 
-	prim->GetIndex()=m_Indices;
+	prim->GetIndex().swap(m_Indices);
 	prim->SetIndexMode(true);
 	return prim;
 }
 
-unsigned int OBJPrimitiveIO::TokeniseLine(unsigned int pos, vector<string> &output)
+void OBJPrimitiveIO::ReadOBJ(const char *data, unsigned int size)
 {
-	char c=m_Data[pos];
-	vector<string> temp;
-	temp.push_back("");
-	while(c!='\n' && pos<m_DataSize)
-	{
-		if (c==' ' && *temp.rbegin()!="") temp.push_back("");
-		else temp.rbegin()->push_back(c);
-		c=m_Data[++pos];
-	}
-
-	// get rid of whitespace
-	output.clear();
-	for(vector<string>::iterator i=temp.begin(); i!=temp.end(); ++i)
-	{
-		if (*i!="")	output.push_back(*i);
-	}
+	m_Position.clear();
+	m_Texture.clear();
+	m_Normal.clear();
+	m_Corners.clear();
 
-	return pos+1;
-}
+	const char *pos=data;
+	const char *dataend=data+size;
 
-void OBJPrimitiveIO::TokeniseIndices(const string &str, vector<string> &output)
-{
-	unsigned int pos=0;
-	output.clear();
-	output.push_back("");
-	while(pos<str.size())
+	while (pos<dataend)
 	{
-		char c=str[pos++];
-		if (c==' ' || c=='/') output.push_back("");
-		else output.rbegin()->push_back(c);
-	}
-}
+		const char *end=static_cast<const char*>(memchr(pos,'\n',dataend-pos));
+		if (end==NULL) end=dataend;
 
-void OBJPrimitiveIO::ReadOBJ(std::vector<dVector> &positions,
-		std::vector<dVector> &textures,
-		std::vector<dVector> &normals,
-		std::vector<Face> &faces)
-{
-	unsigned int pos=0;
-	positions.clear();
-	textures.clear();
-	normals.clear();
-	faces.clear();
-
-	while (pos<m_DataSize)
-	{
-		vector<string> tokens;
-		pos = TokeniseLine(pos, tokens);
-		if (tokens.empty())
-			continue;
+		pos=SkipSpace(pos,end);
+		const char *keyword=pos;
+		while (pos<end && !IsSpace(*pos)) pos++;
+		unsigned int length=pos-keyword;
 
-		if ((tokens[0] == "v") && (tokens.size() == 4))
+		if (length==1 && keyword[0]=='v')
 		{
-			positions.push_back(dVector(atof(tokens[1].c_str()),
-									 atof(tokens[2].c_str()),
-									 atof(tokens[3].c_str())));
+			dVector v(0,0,0);
+			pos=ParseFloat(SkipSpace(pos,end),end,v.x);
+			pos=ParseFloat(SkipSpace(pos,end),end,v.y);
+			pos=ParseFloat(SkipSpace(pos,end),end,v.z);
+			m_Position.push_back(v);
 		}
-		else if (tokens[0] == "vt")
+		else if (length==2 && keyword[0]=='v' && keyword[1]=='t')
 		{
-			if (tokens.size() == 4)
-			{
-				textures.push_back(dVector(atof(tokens[1].c_str()),
-										 atof(tokens[2].c_str()),
-										 atof(tokens[3].c_str())));
-			}
-			else if (tokens.size() == 3)
-			{
-				textures.push_back(dVector(atof(tokens[1].c_str()),
-										 atof(tokens[2].c_str()),
-										 0));
-			}
+			dVector v(0,0,0);
+			pos=ParseFloat(SkipSpace(pos,end),end,v.x);
+			pos=ParseFloat(SkipSpace(pos,end),end,v.y);
+			pos=ParseFloat(SkipSpace(pos,end),end,v.z);
+			m_Texture.push_back(v);
 		}
-		else if ((tokens[0] == "vn") && (tokens.size() == 4))
+		else if (length==2 && keyword[0]=='v' && keyword[1]=='n')
 		{
-			normals.push_back(dVector(atof(tokens[1].c_str()),
-									 atof(tokens[2].c_str()),
-									 atof(tokens[3].c_str())));
+			dVector v(0,0,0);
+			pos=ParseFloat(SkipSpace(pos,end),end,v.x);
+			pos=ParseFloat(SkipSpace(pos,end),end,v.y);
+			pos=ParseFloat(SkipSpace(pos,end),end,v.z);
+			m_Normal.push_back(v);
 		}
-		else if (tokens[0] == "f")
+		else if (length==1 && keyword[0]=='f')
 		{
-			Face f;
-			for(unsigned int i=1; i<tokens.size(); i++)
-			{
-				vector<string> itokens;
-				TokeniseIndices(tokens[i],itokens);
-				if (itokens.size()==3)
-				{
-					Indices ind;
-					if (itokens[0]!="") ind.Position=(unsigned int)atof(itokens[0].c_str())-1;
-					if (itokens[1]!="") ind.Texture=(unsigned int)atof(itokens[1].c_str())-1;
-					if (itokens[2]!="") ind.Normal=(unsigned int)atof(itokens[2].c_str())-1;
-					f.Index.push_back(ind);
-
-					if ((ind.Position != ind.Texture) ||
-						(ind.Position != ind.Normal) ||
-						(ind.Texture != ind.Normal))
-					{
-						m_UnifiedIndices = false;
-					}
-				}
-				else if (itokens.size()==2)
-				{
-					Indices ind;
-					if (itokens[0]!="") ind.Position=(unsigned int)atof(itokens[0].c_str())-1;
-					if (itokens[1]!="") ind.Texture=(unsigned int)atof(itokens[1].c_str())-1;
-					f.Index.push_back(ind);
-
-					if (ind.Position != ind.Texture)
-					{
-						m_UnifiedIndices = false;
-					}
-				}
-				else if (itokens.size()==1)
-				{
-					Indices ind;
-					if (itokens[0]!="") ind.Position=(unsigned int)atof(itokens[0].c_str())-1;
-					f.Index.push_back(ind);
-				}
-				else
-				{
-					Trace::Stream<<"Wrong number of indices in .obj file ("<<itokens.size()<<")"<<endl;
-				}
-			}
-
-			// subdivide polygons to triangles
-			if (f.Index.size() > 3)
-			{
-				Face tri;
-				for (unsigned i = 0; i < 3; i++)
-				{
-					tri.Index.push_back(f.Index[i]);
-				}
-				faces.push_back(tri);
-
-				for (unsigned i = 3; i < f.Index.size(); i++)
-				{
-					tri.Index.erase(tri.Index.begin() + 1);
-					tri.Index.push_back(f.Index[i]);
-					faces.push_back(tri);
-				}
-			}
-			else
-			{
-				faces.push_back(f);
-			}
+			ReadFace(pos,end);
 		}
+
+		pos=end+1;
 	}
 }
 
-vector<OBJPrimitiveIO::Indices> OBJPrimitiveIO::RemoveDuplicateIndices()
+void OBJPrimitiveIO::ReadFace(const char *pos, const char *end)
 {
-	vector<Indices> ret;
-	for (vector<Face>::iterator fi=m_Faces.begin();
-		fi!=m_Faces.end(); ++fi)
+	m_FaceCorners.clear();
+
+	while (true)
 	{
-		for (vector<Indices>::iterator ii=fi->Index.begin();
-			ii!=fi->Index.end(); ++ii)
+		pos=SkipSpace(pos,end);
+		if (pos>=end) break;
+
+		// position/texture/normal, where the last two are optional
+		int index[3]={0,0,0};
+		bool found[3]={false,false,false};
+		unsigned int count=0;
+		while (count<3)
 		{
-			vector<Indices>::iterator result = find(ret.begin(), ret.end(), *ii);
-			if (result == ret.end())
-			{
-				ii->UnifiedIndex = ret.size();
-				ret.push_back(*ii);
-			}
-			else
-			{
-				ii->UnifiedIndex = result - ret.begin();
-			}
+			const char *next=ParseInt(pos,end,index[count]);
+			found[count]=(next!=pos);
+			pos=next;
+			count++;
+			if (pos<end && *pos=='/') pos++;
+			else break;
+		}
+
+		// skip anything we don't understand
+		if (!found[0])
+		{
+			while (pos<end && !IsSpace(*pos)) pos++;
+			continue;
 		}
+
+		Indices ind;
+		ind.Position=ResolveIndex(index[0],m_Position.size());
+		if (found[1]) ind.Texture=ResolveIndex(index[1],m_Texture.size());
+		if (found[2]) ind.Normal=ResolveIndex(index[2],m_Normal.size());
+		m_FaceCorners.push_back(ind);
+
+		if ((count==3 && (ind.Position!=ind.Texture || ind.Position!=ind.Normal)) ||
+			(count==2 && ind.Position!=ind.Texture))
+		{
+			m_UnifiedIndices = false;
+		}
+	}
+
+	// subdivide polygons to triangles, fanning from the first
+	// corner in the same order as the old loader
+	for (unsigned int i=2; i<m_FaceCorners.size(); i++)
+	{
+		m_Corners.push_back(m_FaceCorners[0]);
+		m_Corners.push_back(m_FaceCorners[i-1]);
+		m_Corners.push_back(m_FaceCorners[i]);
 	}
-	return ret;
 }
 
-void OBJPrimitiveIO::ReorderData(const vector<OBJPrimitiveIO::Indices> &unique)
+void OBJPrimitiveIO::RemoveDuplicateIndices()
 {
 	vector<dVector> NewPosition;
 	vector<dVector> NewTexture;
 	vector<dVector> NewNormal;
+	vector<Indices> unique;
 
-	for (vector<Indices>::const_iterator i=unique.begin();
-		i!=unique.end(); ++i)
-	{
-		if (!m_Position.empty()) NewPosition.push_back(m_Position[i->Position]);
-		if (!m_Texture.empty()) NewTexture.push_back(m_Texture[i->Texture]);
-		if (!m_Normal.empty()) NewNormal.push_back(m_Normal[i->Normal]);
-	}
-
-	m_Position=NewPosition;
-	m_Texture=NewTexture;
-	m_Normal=NewNormal;
-}
+	// an open addressed table of the unique index + 1, 0 is empty
+	unsigned int tablesize=1;
+	while (tablesize<m_Corners.size()*2) tablesize<<=1;
+	vector<unsigned int> table(tablesize,0);
+	unsigned int mask=tablesize-1;
+	bool warned=false;
 
-void OBJPrimitiveIO::UnifyIndices(const vector<Indices> &unique)
-{
-	m_Indices.clear();
-	for (vector<Face>::const_iterator fi=m_Faces.begin();
-		fi!=m_Faces.end(); ++fi)
+	m_Indices.resize(m_Corners.size());
+	for (unsigned int i=0; i<m_Corners.size(); i++)
 	{
-		for (vector<Indices>::const_iterator ii=fi->Index.begin();
-			ii!=fi->Index.end(); ++ii)
+		const Indices &ind=m_Corners[i];
+		unsigned int slot=HashIndices(ind.Position,ind.Texture,ind.Normal)&mask;
+		while (table[slot]!=0 && !(unique[table[slot]-1]==ind))
+		{
+			slot=(slot+1)&mask;
+		}
+
+		if (table[slot]==0)
 		{
-			m_Indices.push_back(ii->UnifiedIndex);
+			table[slot]=unique.size()+1;
+			unique.push_back(ind);
+
+			if (ind.Position>=m_Position.size() ||
+				(!m_Texture.empty() && ind.Texture>=m_Texture.size()) ||
+				(!m_Normal.empty() && ind.Normal>=m_Normal.size()))
+			{
+				if (!warned) Trace::Stream<<"obj file has indices out of range"<<endl;
+				warned=true;
+			}
+
+			NewPosition.push_back(ind.Position<m_Position.size()?m_Position[ind.Position]:dVector(0,0,0));
+			if (!m_Texture.empty()) NewTexture.push_back(ind.Texture<m_Texture.size()?m_Texture[ind.Texture]:dVector(0,0,0));
+			if (!m_Normal.empty()) NewNormal.push_back(ind.Normal<m_Normal.size()?m_Normal[ind.Normal]:dVector(0,0,0));
 		}
+
+		m_Indices[i]=table[slot]-1;
 	}
+
+	m_Position.swap(NewPosition);
+	m_Texture.swap(NewTexture);
+	m_Normal.swap(NewNormal);
 }
 
 //////////////////////////////////
@@ -30,12 +30,13 @@ public:
 	virtual ~OBJPrimitiveIO();
 	virtual Primitive *FormatRead(const std::string &filename);
 	virtual bool FormatWrite(const std::string &filename, const Primitive *ob);
+	virtual bool BinaryCacheable() { return true; }
 
 private:
 	class Indices
 	{
 	public:
-		Indices() : Position(0), Texture(0), Normal(0), UnifiedIndex(0) {}
+		Indices() : Position(0), Texture(0), Normal(0) {}
 
 		bool operator==(const Indices &other) const
 		{
@@ -47,33 +48,23 @@ private:
 		unsigned int Position;
 		unsigned int Texture;
 		unsigned int Normal;
-
-		unsigned int UnifiedIndex;
 	};
 
-	struct Face
-	{
-		vector<Indices> Index;
-	};
+	/// Parses straight from the file data, filling in the
+	/// vertex data and the triangulated face indices
+	void ReadOBJ(const char *data, unsigned int size);
+	void ReadFace(const char *pos, const char *end);
 
-	unsigned int TokeniseLine(unsigned int pos, vector<string> &output);
-	void TokeniseIndices(const string &str, vector<string> &output);
-	void ReadOBJ(std::vector<dVector> &positions,
-				std::vector<dVector> &textures,
-				std::vector<dVector> &normals,
-				std::vector<Face> &faces);
-	vector<Indices> RemoveDuplicateIndices();
-	void ReorderData(const vector<Indices> &unique);
-	void UnifyIndices(const vector<Indices> &unique);
+	/// Makes a vertex for each unique combination of position,
+	/// texture and normal index, found with a hash table
+	void RemoveDuplicateIndices();
 	Primitive *MakePrimitive();
 
 	void WriteVertices(const std::string &pdataname, const std::string &objname, const Primitive *ob, FILE *file);
 	void WriteIndices(const Primitive *ob, FILE *file);
 
-	unsigned int m_DataSize;
-	char *m_Data;
-
-	vector<Face> m_Faces;
+	vector<Indices> m_Corners; // three for each triangle
+	vector<Indices> m_FaceCorners; // for the face we are reading
 	vector<dVector> m_Position;
 	vector<dVector> m_Texture;
 	vector<dVector> m_Normal;
@@ -31,19 +31,54 @@ namespace Fluxus
 class PData
 {
 public:
-	PData() {}
+	PData() : m_DirtyStart(0), m_DirtyEnd(DIRTY_ALL) {}
 	virtual ~PData() {}
 	virtual PData *Copy() const=0;
 	virtual unsigned int Size() const=0;
 	virtual void Resize(unsigned int size)=0;
 	
+	/// Size in bytes of one element, and a pointer to the first 
+	/// element - for handing the array straight to the graphics card
+	virtual unsigned int ElementSize() const=0;
+	virtual const void *RawData() const=0;
+	/// Writing through this doesn't mark anything dirty
+	virtual void *RawData()=0;
+	
 	char GetType() const { return m_Type; }
 	
+	///////////////////////////////////////////////////
+	///@name Dirty tracking
+	/// Records the range of elements written since the last 
+	/// call to ClearDirty(), so things which keep copies of 
+	/// the data (such as vertex buffers) only need to update 
+	/// what has changed. New arrays start off entirely dirty.
+	///@{
+	void SetDirty(unsigned int index) 
+	{ 
+		if (index<m_DirtyStart) m_DirtyStart=index;
+		if (m_DirtyEnd==DIRTY_NONE || index>=m_DirtyEnd) m_DirtyEnd=index+1;
+	}
+	void SetAllDirty()                 { m_DirtyStart=0; m_DirtyEnd=DIRTY_ALL; }
+	void ClearDirty()                  { m_DirtyStart=DIRTY_ALL; m_DirtyEnd=DIRTY_NONE; }
+	bool IsDirty() const               { return m_DirtyEnd!=DIRTY_NONE; }
+	/// The dirty range as [start,end), clamped to the array size
+	void GetDirtyRange(unsigned int &start, unsigned int &end) const
+	{
+		start=m_DirtyStart;
+		end=m_DirtyEnd<Size()?m_DirtyEnd:Size();
+	}
+	///@}
+	
 protected:
 	void SetType(const char s) { m_Type=s; }
 	
 private:
+	static const unsigned int DIRTY_NONE=0;
+	static const unsigned int DIRTY_ALL=0xffffffff;
+
 	char m_Type;
+	unsigned int m_DirtyStart;
+	unsigned int m_DirtyEnd;
 };
 
 /////////////////////////////////////////////////
@@ -73,6 +108,24 @@ public:
 	virtual void Resize(unsigned int size)
 	{
 		m_Data.resize(size);
+		SetAllDirty();
+	}
+	
+	virtual unsigned int ElementSize() const
+	{
+		return sizeof(T);
+	}
+	
+	virtual const void *RawData() const
+	{
+		if (m_Data.empty()) return NULL;
+		return &m_Data[0];
+	}
+	
+	virtual void *RawData()
+	{
+		if (m_Data.empty()) return NULL;
+		return &m_Data[0];
 	}
 	
 	///\todo add operator[] and make m_Data private
@@ -14,49 +14,254 @@
 // along with this program; if not, write to the Free Software
 // Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
 
+#include <math.h>
 #include "PDataArithmetic.h"
+#include "SimplexNoise.h"
+
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
+#ifdef PDATA_AVX2
+#include "PDataArithmeticAVX2.h"
+#endif
 
 using namespace Fluxus;
 
-template <>
-PData *AddOperator::Operate(TypedPData<float> *a, float b)
+#ifdef PDATA_AVX2
+
+// the AVX2 kernels are built separately, and are only 
+// used if the cpu we're running on turns out to have it
+static bool HasAVX2()
+{
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2");
+}
+
+static const bool UseAVX2=HasAVX2();
+
+#define DISPATCH_AVX2(call) if (UseAVX2) { AVX2::call; return; }
+#else
+#define DISPATCH_AVX2(call)
+#endif
+
+#ifdef __SSE__
+
+// dVectors and dColours are 4 floats, so they are loaded as a 
+// single register - vector operations use this mask to leave w alone
+static const union { unsigned int i[4]; __m128 v; } XYZMask = {{0xffffffff,0xffffffff,0xffffffff,0}};
+
+// returns a with it's w replaced from b
+static inline __m128 KeepW(__m128 a, __m128 b)
+{
+	return _mm_or_ps(_mm_and_ps(a,XYZMask.v),_mm_andnot_ps(XYZMask.v,b));
+}
+
+#endif
+
+// adds a constant to n floats
+static void AddFloats(float *a, const float *b, unsigned int n, unsigned int stride)
 {
-	for (vector<float>::iterator i=a->m_Data.begin(); i!=a->m_Data.end(); i++)
+	DISPATCH_AVX2(AddFloats(a,b,n,stride));
+	unsigned int i=0;
+#ifdef __SSE__
+	// stride 0 means b is a single value, otherwise an array
+	if (stride==0)
 	{
-		*i+=b;
+		__m128 v=_mm_set1_ps(*b);
+		for (; i+4<=n; i+=4) _mm_storeu_ps(a+i,_mm_add_ps(_mm_loadu_ps(a+i),v));
 	}
-	
+	else
+	{
+		for (; i+4<=n; i+=4) _mm_storeu_ps(a+i,_mm_add_ps(_mm_loadu_ps(a+i),_mm_loadu_ps(b+i)));
+	}
+#endif
+	for (; i<n; i++) a[i]+=b[i*stride];
+}
+
+static void MultFloats(float *a, const float *b, unsigned int n, unsigned int stride)
+{
+	DISPATCH_AVX2(MultFloats(a,b,n,stride));
+	unsigned int i=0;
+#ifdef __SSE__
+	if (stride==0)
+	{
+		__m128 v=_mm_set1_ps(*b);
+		for (; i+4<=n; i+=4) _mm_storeu_ps(a+i,_mm_mul_ps(_mm_loadu_ps(a+i),v));
+	}
+	else
+	{
+		for (; i+4<=n; i+=4) _mm_storeu_ps(a+i,_mm_mul_ps(_mm_loadu_ps(a+i),_mm_loadu_ps(b+i)));
+	}
+#endif
+	for (; i<n; i++) a[i]*=b[i*stride];
+}
+
+// adds the xyz of a constant vector, or an array of them to n vectors
+static void AddVectors(dVector *a, const dVector *b, unsigned int n, unsigned int stride)
+{
+	DISPATCH_AVX2(AddQuads(a->arr(),&b->x,n,stride));
+#ifdef __SSE__
+	float *pa=a->arr();
+	const float *pb=&b->x;
+	for (unsigned int i=0; i<n; i++)
+	{
+		__m128 v=_mm_and_ps(_mm_loadu_ps(pb),XYZMask.v);
+		_mm_storeu_ps(pa,_mm_add_ps(_mm_loadu_ps(pa),v));
+		pa+=4;
+		pb+=stride*4;
+	}
+#else
+	for (unsigned int i=0; i<n; i++) a[i]+=b[i*stride];
+#endif
+}
+
+static void MultVectors(dVector *a, const dVector *b, unsigned int n, unsigned int stride)
+{
+	DISPATCH_AVX2(MultQuads(a->arr(),&b->x,n,stride));
+#ifdef __SSE__
+	float *pa=a->arr();
+	const float *pb=&b->x;
+	__m128 one=_mm_set1_ps(1);
+	for (unsigned int i=0; i<n; i++)
+	{
+		__m128 v=KeepW(_mm_loadu_ps(pb),one);
+		_mm_storeu_ps(pa,_mm_mul_ps(_mm_loadu_ps(pa),v));
+		pa+=4;
+		pb+=stride*4;
+	}
+#else
+	for (unsigned int i=0; i<n; i++) 
+	{
+		a[i].x*=b[i*stride].x;
+		a[i].y*=b[i*stride].y;
+		a[i].z*=b[i*stride].z;
+	}
+#endif
+}
+
+// a+(b-a)*t over n lots of 4 floats, keeping w if xyzonly is set
+static void LerpQuads(float *a, const float *b, unsigned int n, unsigned int stride, float t, bool xyzonly)
+{
+	DISPATCH_AVX2(LerpQuads(a,b,n,stride,t,xyzonly));
+#ifdef __SSE__
+	__m128 vt=_mm_set1_ps(t);
+	for (unsigned int i=0; i<n; i++)
+	{
+		__m128 va=_mm_loadu_ps(a);
+		__m128 r=_mm_add_ps(va,_mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(b),va),vt));
+		_mm_storeu_ps(a,xyzonly?KeepW(r,va):r);
+		a+=4;
+		b+=stride*4;
+	}
+#else
+	unsigned int c=xyzonly?3:4;
+	for (unsigned int i=0; i<n; i++)
+	{
+		for (unsigned int j=0; j<c; j++) a[j]+=(b[j]-a[j])*t;
+		a+=4;
+		b+=stride*4;
+	}
+#endif
+}
+
+static void ClampQuads(float *a, unsigned int n, float low, float high, bool xyzonly)
+{
+	DISPATCH_AVX2(ClampQuads(a,n,low,high,xyzonly));
+#ifdef __SSE__
+	__m128 vl=_mm_set1_ps(low);
+	__m128 vh=_mm_set1_ps(high);
+	for (unsigned int i=0; i<n; i++)
+	{
+		__m128 va=_mm_loadu_ps(a);
+		__m128 r=_mm_min_ps(_mm_max_ps(va,vl),vh);
+		_mm_storeu_ps(a,xyzonly?KeepW(r,va):r);
+		a+=4;
+	}
+#else
+	unsigned int c=xyzonly?3:4;
+	for (unsigned int i=0; i<n; i++)
+	{
+		for (unsigned int j=0; j<c; j++) 
+		{
+			if (a[j]<low) a[j]=low;
+			if (a[j]>high) a[j]=high;
+		}
+		a+=4;
+	}
+#endif
+}
+
+// transforms n vectors, if rotate is set translation is ignored and w is left alone
+static void TransformVectors(dVector *a, const dMatrix &m, unsigned int n, bool rotate)
+{
+	DISPATCH_AVX2(TransformQuads(a->arr(),&m.m[0][0],n,rotate));
+#ifdef __SSE__
+	__m128 r0=_mm_loadu_ps(m.m[0]);
+	__m128 r1=_mm_loadu_ps(m.m[1]);
+	__m128 r2=_mm_loadu_ps(m.m[2]);
+	__m128 r3=_mm_loadu_ps(m.m[3]);
+	float *p=a->arr();
+	for (unsigned int i=0; i<n; i++)
+	{
+		__m128 v=_mm_loadu_ps(p);
+		__m128 t=_mm_add_ps(_mm_add_ps(
+			_mm_mul_ps(_mm_shuffle_ps(v,v,_MM_SHUFFLE(0,0,0,0)),r0),
+			_mm_mul_ps(_mm_shuffle_ps(v,v,_MM_SHUFFLE(1,1,1,1)),r1)),
+			_mm_mul_ps(_mm_shuffle_ps(v,v,_MM_SHUFFLE(2,2,2,2)),r2));
+		if (rotate) t=KeepW(t,v);
+		else t=_mm_add_ps(t,_mm_mul_ps(_mm_shuffle_ps(v,v,_MM_SHUFFLE(3,3,3,3)),r3));
+		_mm_storeu_ps(p,t);
+		p+=4;
+	}
+#else
+	for (unsigned int i=0; i<n; i++)
+	{
+		if (rotate) a[i]=m.transform_no_trans(a[i]);
+		else a[i]=m.transform(a[i]);
+	}
+#endif
+}
+
+static bool SameSize(const char *name, PData *a, const PData *b)
+{
+	if (a->Size()!=b->Size())
+	{
+		Trace::Stream<<name<<": pdata arrays are different sizes"<<endl;
+		return false;
+	}
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////////////
+
+template <>
+PData *AddOperator::Operate(TypedPData<float> *a, float b)
+{
+	if (!a->m_Data.empty()) AddFloats(&a->m_Data[0],&b,a->Size(),0);
 	return NULL;
 }
 
 template <>
 PData *AddOperator::Operate(TypedPData<dVector> *a, float b)
 {
-	for (vector<dVector>::iterator i=a->m_Data.begin(); i!=a->m_Data.end(); i++)
-	{
-		i->x+=b;
-		i->y+=b;
-		i->z+=b;
-	}
+	dVector v(b,b,b);
+	if (!a->m_Data.empty()) AddVectors(&a->m_Data[0],&v,a->Size(),0);
 	return NULL;
 }
 
 template <>
 PData *AddOperator::Operate(TypedPData<dVector> *a, dVector b)
 {
-	for (vector<dVector>::iterator i=a->m_Data.begin(); i!=a->m_Data.end(); i++)
-	{
-		i->x+=b.x;
-		i->y+=b.y;
-		i->z+=b.z;
-	}
+	if (!a->m_Data.empty()) AddVectors(&a->m_Data[0],&b,a->Size(),0);
 	return NULL;
 }
 
 template <>
 PData *AddOperator::Operate(TypedPData<float> *a, TypedPData<float> *b)
 {
-	for (unsigned int i=0; i<a->Size(); i++) a->m_Data[i]+=b->m_Data[i];
+	if (!SameSize("AddOperator",a,b) || a->m_Data.empty()) return NULL;
+	AddFloats(&a->m_Data[0],&b->m_Data[0],a->Size(),1);
 	return NULL;
 }
 
@@ -75,7 +280,8 @@ PData *AddOperator::Operate(TypedPData<dVector> *a, TypedPData<float> *b)
 template <>
 PData *AddOperator::Operate(TypedPData<dVector> *a, TypedPData<dVector> *b)
 {
-	for (unsigned int i=0; i<a->Size(); i++) a->m_Data[i]+=b->m_Data[i];
+	if (!SameSize("AddOperator",a,b) || a->m_Data.empty()) return NULL;
+	AddVectors(&a->m_Data[0],&b->m_Data[0],a->Size(),1);
 	return NULL;
 }
 
@@ -84,49 +290,38 @@ PData *AddOperator::Operate(TypedPData<dVector> *a, TypedPData<dVector> *b)
 template <>
 PData *MultOperator::Operate(TypedPData<float> *a, float b)
 {
-	for (vector<float>::iterator i=a->m_Data.begin(); i!=a->m_Data.end(); i++)
-	{
-		(*i)*=b;
-	}
+	if (!a->m_Data.empty()) MultFloats(&a->m_Data[0],&b,a->Size(),0);
 	return NULL;
 }
 
 template <>
 PData *MultOperator::Operate(TypedPData<dVector> *a, float b)
 {
-	for (vector<dVector>::iterator i=a->m_Data.begin(); i!=a->m_Data.end(); i++)
-	{
-		(*i)*=b;
-	}
+	dVector v(b,b,b);
+	if (!a->m_Data.empty()) MultVectors(&a->m_Data[0],&v,a->Size(),0);
 	return NULL;
 }
 
 template <>
 PData *MultOperator::Operate(TypedPData<dColour> *a, float b)
 {
-	for (vector<dColour>::iterator i=a->m_Data.begin(); i!=a->m_Data.end(); i++)
-	{
-		(*i)*=b;
-	}
+	// colours scale alpha too
+	if (!a->m_Data.empty()) MultFloats(a->m_Data[0].arr(),&b,a->Size()*4,0);
 	return NULL;
 }
 
 template <>
 PData *MultOperator::Operate(TypedPData<dVector> *a, dVector b)
 {
-	for (vector<dVector>::iterator i=a->m_Data.begin(); i!=a->m_Data.end(); i++)
-	{
-		(*i).x*=b.x;
-		(*i).y*=b.y;
-		(*i).z*=b.z;
-	}
+	if (!a->m_Data.empty()) MultVectors(&a->m_Data[0],&b,a->Size(),0);
 	return NULL;
 }
 
 template <>
 PData *MultOperator::Operate(TypedPData<float> *a, TypedPData<float> *b)
 {
-	for (unsigned int i=0; i<a->Size(); i++) a->m_Data[i]*=b->m_Data[i];
+	if (!SameSize("MultOperator",a,b) || a->m_Data.empty()) return NULL;
+	MultFloats(&a->m_Data[0],&b->m_Data[0],a->Size(),1);
 	return NULL;
 }
 
@@ -143,12 +338,8 @@ PData *MultOperator::Operate(TypedPData<dVector> *a, TypedPData<float> *b)
 template <>
 PData *MultOperator::Operate(TypedPData<dVector> *a, TypedPData<dVector> *b)
 {
-	for (unsigned int i=0; i<a->Size(); i++)
-	{
-		a->m_Data[i].x*=b->m_Data[i].x;
-		a->m_Data[i].y*=b->m_Data[i].y;
-		a->m_Data[i].z*=b->m_Data[i].z;
-	}
+	if (!SameSize("MultOperator",a,b) || a->m_Data.empty()) return NULL;
+	MultVectors(&a->m_Data[0],&b->m_Data[0],a->Size(),1);
 	return NULL;
 }
 
@@ -224,3 +415,235 @@ PData *ClosestOperator::Operate(TypedPData<dVector> *a, float b)
 	return ret;
 }
 
+///////////////////////////////////////////////////////
+
+template <>
+PData *LerpOperator::Operate(TypedPData<float> *a, float b, const PDataArgs &args)
+{
+	float t=args.Get(0,0.5);
+	for (unsigned int i=0; i<a->Size(); i++)
+	{
+		a->m_Data[i]+=(b-a->m_Data[i])*t;
+	}
+	return NULL;
+}
+
+template <>
+PData *LerpOperator::Operate(TypedPData<float> *a, TypedPData<float> *b, const PDataArgs &args)
+{
+	if (!SameSize("LerpOperator",a,b)) return NULL;
+	float t=args.Get(0,0.5);
+	for (unsigned int i=0; i<a->Size(); i++)
+	{
+		a->m_Data[i]+=(b->m_Data[i]-a->m_Data[i])*t;
+	}
+	return NULL;
+}
+
+template <>
+PData *LerpOperator::Operate(TypedPData<dVector> *a, dVector b, const PDataArgs &args)
+{
+	if (!a->m_Data.empty()) LerpQuads(a->m_Data[0].arr(),b.arr(),a->Size(),0,args.Get(0,0.5),true);
+	return NULL;
+}
+
+template <>
+PData *LerpOperator::Operate(TypedPData<dVector> *a, TypedPData<dVector> *b, const PDataArgs &args)
+{
+	if (!SameSize("LerpOperator",a,b) || a->m_Data.empty()) return NULL;
+	LerpQuads(a->m_Data[0].arr(),b->m_Data[0].arr(),a->Size(),1,args.Get(0,0.5),true);
+	return NULL;
+}
+
+template <>
+PData *LerpOperator::Operate(TypedPData<dColour> *a, dColour b, const PDataArgs &args)
+{
+	if (!a->m_Data.empty()) LerpQuads(a->m_Data[0].arr(),b.arr(),a->Size(),0,args.Get(0,0.5),false);
+	return NULL;
+}
+
+template <>
+PData *LerpOperator::Operate(TypedPData<dColour> *a, TypedPData<dColour> *b, const PDataArgs &args)
+{
+	if (!SameSize("LerpOperator",a,b) || a->m_Data.empty()) return NULL;
+	LerpQuads(a->m_Data[0].arr(),b->m_Data[0].arr(),a->Size(),1,args.Get(0,0.5),false);
+	return NULL;
+}
+
+///////////////////////////////////////////////////////
+
+template <>
+PData *ClampOperator::Operate(TypedPData<float> *a, float b, const PDataArgs &args)
+{
+	float high=args.Get(0,1);
+	for (unsigned int i=0; i<a->Size(); i++)
+	{
+		if (a->m_Data[i]<b) a->m_Data[i]=b;
+		if (a->m_Data[i]>high) a->m_Data[i]=high;
+	}
+	return NULL;
+}
+
+template <>
+PData *ClampOperator::Operate(TypedPData<dVector> *a, float b, const PDataArgs &args)
+{
+	if (!a->m_Data.empty()) ClampQuads(a->m_Data[0].arr(),a->Size(),b,args.Get(0,1),true);
+	return NULL;
+}
+
+template <>
+PData *ClampOperator::Operate(TypedPData<dColour> *a, float b, const PDataArgs &args)
+{
+	if (!a->m_Data.empty()) ClampQuads(a->m_Data[0].arr(),a->Size(),b,args.Get(0,1),false);
+	return NULL;
+}
+
+///////////////////////////////////////////////////////
+
+template <>
+PData *NormaliseOperator::Operate(TypedPData<dVector> *a, float b)
+{
+	for (vector<dVector>::iterator i=a->m_Data.begin(); i!=a->m_Data.end(); i++)
+	{
+		float mag=i->mag();
+		// leave zero length vectors alone
+		if (mag>0) (*i)*=b/mag;
+	}
+	return NULL;
+}
+
+///////////////////////////////////////////////////////
+
+template <>
+PData *CrossOperator::Operate(TypedPData<dVector> *a, dVector b)
+{
+	for (vector<dVector>::iterator i=a->m_Data.begin(); i!=a->m_Data.end(); i++)
+	{
+		float w=i->w;
+		*i=i->cross(b);
+		i->w=w;
+	}
+	return NULL;
+}
+
+template <>
+PData *CrossOperator::Operate(TypedPData<dVector> *a, TypedPData<dVector> *b)
+{
+	if (!SameSize("CrossOperator",a,b)) return NULL;
+	for (unsigned int i=0; i<a->Size(); i++)
+	{
+		float w=a->m_Data[i].w;
+		a->m_Data[i]=a->m_Data[i].cross(b->m_Data[i]);
+		a->m_Data[i].w=w;
+	}
+	return NULL;
+}
+
+///////////////////////////////////////////////////////
+
+template <>
+PData *DotOperator::Operate(TypedPData<float> *a, TypedPData<dVector> *b, const PDataArgs &args)
+{
+	if (!SameSize("DotOperator",a,b)) return NULL;
+	
+	const TypedPData<dVector> *other=dynamic_cast<const TypedPData<dVector>*>(args.Data);
+	if (other)
+	{
+		if (other->Size()!=a->Size())
+		{
+			Trace::Stream<<"DotOperator: pdata arrays are different sizes"<<endl;
+			return NULL;
+		}
+		
+		for (unsigned int i=0; i<a->Size(); i++)
+		{
+			a->m_Data[i]=b->m_Data[i].dot(other->m_Data[i]);
+		}
+	}
+	else
+	{
+		dVector v(args.Get(0,0),args.Get(1,0),args.Get(2,0));
+		for (unsigned int i=0; i<a->Size(); i++)
+		{
+			a->m_Data[i]=b->m_Data[i].dot(v);
+		}
+	}
+	return NULL;
+}
+
+///////////////////////////////////////////////////////
+
+template <>
+PData *TransformOperator::Operate(TypedPData<dVector> *a, dMatrix b)
+{
+	if (!a->m_Data.empty()) TransformVectors(&a->m_Data[0],b,a->Size(),false);
+	return NULL;
+}
+
+template <>
+PData *RotateOperator::Operate(TypedPData<dVector> *a, dMatrix b)
+{
+	if (!a->m_Data.empty()) TransformVectors(&a->m_Data[0],b,a->Size(),true);
+	return NULL;
+}
+
+///////////////////////////////////////////////////////
+
+template <>
+PData *SineDisplaceOperator::Operate(TypedPData<dVector> *a, dVector b, const PDataArgs &args)
+{
+	float amplitude=args.Get(0,1);
+	float phase=args.Get(1,0);
+	
+	const TypedPData<dVector> *dirs=dynamic_cast<const TypedPData<dVector>*>(args.Data);
+	if (dirs && dirs->Size()!=a->Size())
+	{
+		Trace::Stream<<"SineDisplaceOperator: pdata arrays are different sizes"<<endl;
+		return NULL;
+	}
+	
+	// without a direction array, displace along the wave
+	dVector dir=b;
+	if (dir.mag()>0) dir.normalise();
+	
+	for (unsigned int i=0; i<a->Size(); i++)
+	{
+		float d=amplitude*sin(a->m_Data[i].dot(b)+phase);
+		if (dirs) a->m_Data[i]+=dirs->m_Data[i]*d;
+		else a->m_Data[i]+=dir*d;
+	}
+	return NULL;
+}
+
+template <>
+PData *NoiseDisplaceOperator::Operate(TypedPData<dVector> *a, dVector b, const PDataArgs &args)
+{
+	float amplitude=args.Get(0,1);
+	float offset=args.Get(1,0);
+	
+	const TypedPData<dVector> *dirs=dynamic_cast<const TypedPData<dVector>*>(args.Data);
+	if (dirs && dirs->Size()!=a->Size())
+	{
+		Trace::Stream<<"NoiseDisplaceOperator: pdata arrays are different sizes"<<endl;
+		return NULL;
+	}
+	
+	for (unsigned int i=0; i<a->Size(); i++)
+	{
+		dVector &p=a->m_Data[i];
+		if (dirs)
+		{
+			float d=amplitude*SimplexNoise::noise(p.x*b.x,p.y*b.y,p.z*b.z,offset);
+			p+=dirs->m_Data[i]*d;
+		}
+		else
+		{
+			// displace each axis with a different part of the noise field
+			dVector d(SimplexNoise::noise(p.x*b.x,p.y*b.y,p.z*b.z,offset),
+			          SimplexNoise::noise(p.x*b.x+31.4,p.y*b.y,p.z*b.z,offset),
+			          SimplexNoise::noise(p.x*b.x,p.y*b.y+31.4,p.z*b.z,offset));
+			p+=d*amplitude;
+		}
+	}
+	return NULL;
+}
@@ -30,6 +30,10 @@ namespace Fluxus
 /// operations on pdata arrays. The way this works is a little
 /// bit strange at present, and will be changed in a future 
 /// release...
+///
+/// The arithmetic on whole arrays uses SSE where it's available, 
+/// vectors are operated on as one register, leaving w alone. If the
+/// cpu supports AVX2 the kernels in PDataArithmeticAVX2 are used.
 
 /// All this template code makes the pdata operators easier to write, as it means the compiler
 /// generates a lot of the code for type/function mapping and also all the combinations that
@@ -149,6 +153,199 @@ PData *ClosestOperator::Operate(TypedPData<dVector> *a, dVector b);
 template<>
 PData *ClosestOperator::Operate(TypedPData<dVector> *a, float b);
 
+/// Blends towards the operand by the amount given as the first extra 
+/// argument, 0 leaves the array alone, 1 sets it to the operand
+class LerpOperator : public PDataOperator
+{
+public:
+	LerpOperator() {}
+	
+	template <class S, class T>
+	static PData *Operate(TypedPData<S> *a, T b, const PDataArgs &args)
+	{
+		Trace::Stream<<"LerpOperator has no operator for types: "<<typeid(a).name()<<" and "	
+			<<typeid(b).name()<<endl;
+		return NULL;
+	}
+	
+};
+
+template<>
+PData *LerpOperator::Operate(TypedPData<float> *a, float b, const PDataArgs &args);
+template<>
+PData *LerpOperator::Operate(TypedPData<float> *a, TypedPData<float> *b, const PDataArgs &args);
+template<>
+PData *LerpOperator::Operate(TypedPData<dVector> *a, dVector b, const PDataArgs &args);
+template<>
+PData *LerpOperator::Operate(TypedPData<dVector> *a, TypedPData<dVector> *b, const PDataArgs &args);
+template<>
+PData *LerpOperator::Operate(TypedPData<dColour> *a, dColour b, const PDataArgs &args);
+template<>
+PData *LerpOperator::Operate(TypedPData<dColour> *a, TypedPData<dColour> *b, const PDataArgs &args);
+
+/// Clamps each element between the operand and the first extra argument
+class ClampOperator : public PDataOperator
+{
+public:
+	ClampOperator() {}
+	
+	template <class S, class T>
+	static PData *Operate(TypedPData<S> *a, T b, const PDataArgs &args)
+	{
+		Trace::Stream<<"ClampOperator has no operator for types: "<<typeid(a).name()<<" and "	
+			<<typeid(b).name()<<endl;
+		return NULL;
+	}
+	
+};
+
+template<>
+PData *ClampOperator::Operate(TypedPData<float> *a, float b, const PDataArgs &args);
+template<>
+PData *ClampOperator::Operate(TypedPData<dVector> *a, float b, const PDataArgs &args);
+template<>
+PData *ClampOperator::Operate(TypedPData<dColour> *a, float b, const PDataArgs &args);
+
+/// Scales each vector to the length given
+class NormaliseOperator : public PDataOperator
+{
+public:
+	NormaliseOperator() {}
+	
+	template <class S, class T>
+	static PData *Operate(TypedPData<S> *a, T b)
+	{
+		Trace::Stream<<"NormaliseOperator has no operator for types: "<<typeid(a).name()<<" and "	
+			<<typeid(b).name()<<endl;
+		return NULL;
+	}
+	
+};
+
+template<>
+PData *NormaliseOperator::Operate(TypedPData<dVector> *a, float b);
+
+/// Replaces each vector with it's cross product with the operand
+class CrossOperator : public PDataOperator
+{
+public:
+	CrossOperator() {}
+	
+	template <class S, class T>
+	static PData *Operate(TypedPData<S> *a, T b)
+	{
+		Trace::Stream<<"CrossOperator has no operator for types: "<<typeid(a).name()<<" and "	
+			<<typeid(b).name()<<endl;
+		return NULL;
+	}
+	
+};
+
+template<>
+PData *CrossOperator::Operate(TypedPData<dVector> *a, dVector b);
+template<>
+PData *CrossOperator::Operate(TypedPData<dVector> *a, TypedPData<dVector> *b);
+
+/// Writes the dot products of the operand vectors with another vector 
+/// array, or a constant vector given as extra arguments, into a float array
+class DotOperator : public PDataOperator
+{
+public:
+	DotOperator() {}
+	
+	template <class S, class T>
+	static PData *Operate(TypedPData<S> *a, T b, const PDataArgs &args)
+	{
+		Trace::Stream<<"DotOperator has no operator for types: "<<typeid(a).name()<<" and "	
+			<<typeid(b).name()<<endl;
+		return NULL;
+	}
+	
+};
+
+template<>
+PData *DotOperator::Operate(TypedPData<float> *a, TypedPData<dVector> *b, const PDataArgs &args);
+
+/// Transforms each vector by the matrix
+class TransformOperator : public PDataOperator
+{
+public:
+	TransformOperator() {}
+	
+	template <class S, class T>
+	static PData *Operate(TypedPData<S> *a, T b)
+	{
+		Trace::Stream<<"TransformOperator has no operator for types: "<<typeid(a).name()<<" and "	
+			<<typeid(b).name()<<endl;
+		return NULL;
+	}
+	
+};
+
+template<>
+PData *TransformOperator::Operate(TypedPData<dVector> *a, dMatrix b);
+
+/// Transforms each vector by the matrix ignoring translation, for normals
+class RotateOperator : public PDataOperator
+{
+public:
+	RotateOperator() {}
+	
+	template <class S, class T>
+	static PData *Operate(TypedPData<S> *a, T b)
+	{
+		Trace::Stream<<"RotateOperator has no operator for types: "<<typeid(a).name()<<" and "	
+			<<typeid(b).name()<<endl;
+		return NULL;
+	}
+	
+};
+
+template<>
+PData *RotateOperator::Operate(TypedPData<dVector> *a, dMatrix b);
+
+/// Displaces vectors by a sine wave, the operand is the wave vector,
+/// extra arguments are the amplitude, phase and optionally a vector 
+/// array of directions to displace along (normals for instance)
+class SineDisplaceOperator : public PDataOperator
+{
+public:
+	SineDisplaceOperator() {}
+	
+	template <class S, class T>
+	static PData *Operate(TypedPData<S> *a, T b, const PDataArgs &args)
+	{
+		Trace::Stream<<"SineDisplaceOperator has no operator for types: "<<typeid(a).name()<<" and "	
+			<<typeid(b).name()<<endl;
+		return NULL;
+	}
+	
+};
+
+template<>
+PData *SineDisplaceOperator::Operate(TypedPData<dVector> *a, dVector b, const PDataArgs &args);
+
+/// Displaces vectors by simplex noise, the operand scales the noise 
+/// lookup, extra arguments are the amplitude, the 4th noise coordinate 
+/// (for animating) and optionally a vector array of directions
+class NoiseDisplaceOperator : public PDataOperator
+{
+public:
+	NoiseDisplaceOperator() {}
+	
+	template <class S, class T>
+	static PData *Operate(TypedPData<S> *a, T b, const PDataArgs &args)
+	{
+		Trace::Stream<<"NoiseDisplaceOperator has no operator for types: "<<typeid(a).name()<<" and "	
+			<<typeid(b).name()<<endl;
+		return NULL;
+	}
+	
+};
+
+template<>
+PData *NoiseDisplaceOperator::Operate(TypedPData<dVector> *a, dVector b, const PDataArgs &args);
+
 }
 
 #endif
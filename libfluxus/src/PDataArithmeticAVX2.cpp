@@ -0,0 +1,167 @@
+// Copyright (C) 2005 Dave Griffiths
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+
+#include <immintrin.h>
+#include "PDataArithmeticAVX2.h"
+
+using namespace Fluxus;
+
+// blend masks which take w from the second argument
+#define KEEP_W4 0x08
+#define KEEP_W8 0x88
+
+// loads the next two quads of b, or repeats the first one for a stride of 0
+static inline __m256 LoadPair(const float *b, unsigned int stride)
+{
+	if (stride==0) return _mm256_broadcast_ps((const __m128*)b);
+	return _mm256_loadu_ps(b);
+}
+
+void AVX2::AddFloats(float *a, const float *b, unsigned int n, unsigned int stride)
+{
+	unsigned int i=0;
+	if (stride==0)
+	{
+		__m256 v=_mm256_set1_ps(*b);
+		for (; i+8<=n; i+=8) _mm256_storeu_ps(a+i,_mm256_add_ps(_mm256_loadu_ps(a+i),v));
+	}
+	else
+	{
+		for (; i+8<=n; i+=8) _mm256_storeu_ps(a+i,_mm256_add_ps(_mm256_loadu_ps(a+i),_mm256_loadu_ps(b+i)));
+	}
+	for (; i<n; i++) a[i]+=b[i*stride];
+}
+
+void AVX2::MultFloats(float *a, const float *b, unsigned int n, unsigned int stride)
+{
+	unsigned int i=0;
+	if (stride==0)
+	{
+		__m256 v=_mm256_set1_ps(*b);
+		for (; i+8<=n; i+=8) _mm256_storeu_ps(a+i,_mm256_mul_ps(_mm256_loadu_ps(a+i),v));
+	}
+	else
+	{
+		for (; i+8<=n; i+=8) _mm256_storeu_ps(a+i,_mm256_mul_ps(_mm256_loadu_ps(a+i),_mm256_loadu_ps(b+i)));
+	}
+	for (; i<n; i++) a[i]*=b[i*stride];
+}
+
+void AVX2::AddQuads(float *a, const float *b, unsigned int n, unsigned int stride)
+{
+	unsigned int i=0;
+	for (; i+2<=n; i+=2)
+	{
+		__m256 va=_mm256_loadu_ps(a);
+		_mm256_storeu_ps(a,_mm256_blend_ps(_mm256_add_ps(va,LoadPair(b,stride)),va,KEEP_W8));
+		a+=8;
+		b+=stride*8;
+	}
+	// an odd one left over
+	if (i<n)
+	{
+		__m128 va=_mm_loadu_ps(a);
+		_mm_storeu_ps(a,_mm_blend_ps(_mm_add_ps(va,_mm_loadu_ps(b)),va,KEEP_W4));
+	}
+}
+
+void AVX2::MultQuads(float *a, const float *b, unsigned int n, unsigned int stride)
+{
+	unsigned int i=0;
+	for (; i+2<=n; i+=2)
+	{
+		__m256 va=_mm256_loadu_ps(a);
+		_mm256_storeu_ps(a,_mm256_blend_ps(_mm256_mul_ps(va,LoadPair(b,stride)),va,KEEP_W8));
+		a+=8;
+		b+=stride*8;
+	}
+	if (i<n)
+	{
+		__m128 va=_mm_loadu_ps(a);
+		_mm_storeu_ps(a,_mm_blend_ps(_mm_mul_ps(va,_mm_loadu_ps(b)),va,KEEP_W4));
+	}
+}
+
+void AVX2::LerpQuads(float *a, const float *b, unsigned int n, unsigned int stride, float t, bool xyzonly)
+{
+	__m256 vt=_mm256_set1_ps(t);
+	unsigned int i=0;
+	for (; i+2<=n; i+=2)
+	{
+		__m256 va=_mm256_loadu_ps(a);
+		__m256 r=_mm256_add_ps(va,_mm256_mul_ps(_mm256_sub_ps(LoadPair(b,stride),va),vt));
+		_mm256_storeu_ps(a,xyzonly?_mm256_blend_ps(r,va,KEEP_W8):r);
+		a+=8;
+		b+=stride*8;
+	}
+	if (i<n)
+	{
+		__m128 va=_mm_loadu_ps(a);
+		__m128 r=_mm_add_ps(va,_mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(b),va),_mm256_castps256_ps128(vt)));
+		_mm_storeu_ps(a,xyzonly?_mm_blend_ps(r,va,KEEP_W4):r);
+	}
+}
+
+void AVX2::ClampQuads(float *a, unsigned int n, float low, float high, bool xyzonly)
+{
+	__m256 vl=_mm256_set1_ps(low);
+	__m256 vh=_mm256_set1_ps(high);
+	unsigned int i=0;
+	for (; i+2<=n; i+=2)
+	{
+		__m256 va=_mm256_loadu_ps(a);
+		__m256 r=_mm256_min_ps(_mm256_max_ps(va,vl),vh);
+		_mm256_storeu_ps(a,xyzonly?_mm256_blend_ps(r,va,KEEP_W8):r);
+		a+=8;
+	}
+	if (i<n)
+	{
+		__m128 va=_mm_loadu_ps(a);
+		__m128 r=_mm_min_ps(_mm_max_ps(va,_mm256_castps256_ps128(vl)),_mm256_castps256_ps128(vh));
+		_mm_storeu_ps(a,xyzonly?_mm_blend_ps(r,va,KEEP_W4):r);
+	}
+}
+
+// transforms one or two vectors held in a register by the matrix rows
+static inline __m256 Transform(__m256 v, __m256 r0, __m256 r1, __m256 r2, __m256 r3, bool rotate)
+{
+	__m256 t=_mm256_add_ps(_mm256_add_ps(
+		_mm256_mul_ps(_mm256_permute_ps(v,_MM_SHUFFLE(0,0,0,0)),r0),
+		_mm256_mul_ps(_mm256_permute_ps(v,_MM_SHUFFLE(1,1,1,1)),r1)),
+		_mm256_mul_ps(_mm256_permute_ps(v,_MM_SHUFFLE(2,2,2,2)),r2));
+	if (rotate) return _mm256_blend_ps(t,v,KEEP_W8);
+	return _mm256_add_ps(t,_mm256_mul_ps(_mm256_permute_ps(v,_MM_SHUFFLE(3,3,3,3)),r3));
+}
+
+void AVX2::TransformQuads(float *a, const float *m, unsigned int n, bool rotate)
+{
+	__m256 r0=_mm256_broadcast_ps((const __m128*)m);
+	__m256 r1=_mm256_broadcast_ps((const __m128*)(m+4));
+	__m256 r2=_mm256_broadcast_ps((const __m128*)(m+8));
+	__m256 r3=_mm256_broadcast_ps((const __m128*)(m+12));
+	unsigned int i=0;
+	for (; i+2<=n; i+=2)
+	{
+		_mm256_storeu_ps(a,Transform(_mm256_loadu_ps(a),r0,r1,r2,r3,rotate));
+		a+=8;
+	}
+	if (i<n)
+	{
+		// do the last one in the low half
+		__m256 v=_mm256_castps128_ps256(_mm_loadu_ps(a));
+		_mm_storeu_ps(a,_mm256_castps256_ps128(Transform(v,r0,r1,r2,r3,rotate)));
+	}
+}
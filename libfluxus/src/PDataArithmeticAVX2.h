@@ -0,0 +1,48 @@
+// Copyright (C) 2005 Dave Griffiths
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+
+#ifndef N_PDATA_ARITH_AVX2
+#define N_PDATA_ARITH_AVX2
+
+namespace Fluxus
+{
+
+///////////////////////////////////////////////////////////////
+/// AVX2 versions of the pdata arithmetic kernels. These are built 
+/// in their own file with -mavx2 (when the compiler supports it, 
+/// see PDATA_AVX2 in the SConstruct) and PDataArithmetic.cpp only 
+/// calls them after checking the cpu has AVX2. 
+///
+/// The quad kernels work on arrays of 4 floats (dVector or dColour), 
+/// two to a register. A stride of 0 means b is a single value, 1 
+/// means it's an array the same length as a.
+namespace AVX2
+{
+	void AddFloats(float *a, const float *b, unsigned int n, unsigned int stride);
+	void MultFloats(float *a, const float *b, unsigned int n, unsigned int stride);
+	/// These two leave w alone
+	void AddQuads(float *a, const float *b, unsigned int n, unsigned int stride);
+	void MultQuads(float *a, const float *b, unsigned int n, unsigned int stride);
+	void LerpQuads(float *a, const float *b, unsigned int n, unsigned int stride, float t, bool xyzonly);
+	void ClampQuads(float *a, unsigned int n, float low, float high, bool xyzonly);
+	/// m is a dMatrix's 16 floats, if rotate is set translation 
+	/// is ignored and w is left alone
+	void TransformQuads(float *a, const float *m, unsigned int n, bool rotate);
+}
+
+}
+
+#endif
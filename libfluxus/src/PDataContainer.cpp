@@ -18,12 +18,16 @@
 
 using namespace Fluxus;
 
+unsigned int PDataContainer::m_NextVersion=0;
+
 PDataContainer::PDataContainer() 
 {
+	UpdateVersion();
 }
 
 PDataContainer::PDataContainer(const PDataContainer &other) 
 {
+	UpdateVersion();
 	Clear();
 	for (map<string,PData*>::const_iterator i=other.m_PData.begin(); 
 		i!=other.m_PData.end(); i++)
@@ -43,6 +47,7 @@ void PDataContainer::Clear()
 	{
 		delete i->second;
 	}
+	UpdateVersion();
 }	
 
 void PDataContainer::Resize(unsigned int size)
@@ -73,28 +78,20 @@ bool PDataContainer::GetDataInfo(const string &name, char &type, unsigned int &s
 	}
 	
 	size=i->second->Size();
-	
-	//\todo: remove all this dynamic casting and store the char type inside pdata...
-	TypedPData<dVector> *data = dynamic_cast<TypedPData<dVector>*>(i->second);	
-	if (data) type='v';
-	else
-	{
-		TypedPData<dColour> *data = dynamic_cast<TypedPData<dColour>*>(i->second);
-		if (data) type='c';
-		else 
-		{
-			TypedPData<float> *data = dynamic_cast<TypedPData<float>*>(i->second);
-			if (data) type='f';
-			else 
-			{
-				TypedPData<dMatrix> *data = dynamic_cast<TypedPData<dMatrix>*>(i->second);
-				if (data) type='m';
-			}
-		}
-	}
-		
+	char t=GetDataType(i->second);
+	if (t) type=t;
 	return true;
 }
+
+char PDataContainer::GetDataType(const PData *pd)
+{
+	//\todo: remove all this dynamic casting and store the char type inside pdata...
+	if (dynamic_cast<const TypedPData<dVector>*>(pd)) return 'v';
+	if (dynamic_cast<const TypedPData<dColour>*>(pd)) return 'c';
+	if (dynamic_cast<const TypedPData<float>*>(pd)) return 'f';
+	if (dynamic_cast<const TypedPData<dMatrix>*>(pd)) return 'm';
+	return 0;
+}
 	
 void PDataContainer::AddData(const string &name, PData* pd)
 {
@@ -106,6 +103,7 @@ void PDataContainer::AddData(const string &name, PData* pd)
 	}
 	
 	m_PData[name]=pd;
+	UpdateVersion();
 }
 
 void PDataContainer::CopyData(const string &name, string newname)
@@ -125,6 +123,7 @@ void PDataContainer::CopyData(const string &name, string newname)
 	}
 	
 	m_PData[newname]=i->second->Copy();
+	UpdateVersion();
 	
 	PDataDirty();
 }
@@ -140,6 +139,7 @@ void PDataContainer::RemoveDataVec(const string &name)
 	
 	delete i->second;
 	m_PData.erase(i);
+	UpdateVersion();
 }
 
 PData* PDataContainer::GetDataRaw(const string &name)
@@ -150,6 +150,7 @@ PData* PDataContainer::GetDataRaw(const string &name)
 		return NULL;
 	}
 	
+	i->second->SetAllDirty();
 	return i->second;
 }
 
@@ -164,6 +165,17 @@ const PData* PDataContainer::GetDataRawConst(const string &name) const
 	return i->second;
 }
 
+PData* PDataContainer::GetDataRawUnmarked(const string &name)
+{
+	map<string,PData*>::iterator i=m_PData.find(name);
+	if (i==m_PData.end())
+	{
+		return NULL;
+	}
+	
+	return i->second;
+}
+
 void PDataContainer::SetDataRaw(const string &name, PData* pd)
 {
 	map<string,PData*>::iterator i=m_PData.find(name);
@@ -174,9 +186,19 @@ void PDataContainer::SetDataRaw(const string &name, PData* pd)
 	}
 	delete i->second;
 	i->second = pd;
+	UpdateVersion();
 	PDataDirty();
 }
 
+void PDataContainer::SetDataDirty(const string &name)
+{
+	map<string,PData*>::iterator i=m_PData.find(name);
+	if (i!=m_PData.end())
+	{
+		i->second->SetAllDirty();
+	}
+}
+
 void PDataContainer::GetDataNames(vector<string> &names) const
 {
 	for (map<string,PData*>::const_iterator i=m_PData.begin(); i!=m_PData.end(); ++i)
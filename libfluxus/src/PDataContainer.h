@@ -61,7 +61,8 @@ public:
 	
 	/// Retrieves a pointer to the internal vector by name
 	/// Returns NULL if it doesn't exist, or is not the 
-	/// type given in the template call.
+	/// type given in the template call. As the data can be 
+	/// written through the pointer, the array is marked dirty.
 	template<class T> vector<T>* GetDataVec(const string &name);      
 	
 	/// Destroys a pdata array
@@ -71,29 +72,52 @@ public:
 	/// returns false if it doesn't actually exist
 	bool GetDataInfo(const string &name, char &type, unsigned int &size) const;
 	
-	/// Sets an element of the array. Not checked, for 
-	/// speed - use GetDataInfo() to check
+	/// Sets an element of the array, and marks it dirty. 
+	/// Not checked, for speed - use GetDataInfo() to check
 	template<class T> void SetData(const string &name, unsigned int index, T s);
 	
 	/// Gets an element of the array. Not checked, for 
 	/// speed - use GetDataInfo() to check
 	template<class T> T GetData(const string &name, unsigned int index) const;
 		
-	/// Runs a pdata operation on the given pdata array
-	template<class T> PData *DataOp(const string &op, const string &name, T operand);
-	
-	/// Gets the whole pdata array, returns NULL if it doesn't exist
+	/// Runs a pdata operation on the given pdata array, 
+	/// marks the whole array dirty. Some operators need extra 
+	/// arguments as well as the operand (see PDataArithmetic.h)
+	template<class T> PData *DataOp(const string &op, const string &name, T operand,
+		const PDataArgs &args=PDataArgs());
+	
+	/// Gets the whole pdata array, returns NULL if it doesn't exist.
+	/// Marks the array as dirty, use GetDataRawConst() for reading
 	PData* GetDataRaw(const string &name);
 
 	/// Gets the whole const pdata array, returns NULL if it doesn't exist
 	const PData* GetDataRawConst(const string &name) const;
 	
+	/// Gets the whole pdata array without marking it dirty, for 
+	/// callers which mark what they write with PData::SetDirty()
+	PData* GetDataRawUnmarked(const string &name);
+	
+	/// Returns the type character of the array ('v','c','f' or 'm'), 
+	/// or 0 for an unknown type
+	static char GetDataType(const PData *pd);
+	
+	/// Returns a number which changes whenever pdata arrays are 
+	/// added, removed or replaced in this container. This is unique 
+	/// across all containers, so pointers to the arrays can be 
+	/// cached along with it and checked later on
+	unsigned int GetDataVersion() const { return m_Version; }
+	
 	/// Sets the whole pdata array
 	void SetDataRaw(const string &name, PData* pd);
 	
+	/// Marks the whole array as changed, needed if it's been
+	/// written to through a pointer fetched earlier on
+	void SetDataDirty(const string &name);
+	
 	/// Maps the name of a pdata operator to the actual object, all pdata ops
 	/// need to be registered inside this function (see below)
-	template <class S, class T> PData *FindOperate(const string &name, TypedPData<S> *a, T b);
+	template <class S, class T> PData *FindOperate(const string &name, TypedPData<S> *a, T b, 
+		const PDataArgs &args);
 	
 	/// Erases all current data!
 	void Resize(unsigned int size);
@@ -113,12 +137,20 @@ protected:
 	///\todo replace with a hashmap?
 	mutable map<string,PData*> m_PData;
 
+private:
+	void UpdateVersion() { m_Version=m_NextVersion++; }
+
+	unsigned int m_Version;
+	static unsigned int m_NextVersion;
+
 };
 
 template<class T> 
 void PDataContainer::SetData(const string &name, unsigned int index, T s)	
 {
-	static_cast<TypedPData<T>*>(m_PData[name])->m_Data[index]=s;
+	TypedPData<T> *pd=static_cast<TypedPData<T>*>(m_PData[name]);
+	pd->m_Data[index]=s;
+	pd->SetDirty(index);
 }
 
 ///Todo: no const [] for m_PData[name] so m_PData has to be mutable???
@@ -145,11 +177,12 @@ vector<T>* PDataContainer::GetDataVec(const string &name)
 		return NULL;
 	}
 	
+	ptr->SetAllDirty();
 	return &ptr->m_Data;
 }
 
 template<class T>
-PData *PDataContainer::DataOp(const string &op, const string &name, T operand)
+PData *PDataContainer::DataOp(const string &op, const string &name, T operand, const PDataArgs &args)
 {
 	map<string,PData*>::iterator i=m_PData.find(name);
 	if (i==m_PData.end())
@@ -158,20 +191,23 @@ PData *PDataContainer::DataOp(const string &op, const string &name, T operand)
 		return NULL;
 	}
 	
+	// most operators work in place
+	i->second->SetAllDirty();
+	
 	TypedPData<dVector> *data = dynamic_cast<TypedPData<dVector>*>(i->second);	
-	if (data) return FindOperate<dVector,T>(op, data, operand);
+	if (data) return FindOperate<dVector,T>(op, data, operand, args);
 	else
 	{
 		TypedPData<dColour> *data = dynamic_cast<TypedPData<dColour>*>(i->second);
-		if (data) return FindOperate<dColour, T>(op, data, operand);
+		if (data) return FindOperate<dColour, T>(op, data, operand, args);
 		else 
 		{
 			TypedPData<float> *data = dynamic_cast<TypedPData<float>*>(i->second);
-			if (data) return FindOperate<float, T>(op, data, operand);
+			if (data) return FindOperate<float, T>(op, data, operand, args);
 			else 
 			{
 				TypedPData<dMatrix> *data = dynamic_cast<TypedPData<dMatrix>*>(i->second);
-				if (data) return FindOperate<dMatrix, T>(op, data, operand);
+				if (data) return FindOperate<dMatrix, T>(op, data, operand, args);
 			}
 		}
 	}
@@ -180,13 +216,22 @@ PData *PDataContainer::DataOp(const string &op, const string &name, T operand)
 }
 
 template <class S, class T>
-PData *PDataContainer::FindOperate(const string &name, TypedPData<S> *a, T b)
+PData *PDataContainer::FindOperate(const string &name, TypedPData<S> *a, T b, const PDataArgs &args)
 {
 	if (name=="+") return AddOperator::Operate<S,T>(a,b);
 	else if (name=="*") return MultOperator::Operate<S,T>(a,b);
 	else if (name=="closest") return ClosestOperator::Operate<S,T>(a,b);
 	else if (name=="sin") return SineOperator::Operate<S,T>(a,b);
 	else if (name=="cos") return CosineOperator::Operate<S,T>(a,b);
+	else if (name=="lerp") return LerpOperator::Operate<S,T>(a,b,args);
+	else if (name=="clamp") return ClampOperator::Operate<S,T>(a,b,args);
+	else if (name=="normalise") return NormaliseOperator::Operate<S,T>(a,b);
+	else if (name=="cross") return CrossOperator::Operate<S,T>(a,b);
+	else if (name=="dot") return DotOperator::Operate<S,T>(a,b,args);
+	else if (name=="transform") return TransformOperator::Operate<S,T>(a,b);
+	else if (name=="rotate") return RotateOperator::Operate<S,T>(a,b);
+	else if (name=="sine-displace") return SineDisplaceOperator::Operate<S,T>(a,b,args);
+	else if (name=="noise-displace") return NoiseDisplaceOperator::Operate<S,T>(a,b,args);
 	
 	Trace::Stream<<"operator "<<name<<" not found"<<endl;
 	return NULL;
@@ -17,6 +17,7 @@
 #ifndef N_PDATA_OPERATOR
 #define N_PDATA_OPERATOR
 
+#include <vector>
 #include "PData.h"
 
 using namespace std;
@@ -38,6 +39,23 @@ public:
 	PDataOperator() {}
 };
 
+///////////////////////////////////////////////////////////////
+/// Extra arguments for operators which need more than one 
+/// operand, such as the blend amount for lerp. Any numbers 
+/// given are stored in order in Floats, and Data is another 
+/// pdata array, or NULL if none was given.
+class PDataArgs
+{
+public:
+	PDataArgs() : Data(NULL) {}
+	
+	/// Returns the nth number, or def if it wasn't supplied
+	float Get(unsigned int n, float def) const { return n<Floats.size()?Floats[n]:def; }
+	
+	vector<float> Floats;
+	const PData *Data;
+};
+
 }
 
 #endif
@@ -20,6 +20,7 @@
 #include <iostream>
 #include <string>
 #include "TexturePainter.h"
+#include "Trace.h"
 
 using namespace std;
 
@@ -29,8 +30,9 @@ namespace Fluxus
 class PNGLoader
 {
 public:
-	/// A utility for loading png files and returns the raw pixel data
-	static void Load(const string &Filename, TexturePainter::TextureDesc &desc);
+	/// A utility for loading png files and returns the raw pixel data,
+	/// problems are written to log
+	static void Load(const string &Filename, TexturePainter::TextureDesc &desc, ostream &log=Trace::Stream);
 	static void Save(const string &Filename, unsigned int w, unsigned int h, int p, unsigned char *);
 private:
 
@@ -20,6 +20,33 @@
 
 using namespace Fluxus;
 
+// particles per chunk of work for the threads
+static const unsigned int PARTICLE_GRAIN=4096;
+
+// expands point sprites to the size of the particles, which 
+// comes in as the normal so it can be read straight from the pdata 
+static const string SPRITE_VERTEX_SHADER=
+	"uniform float ViewportHeight;"
+	"void main()"
+	"{"
+	"	gl_Position=ftransform();"
+	"	gl_PointSize=gl_Normal.x*gl_ProjectionMatrix[1][1]*ViewportHeight*0.5/gl_Position.w;"
+	"	gl_FrontColor=gl_Color;"
+	"}";
+
+static const string SPRITE_FRAGMENT_SHADER=
+	"uniform sampler2D Texture;"
+	"uniform int Textured;"
+	"void main()"
+	"{"
+	"	if (Textured==1) gl_FragColor=gl_Color*texture2D(Texture,gl_PointCoord);"
+	"	else gl_FragColor=gl_Color;"
+	"}";
+
+vector<float> ParticlePrimitive::m_QuadTexCoords;
+// made when first needed, and kept for as long as the gl context
+GLSLShader *ParticlePrimitive::m_SpriteShader=NULL;
+
 ParticlePrimitive::ParticlePrimitive()
 {
 	AddData("p",new TypedPData<dVector>);
@@ -81,65 +108,158 @@ void ParticlePrimitive::Render()
 		glEnableClientState(GL_TEXTURE_COORD_ARRAY);
 	}
 
-	if (m_State.Hints & HINT_SOLID)
+	if ((m_State.Hints & HINT_SOLID) && !m_VertData->empty())
 	{
-		dVector cameradir=GetLocalCameraDir();
-		dVector across=GetLocalCameraUp().cross(cameradir);
-		across.normalise();
-		dVector down=across.cross(cameradir);
-		down.normalise();
+		bool sorted=m_State.Hints & HINT_DEPTH_SORT;
+		if (sorted) SortParticles();
 		
-		if (m_State.Hints & HINT_DEPTH_SORT)
+		if ((m_State.Hints & HINT_SPRITES) && GLSLShader::m_Enabled) RenderSprites(sorted);
+		else RenderQuads(sorted);
+	}
+	glEnable(GL_LIGHTING);
+}
+
+void ParticlePrimitive::SortParticles()
+{
+	dMatrix ModelView;
+	glGetFloatv(GL_MODELVIEW_MATRIX,ModelView.arr());
+	
+	// we only need the eye space z
+	float zx=ModelView.m[0][2], zy=ModelView.m[1][2];
+	float zz=ModelView.m[2][2], zw=ModelView.m[3][2];
+	
+	m_DepthSort.Clear();
+	for (unsigned int n=0; n<m_VertData->size(); n++)
+	{
+		const dVector &v=(*m_VertData)[n];
+		m_DepthSort.Add(v.x*zx + v.y*zy + v.z*zz + zw);
+	}
+	m_DepthSort.Sort();
+}
+
+void ParticlePrimitive::RenderQuads(bool sorted)
+{
+	dVector cameradir=GetLocalCameraDir();
+	dVector across=GetLocalCameraUp().cross(cameradir);
+	across.normalise();
+	dVector down=across.cross(cameradir);
+	down.normalise();
+	
+	unsigned int count=m_VertData->size();
+	m_QuadPoints.resize(count*12);
+	m_QuadColours.resize(count*16);
+	if (m_QuadTexCoords.size()<count*8)
+	{
+		unsigned int start=m_QuadTexCoords.size()/8;
+		m_QuadTexCoords.resize(count*8);
+		for (unsigned int n=start; n<count; n++)
 		{
-			dMatrix ModelView2;
-			glGetFloatv(GL_MODELVIEW_MATRIX,ModelView2.arr());
-			
-			list<SortItem> sorted;
-			for (unsigned int n=0; n<m_VertData->size(); n++)
-			{
-				dVector t=ModelView2.transform((*m_VertData)[n]);
-				sorted.push_back(SortItem(n, t.z));
-			}
-			sorted.sort();
-			
-			glBegin(GL_QUADS);
-			for (list<SortItem>::iterator i=sorted.begin(); i!=sorted.end(); ++i)
-			{
-				dVector scaledacross(across*(*m_SizeData)[i->Index].x*0.5);
-				dVector scaledown(down*(*m_SizeData)[i->Index].y*0.5);
-				glColor4fv((*m_ColData)[i->Index].arr());
-				glTexCoord2f(0,0);
-				glVertex3fv(((*m_VertData)[i->Index]-scaledacross-scaledown).arr());
-				glTexCoord2f(0,1);
-				glVertex3fv(((*m_VertData)[i->Index]-scaledacross+scaledown).arr());
-				glTexCoord2f(1,1);
-				glVertex3fv(((*m_VertData)[i->Index]+scaledacross+scaledown).arr());
-				glTexCoord2f(1,0);
-				glVertex3fv(((*m_VertData)[i->Index]+scaledacross-scaledown).arr());
-			}
-			glEnd();
+			float *t=&m_QuadTexCoords[n*8];
+			t[0]=0; t[1]=0;
+			t[2]=0; t[3]=1;
+			t[4]=1; t[5]=1;
+			t[6]=1; t[7]=0;
 		}
-		else
+	}
+	
+	QuadJob job(*this,across,down,sorted?&m_DepthSort.GetOrder()[0]:NULL);
+	WorkerPool::Get()->Run(job,count,PARTICLE_GRAIN);
+	
+	glDisableClientState(GL_NORMAL_ARRAY);
+	glEnableClientState(GL_COLOR_ARRAY);
+	
+	glVertexPointer(3,GL_FLOAT,0,&m_QuadPoints[0]);
+	glColorPointer(4,GL_UNSIGNED_BYTE,0,&m_QuadColours[0]);
+	glTexCoordPointer(2,GL_FLOAT,0,&m_QuadTexCoords[0]);
+	glDrawArrays(GL_QUADS,0,count*4);
+	
+	glDisableClientState(GL_COLOR_ARRAY);
+	glEnableClientState(GL_NORMAL_ARRAY);
+}
+
+void ParticlePrimitive::QuadJob::Run(unsigned int start, unsigned int end)
+{
+	const vector<dVector> &verts=*m_Prim.m_VertData;
+	const vector<dVector> &sizes=*m_Prim.m_SizeData;
+	const vector<dColour> &cols=*m_Prim.m_ColData;
+	
+	for (unsigned int n=start; n<end; n++)
+	{
+		unsigned int i=m_Order?m_Order[n]:n;
+		const dVector &v=verts[i];
+		float ax=m_Across.x*sizes[i].x*0.5, ay=m_Across.y*sizes[i].x*0.5, az=m_Across.z*sizes[i].x*0.5;
+		float dx=m_Down.x*sizes[i].y*0.5, dy=m_Down.y*sizes[i].y*0.5, dz=m_Down.z*sizes[i].y*0.5;
+		
+		float *p=&m_Prim.m_QuadPoints[n*12];
+		p[0]=v.x-ax-dx; p[1]=v.y-ay-dy; p[2]=v.z-az-dz;
+		p[3]=v.x-ax+dx; p[4]=v.y-ay+dy; p[5]=v.z-az+dz;
+		p[6]=v.x+ax+dx; p[7]=v.y+ay+dy; p[8]=v.z+az+dz;
+		p[9]=v.x+ax-dx; p[10]=v.y+ay-dy; p[11]=v.z+az-dz;
+		
+		unsigned char col[4];
+		const float *c=&cols[i].r;
+		for (int e=0; e<4; e++)
+		{
+			if (c[e]<=0) col[e]=0;
+			else if (c[e]>=1) col[e]=255;
+			else col[e]=(unsigned char)(c[e]*255+0.5f);
+		}
+		unsigned char *q=&m_Prim.m_QuadColours[n*16];
+		for (int corner=0; corner<4; corner++)
 		{
-			glBegin(GL_QUADS);
-			for (unsigned int n=0; n<m_VertData->size(); n++)
-			{
-				dVector scaledacross(across*(*m_SizeData)[n].x*0.5);
-				dVector scaledown(down*(*m_SizeData)[n].y*0.5);
-				glColor4fv((*m_ColData)[n].arr());
-				glTexCoord2f(0,0);
-				glVertex3fv(((*m_VertData)[n]-scaledacross-scaledown).arr());
-				glTexCoord2f(0,1);
-				glVertex3fv(((*m_VertData)[n]-scaledacross+scaledown).arr());
-				glTexCoord2f(1,1);
-				glVertex3fv(((*m_VertData)[n]+scaledacross+scaledown).arr());
-				glTexCoord2f(1,0);
-				glVertex3fv(((*m_VertData)[n]+scaledacross-scaledown).arr());
-			}
-			glEnd();
+			q[corner*4]=col[0];
+			q[corner*4+1]=col[1];
+			q[corner*4+2]=col[2];
+			q[corner*4+3]=col[3];
 		}
 	}
-	glEnable(GL_LIGHTING);
+}
+
+void ParticlePrimitive::RenderSprites(bool sorted)
+{
+	GLSLShader *shader=m_State.Shader;
+	if (shader==NULL)
+	{
+		if (m_SpriteShader==NULL)
+		{
+			m_SpriteShader=new GLSLShader(GLSLShaderPair(false,SPRITE_VERTEX_SHADER,SPRITE_FRAGMENT_SHADER));
+		}
+		
+		if (!m_SpriteShader->IsValid())
+		{
+			RenderQuads(sorted);
+			return;
+		}
+		
+		// uniforms are sent when the shader is applied
+		shader=m_SpriteShader;
+		GLint viewport[4];
+		glGetIntegerv(GL_VIEWPORT,viewport);
+		shader->SetFloat("ViewportHeight",viewport[3]);
+		shader->SetInt("Textured",m_State.Textures[0]!=0);
+		shader->Apply();
+	}
+
+	glEnable(GL_VERTEX_PROGRAM_POINT_SIZE);
+	glEnable(GL_POINT_SPRITE);
+	glTexEnvi(GL_POINT_SPRITE,GL_COORD_REPLACE,GL_TRUE);
+	glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+	glEnableClientState(GL_COLOR_ARRAY);
+	
+	glVertexPointer(3,GL_FLOAT,sizeof(dVector),m_VertData->begin()->arr());
+	glColorPointer(4,GL_FLOAT,sizeof(dColour),m_ColData->begin()->arr());
+	glNormalPointer(GL_FLOAT,sizeof(dVector),m_SizeData->begin()->arr());
+	
+	if (sorted) glDrawElements(GL_POINTS,m_VertData->size(),GL_UNSIGNED_INT,&m_DepthSort.GetOrder()[0]);
+	else glDrawArrays(GL_POINTS,0,m_VertData->size());
+	
+	glDisableClientState(GL_COLOR_ARRAY);
+	glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+	glTexEnvi(GL_POINT_SPRITE,GL_COORD_REPLACE,GL_FALSE);
+	glDisable(GL_POINT_SPRITE);
+	glDisable(GL_VERTEX_PROGRAM_POINT_SIZE);
+	
+	if (shader==m_SpriteShader) GLSLShader::Unapply();
 }
 
 dBoundingBox ParticlePrimitive::GetBoundingBox(const dMatrix &space)
@@ -18,6 +18,8 @@
 #define N_PARTICLEPRIM
 
 #include "Primitive.h"
+#include "DepthSortBuffer.h"
+#include "WorkerPool.h"
 
 namespace Fluxus
 {
@@ -61,19 +63,35 @@ private:
 	vector<dVector> *m_SizeData;
 	vector<float> *m_RotateData;
 	
-	class SortItem
+	void SortParticles();
+	void RenderQuads(bool sorted);
+	void RenderSprites(bool sorted);
+	
+	/// Builds the camera facing quads for a range of particles
+	class QuadJob : public WorkerPool::Job
 	{
 	public:
-		SortItem(int i, float d) : Index(i), Depth(d) {}
-
-		int Index;
-		float Depth;
-		
-		bool operator<(const SortItem &other) const
-		{
-			return Depth<other.Depth;
-		}
+		QuadJob(ParticlePrimitive &prim, const dVector &across, const dVector &down, const unsigned int *order) :
+			m_Prim(prim), m_Across(across), m_Down(down), m_Order(order) {}
+		virtual void Run(unsigned int start, unsigned int end);
+	private:
+		ParticlePrimitive &m_Prim;
+		dVector m_Across;
+		dVector m_Down;
+		const unsigned int *m_Order;
 	};
+	
+	friend class QuadJob;
+	
+	DepthSortBuffer m_DepthSort;
+	
+	// the quads are kept to save reallocating them each frame
+	vector<float> m_QuadPoints;
+	vector<unsigned char> m_QuadColours;
+	
+	/// The quad texture coords are the same for all particles 
+	static vector<float> m_QuadTexCoords;
+	static GLSLShader *m_SpriteShader;
 };
 
 }
@@ -0,0 +1,179 @@
+// Copyright (C) 2010 Dave Griffiths
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+
+
+#include "ParticlesPrimFunc.h"
+#include "Primitive.h"
+#include "SceneGraph.h"
+#include "SimplexNoise.h"
+
+using namespace Fluxus;
+
+// particles per chunk handed to each worker thread
+static const unsigned int PARTICLES_GRAIN = 4096;
+
+// a cheap random number for each particle which doesn't
+// need any state, so the threads can share it
+static float Random(unsigned int seed)
+{
+	seed = (seed ^ 61) ^ (seed >> 16);
+	seed *= 9;
+	seed = seed ^ (seed >> 4);
+	seed *= 0x27d4eb2d;
+	seed = seed ^ (seed >> 15);
+	return (seed & 0xffffff)/(float)0x1000000;
+}
+
+ParticlesPrimFunc::ParticlesPrimFunc() :
+m_Frame(0)
+{
+}
+
+ParticlesPrimFunc::~ParticlesPrimFunc()
+{
+}
+
+float ParticlesPrimFunc::GetNumber(const string &name, float def)
+{
+	if (ArgExists<int>(name)) return GetArg<int>(name,0);
+	return GetArg<float>(name,def);
+}
+
+void ParticlesPrimFunc::Run(Primitive &prim, const SceneGraph &world)
+{
+	string velname = GetArg<string>("vel",string("vel"));
+	string agename = GetArg<string>("age",string("age"));
+	char type;
+	unsigned int size;
+
+	if (!prim.GetDataInfo(velname,type,size) || type!='v')
+	{
+		Trace::Stream<<"ParticlesPrimFunc::Run: aborting: primitive needs a vector pdata called "<<velname<<endl;
+		return;
+	}
+
+	vector<dVector> *p = prim.GetDataVec<dVector>("p");
+	vector<dVector> *vel = prim.GetDataVec<dVector>(velname);
+	vector<float> *age = NULL;
+	if (prim.GetDataInfo(agename,type,size) && type=='f')
+	{
+		age = prim.GetDataVec<float>(agename);
+	}
+	if (!p) return;
+
+	Settings settings;
+	settings.TimeStep = GetNumber("timestep",0.02);
+	settings.Gravity = GetArg<dVector>("gravity",dVector(0,0,0));
+	settings.Drag = GetNumber("drag",0);
+	if (ArgExists<vector<int> >("attractors"))
+	{
+		// lists starting with an exact integer are stored as ints
+		vector<int> attractors = GetArg<vector<int> >("attractors",vector<int>());
+		settings.Attractors.assign(attractors.begin(),attractors.end());
+	}
+	else
+	{
+		settings.Attractors = GetArg<vector<float> >("attractors",vector<float>());
+	}
+	if (settings.Attractors.size()%4!=0)
+	{
+		Trace::Stream<<"ParticlesPrimFunc::Run: attractors need 4 numbers each (x y z strength), ignoring the extra ones"<<endl;
+		settings.Attractors.resize(settings.Attractors.size()-settings.Attractors.size()%4);
+	}
+	settings.Noise = GetNumber("noise",0);
+	settings.NoiseScale = GetNumber("noise-scale",1);
+	settings.NoiseTime = GetNumber("noise-time",0);
+	settings.Bounce = ArgExists<dVector>("plane-normal");
+	settings.PlanePos = GetArg<dVector>("plane-pos",dVector(0,0,0));
+	settings.PlaneNormal = GetArg<dVector>("plane-normal",dVector(0,1,0));
+	settings.PlaneNormal.normalise();
+	settings.Restitution = GetNumber("restitution",0.5);
+	settings.Lifetime = GetNumber("lifetime",0);
+	settings.Emitter = GetArg<dVector>("emitter",dVector(0,0,0));
+	settings.EmitVel = GetArg<dVector>("emit-vel",dVector(0,0,0));
+	settings.EmitSpread = GetNumber("emit-spread",0);
+	settings.Seed = m_Frame++*2654435761u;
+
+	ParticleJob job(settings,*p,*vel,age);
+	WorkerPool::Get()->Run(job,p->size(),PARTICLES_GRAIN);
+}
+
+void ParticlesPrimFunc::ParticleJob::Run(unsigned int start, unsigned int end)
+{
+	const Settings &s=m_Settings;
+	float dt=s.TimeStep;
+	float damping=1-s.Drag*dt;
+	if (damping<0) damping=0;
+	unsigned int numattractors=s.Attractors.size()/4;
+
+	for (unsigned int i=start; i<end; i++)
+	{
+		dVector &p=m_P[i];
+		dVector &v=m_Vel[i];
+
+		if (m_Age!=NULL)
+		{
+			float &age=(*m_Age)[i];
+			age+=dt;
+			if (s.Lifetime>0 && age>s.Lifetime)
+			{
+				unsigned int seed=s.Seed^(i*3);
+				p=s.Emitter;
+				v=s.EmitVel+dVector(Random(seed)-0.5f,Random(seed+1)-0.5f,Random(seed+2)-0.5f)*s.EmitSpread;
+				age=0;
+				continue;
+			}
+		}
+
+		dVector acc=s.Gravity;
+
+		for (unsigned int a=0; a<numattractors; a++)
+		{
+			const float *attractor=&s.Attractors[a*4];
+			dVector dir(attractor[0]-p.x,attractor[1]-p.y,attractor[2]-p.z);
+			// softened so particles don't shoot off when they get close
+			float distsq=dir.x*dir.x+dir.y*dir.y+dir.z*dir.z+0.01f;
+			acc+=dir*(attractor[3]/(distsq*sqrtf(distsq)));
+		}
+
+		if (s.Noise!=0)
+		{
+			// 3D noise is a lot quicker than 4D, so the time 
+			// just scrolls through it in a different direction
+			// for each axis
+			float x=p.x*s.NoiseScale, y=p.y*s.NoiseScale, z=p.z*s.NoiseScale;
+			float t=s.NoiseTime;
+			acc+=dVector(SimplexNoise::noise(x+t,y,z),
+						 SimplexNoise::noise(x+31.4f,y+t,z),
+						 SimplexNoise::noise(x,y+27.1f,z+t))*s.Noise;
+		}
+
+		v+=acc*dt;
+		v*=damping;
+		p+=v*dt;
+
+		if (s.Bounce)
+		{
+			float dist=(p-s.PlanePos).dot(s.PlaneNormal);
+			if (dist<0)
+			{
+				p-=s.PlaneNormal*dist;
+				float normalvel=v.dot(s.PlaneNormal);
+				if (normalvel<0) v-=s.PlaneNormal*(normalvel*(1+s.Restitution));
+			}
+		}
+	}
+}
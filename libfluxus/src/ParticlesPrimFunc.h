@@ -0,0 +1,94 @@
+// Copyright (C) 2010 Dave Griffiths
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+
+
+#ifndef N_PARTICLES_PRIMITIVE_FUNCTION
+#define N_PARTICLES_PRIMITIVE_FUNCTION
+
+#include "PrimitiveFunction.h"
+#include "Primitive.h"
+#include "SceneGraph.h"
+#include "WorkerPool.h"
+
+using namespace std;
+
+namespace Fluxus
+{
+
+//////////////////////////////////////////////////
+/// A primitive function for simulating particles,
+/// moves the "p" pdata along by a velocity pdata 
+/// which is accelerated by gravity, drag, point
+/// attractors and noise turbulence, and bounced off
+/// a plane. Particles older than their lifetime are 
+/// respawned at the emitter. The particles are split 
+/// up over the worker pool.
+class ParticlesPrimFunc : public PrimitiveFunction
+{
+public:
+	ParticlesPrimFunc();
+	~ParticlesPrimFunc();
+
+	virtual void Run(Primitive &prim, const SceneGraph &world);
+
+private:
+
+	/// Ints and floats are both fine as numbers
+	float GetNumber(const string &name, float def);
+
+	/// All the settings, read from the arguments each run
+	class Settings
+	{
+	public:
+		float TimeStep;
+		dVector Gravity;
+		float Drag;
+		vector<float> Attractors; // x y z strength for each
+		float Noise;
+		float NoiseScale;
+		float NoiseTime;
+		bool Bounce;
+		dVector PlanePos;
+		dVector PlaneNormal;
+		float Restitution;
+		float Lifetime;
+		dVector Emitter;
+		dVector EmitVel;
+		float EmitSpread;
+		unsigned int Seed;
+	};
+
+	/// Updates a range of particles
+	class ParticleJob : public WorkerPool::Job
+	{
+	public:
+		ParticleJob(const Settings &settings, vector<dVector> &p, vector<dVector> &vel, vector<float> *age) :
+			m_Settings(settings), m_P(p), m_Vel(vel), m_Age(age) {}
+		virtual void Run(unsigned int start, unsigned int end);
+
+	private:
+		const Settings &m_Settings;
+		vector<dVector> &m_P;
+		vector<dVector> &m_Vel;
+		vector<float> *m_Age;
+	};
+
+	unsigned int m_Frame;
+};
+
+}
+
+#endif
@@ -18,15 +18,21 @@
 #include "Physics.h"
 #include "State.h"
 #include "Primitive.h"
+#include <sys/time.h>
+#include <math.h>
 
 using namespace Fluxus;
 
-Physics::Object::Object()
+Physics::Object::Object() :
+ID(0),
+Type(PASSIVE),
+Body(0),
+Bound(0),
+Prim(NULL)
 {
-	Prim=NULL;
 }
 
-Physics::Object::~Object()
+void Physics::Object::Destroy()
 {
 	if (Type==ACTIVE) dBodyDestroy(Body);
 	dGeomDestroy(Bound);
@@ -41,6 +47,15 @@ Physics::JointObject::~JointObject()
 	dJointDestroy(Joint);
 }
 
+Physics::BroadphaseParams::BroadphaseParams() :
+MinLevel(-3),
+MaxLevel(10),
+Centre(0,0,0),
+Extents(100,100,100),
+Depth(6)
+{
+}
+
 //////////////////////////////////////////////////////////////////////
 
 bool Physics::m_ODEInited = false;
@@ -54,7 +69,20 @@ m_Collisions(false),
 m_Slip1(0.9),
 m_Slip2(0.9),
 m_SoftErp(0.25),
-m_SoftCfm(0.15)
+m_SoftCfm(0.15),
+m_StepMode(FRAME),
+m_StepSize(0.05),
+m_MaxSubSteps(5),
+m_Interpolate(true),
+m_Accumulator(0),
+m_CollideTime(0),
+m_StepTime(0),
+m_WritebackTime(0),
+m_StepsTaken(0)
+#ifdef ODE_THREADING
+,m_Threading(NULL),
+m_ThreadPool(NULL)
+#endif
 {
 	if (!m_ODEInited)	// init ODE only once
 	{
@@ -67,27 +95,252 @@ m_SoftCfm(0.15)
 	}
 
 	m_World = dWorldCreate();
-	m_Space = dHashSpaceCreate(0);
+	m_Space = CreateSpace(HASH,BroadphaseParams());
 	m_ContactGroup = dJointGroupCreate(0);
 	dWorldSetGravity(m_World,0,-5,0);
+	// new bodies pick this up from the world
+	dWorldSetAutoDisableFlag(m_World,1);
+	m_Contacts.resize(10);
 }
 
 Physics::~Physics()
 {
+	FreeThreads();
 	dCloseODE();
 }
 
-void Physics::Tick()
+static double TimeNow()
 {
-	m_CollisionRecord.clear();
+	timeval t;
+	gettimeofday(&t,NULL);
+	return t.tv_sec+t.tv_usec*0.000001;
+}
+
+void Physics::Tick(float delta)
+{
+	unsigned int steps=1;
+	if (m_StepMode==FIXED)
+	{
+		if (delta>0)
+		{
+			// never take more time than we can step, the renderer's first 
+			// delta is the whole time since the epoch, and long stalls 
+			// shouldn't leave a backlog for later frames
+			float maxdelta=m_MaxSubSteps*m_StepSize;
+			m_Accumulator+=delta<maxdelta?delta:maxdelta;
+		}
+		float wholesteps=floor(m_Accumulator/m_StepSize);
+		if (wholesteps>m_MaxSubSteps)
+		{
+			// we can't keep up, so drop the time we are behind 
+			// rather than trying to catch up on later frames
+			steps=m_MaxSubSteps;
+			m_Accumulator=fmod(m_Accumulator,m_StepSize);
+		}
+		else
+		{
+			steps=(unsigned int)wholesteps;
+			m_Accumulator-=steps*m_StepSize;
+		}
+	}
+
+	bool interpolate = m_StepMode==FIXED && m_Interpolate;
+
+	m_CollideTime=0;
+	m_StepTime=0;
+	m_StepsTaken=steps;
+
+	// collisions are recorded since the last frame that was stepped
+	if (steps>0 && !m_CollisionRecord.empty()) 
+	{
+		memset(&m_CollisionRecord[0],0,m_CollisionRecord.size());
+	}
+
+	for (unsigned int n=0; n<steps; n++)
+	{
+		if (interpolate && n==steps-1)
+		{
+			// keep the state from before the last step
+			if (n>0) ReadStates();
+			m_PrevStates=m_States;
+		}
+		Step();
+	}
+
+	double start=TimeNow();
+	if (steps>0) ReadStates();
+	UpdatePrimitives(interpolate?m_Accumulator/m_StepSize:1);
+	m_WritebackTime=(TimeNow()-start)*1000;
+}
+
+void Physics::Step()
+{
+	double start=TimeNow();
+	if (m_Collisions)
+	{
+		dSpaceCollide(m_Space,this,&NearCallback);
+		// the groups are only tested against each other above, 
+		// the objects in them need testing together too
+		for (map<int,dSpaceID>::iterator i=m_GroupMap.begin(); i!=m_GroupMap.end(); ++i)
+		{
+			dSpaceCollide(i->second,this,&NearCallback);
+		}
+	}
+	double collided=TimeNow();
+	dWorldQuickStep(m_World,m_StepSize);
+
+	// remove all contact joints
+	dJointGroupEmpty(m_ContactGroup);
+
+	m_CollideTime+=(collided-start)*1000;
+	m_StepTime+=(TimeNow()-collided)*1000;
+}
+
+dSpaceID Physics::CreateSpace(BroadphaseType t, const BroadphaseParams &p)
+{
+	switch (t)
+	{
+		case SAP:
+			// sorted along x and z, as y is usually the way things fall
+			return dSweepAndPruneSpaceCreate(0,dSAP_AXES_XZY);
+		case QUADTREE:
+		{
+			dVector3 centre={p.Centre.x,p.Centre.y,p.Centre.z,0};
+			dVector3 extents={p.Extents.x,p.Extents.y,p.Extents.z,0};
+			return dQuadTreeSpaceCreate(0,centre,extents,p.Depth);
+		}
+		default:
+		{
+			dSpaceID space=dHashSpaceCreate(0);
+			dHashSpaceSetLevels(space,p.MinLevel,p.MaxLevel);
+			return space;
+		}
+	}
+}
+
+void Physics::SetBroadphase(BroadphaseType t, const BroadphaseParams &p)
+{
+	dSpaceID space=CreateSpace(t,p);
+
+	// move everything across, including the group spaces
+	while (dSpaceGetNumGeoms(m_Space)>0)
+	{
+		dGeomID geom=dSpaceGetGeom(m_Space,0);
+		dSpaceRemove(m_Space,geom);
+		dSpaceAdd(space,geom);
+	}
+
+	dSpaceDestroy(m_Space);
+	m_Space=space;
+}
+
+void Physics::SetGroup(int ID, int group)
+{
+	Object *ob = FindObject(ID,"SetGroup");
+	if (ob==NULL) return;
+
+	dSpaceID space=m_Space;
+	if (group>=0)
+	{
+		map<int,dSpaceID>::iterator i=m_GroupMap.find(group);
+		if (i==m_GroupMap.end())
+		{
+			space=dHashSpaceCreate(m_Space);
+			m_GroupMap[group]=space;
+		}
+		else
+		{
+			space=i->second;
+		}
+	}
+
+	dSpaceID current=dGeomGetSpace(ob->Bound);
+	if (current!=space)
+	{
+		dSpaceRemove(current,ob->Bound);
+		dSpaceAdd(space,ob->Bound);
+	}
+}
+
+void Physics::SetMaxContacts(unsigned int s)
+{
+	m_Contacts.resize(s>0?s:1);
+}
 
-	dSpaceCollide(m_Space,this,&NearCallback);
-    dWorldQuickStep(m_World,0.05);
+void Physics::SetIterations(int s)
+{
+	if (s>0) dWorldSetQuickStepNumIterations(m_World,s);
+}
 
-    // remove all contact joints
-    dJointGroupEmpty(m_ContactGroup);
+void Physics::SetAutoDisable(bool s, float linear, float angular, int steps)
+{
+	dWorldSetAutoDisableFlag(m_World,s);
+	dWorldSetAutoDisableLinearThreshold(m_World,linear);
+	dWorldSetAutoDisableAngularThreshold(m_World,angular);
+	dWorldSetAutoDisableSteps(m_World,steps);
 
-    UpdatePrimitives();
+	for (vector<Object>::iterator i=m_Objects.begin(); i!=m_Objects.end(); ++i)
+	{
+		if (i->Type==ACTIVE) 
+		{
+			dBodySetAutoDisableDefaults(i->Body);
+			// wake them all up, in case they need to check again
+			dBodyEnable(i->Body);
+		}
+	}
+}
+
+void Physics::SetThreads(unsigned int s)
+{
+#ifdef ODE_THREADING
+	FreeThreads();
+	if (s<2) return;
+
+	m_Threading=dThreadingAllocateMultiThreadedImplementation();
+	if (m_Threading==NULL)
+	{
+		Trace::Stream<<"Physics::SetThreads : couldn't make the threading implementation"<<endl;
+		return;
+	}
+
+	m_ThreadPool=dThreadingAllocateThreadPool(s,0,dAllocateFlagBasicData,NULL);
+	if (m_ThreadPool==NULL)
+	{
+		Trace::Stream<<"Physics::SetThreads : couldn't start the threads"<<endl;
+		dThreadingFreeImplementation(m_Threading);
+		m_Threading=NULL;
+		return;
+	}
+
+	dThreadingThreadPoolServeMultiThreadedImplementation(m_ThreadPool,m_Threading);
+	dWorldSetStepIslandsProcessingMaxThreadCount(m_World,s);
+	dWorldSetStepThreadingImplementation(m_World,dThreadingImplementationGetFunctions(m_Threading),m_Threading);
+#else
+	if (s>1) Trace::Stream<<"Physics::SetThreads : ODE was built without threading support"<<endl;
+#endif
+}
+
+void Physics::FreeThreads()
+{
+#ifdef ODE_THREADING
+	if (m_Threading!=NULL)
+	{
+		dThreadingImplementationShutdownProcessing(m_Threading);
+		dThreadingFreeThreadPool(m_ThreadPool);
+		dWorldSetStepThreadingImplementation(m_World,NULL,NULL);
+		dThreadingFreeImplementation(m_Threading);
+		m_Threading=NULL;
+		m_ThreadPool=NULL;
+	}
+#endif
+}
+
+void Physics::GetTimings(float &collide, float &step, float &writeback, unsigned int &steps)
+{
+	collide=m_CollideTime;
+	step=m_StepTime;
+	writeback=m_WritebackTime;
+	steps=m_StepsTaken;
 }
 
 void Physics::DrawLocator(dVector3 pos)
@@ -220,24 +473,25 @@ void Physics::SetupTransform(Primitive *p, dMatrix &rotation, dVector &Pos)
 
 void Physics::MakeActive(int ID, float Mass, BoundingType Bound)
 {	
-	if (m_ObjectMap.find(ID)!=m_ObjectMap.end())
+	if (FindObject(ID)!=NULL)
 	{
 		Trace::Stream<<"Physics::AddToGroup : Object ["<<ID<<"] already registered"<<endl;
 		return;
 	}
 	
-    Object *Ob = new Object;
-    Ob->Type = ACTIVE;
-	Ob->Prim = m_Renderer->GetPrimitive(ID);	
+    Object Ob;
+    Ob.ID = ID;
+    Ob.Type = ACTIVE;
+	Ob.Prim = m_Renderer->GetPrimitive(ID);	
 	
-	if (!Ob->Prim) return;
+	if (!Ob.Prim) return;
 	
 	dMass m;
-	Ob->Body = dBodyCreate(m_World);
+	Ob.Body = dBodyCreate(m_World);
 	
     dMatrix rotation;
     dVector Pos;
-    SetupTransform(Ob->Prim,rotation,Pos);
+    SetupTransform(Ob.Prim,rotation,Pos);
     dMatrix ident;
 	  	
 	// get the bounding box from the fluxus object
@@ -245,41 +499,41 @@ void Physics::MakeActive(int ID, float Mass, BoundingType Bound)
   	{
   		case BOX:
   		{
-			dBoundingBox Box=Ob->Prim->GetBoundingBox(ident);
+			dBoundingBox Box=Ob.Prim->GetBoundingBox(ident);
             Box.fudgenonzerovolume();
  			dVector BoxSize=Box.max-Box.min;
  			dMassSetBox(&m,1,BoxSize.x,BoxSize.y,BoxSize.z);
 			dMassAdjust(&m,Mass);
- 			dBodySetMass(Ob->Body,&m);
- 			Ob->Bound = dCreateBox (m_Space,BoxSize.x,BoxSize.y,BoxSize.z);
+ 			dBodySetMass(Ob.Body,&m);
+ 			Ob.Bound = dCreateBox (m_Space,BoxSize.x,BoxSize.y,BoxSize.z);
  	    } break;
  	    case SPHERE:
  	    {
-			dBoundingBox Box=Ob->Prim->GetBoundingBox(ident);
+			dBoundingBox Box=Ob.Prim->GetBoundingBox(ident);
             Box.fudgenonzerovolume();
 			// Take the distance across the box in x divided by 2 to be the
 			// radius. This works with a sphere well enough...
 			float Radius=(Box.max.x-Box.min.x)/2;
 			dMassSetSphere(&m,1,Radius);
 			dMassAdjust(&m,Mass);
- 			dBodySetMass(Ob->Body,&m);
- 			Ob->Bound = dCreateSphere (m_Space,Radius);	
+ 			dBodySetMass(Ob.Body,&m);
+ 			Ob.Bound = dCreateSphere (m_Space,Radius);	
  	    } break;
  	    case CYLINDER:
  	    {
-            dBoundingBox Box=Ob->Prim->GetBoundingBox(ident);
+            dBoundingBox Box=Ob.Prim->GetBoundingBox(ident);
             Box.fudgenonzerovolume();
 			float Radius=(Box.max.x-Box.min.x)/2;
 			float Height=Box.max.y-Box.min.y;
 			dMassSetCylinder(&m,1,2,Radius,Height);
 			dMassAdjust(&m,Mass);
- 			dBodySetMass(Ob->Body,&m);
- 			Ob->Bound = dCreateCylinder(m_Space,Radius,Height);	
+ 			dBodySetMass(Ob.Body,&m);
+ 			Ob.Bound = dCreateCylinder(m_Space,Radius,Height);	
         } break;
 		case MESH:
 		{
 			
-			PolyPrimitive *pp = dynamic_cast<PolyPrimitive *>(Ob->Prim);
+			PolyPrimitive *pp = dynamic_cast<PolyPrimitive *>(Ob.Prim);
 			if (pp!=NULL)
 			{
 				dTriMeshDataID TriMeshData=dGeomTriMeshDataCreate();
@@ -294,24 +548,26 @@ void Physics::MakeActive(int ID, float Mass, BoundingType Bound)
                     	   (void*)idx, pp->GetIndex().size(),
                     	   sizeof(unsigned int)*3, (void*)normals);
 
-					dBoundingBox Box=Ob->Prim->GetBoundingBox(ident);
+					dBoundingBox Box=Ob.Prim->GetBoundingBox(ident);
                     Box.fudgenonzerovolume();
 					dVector BoxSize=Box.max-Box.min;
                     
 					dMassSetBox(&m,1,BoxSize.x,BoxSize.y,BoxSize.z);
 					dMassAdjust(&m,Mass);
- 					dBodySetMass(Ob->Body,&m);
-					Ob->Bound = dCreateTriMesh(m_Space,TriMeshData,NULL,NULL,NULL);
+ 					dBodySetMass(Ob.Body,&m);
+					Ob.Bound = dCreateTriMesh(m_Space,TriMeshData,NULL,NULL,NULL);
 				}
 				else
 				{
 					Trace::Stream<<"Physics::MakeActive : PolyPrimitive ["<<ID<<"] needs to be an indexed triangle list"<<endl;
+					dBodyDestroy(Ob.Body);
                     return;
 				}
 			}
 			else
 			{
 				Trace::Stream<<"Physics::MakeActive : Object ["<<ID<<"] is not a polyprimitive, and mesh specified"<<endl;
+				dBodyDestroy(Ob.Body);
                 return;
 			}
 
@@ -340,20 +596,18 @@ void Physics::MakeActive(int ID, float Mass, BoundingType Bound)
 	rot[14]=rotation.m[2][3];
 	rot[15]=rotation.m[3][3];
 	
-  	dBodySetRotation(Ob->Body,rot);
+  	dBodySetRotation(Ob.Body,rot);
 	
 	// set position into ode body
-  	dBodySetPosition(Ob->Body,Pos.x,Pos.y,Pos.z);
+  	dBodySetPosition(Ob.Body,Pos.x,Pos.y,Pos.z);
 
- 	dGeomSetBody (Ob->Bound,Ob->Body);
+ 	dGeomSetBody (Ob.Bound,Ob.Body);
 	
-	dBodySetAutoDisableFlag(Ob->Body, 1);
-
-  	m_ObjectMap[ID]=Ob;
+  	AddObject(Ob);
   	m_History.push_back(ID);
   	
   	// remove oldest object if neccesary
-  	if ((int)m_ObjectMap.size()>m_MaxObjectCount)
+  	if ((int)m_Objects.size()>m_MaxObjectCount)
   	{
         int ID=*m_History.begin();
         Free(ID);
@@ -364,56 +618,57 @@ void Physics::MakeActive(int ID, float Mass, BoundingType Bound)
 
 void Physics::MakePassive(int ID, float Mass, BoundingType Bound)
 {	
-	if (m_ObjectMap.find(ID)!=m_ObjectMap.end())
+	if (FindObject(ID)!=NULL)
 	{
 		Trace::Stream<<"Physics::AddToGroup : Object ["<<ID<<"] already registered"<<endl;
 		return;
 	}
 	
-    Object *Ob = new Object;
-    Ob->Type = PASSIVE;
-	Ob->Prim = m_Renderer->GetPrimitive(ID);	
+    Object Ob;
+    Ob.ID = ID;
+    Ob.Type = PASSIVE;
+	Ob.Prim = m_Renderer->GetPrimitive(ID);	
 	
-	if (!Ob->Prim) return;
+	if (!Ob.Prim) return;
 
     dMatrix rotation;
     dVector Pos;
-    SetupTransform(Ob->Prim,rotation,Pos);
+    SetupTransform(Ob.Prim,rotation,Pos);
     dMatrix ident;
 	
 	// this tells ode to attach joints to the static environment if they are attached
 	// to this joint
-	Ob->Body = 0;
+	Ob.Body = 0;
 
   	switch (Bound)
   	{
   		case BOX:
   		{
-			dBoundingBox Box=Ob->Prim->GetBoundingBox(ident);
+			dBoundingBox Box=Ob.Prim->GetBoundingBox(ident);
             Box.fudgenonzerovolume();
 			dVector BoxSize=Box.max-Box.min;
- 			Ob->Bound = dCreateBox(m_Space,BoxSize.x,BoxSize.y,BoxSize.z);
+ 			Ob.Bound = dCreateBox(m_Space,BoxSize.x,BoxSize.y,BoxSize.z);
  	    } break;
  	    case SPHERE:
  	    {
-			dBoundingBox Box=Ob->Prim->GetBoundingBox(ident);
+			dBoundingBox Box=Ob.Prim->GetBoundingBox(ident);
             Box.fudgenonzerovolume();
 			// Take the distance across the box in x divided by 2 to be the
 			// radius. This works with a sphere well enough...
 			float Radius=(Box.max.x-Box.min.x)/2;
- 			Ob->Bound = dCreateSphere(m_Space,Radius);	
+ 			Ob.Bound = dCreateSphere(m_Space,Radius);	
  	    } break;
  	    case CYLINDER:
  	    {
-            dBoundingBox Box=Ob->Prim->GetBoundingBox(ident);
+            dBoundingBox Box=Ob.Prim->GetBoundingBox(ident);
             Box.fudgenonzerovolume();
 			float Radius=(Box.max.x-Box.min.x)/2;
 			float Height=Box.max.y-Box.min.y;
- 			Ob->Bound = dCreateCylinder(m_Space,Radius,Height);	
+ 			Ob.Bound = dCreateCylinder(m_Space,Radius,Height);	
         } break;
 		case MESH:
 		{
-			PolyPrimitive *pp = dynamic_cast<PolyPrimitive *>(Ob->Prim);
+			PolyPrimitive *pp = dynamic_cast<PolyPrimitive *>(Ob.Prim);
 			if (pp!=NULL)
 			{
 				dTriMeshDataID TriMeshData=dGeomTriMeshDataCreate();
@@ -428,7 +683,7 @@ void Physics::MakePassive(int ID, float Mass, BoundingType Bound)
                     	   (void*)idx, pp->GetIndex().size(),
                     	   sizeof(unsigned int)*3, (void*)normals);
 
-					Ob->Bound = dCreateTriMesh(m_Space,TriMeshData,NULL,NULL,NULL);
+					Ob.Bound = dCreateTriMesh(m_Space,TriMeshData,NULL,NULL,NULL);
 				}
 				else
 				{
@@ -467,38 +722,93 @@ void Physics::MakePassive(int ID, float Mass, BoundingType Bound)
 	rot[14]=rotation.m[2][3];
 	rot[15]=rotation.m[3][3];
 	
-  	dGeomSetPosition(Ob->Bound,Pos.x,Pos.y,Pos.z);
-  	dGeomSetRotation(Ob->Bound,rot);
+  	dGeomSetPosition(Ob.Bound,Pos.x,Pos.y,Pos.z);
+  	dGeomSetRotation(Ob.Bound,rot);
 
   	
-  	m_ObjectMap[ID]=Ob;
+  	AddObject(Ob);
 }
 
 void Physics::SetMass(int ID, float mass)
 {
-	map<int,Object*>::iterator i = m_ObjectMap.find(ID);
-	if (i==m_ObjectMap.end())
-	{
-		Trace::Stream<<"Physics::SetMass : Object ["<<ID<<"] doesn't exist"<<endl;
-		return;
-	}
+	Object *ob = FindObject(ID,"SetMass");
+	if (ob==NULL) return;
 	
-	if (i->second->Type!=ACTIVE)
+	if (ob->Type!=ACTIVE)
 	{
 		Trace::Stream<<"Physics::SetMass : Object ["<<ID<<"] isn't active"<<endl;
 		return;
 	}
 	
 	dMass m;
-	dBodyGetMass(i->second->Body,&m);
+	dBodyGetMass(ob->Body,&m);
 	dMassAdjust(&m,mass);
-	dBodySetMass(i->second->Body,&m);
+	dBodySetMass(ob->Body,&m);
+}
+
+Physics::Object *Physics::FindObject(int ID)
+{
+	if (ID<0 || ID>=(int)m_Slots.size() || m_Slots[ID]==-1) return NULL;
+	return &m_Objects[m_Slots[ID]];
+}
+
+Physics::Object *Physics::FindObject(int ID, const char *func)
+{
+	Object *ob = FindObject(ID);
+	if (ob==NULL)
+	{
+		Trace::Stream<<"Physics::"<<func<<" : Object ["<<ID<<"] doesn't exist"<<endl;
+	}
+	return ob;
+}
+
+void Physics::AddObject(const Object &ob)
+{
+	if (ob.ID>=(int)m_Slots.size()) m_Slots.resize(ob.ID+1,-1);
+	m_Slots[ob.ID]=m_Objects.size();
+	m_Objects.push_back(ob);
+	
+	BodyState st;
+	if (ob.Type==ACTIVE)
+	{
+		const dReal *p=dBodyGetPosition(ob.Body);
+		const dReal *q=dBodyGetQuaternion(ob.Body);
+		st.Pos=dVector(p[0],p[1],p[2]);
+		st.Rot=dQuat(q[1],q[2],q[3],q[0]);
+	}
+	m_States.push_back(st);
+	m_PrevStates.push_back(st);
+	m_CollisionRecord.push_back(0);
+
+	// so the collisions can be recorded by slot, 0 is for 
+	// geoms which aren't objects, like the ground plane
+	dGeomSetData(ob.Bound,(void*)(size_t)m_Objects.size());
+}
+
+void Physics::RemoveObject(unsigned int slot)
+{
+	m_Objects[slot].Destroy();
+	m_Slots[m_Objects[slot].ID]=-1;
+	
+	unsigned int last=m_Objects.size()-1;
+	if (slot!=last)
+	{
+		m_Objects[slot]=m_Objects[last];
+		m_States[slot]=m_States[last];
+		m_PrevStates[slot]=m_PrevStates[last];
+		m_CollisionRecord[slot]=m_CollisionRecord[last];
+		m_Slots[m_Objects[slot].ID]=slot;
+		dGeomSetData(m_Objects[slot].Bound,(void*)(size_t)(slot+1));
+	}
+	m_Objects.pop_back();
+	m_States.pop_back();
+	m_PrevStates.pop_back();
+	m_CollisionRecord.pop_back();
 }
 
 void Physics::Free(int ID)
 {
-	map<int,Object*>::iterator i = m_ObjectMap.find(ID);
-	if (i!=m_ObjectMap.end())
+	if (FindObject(ID)!=NULL)
 	{
         // clean up joints connected to this object
         vector<map<int,JointObject*>::iterator> toremove;
@@ -516,8 +826,7 @@ void Physics::Free(int ID)
             m_JointMap.erase(*j);
         }
         
-        delete i->second;
-        m_ObjectMap.erase(i);
+        RemoveObject(m_Slots[ID]);
     }
 
     Node *node = m_Renderer->GetSceneGraph().FindNode(ID);
@@ -533,11 +842,23 @@ void Physics::Free(int ID)
 
 void Physics::Clear()
 {
-	for(map<int,Object*>::iterator i=m_ObjectMap.begin(); i!=m_ObjectMap.end(); ++i)
+	for(vector<Object>::iterator i=m_Objects.begin(); i!=m_Objects.end(); ++i)
 	{
-		delete i->second;
+		i->Destroy();
 	}
-	m_ObjectMap.clear();
+	m_Objects.clear();
+	m_Slots.clear();
+	m_States.clear();
+	m_PrevStates.clear();
+	m_CollisionRecord.clear();
+	m_Accumulator=0;
+
+	// the objects in them have gone already
+	for (map<int,dSpaceID>::iterator i=m_GroupMap.begin(); i!=m_GroupMap.end(); ++i)
+	{
+		dSpaceDestroy(i->second);
+	}
+	m_GroupMap.clear();
 
 	for(map<int,JointObject*>::iterator i=m_JointMap.begin(); i!=m_JointMap.end(); ++i)
 	{
@@ -555,104 +876,161 @@ void Physics::Clear()
 	m_NextJointID=0;
 }
 
-void Physics::UpdatePrimitives()
+void Physics::ReadStates()
+{
+	for (unsigned int slot=0; slot<m_Objects.size(); slot++)
+	{
+		const Object &ob=m_Objects[slot];
+		// bodies which have gone to sleep haven't moved
+		if (ob.Type!=ACTIVE || !dBodyIsEnabled(ob.Body)) continue;
+
+		// ode quaternions are w,x,y,z
+		const dReal *p=dBodyGetPosition(ob.Body);
+		const dReal *q=dBodyGetQuaternion(ob.Body);
+		BodyState &st=m_States[slot];
+		st.Pos.x=p[0]; st.Pos.y=p[1]; st.Pos.z=p[2];
+		st.Rot.x=q[1]; st.Rot.y=q[2]; st.Rot.z=q[3]; st.Rot.w=q[0];
+	}
+}
+
+void Physics::UpdatePrimitives(float t)
 {
-	// for every object
-	for(map<int,Object*>::iterator i=m_ObjectMap.begin(); i!=m_ObjectMap.end(); ++i)
+	for (unsigned int slot=0; slot<m_Objects.size(); slot++)
 	{
-		if (i->second->Type==ACTIVE)
+		const Object &ob=m_Objects[slot];
+		// sleeping bodies keep the transform they had last time
+		if (ob.Type!=ACTIVE || !dBodyIsEnabled(ob.Body)) continue;
+
+		const BodyState &cur=m_States[slot];
+		dMatrix &m=ob.Prim->GetState()->Transform;
+		if (t>=1)
 		{
-			float Pos[3]={dBodyGetPosition(i->second->Body)[0],
-			              dBodyGetPosition(i->second->Body)[1],
-						  dBodyGetPosition(i->second->Body)[2]};
-					
-			dMatrix Rot(dBodyGetRotation(i->second->Body)[0], dBodyGetRotation(i->second->Body)[1], dBodyGetRotation(i->second->Body)[2],
-			  			   dBodyGetRotation(i->second->Body)[3], dBodyGetRotation(i->second->Body)[4], dBodyGetRotation(i->second->Body)[5],
-			               dBodyGetRotation(i->second->Body)[6], dBodyGetRotation(i->second->Body)[7], dBodyGetRotation(i->second->Body)[8],
-			       		   dBodyGetRotation(i->second->Body)[9], dBodyGetRotation(i->second->Body)[10], dBodyGetRotation(i->second->Body)[11], 0,0,0,1);
-       		   		
-			dVector PosVec(Pos[0],Pos[1],Pos[2]);	
-				
-			i->second->Prim->GetState()->Transform=Rot;
-			i->second->Prim->GetState()->Transform.settranslate(PosVec);
+			m=cur.Rot.toMatrix();
+			m.settranslate(cur.Pos);
+		}
+		else
+		{
+			// normalised lerp, toMatrix() copes with the 
+			// quaternion not being unit length
+			const BodyState &prev=m_PrevStates[slot];
+			dQuat from=prev.Rot;
+			if (from.x*cur.Rot.x+from.y*cur.Rot.y+from.z*cur.Rot.z+from.w*cur.Rot.w<0) 
+			{
+				from=from*-1;
+			}
+			m=(from+(cur.Rot-from)*t).toMatrix();
+			m.settranslate(prev.Pos+(cur.Pos-prev.Pos)*t);
 		}
 	}
 }
 
 void Physics::Kick(int ID, dVector v)
 {
-    map<int,Object*>::iterator i = m_ObjectMap.find(ID);
-	if (i==m_ObjectMap.end())
+	Object *ob = FindObject(ID,"Kick");
+	if (ob!=NULL && ob->Type==ACTIVE)
 	{
-		Trace::Stream<<"Physics::Kick : Object ["<<ID<<"] doesn't exist"<<endl;
-		return;
+		const dReal *cv = dBodyGetLinearVel(ob->Body);
+		dBodySetLinearVel(ob->Body,cv[0]+v.x,cv[1]+v.y,cv[2]+v.z);
 	}
+}
 
-	if (i->second->Type==ACTIVE)
+void Physics::Twist(int ID, dVector v)
+{
+	Object *ob = FindObject(ID,"Twist");
+	if (ob!=NULL && ob->Type==ACTIVE)
 	{
-		const dReal *cv = dBodyGetLinearVel(i->second->Body);
-		dBodySetLinearVel(i->second->Body,cv[0]+v.x,cv[1]+v.y,cv[2]+v.z);
+		const dReal *cv = dBodyGetAngularVel(ob->Body);
+		dBodySetAngularVel(ob->Body,cv[0]+v.x,cv[1]+v.y,cv[2]+v.z);
 	}
 }
 
-void Physics::Twist(int ID, dVector v)
+void Physics::AddForce(int ID, dVector v)
 {
-    map<int,Object*>::iterator i = m_ObjectMap.find(ID);
-	if (i==m_ObjectMap.end())
+	Object *ob = FindObject(ID,"AddForce");
+	if (ob!=NULL && ob->Type==ACTIVE)
 	{
-		Trace::Stream<<"Physics::Twist : Object ["<<ID<<"] doesn't exist"<<endl;
-		return;
+		dBodyAddForce(ob->Body,v.x, v.y, v.z);
 	}
+}
 
-	if (i->second->Type==ACTIVE)
+void Physics::AddTorque(int ID, dVector v)
+{
+	Object *ob = FindObject(ID,"AddTorque");
+	if (ob!=NULL && ob->Type==ACTIVE)
 	{
-		const dReal *cv = dBodyGetAngularVel(i->second->Body);
-		dBodySetAngularVel(i->second->Body,cv[0]+v.x,cv[1]+v.y,cv[2]+v.z);
+		dBodyAddTorque(ob->Body,v.x, v.y, v.z);
 	}
 }
 
-void Physics::AddForce(int ID, dVector v)
+void Physics::GetBatch(const char *func, const vector<int> &IDs, const vector<dVector> &v,
+	vector<pair<dBodyID,dVector> > &batch)
 {
-    map<int,Object*>::iterator i = m_ObjectMap.find(ID);
-	if (i==m_ObjectMap.end())
+	batch.clear();
+	if (v.size()!=1 && v.size()!=IDs.size())
 	{
-		Trace::Stream<<"Physics::AddForce : Object ["<<ID<<"] doesn't exist"<<endl;
+		Trace::Stream<<"Physics::"<<func<<" : need one vector, or one for each object"<<endl;
 		return;
 	}
 
-	if (i->second->Type==ACTIVE)
+	batch.reserve(IDs.size());
+	for (unsigned int n=0; n<IDs.size(); n++)
 	{
-		dBodyAddForce(i->second->Body,v.x, v.y, v.z);
+		Object *ob = FindObject(IDs[n],func);
+		if (ob!=NULL && ob->Type==ACTIVE)
+		{
+			batch.push_back(pair<dBodyID,dVector>(ob->Body,v.size()==1?v[0]:v[n]));
+		}
 	}
 }
 
-void Physics::AddTorque(int ID, dVector v)
+void Physics::Kick(const vector<int> &IDs, const vector<dVector> &v)
 {
-    map<int,Object*>::iterator i = m_ObjectMap.find(ID);
-	if (i==m_ObjectMap.end())
+	vector<pair<dBodyID,dVector> > batch;
+	GetBatch("Kick",IDs,v,batch);
+	for (vector<pair<dBodyID,dVector> >::iterator i=batch.begin(); i!=batch.end(); ++i)
 	{
-		Trace::Stream<<"Physics::AddTorque : Object ["<<ID<<"] doesn't exist"<<endl;
-		return;
+		const dReal *cv = dBodyGetLinearVel(i->first);
+		dBodySetLinearVel(i->first,cv[0]+i->second.x,cv[1]+i->second.y,cv[2]+i->second.z);
 	}
+}
 
-	if (i->second->Type==ACTIVE)
+void Physics::Twist(const vector<int> &IDs, const vector<dVector> &v)
+{
+	vector<pair<dBodyID,dVector> > batch;
+	GetBatch("Twist",IDs,v,batch);
+	for (vector<pair<dBodyID,dVector> >::iterator i=batch.begin(); i!=batch.end(); ++i)
 	{
-		dBodyAddTorque(i->second->Body,v.x, v.y, v.z);
+		const dReal *cv = dBodyGetAngularVel(i->first);
+		dBodySetAngularVel(i->first,cv[0]+i->second.x,cv[1]+i->second.y,cv[2]+i->second.z);
 	}
 }
 
-void Physics::SetGravityMode(int ID, bool mode)
+void Physics::AddForce(const vector<int> &IDs, const vector<dVector> &v)
 {
-    map<int,Object*>::iterator i = m_ObjectMap.find(ID);
-	if (i==m_ObjectMap.end())
+	vector<pair<dBodyID,dVector> > batch;
+	GetBatch("AddForce",IDs,v,batch);
+	for (vector<pair<dBodyID,dVector> >::iterator i=batch.begin(); i!=batch.end(); ++i)
 	{
-		Trace::Stream<<"Physics::SetGravityMode : Object ["<<ID<<"] doesn't exist"<<endl;
-		return;
+		dBodyAddForce(i->first,i->second.x,i->second.y,i->second.z);
 	}
+}
 
-	if (i->second->Type==ACTIVE)
+void Physics::AddTorque(const vector<int> &IDs, const vector<dVector> &v)
+{
+	vector<pair<dBodyID,dVector> > batch;
+	GetBatch("AddTorque",IDs,v,batch);
+	for (vector<pair<dBodyID,dVector> >::iterator i=batch.begin(); i!=batch.end(); ++i)
 	{
-		dBodySetGravityMode(i->second->Body, mode ? 1 : 0);
+		dBodyAddTorque(i->first,i->second.x,i->second.y,i->second.z);
+	}
+}
+
+void Physics::SetGravityMode(int ID, bool mode)
+{
+	Object *ob = FindObject(ID,"SetGravityMode");
+	if (ob!=NULL && ob->Type==ACTIVE)
+	{
+		dBodySetGravityMode(ob->Body, mode ? 1 : 0);
 	}
 }
 
@@ -663,14 +1041,26 @@ void Physics::NearCallback(void *data, dGeomID o1, dGeomID o2)
 
 void Physics::NearCallback_i(dGeomID o1, dGeomID o2)
 {
+	// one of them is a group, so test the objects in it
+	if (dGeomIsSpace(o1) || dGeomIsSpace(o2))
+	{
+		dSpaceCollide2(o1,o2,this,&NearCallback);
+		return;
+	}
+
 	if (m_Collisions)
 	{
-  		const int N = 10;
-		dContact contact[N];
+		dContact *contact = &m_Contacts[0];
 
-		int n = dCollide(o1,o2,N,&contact[0].geom,sizeof(dContact));
+		int n = dCollide(o1,o2,m_Contacts.size(),&contact[0].geom,sizeof(dContact));
 		if (n > 0)
 		{
+			// slots are stored one up, so 0 can mean no object
+			size_t slot1=(size_t)dGeomGetData(o1);
+			size_t slot2=(size_t)dGeomGetData(o2);
+			if (slot1>0) m_CollisionRecord[slot1-1]=1;
+			if (slot2>0) m_CollisionRecord[slot2-1]=1;
+
 			for (int i=0; i<n; i++)
 			{
 				contact[i].surface.mode = dContactSlip1 | dContactSlip2 | dContactSoftERP | dContactSoftCFM | dContactApprox1;
@@ -683,8 +1073,6 @@ void Physics::NearCallback_i(dGeomID o1, dGeomID o2)
 				dBodyID geom1 = dGeomGetBody(contact[i].geom.g1);
 				dBodyID geom2 = dGeomGetBody(contact[i].geom.g2);
 				dJointAttach(c,geom1,geom2);
-				m_CollisionRecord.insert(geom1);
-				m_CollisionRecord.insert(geom2);
 			}
 		}
 	}
@@ -692,29 +1080,18 @@ void Physics::NearCallback_i(dGeomID o1, dGeomID o2)
 
 int Physics::CreateJointHinge2(int Ob1, int Ob2, dVector Anchor, dVector Hinge[2])
 {
-	map<int,Object*>::iterator i1 = m_ObjectMap.find(Ob1);
-	map<int,Object*>::iterator i2 = m_ObjectMap.find(Ob2);
+	Object *o1 = FindObject(Ob1,"CreateJointHinge2");
+	Object *o2 = FindObject(Ob2,"CreateJointHinge2");
+	if (o1==NULL || o2==NULL) return 0;
 	
-	if (i1==m_ObjectMap.end())
-	{
-		Trace::Stream<<"Physics::CreateJointHinge2 : Object ["<<Ob1<<"] doesn't exist"<<endl;
-		return 0;
-	}
-	
-	if (i2==m_ObjectMap.end())
-	{
-		Trace::Stream<<"Physics::CreateJointHinge2 : Object ["<<Ob2<<"] doesn't exist"<<endl;
-		return 0;
-	}
-	
-	if (i1->second->Body==0 || i2->second->Body==0)
+	if (o1->Body==0 || o2->Body==0)
 	{
 		Trace::Stream<<"Physics::CreateJointHinge2 : cant connect passive objects"<<endl;
 		return 0;
 	}
 
 	dJointID j = dJointCreateHinge2(m_World,0);
-	dJointAttach(j,i1->second->Body,i2->second->Body);
+	dJointAttach(j,o1->Body,o2->Body);
 	dJointSetHinge2Anchor(j,Anchor.x,Anchor.y,Anchor.z);
 	dJointSetHinge2Axis1(j,Hinge[0].x, Hinge[0].y, Hinge[0].z);
 	dJointSetHinge2Axis2(j,Hinge[1].x, Hinge[1].y, Hinge[1].z);
@@ -733,29 +1110,18 @@ int Physics::CreateJointHinge2(int Ob1, int Ob2, dVector Anchor, dVector Hinge[2
 
 int Physics::CreateJointHinge(int Ob1, int Ob2, dVector Anchor, dVector Hinge)
 {
-	map<int,Object*>::iterator i1 = m_ObjectMap.find(Ob1);
-	map<int,Object*>::iterator i2 = m_ObjectMap.find(Ob2);
+	Object *o1 = FindObject(Ob1,"CreateJointHinge");
+	Object *o2 = FindObject(Ob2,"CreateJointHinge");
+	if (o1==NULL || o2==NULL) return 0;
 	
-	if (i1==m_ObjectMap.end())
-	{
-		Trace::Stream<<"Physics::CreateJointHinge : Object ["<<Ob1<<"] doesn't exist"<<endl;
-		return 0;
-	}
-	
-	if (i2==m_ObjectMap.end())
-	{
-		Trace::Stream<<"Physics::CreateJointHinge : Object ["<<Ob2<<"] doesn't exist"<<endl;
-		return 0;
-	}
-	
-	if (i1->second->Body==0 || i2->second->Body==0)
+	if (o1->Body==0 || o2->Body==0)
 	{
 		Trace::Stream<<"Physics::CreateJointHinge : cant connect passive objects"<<endl;
 		return 0;
 	}
 	
 	dJointID j = dJointCreateHinge(m_World,0);
-	dJointAttach (j,i1->second->Body,i2->second->Body);
+	dJointAttach (j,o1->Body,o2->Body);
 	dJointSetHingeAnchor(j,Anchor.x,Anchor.y,Anchor.z);
 	dJointSetHingeAxis(j,Hinge.x, Hinge.y, Hinge.z);
 	dJointSetHingeParam(j,dParamFMax,100); // unlock the joint by default
@@ -772,22 +1138,17 @@ int Physics::CreateJointHinge(int Ob1, int Ob2, dVector Anchor, dVector Hinge)
 
 int Physics::CreateJointFixed(int Ob)
 {
-	map<int,Object*>::iterator i = m_ObjectMap.find(Ob);
-	
-	if (i==m_ObjectMap.end())
-	{
-		Trace::Stream<<"Physics::CreateJointFixed : Object ["<<Ob<<"] doesn't exist"<<endl;
-		return 0;
-	}
+	Object *o = FindObject(Ob,"CreateJointFixed");
+	if (o==NULL) return 0;
 	
-	if (i->second->Body==0)
+	if (o->Body==0)
 	{
 		Trace::Stream<<"Physics::CreateJointFixed : can't connect passive objects"<<endl;
 		return 0;
 	}
 
 	dJointID j = dJointCreateFixed(m_World,0);
-	dJointAttach (j,0,i->second->Body);
+	dJointAttach (j,0,o->Body);
 	dJointSetFixed(j);
 	
 	JointObject *NewJoint = new JointObject;
@@ -802,29 +1163,18 @@ int Physics::CreateJointFixed(int Ob)
 
 int Physics::CreateJointSlider(int Ob1, int Ob2, dVector Hinge)
 {
-	map<int,Object*>::iterator i1 = m_ObjectMap.find(Ob1);
-	map<int,Object*>::iterator i2 = m_ObjectMap.find(Ob2);
-	
-	if (i1==m_ObjectMap.end())
-	{
-		Trace::Stream<<"Physics::CreateJointSlider : Object ["<<Ob1<<"] doesn't exist"<<endl;
-		return 0;
-	}
-	
-	if (i2==m_ObjectMap.end())
-	{
-		Trace::Stream<<"Physics::CreateJointSlider : Object ["<<Ob2<<"] doesn't exist"<<endl;
-		return 0;
-	}
+	Object *o1 = FindObject(Ob1,"CreateJointSlider");
+	Object *o2 = FindObject(Ob2,"CreateJointSlider");
+	if (o1==NULL || o2==NULL) return 0;
 
-	if (i1->second->Body==0 || i2->second->Body==0)
+	if (o1->Body==0 || o2->Body==0)
 	{
 		Trace::Stream<<"Physics::CreateJointSlider : cant connect passive objects"<<endl;
 		return 0;
 	}
 	
 	dJointID j = dJointCreateSlider(m_World,0);
-	dJointAttach (j,i1->second->Body,i2->second->Body);
+	dJointAttach (j,o1->Body,o2->Body);
 	dJointSetSliderAxis(j,Hinge.x, Hinge.y, Hinge.z);
 	
 	JointObject *NewJoint = new JointObject;
@@ -839,29 +1189,18 @@ int Physics::CreateJointSlider(int Ob1, int Ob2, dVector Hinge)
 
 int Physics::CreateJointAMotor(int Ob1, int Ob2, dVector Axis)
 {
-	map<int,Object*>::iterator i1 = m_ObjectMap.find(Ob1);
-	map<int,Object*>::iterator i2 = m_ObjectMap.find(Ob2);
-	
-	if (i1==m_ObjectMap.end())
-	{
-		Trace::Stream<<"Physics::CreateJointAMotor : Object ["<<Ob1<<"] doesn't exist"<<endl;
-		return 0;
-	}
-	
-	if (i2==m_ObjectMap.end())
-	{
-		Trace::Stream<<"Physics::CreateJointAMotor : Object ["<<Ob2<<"] doesn't exist"<<endl;
-		return 0;
-	}
+	Object *o1 = FindObject(Ob1,"CreateJointAMotor");
+	Object *o2 = FindObject(Ob2,"CreateJointAMotor");
+	if (o1==NULL || o2==NULL) return 0;
 
-	if (i1->second->Body==0 || i2->second->Body==0)
+	if (o1->Body==0 || o2->Body==0)
 	{
 		Trace::Stream<<"Physics::CreateJointAMotor : cant connect passive objects"<<endl;
 		return 0;
 	}
 
 	dJointID j = dJointCreateAMotor(m_World,0);
-	dJointAttach(j,i1->second->Body,i2->second->Body);
+	dJointAttach(j,o1->Body,o2->Body);
 
 	dJointSetAMotorMode(j,dAMotorUser);
 	dJointSetAMotorNumAxes(j,1);
@@ -879,29 +1218,18 @@ int Physics::CreateJointAMotor(int Ob1, int Ob2, dVector Axis)
 
 int Physics::CreateJointBall(int Ob1, int Ob2, dVector Anchor)
 {
-	map<int,Object*>::iterator i1 = m_ObjectMap.find(Ob1);
-	map<int,Object*>::iterator i2 = m_ObjectMap.find(Ob2);
-	
-	if (i1==m_ObjectMap.end())
-	{
-		Trace::Stream<<"Physics::CreateJointBall : Object ["<<Ob1<<"] doesn't exist"<<endl;
-		return 0;
-	}
-	
-	if (i2==m_ObjectMap.end())
-	{
-		Trace::Stream<<"Physics::CreateJointBall : Object ["<<Ob2<<"] doesn't exist"<<endl;
-		return 0;
-	}
+	Object *o1 = FindObject(Ob1,"CreateJointBall");
+	Object *o2 = FindObject(Ob2,"CreateJointBall");
+	if (o1==NULL || o2==NULL) return 0;
 
-	if (i1->second->Body==0 || i2->second->Body==0)
+	if (o1->Body==0 || o2->Body==0)
 	{
 		Trace::Stream<<"Physics::CreateJointBall : cant connect passive objects"<<endl;
 		return 0;
 	}
 
 	dJointID j = dJointCreateBall(m_World,0);
-	dJointAttach(j,i1->second->Body,i2->second->Body);
+	dJointAttach(j,o1->Body,o2->Body);
 	dJointSetBallAnchor(j,Anchor.x,Anchor.y,Anchor.z);
 
 	JointObject *NewJoint = new JointObject;
@@ -993,15 +1321,11 @@ void Physics::SetJointParam(int ID, const string &Param, float Value)
 
 bool Physics::HasCollided(int Ob)
 {
-	map<int,Object*>::iterator i = m_ObjectMap.find(Ob);
-	if (i==m_ObjectMap.end())
-	{
-		Trace::Stream<<"Physics::HasCollided : Object ["<<Ob<<"] doesn't exist"<<endl;
-		return false;
-	}
+	Object *o = FindObject(Ob,"HasCollided");
+	if (o==NULL) return false;
 	
 	// only active objects have bodies to get
-	if (i->second->Type==ACTIVE && m_CollisionRecord.find(i->second->Body)!=m_CollisionRecord.end())
+	if (o->Type==ACTIVE && m_CollisionRecord[m_Slots[Ob]])
 	{
 		return true;
 	}
@@ -35,9 +35,57 @@ public:
 	
 	enum BoundingType {BOX,CYLINDER,SPHERE,MESH};
 	enum ObjectType {ACTIVE,PASSIVE};
+	/// FRAME steps the simulation once per Tick (the old behaviour, 
+	/// so the speed depends on the frame rate), FIXED steps it as 
+	/// many times as the time since the last frame needs
+	enum StepMode {FRAME,FIXED};
+	/// The ways of finding which objects might be touching
+	enum BroadphaseType {HASH,SAP,QUADTREE};
+
+	/// Settings for the broadphases, only the ones for 
+	/// the type being made are used
+	class BroadphaseParams
+	{
+	public:
+		BroadphaseParams();
+		/// The range of cell sizes for HASH, as powers of two
+		int MinLevel;
+		int MaxLevel;
+		/// The area covered by QUADTREE, and how many times it's split up
+		dVector Centre;
+		dVector Extents;
+		int Depth;
+	};
 	
-	/// Run the simulation for one frame
-    void Tick();
+	/// Run the simulation for one frame, delta is the time in
+	/// seconds since the last one, used in FIXED step mode
+    void Tick(float delta=0);
+
+	/////////////////////////////////
+	///@name Stepping
+	///@{
+	void SetStepMode(StepMode s)          { m_StepMode=s; m_Accumulator=0; m_PrevStates=m_States; }
+	/// The simulation time for each step, in seconds
+	void SetStepSize(float s)             { if (s>0) m_StepSize=s; }
+	/// The number of iterations the quick step solver makes
+	void SetIterations(int s);
+	/// The most steps to make in one Tick in FIXED mode, if the 
+	/// frame rate drops below this the simulation slows down
+	void SetMaxSubSteps(unsigned int s)   { m_MaxSubSteps=s>0?s:1; }
+	/// Whether the transforms are blended between the last two 
+	/// steps in FIXED mode, so movement is smooth between frames
+	void SetInterpolate(bool s)           { m_Interpolate=s; m_PrevStates=m_States; }
+	/// Turns off bodies that have been resting for this many steps
+	/// under the linear and angular velocity thresholds, they are 
+	/// turned back on when something hits them
+	void SetAutoDisable(bool s, float linear, float angular, int steps);
+	/// The number of threads islands of connected bodies are stepped 
+	/// on, needs ODE built with threading support
+	void SetThreads(unsigned int s);
+	/// The times taken by the last Tick, in milliseconds, and the
+	/// number of steps it made
+	void GetTimings(float &collide, float &step, float &writeback, unsigned int &steps);
+	///@}
 	
 	/// Just for visualisation of joints
    	void Render();
@@ -66,9 +114,23 @@ public:
     void Twist(int ID, dVector v);
 	void AddForce(int ID, dVector v);
 	void AddTorque(int ID, dVector v);
+	/// Batched versions, the vectors are either one for all
+	/// the objects, or one for each of them
+    void Kick(const vector<int> &IDs, const vector<dVector> &v);
+    void Twist(const vector<int> &IDs, const vector<dVector> &v);
+	void AddForce(const vector<int> &IDs, const vector<dVector> &v);
+	void AddTorque(const vector<int> &IDs, const vector<dVector> &v);
 	void SetGravityMode(int ID, bool mode);
     void SetMass(int ID, float mass);
 	void SetCollisions(bool s) { m_Collisions=s; }
+	/// Replaces the space all the objects are kept in
+	void SetBroadphase(BroadphaseType t, const BroadphaseParams &p);
+	/// Moves the object into a space of its own with the others in 
+	/// the group, they are tested against other groups all at once 
+	/// using the group's bounds. A group less than 0 takes it out
+	void SetGroup(int ID, int group);
+	/// The most contact points made for each pair of objects touching
+	void SetMaxContacts(unsigned int s);
 	void SetGravity(const dVector &g);
 	void SetGlobalSurfaceParams(float slip1, float slip2, float softerp, float softcfm) 
 		{ m_Slip1=slip1; m_Slip2=slip2; m_SoftErp=softerp; m_SoftCfm=softcfm; }
@@ -100,11 +162,14 @@ private:
 
 	enum JointType {BallJoint,HingeJoint,SliderJoint,ContactJoint,UniversalJoint,Hinge2Joint,FixedJoint,AMotorJoint};
 
+	/// Objects are kept by value in a packed array, so they 
+	/// need destroying explicitly when they are removed
 	class Object
 	{
 	public:
 		Object();
-		~Object();
+		void Destroy();
+		int ID;
 		ObjectType Type;
 		dBodyID Body;
 		dGeomID Bound;
@@ -122,7 +187,27 @@ private:
 		int Ob2;
 	};
 
-	void UpdatePrimitives();
+	/// Finds the object for a primitive, or NULL
+	Object *FindObject(int ID);
+	/// As FindObject(), but complains if it's missing
+	Object *FindObject(int ID, const char *func);
+	/// Puts an object into the next slot
+	void AddObject(const Object &ob);
+	/// Destroys the object in a slot, and moves the last one into it
+	void RemoveObject(unsigned int slot);
+	/// The active bodies for the batch functions, with the vector for each
+	void GetBatch(const char *func, const vector<int> &IDs, const vector<dVector> &v,
+		vector<pair<dBodyID,dVector> > &batch);
+	/// One step of the simulation
+	void Step();
+	/// Reads the positions and rotations of the bodies into m_States
+	void ReadStates();
+	/// Writes the states into the primitives, t is the 
+	/// amount from the previous states to the current ones
+	void UpdatePrimitives(float t);
+	void FreeThreads();
+
+	dSpaceID CreateSpace(BroadphaseType t, const BroadphaseParams &p);
 
 	static void NearCallback(void *data, dGeomID o1, dGeomID o2);
 	void NearCallback_i(dGeomID o1, dGeomID o2);
@@ -132,11 +217,28 @@ private:
 	dSpaceID m_Space;
 	dGeomID m_Ground;
 
-	map<int,Object*>       m_ObjectMap;
-	map<int,dGeomID>       m_GroupMap;
+	/// The objects packed together, with an index from primitive 
+	/// id to their slot, -1 for primitives not in the simulation
+	vector<Object>         m_Objects;
+	vector<int>            m_Slots;
+	/// The position and rotation of a body
+	class BodyState
+	{
+	public:
+		dVector Pos;
+		dQuat Rot;
+	};
+
+	/// The body states read back after the last step, and
+	/// the one before for interpolating, by slot
+	vector<BodyState>      m_States;
+	vector<BodyState>      m_PrevStates;
+	map<int,dSpaceID>      m_GroupMap;
 	map<int,JointObject*>  m_JointMap;
 	deque<int>             m_History;
-	set<dBodyID>		   m_CollisionRecord;
+	/// Whether each slot has collided since the last step
+	vector<char>           m_CollisionRecord;
+	vector<dContact>       m_Contacts;
 
 	Renderer *m_Renderer;
 	int m_MaxObjectCount;
@@ -149,6 +251,22 @@ private:
 	float m_Slip2;
 	float m_SoftErp;
 	float m_SoftCfm;
+
+	StepMode m_StepMode;
+	float m_StepSize;
+	unsigned int m_MaxSubSteps;
+	bool m_Interpolate;
+	float m_Accumulator;
+
+	float m_CollideTime;
+	float m_StepTime;
+	float m_WritebackTime;
+	unsigned int m_StepsTaken;
+
+#ifdef ODE_THREADING
+	dThreadingImplementationID m_Threading;
+	dThreadingThreadPoolID m_ThreadPool;
+#endif
 };
 
 };
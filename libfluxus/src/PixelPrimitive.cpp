@@ -82,9 +82,21 @@ m_Width(w),
 m_Height(h),
 m_ReadyForUpload(false),
 m_ReadyForDownload(false),
-m_RendererActive(RendererActive)
+m_ReadyForAsyncDownload(false),
+m_RendererActive(RendererActive),
+m_TransferFormat(TRANSFER_FLOAT),
+m_UploadIndex(0),
+m_DownloadIndex(0),
+m_DownloadReady(false)
 {
 	m_FBOSupported = glewIsSupported("GL_EXT_framebuffer_object");
+	m_PixelBuffersSupported = glewIsSupported("GL_VERSION_2_1") && glMapBuffer!=NULL;
+	for (unsigned int i=0; i<2; i++)
+	{
+		m_UploadBuffers[i]=0;
+		m_DownloadBuffers[i]=0;
+		m_DownloadPending[i]=false;
+	}
 	m_Renderer = new Renderer();
 	m_Physics = new Physics(m_Renderer);
 
@@ -130,9 +142,25 @@ m_Width(other.m_Width),
 m_Height(other.m_Height),
 m_ReadyForUpload(other.m_ReadyForUpload),
 m_ReadyForDownload(other.m_ReadyForDownload),
+m_ReadyForAsyncDownload(false),
 m_FBOSupported(other.m_FBOSupported),
-m_RendererActive(other.m_RendererActive)
+m_RendererActive(other.m_RendererActive),
+m_PixelBuffersSupported(other.m_PixelBuffersSupported),
+m_UploadRegion(other.m_UploadRegion),
+m_DownloadRegion(other.m_DownloadRegion),
+m_TransferFormat(other.m_TransferFormat),
+m_UploadIndex(0),
+m_DownloadIndex(0),
+m_DownloadReady(false)
 {
+	// the buffers belong to the original
+	for (unsigned int i=0; i<2; i++)
+	{
+		m_UploadBuffers[i]=0;
+		m_DownloadBuffers[i]=0;
+		m_DownloadPending[i]=false;
+	}
+
 	m_Renderer = new Renderer();
 	m_Physics = new Physics(m_Renderer);
 
@@ -162,9 +190,22 @@ PixelPrimitive::~PixelPrimitive()
 	}
 	#endif
 
+	DeleteBuffers();
 	delete m_Renderer;
 }
 
+void PixelPrimitive::DeleteBuffers()
+{
+	for (unsigned int i=0; i<2; i++)
+	{
+		if (m_UploadBuffers[i]!=0) glDeleteBuffers(1,(GLuint*)&m_UploadBuffers[i]);
+		if (m_DownloadBuffers[i]!=0) glDeleteBuffers(1,(GLuint*)&m_DownloadBuffers[i]);
+		m_UploadBuffers[i]=0;
+		m_DownloadBuffers[i]=0;
+		m_DownloadPending[i]=false;
+	}
+}
+
 PixelPrimitive* PixelPrimitive::Clone() const
 {
 	return new PixelPrimitive(*this);
@@ -190,6 +231,12 @@ void PixelPrimitive::ResizeFBO(int w, int h)
 
 		glGenTextures(1, (GLuint*)&m_Texture);
 
+		// anything in flight is for the old size
+		DeleteBuffers();
+		m_UploadRegion=Region();
+		m_DownloadRegion=Region();
+		m_AsyncRegion=Region();
+
 		m_FBOWidth = 1 << (unsigned)ceil(log2(w));
 		m_FBOHeight = 1 << (unsigned)ceil(log2(h));
 
@@ -278,16 +325,75 @@ void PixelPrimitive::ResizeFBO(int w, int h)
 #endif
 }
 
+void PixelPrimitive::Region::Add(const Region &other)
+{
+	if (other.Empty()) return;
+	if (Empty()) 
+	{
+		*this=other;
+		return;
+	}
+	
+	unsigned int right=max(X+Width,other.X+other.Width);
+	unsigned int top=max(Y+Height,other.Y+other.Height);
+	X=min(X,other.X);
+	Y=min(Y,other.Y);
+	Width=right-X;
+	Height=top-Y;
+}
+
+PixelPrimitive::Region PixelPrimitive::Clip(int x, int y, int w, int h) const
+{
+	Region r;
+	int right=min(x+w,(int)m_Width);
+	int top=min(y+h,(int)m_Height);
+	x=max(x,0);
+	y=max(y,0);
+	if (right>x && top>y)
+	{
+		r.X=x;
+		r.Y=y;
+		r.Width=right-x;
+		r.Height=top-y;
+	}
+	return r;
+}
+
 void PixelPrimitive::Upload()
 {
+	Upload(0,0,m_Width,m_Height);
+}
+
+void PixelPrimitive::Upload(int x, int y, int w, int h)
+{
+	m_UploadRegion.Add(Clip(x,y,w,h));
 	m_ReadyForUpload = true;
 }
 
 void PixelPrimitive::Download()
 {
+	Download(0,0,m_Width,m_Height);
+}
+
+void PixelPrimitive::Download(int x, int y, int w, int h)
+{
+	m_DownloadRegion.Add(Clip(x,y,w,h));
 	m_ReadyForDownload = true;
 }
 
+void PixelPrimitive::DownloadAsync(int x, int y, int w, int h)
+{
+	m_AsyncRegion.Add(Clip(x,y,w,h));
+	m_ReadyForAsyncDownload = true;
+}
+
+bool PixelPrimitive::DownloadReady()
+{
+	bool ready=m_DownloadReady;
+	m_DownloadReady=false;
+	return ready;
+}
+
 void PixelPrimitive::Load(const string &filename)
 {
 	TypedPData<dColour> *data = dynamic_cast<TypedPData<dColour>*>(GetDataRaw("c"));
@@ -353,7 +459,8 @@ void PixelPrimitive::Render()
 	// we need to do uploading while we have an active gl context
 	if (m_ReadyForUpload)
 	{
-		UploadPData();
+		UploadPData(m_UploadRegion);
+		m_UploadRegion=Region();
 		m_ReadyForUpload=false;
 	}
 
@@ -428,9 +535,12 @@ void PixelPrimitive::Render()
 
 	if (m_ReadyForDownload)
 	{
-		DownloadPData();
+		DownloadPData(m_DownloadRegion);
+		m_DownloadRegion=Region();
 		m_ReadyForDownload=false;
 	}
+
+	ReadAsync();
 }
 
 dBoundingBox PixelPrimitive::GetBoundingBox(const dMatrix &space)
@@ -463,37 +573,194 @@ void PixelPrimitive::ApplyTransform(bool ScaleRotOnly)
 	GetState()->Transform.init();
 }
 
-void PixelPrimitive::UploadPData()
+unsigned int PixelPrimitive::PixelSize() const
 {
-	if (m_FBOSupported)
+	return m_TransferFormat==TRANSFER_BYTE ? 4 : sizeof(dColour);
+}
+
+GLenum PixelPrimitive::PixelType() const
+{
+	return m_TransferFormat==TRANSFER_BYTE ? GL_UNSIGNED_BYTE : GL_FLOAT;
+}
+
+void PixelPrimitive::PackPixels(const Region &region, void *dest) const
+{
+	if (m_TransferFormat==TRANSFER_BYTE)
 	{
-		glBindTexture(GL_TEXTURE_2D, m_Texture);
-		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, m_Width, m_Height,
-				GL_RGBA, GL_FLOAT, &(*m_ColourData)[0]);
-		glBindTexture(GL_TEXTURE_2D, 0);
+		unsigned char *d=(unsigned char*)dest;
+		for (unsigned int y=region.Y; y<region.Y+region.Height; y++)
+		{
+			const dColour *src=&(*m_ColourData)[y*m_Width+region.X];
+			for (unsigned int x=0; x<region.Width; x++)
+			{
+				const float *c=&src[x].r;
+				for (unsigned int n=0; n<4; n++)
+				{
+					float v=c[n];
+					*d++=v<=0 ? 0 : v>=1 ? 255 : (unsigned char)(v*255.0f+0.5f);
+				}
+			}
+		}
 	}
 	else
 	{
-		glBindTexture(GL_TEXTURE_2D, m_Texture);
-		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, m_Width, m_Height,
-				GL_RGBA, GL_FLOAT, &(*m_ColourData)[0]);
+		unsigned int rowsize=region.Width*sizeof(dColour);
+		for (unsigned int y=0; y<region.Height; y++)
+		{
+			memcpy((char*)dest+y*rowsize,&(*m_ColourData)[(region.Y+y)*m_Width+region.X],rowsize);
+		}
 	}
 }
 
-void PixelPrimitive::DownloadPData()
+void PixelPrimitive::UnpackPixels(const Region &region, TransferFormat format, const void *src)
 {
-	if (m_FBOSupported)
+	if (format==TRANSFER_BYTE)
 	{
-		Bind();
-		GLubyte *data=GetScreenBuffer(0, 0, m_Width, m_Height, 1);
-		for (unsigned int i=0; i<m_Width*m_Height; i++)
+		const unsigned char *s=(const unsigned char*)src;
+		for (unsigned int y=region.Y; y<region.Y+region.Height; y++)
 		{
-			(*m_ColourData)[i].r=data[i*3]/255.0f;
-			(*m_ColourData)[i].g=data[i*3+1]/255.0f;
-			(*m_ColourData)[i].b=data[i*3+2]/255.0f;
+			dColour *dest=&(*m_ColourData)[y*m_Width+region.X];
+			for (unsigned int x=0; x<region.Width; x++)
+			{
+				dest[x].r=s[0]/255.0f;
+				dest[x].g=s[1]/255.0f;
+				dest[x].b=s[2]/255.0f;
+				dest[x].a=s[3]/255.0f;
+				s+=4;
+			}
 		}
-        free(data);
-		Unbind();
 	}
+	else
+	{
+		unsigned int rowsize=region.Width*sizeof(dColour);
+		for (unsigned int y=0; y<region.Height; y++)
+		{
+			memcpy((void*)&(*m_ColourData)[(region.Y+y)*m_Width+region.X],(const char*)src+y*rowsize,rowsize);
+		}
+	}
+}
+
+void PixelPrimitive::UploadPData(const Region &region)
+{
+	if (region.Empty()) return;
+
+	glBindTexture(GL_TEXTURE_2D, m_Texture);
+	if (m_PixelBuffersSupported)
+	{
+		// pack the region into the next buffer, the card copies it 
+		// to the texture in its own time
+		unsigned int size=region.Width*region.Height*PixelSize();
+		unsigned int &buffer=m_UploadBuffers[m_UploadIndex];
+		m_UploadIndex=(m_UploadIndex+1)%2;
+		if (buffer==0) glGenBuffers(1,(GLuint*)&buffer);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER,buffer);
+		// orphan the old contents, so we don't wait for them
+		glBufferData(GL_PIXEL_UNPACK_BUFFER,size,NULL,GL_STREAM_DRAW);
+		void *dest=glMapBuffer(GL_PIXEL_UNPACK_BUFFER,GL_WRITE_ONLY);
+		if (dest!=NULL)
+		{
+			PackPixels(region,dest);
+			glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+			glTexSubImage2D(GL_TEXTURE_2D, 0, region.X, region.Y, region.Width, region.Height,
+				GL_RGBA, PixelType(), NULL);
+		}
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER,0);
+	}
+	else if (m_TransferFormat==TRANSFER_BYTE)
+	{
+		m_Staging.resize(region.Width*region.Height*4);
+		PackPixels(region,&m_Staging[0]);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, region.X, region.Y, region.Width, region.Height,
+				GL_RGBA, GL_UNSIGNED_BYTE, &m_Staging[0]);
+	}
+	else
+	{
+		// straight from the pdata
+		glPixelStorei(GL_UNPACK_ROW_LENGTH, m_Width);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, region.X, region.Y, region.Width, region.Height,
+				GL_RGBA, GL_FLOAT, &(*m_ColourData)[region.Y*m_Width+region.X]);
+		glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+	}
+	if (m_FBOSupported) glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void PixelPrimitive::DownloadPData(const Region &region)
+{
+	if (!m_FBOSupported || region.Empty()) return;
+
+	glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, m_FBO);
+	if (m_TransferFormat==TRANSFER_BYTE)
+	{
+		m_Staging.resize(region.Width*region.Height*4);
+		glReadPixels(region.X, region.Y, region.Width, region.Height,
+			GL_RGBA, GL_UNSIGNED_BYTE, &m_Staging[0]);
+		UnpackPixels(region,TRANSFER_BYTE,&m_Staging[0]);
+	}
+	else
+	{
+		// straight into the pdata, alpha and all
+		glPixelStorei(GL_PACK_ROW_LENGTH, m_Width);
+		glReadPixels(region.X, region.Y, region.Width, region.Height,
+			GL_RGBA, GL_FLOAT, &(*m_ColourData)[region.Y*m_Width+region.X]);
+		glPixelStorei(GL_PACK_ROW_LENGTH, 0);
+	}
+	glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, 0);
+}
+
+void PixelPrimitive::ReadAsync()
+{
+	if (!m_FBOSupported) return;
+
+	if (m_ReadyForAsyncDownload && !m_PixelBuffersSupported)
+	{
+		// nothing to wait for without pixel buffers
+		DownloadPData(m_AsyncRegion);
+		m_AsyncRegion=Region();
+		m_ReadyForAsyncDownload=false;
+		m_DownloadReady=true;
+		return;
+	}
+
+	// start the read into this frame's buffer first, then collect 
+	// last frame's, which the card should have finished with by now
+	unsigned int current=m_DownloadIndex;
+	if (m_ReadyForAsyncDownload && !m_AsyncRegion.Empty())
+	{
+		unsigned int &buffer=m_DownloadBuffers[m_DownloadIndex];
+		if (buffer==0) glGenBuffers(1,(GLuint*)&buffer);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER,buffer);
+		glBufferData(GL_PIXEL_PACK_BUFFER,m_AsyncRegion.Width*m_AsyncRegion.Height*PixelSize(),
+			NULL,GL_STREAM_READ);
+		glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, m_FBO);
+		glReadPixels(m_AsyncRegion.X, m_AsyncRegion.Y, m_AsyncRegion.Width, m_AsyncRegion.Height,
+			GL_RGBA, PixelType(), NULL);
+		glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, 0);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER,0);
+
+		m_DownloadBufferRegions[m_DownloadIndex]=m_AsyncRegion;
+		m_DownloadBufferFormats[m_DownloadIndex]=m_TransferFormat;
+		m_DownloadPending[m_DownloadIndex]=true;
+		m_DownloadIndex=(current+1)%2;
+	}
+	m_AsyncRegion=Region();
+	m_ReadyForAsyncDownload=false;
+
+	CollectAsync((current+1)%2);
 }
 
+void PixelPrimitive::CollectAsync(unsigned int buffer)
+{
+	if (!m_DownloadPending[buffer]) return;
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER,m_DownloadBuffers[buffer]);
+	const void *src=glMapBuffer(GL_PIXEL_PACK_BUFFER,GL_READ_ONLY);
+	if (src!=NULL)
+	{
+		// it may have been read in a different format
+		UnpackPixels(m_DownloadBufferRegions[buffer],m_DownloadBufferFormats[buffer],src);
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		m_DownloadReady=true;
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER,0);
+	m_DownloadPending[buffer]=false;
+}
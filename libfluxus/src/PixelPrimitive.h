@@ -52,11 +52,27 @@ public:
 	/// Create a new FBO and release the old one if exists
 	void ResizeFBO(int w, int h);
 
+	/// How the pixels are sent to and from the card, floats keep 
+	/// the pdata as it is, bytes are a quarter the size to move
+	enum TransferFormat {TRANSFER_FLOAT, TRANSFER_BYTE};
+
 	/// Upload the texture to the graphics card
 	void Upload();
+	/// Upload a part of the texture, the regions are merged 
+	/// until the next render
+	void Upload(int x, int y, int w, int h);
 
 	/// Download the texture from the graphics card
 	void Download();
+	void Download(int x, int y, int w, int h);
+
+	/// Download the texture without waiting for the card, the
+	/// pixels arrive in the pdata a frame later
+	void DownloadAsync(int x, int y, int w, int h);
+	/// Returns true once, when an asynchronous download has arrived
+	bool DownloadReady();
+
+	void SetTransferFormat(TransferFormat format) { m_TransferFormat = format; }
 
 	/// Load a png file into this primitive
 	void Load(const string &filename);
@@ -95,8 +111,35 @@ protected:
 
 	virtual void PDataDirty();
 
-	void DownloadPData();
-	void UploadPData();
+	/// A rectangle of pixels, bottom row first
+	class Region
+	{
+	public:
+		Region() : X(0), Y(0), Width(0), Height(0) {}
+		bool Empty() const { return Width==0 || Height==0; }
+		/// Grow to include another region
+		void Add(const Region &other);
+		
+		unsigned int X;
+		unsigned int Y;
+		unsigned int Width;
+		unsigned int Height;
+	};
+
+	/// Returns the part of the rectangle inside the pixels
+	Region Clip(int x, int y, int w, int h) const;
+
+	void DownloadPData(const Region &region);
+	void UploadPData(const Region &region);
+	void ReadAsync();
+	void CollectAsync(unsigned int buffer);
+	
+	/// Converts between the pdata and a packed buffer for the region
+	void PackPixels(const Region &region, void *dest) const;
+	void UnpackPixels(const Region &region, TransferFormat format, const void *src);
+	unsigned int PixelSize() const;
+	GLenum PixelType() const;
+	void DeleteBuffers();
 
 	vector<dVector> m_Points;
 	vector<dColour> *m_ColourData;
@@ -117,8 +160,28 @@ protected:
 
 	bool m_ReadyForUpload;
 	bool m_ReadyForDownload;
+	bool m_ReadyForAsyncDownload;
 	bool m_FBOSupported;
 	bool m_RendererActive;
+	bool m_PixelBuffersSupported;
+
+	Region m_UploadRegion;
+	Region m_DownloadRegion;
+	Region m_AsyncRegion;
+	TransferFormat m_TransferFormat;
+	/// Staging for byte transfers without pixel buffers
+	vector<unsigned char> m_Staging;
+
+	// pixel buffers, used in turn so we don't wait on the 
+	// one the card is still working with
+	unsigned int m_UploadBuffers[2];
+	unsigned int m_UploadIndex;
+	unsigned int m_DownloadBuffers[2];
+	Region m_DownloadBufferRegions[2];
+	TransferFormat m_DownloadBufferFormats[2];
+	bool m_DownloadPending[2];
+	unsigned int m_DownloadIndex;
+	bool m_DownloadReady;
 };
 
 };
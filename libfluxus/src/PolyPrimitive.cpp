@@ -15,6 +15,7 @@
 // Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
 
 #include <stdio.h>
+#include <algorithm>
 
 #include "OpenGL.h"
 
@@ -22,6 +23,7 @@
 #include "PolyPrimitive.h"
 #include "State.h"
 #include "TexturePainter.h"
+#include "SpatialHash.h"
 
 //#define RENDER_NORMALS
 //#define RENDER_BBOX
@@ -29,7 +31,9 @@
 using namespace Fluxus;
 
 PolyPrimitive::PolyPrimitive(Type t) :
+m_TopologySize(0),
 m_IndexMode(false),
+m_IndexDirty(true),
 m_Type(t)
 {
 	AddData("p",new TypedPData<dVector>);
@@ -43,8 +47,10 @@ m_Type(t)
 
 PolyPrimitive::PolyPrimitive(const PolyPrimitive &other) :
 Primitive(other),
+m_TopologySize(0),
 m_IndexMode(other.m_IndexMode),
 m_IndexData(other.m_IndexData),
+m_IndexDirty(true),
 m_Type(other.m_Type)
 {
 	PDataDirty();
@@ -62,9 +68,15 @@ PolyPrimitive *PolyPrimitive::Clone() const
 void PolyPrimitive::Clear()
 {
 	Resize(0);
+	TopologyDirty();
+}
+
+void PolyPrimitive::TopologyDirty()
+{
 	m_ConnectedVerts.clear();
 	m_GeometricNormals.clear();
 	m_UniqueEdges.clear();
+	m_FaceEdges.clear();
 }
 
 void PolyPrimitive::PDataDirty()
@@ -74,6 +86,13 @@ void PolyPrimitive::PDataDirty()
 	m_NormData=GetDataVec<dVector>("n");
 	m_ColData=GetDataVec<dColour>("c");
 	m_TexData=GetDataVec<dVector>("t");
+	
+	// arrays replaced with the same number of verts (pdata-copy 
+	// etc) keep their topology, as it's slow to make
+	if (m_VertData->size()!=m_TopologySize)
+	{
+		TopologyDirty();
+	}
 }
 
 void PolyPrimitive::AddVertex(const dVertex &Vert) 
@@ -82,10 +101,12 @@ void PolyPrimitive::AddVertex(const dVertex &Vert)
 	m_NormData->push_back(Vert.normal); 
 	m_ColData->push_back(Vert.col); 	
 	m_TexData->push_back(dVector(Vert.s, Vert.t, 0));
+	SetDataDirty("p");
+	SetDataDirty("n");
+	SetDataDirty("c");
+	SetDataDirty("t");
 	
-	m_ConnectedVerts.clear();
-	m_GeometricNormals.clear();
-	m_UniqueEdges.clear();
+	TopologyDirty();
 }
 
 void PolyPrimitive::Render()
@@ -133,9 +154,11 @@ void PolyPrimitive::Render()
 	}
 	if (m_State.Hints & HINT_UNLIT) glDisable(GL_LIGHTING);
 
-	glVertexPointer(3,GL_FLOAT,sizeof(dVector),(void*)m_VertData->begin()->arr());
-	glNormalPointer(GL_FLOAT,sizeof(dVector),(void*)m_NormData->begin()->arr());
-	glTexCoordPointer(3,GL_FLOAT,sizeof(dVector),(void*)m_TexData->begin()->arr());
+	bool vbo = (m_State.Hints & HINT_VBO) && VertexBuffer::IsSupported();
+
+	glVertexPointer(3,GL_FLOAT,sizeof(dVector),BindArray("p",vbo));
+	glNormalPointer(GL_FLOAT,sizeof(dVector),BindArray("n",vbo));
+	glTexCoordPointer(3,GL_FLOAT,sizeof(dVector),BindArray("t",vbo));
 
 	if (m_State.Hints & HINT_SPHERE_MAP)
 	{
@@ -155,17 +178,17 @@ void PolyPrimitive::Render()
 			{
 				char name[3];
 				snprintf(name,3,"t%d",n);
-				TypedPData<dVector> *tex = dynamic_cast<TypedPData<dVector>*>(GetDataRaw(name));
+				const TypedPData<dVector> *tex = dynamic_cast<const TypedPData<dVector>*>(GetDataRawConst(name));
 				glClientActiveTexture(GL_TEXTURE0+n);
 				glEnableClientState(GL_TEXTURE_COORD_ARRAY);
 
 				if (tex!=NULL)
 				{
-					glTexCoordPointer(3,GL_FLOAT,sizeof(dVector),(void*)tex->m_Data.begin()->arr());
+					glTexCoordPointer(3,GL_FLOAT,sizeof(dVector),BindArray(name,vbo));
 				}
 				else // default to using the normal vertex coordinates
 				{
-					glTexCoordPointer(3,GL_FLOAT,sizeof(dVector),(void*)m_TexData->begin()->arr());
+					glTexCoordPointer(3,GL_FLOAT,sizeof(dVector),BindArray("t",vbo));
 				}
 			}
 		}
@@ -176,16 +199,30 @@ void PolyPrimitive::Render()
 	if (m_State.Hints & HINT_VERTCOLS)
 	{
 		glEnableClientState(GL_COLOR_ARRAY);
-		glColorPointer(4,GL_FLOAT,sizeof(dVector),(void*)m_ColData->begin()->arr());
+		glColorPointer(4,GL_FLOAT,sizeof(dVector),BindArray("c",vbo));
 	}
 	else
 	{
 		glDisableClientState(GL_COLOR_ARRAY);
 	}
 
+	const void *index=NULL;
+	if (m_IndexMode)
+	{
+		if (vbo)
+		{
+			m_VertexBuffer.BindIndex(m_IndexData,m_IndexDirty);
+			m_IndexDirty=false;
+		}
+		else
+		{
+			index=&(m_IndexData[0]);
+		}
+	}
+
 	if (m_State.Hints & HINT_SOLID)
 	{
-		if (m_IndexMode) glDrawElements(type,m_IndexData.size(),GL_UNSIGNED_INT,&(m_IndexData[0]));
+		if (m_IndexMode) glDrawElements(type,m_IndexData.size(),GL_UNSIGNED_INT,index);
 		else glDrawArrays(type,0,m_VertData->size());
 	}
 
@@ -202,7 +239,7 @@ void PolyPrimitive::Render()
 		}
 
 		glDisable(GL_LIGHTING);
-		if (m_IndexMode) glDrawElements(type,m_IndexData.size(),GL_UNSIGNED_INT,&(m_IndexData[0]));
+		if (m_IndexMode) glDrawElements(type,m_IndexData.size(),GL_UNSIGNED_INT,index);
 		else glDrawArrays(type,0,m_VertData->size());
 		glPolygonMode(GL_FRONT_AND_BACK,GL_FILL);
 		glEnable(GL_LIGHTING);
@@ -219,13 +256,14 @@ void PolyPrimitive::Render()
 		glPolygonMode(GL_FRONT_AND_BACK,GL_POINT);
 		glColor4fv(m_State.WireColour.arr());
 		glDisable(GL_LIGHTING);
-		if (m_IndexMode) glDrawElements(type,m_IndexData.size(),GL_UNSIGNED_INT,&(m_IndexData[0]));
+		if (m_IndexMode) glDrawElements(type,m_IndexData.size(),GL_UNSIGNED_INT,index);
 		else glDrawArrays(type,0,m_VertData->size());
 		glPolygonMode(GL_FRONT_AND_BACK,GL_FILL);
 		glEnable(GL_LIGHTING);
 		glEnable(GL_TEXTURE_2D);
 	}
 
+	if (vbo) VertexBuffer::Unbind();
 
 	if (m_State.Hints & HINT_UNLIT) glEnable(GL_LIGHTING);
 	if (m_State.Hints & HINT_AALIAS) glDisable(GL_LINE_SMOOTH);
@@ -236,6 +274,14 @@ void PolyPrimitive::Render()
 	}
 }
 
+const void *PolyPrimitive::BindArray(const string &name, bool vbo)
+{
+	PData *data=m_PData[name];
+	if (!vbo) return data->RawData();
+	m_VertexBuffer.BindArray(name,data);
+	return NULL;
+}
+
 void PolyPrimitive::RecalculateNormals(bool smooth)
 {
 	GenerateTopology();
@@ -274,6 +320,7 @@ void PolyPrimitive::RecalculateNormals(bool smooth)
 				(*m_NormData)[i]=m_GeometricNormals[i];
 			}
 		}
+		SetDataDirty("n");
 		
 		if (smooth && !m_IndexMode)
 		{
@@ -349,6 +396,7 @@ void PolyPrimitive::ConvertToIndexed()
 	SetDataRaw("t", NewTex);
 		
 	m_IndexMode=true;
+	m_IndexDirty=true;
 }
 
 void PolyPrimitive::GenerateTopology()
@@ -366,49 +414,53 @@ void PolyPrimitive::GenerateTopology()
 
 void PolyPrimitive::CalculateConnected()
 { 
+	m_TopologySize=m_VertData->size();
+
+	// bin the vertices so we only need to compare close ones
+	SpatialHash hash;
+	hash.Build(*m_VertData);
 	
 	if (m_IndexMode)
 	{		
+		// find which index positions use each vertex
+		vector<vector<int> > users(m_VertData->size());
+		for (unsigned int i=0; i<m_IndexData.size(); i++)
+		{
+			users[m_IndexData[i]].push_back(i);
+		}
+		
+		// index positions are connected if they share an index value,
+		// or their vertex positions are coincident
+		vector<int> close;
+		m_ConnectedVerts.resize(m_IndexData.size());
 		for (unsigned int i=0; i<m_IndexData.size(); i++)
 		{
-			vector<int> connected;
-			for (unsigned int b=0; b<m_IndexData.size(); b++)
+			vector<int> &connected=m_ConnectedVerts[i];
+			connected.clear();
+			close.clear();
+			hash.Find((*m_VertData)[m_IndexData[i]],close);
+			for (vector<int>::iterator v=close.begin(); v!=close.end(); ++v)
 			{
-				// compare index value
-				if (i!=b && (m_IndexData[i]==m_IndexData[b] || 
-				   // compare positions
-				   ((*m_VertData)[m_IndexData[i]].feq((*m_VertData)[m_IndexData[b]]))))
+				for (vector<int>::iterator b=users[*v].begin(); b!=users[*v].end(); ++b)
 				{
-					connected.push_back(b);
+					if (*b!=(int)i) connected.push_back(*b);
 				}
 			}
-			
-			m_ConnectedVerts.push_back(connected);
+			sort(connected.begin(),connected.end());
 		}
 	}
 	else
 	{
 		// cache the connected verts 
-		for (unsigned int i=0; i<m_VertData->size(); i++)
-		{
-			vector<int> connected;
-			for (unsigned int b=0; b<m_VertData->size(); b++)
-			{
-				// find all close verts
-				if (i!=b && (*m_VertData)[i].feq((*m_VertData)[b]))
-				{
-					connected.push_back(b);
-				}
-			}	
-
-			m_ConnectedVerts.push_back(connected);
-		}
+		hash.Connected(m_ConnectedVerts);
 	}
 }
 
 
 void PolyPrimitive::CalculateGeometricNormals()
 {
+	m_TopologySize=m_VertData->size();
+
 	///\todo - need different approach for TRIFAN
 	// one face 
 	if (m_Type==POLYGON && m_VertData->size()>2) 
@@ -472,6 +524,15 @@ void PolyPrimitive::CalculateGeometricNormals()
 	}
 }
 
+// Whether a->b is one of the edges of a face, for face types 
+// where the verts come in groups of stride
+static inline bool IsFaceEdge(int a, int b, int stride)
+{
+	if (a/stride!=b/stride) return false;
+	if (a%stride==stride-1) return b==a-stride+1;
+	return b==a+1;
+}
+
 void PolyPrimitive::CalculateUniqueEdges()
 {
 	if (m_UniqueEdges.empty())
@@ -483,82 +544,109 @@ void PolyPrimitive::CalculateUniqueEdges()
 		if (m_Type==TRILIST) stride=3;
 		if (stride>0)
 		{		
-			set<pair<int,int> > firstpass;
+			if (m_ConnectedVerts.empty())
+			{
+				CalculateConnected();
+			}
 			
 			unsigned int vertcount=m_VertData->size();
 			if (m_IndexMode) vertcount=m_IndexData.size();
 			
-			// first, record all valid edges from the topology type
-			for (unsigned int i=0; i<vertcount; i+=stride)
-			{
-				for (int n=0; n<stride-1; n++)
-				{
-					firstpass.insert(pair<int,int>(n+i,n+i+1));
-				}
-				firstpass.insert(pair<int,int>(i+stride-1,i));
-			}
+			// every face edge starts at a different vert, so we can 
+			// record the edges we've stored by their first vert
+			vector<bool> stored(vertcount,false);
 
-			set<pair<int,int> > stored;
-			pair<int,int> key;
-
-			// now find all edges which share points and group them together
-			for (unsigned int i=0; i<vertcount; i+=stride)
+			// find all edges which share points and group them together
+			for (unsigned int i=0; i+stride<=vertcount; i+=stride)
 			{
 				for (int n=0; n<stride-1; n++)
 				{	
-					UniqueEdgesFindShared(pair<int,int>(n+i,n+i+1), firstpass, stored);
+					UniqueEdgesFindShared(pair<int,int>(n+i,n+i+1), stride, stored);
 				}	
-				UniqueEdgesFindShared(pair<int,int>(i+stride-1,i), firstpass, stored);	
+				UniqueEdgesFindShared(pair<int,int>(i+stride-1,i), stride, stored);	
 			}
 		}
 	}
 }
 
-void PolyPrimitive::UniqueEdgesFindShared(pair<int,int> edge, set<pair<int,int> > firstpass, set<pair<int,int> > &stored)
+int PolyPrimitive::GetFaceStride() const
 {
-	vector<pair<int,int> > edges;
-	
-	if (stored.find(edge)==stored.end() && stored.find(pair<int,int>(edge.second,edge.first))==stored.end())
+	if (m_Type==TRISTRIP) return 2;
+	if (m_Type==QUADS) return 4;
+	if (m_Type==TRILIST) return 3;
+	return 0;
+}
+
+const vector<PolyPrimitive::FaceEdge> &PolyPrimitive::GetFaceEdges()
+{
+	if (m_VertData->size()!=m_TopologySize)
 	{
-		// first, store the test edge
-		edges.push_back(edge);
-		stored.insert(edge);
-		
-		//Trace::Stream<<"edge:"<<edge.first<<" "<<edge.second<<endl;
-		
-		// make all combinations of verts connected to the edge verts
-		for (vector<int>::iterator a=m_ConnectedVerts[edge.first].begin();
-			a!=m_ConnectedVerts[edge.first].end(); a++)
+		TopologyDirty();
+	}
+
+	int stride=GetFaceStride();
+	if (m_FaceEdges.empty() && stride>0)
+	{
+		CalculateUniqueEdges();
+
+		for (vector<vector<pair<int,int> > >::iterator i=m_UniqueEdges.begin(); 
+			i!=m_UniqueEdges.end(); ++i)
 		{
-			for (vector<int>::iterator b=m_ConnectedVerts[edge.second].begin();
-					b!=m_ConnectedVerts[edge.second].end(); b++)
+			// edges on the border, or shared by more than two 
+			// faces can't tell us anything
+			if (i->size()!=2) continue;
+			
+			FaceEdge edge;
+			for (unsigned int n=0; n<2; n++)
 			{
-				//Trace::Stream<<*a<<" "<<*b<<endl;
-				pair<int, int> candidate(*a,*b);
-				if (firstpass.find(candidate)!=firstpass.end() && // if this is a real edge
-					stored.find(candidate)==stored.end() )        // and we've not stored it already
-				{
-					edges.push_back(candidate);
-					stored.insert(candidate);
-					//Trace::Stream<<"^ "<<candidate.first<<" "<<candidate.second<<endl;
-				}						
-
-				pair<int, int> rcandidate(*b,*a);
-				if (firstpass.find(rcandidate)!=firstpass.end() && // if this is a real edge
-					stored.find(rcandidate)==stored.end() )        // and we've not stored it already
-				{
-					edges.push_back(rcandidate);
-					stored.insert(rcandidate);
-					//Trace::Stream<<"^ "<<rcandidate.first<<" "<<rcandidate.second<<endl;
-				}						
+				const pair<int,int> &e=(*i)[n];
+				edge.Face[n]=e.first/stride;
+				edge.Start[n]=m_IndexMode?m_IndexData[e.first]:e.first;
+				edge.End[n]=m_IndexMode?m_IndexData[e.second]:e.second;
 			}
+			m_FaceEdges.push_back(edge);
 		}
+	}
+	return m_FaceEdges;
+}
 
-		if (!edges.empty())
+void PolyPrimitive::UniqueEdgesFindShared(const pair<int,int> &edge, int stride, vector<bool> &stored)
+{
+	if (stored[edge.first] || 
+		(IsFaceEdge(edge.second,edge.first,stride) && stored[edge.second]))
+	{
+		return;
+	}
+		
+	vector<pair<int,int> > edges;
+	
+	// first, store the test edge
+	edges.push_back(edge);
+	stored[edge.first]=true;
+		
+	// make all combinations of verts connected to the edge verts
+	for (vector<int>::iterator a=m_ConnectedVerts[edge.first].begin();
+		a!=m_ConnectedVerts[edge.first].end(); a++)
+	{
+		for (vector<int>::iterator b=m_ConnectedVerts[edge.second].begin();
+				b!=m_ConnectedVerts[edge.second].end(); b++)
 		{
-			m_UniqueEdges.push_back(edges);
+			// if this is a real edge, and we've not stored it already
+			if (IsFaceEdge(*a,*b,stride) && !stored[*a])
+			{
+				edges.push_back(pair<int,int>(*a,*b));
+				stored[*a]=true;
+			}						
+
+			if (IsFaceEdge(*b,*a,stride) && !stored[*b])
+			{
+				edges.push_back(pair<int,int>(*b,*a));
+				stored[*b]=true;
+			}						
 		}
 	}
+
+	m_UniqueEdges.push_back(edges);
 }
 
 dBoundingBox PolyPrimitive::GetBoundingBox(const dMatrix &space)
@@ -590,6 +678,8 @@ void PolyPrimitive::ApplyTransform(bool ScaleRotOnly)
 		}
 	}
 	
+	SetDataDirty("p");
+	SetDataDirty("n");
 	GetState()->Transform.init();
 }
 
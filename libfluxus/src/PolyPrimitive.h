@@ -17,10 +17,9 @@
 #ifndef N_POLYPRIM
 #define N_POLYPRIM
 
-#include <set>
-
 #include "Primitive.h"
 #include "PolyEvaluator.h"
+#include "VertexBuffer.h"
 
 namespace Fluxus
 {
@@ -81,6 +80,24 @@ public:
 	/// In indexed mode there is a geometric normal 
 	/// for every index
 	const vector<dVector> &GetGeometricNormals() { GenerateTopology(); return m_GeometricNormals; }
+	
+	/// An edge shared by exactly two faces, with the verts 
+	/// (looked up through the index) in each face's winding
+	class FaceEdge
+	{
+	public:
+		unsigned int Face[2];
+		unsigned int Start[2];
+		unsigned int End[2];
+	};
+
+	/// The edges silhouettes are made from, built from the unique 
+	/// edges and kept until the number of verts changes
+	const vector<FaceEdge> &GetFaceEdges();
+	
+	/// Verts per face for the face edges, or 0 if it's a type 
+	/// without them
+	int GetFaceStride() const;
 	///@}
 
 	//////////////////////////////////////////////////
@@ -88,7 +105,8 @@ public:
 	///@{
 	void SetIndexMode(bool s) { m_IndexMode=s; }
 	bool IsIndexed() const { return m_IndexMode; }
-	vector<unsigned int> &GetIndex() { return m_IndexData; }
+	/// Non const access marks the index as changed
+	vector<unsigned int> &GetIndex() { m_IndexDirty=true; return m_IndexData; }
 	const vector<unsigned int> &GetIndexConst() const { return m_IndexData; }
 	/// Look at coincident verts and compress the poly
 	/// primitive into an indexed form
@@ -105,15 +123,29 @@ protected:
 	void CalculateConnected();
 	void CalculateGeometricNormals();
 	void CalculateUniqueEdges();
-	void UniqueEdgesFindShared(pair<int,int> edge, set<pair<int,int> > firstpass, set<pair<int,int> > &stored);
+	void UniqueEdgesFindShared(const pair<int,int> &edge, int stride, vector<bool> &stored);
 	void RecalculateNormalsIndexed();
 	
+	/// Returns the pointer to use for gl*Pointer calls, either
+	/// the client side array, or an offset into its vertex buffer
+	const void *BindArray(const string &name, bool vbo);
+	
 	vector<vector<int> > m_ConnectedVerts;
 	vector<dVector> m_GeometricNormals;
 	vector<vector<pair<int,int> > > m_UniqueEdges;
+	vector<FaceEdge> m_FaceEdges;
+	/// The number of verts the topology was made for
+	unsigned int m_TopologySize;
+	
+	/// Clears all the topology
+	void TopologyDirty();
 	
 	bool m_IndexMode;
 	vector<unsigned int> m_IndexData;
+	bool m_IndexDirty;
+	
+	/// Copies of the pdata on the graphics card, for HINT_VBO
+	VertexBuffer m_VertexBuffer;
 	
 	Type m_Type;
 	vector<dVector> *m_VertData;
@@ -17,10 +17,35 @@
 #include "PrimitiveIO.h"
 #include "OBJPrimitiveIO.h"
 #include "PixelPrimitiveIO.h"
+#include "BinaryPrimitiveIO.h"
+#include "PolyPrimitive.h"
 
 using namespace Fluxus;
 	
-map<string, Primitive*> PrimitiveIO::m_GeometryCache;
+map<string, PrimitiveIO::CacheEntry> PrimitiveIO::m_GeometryCache;
+string PrimitiveIO::m_CacheDirectory;
+unsigned long PrimitiveIO::m_CacheBudget=0;
+unsigned long PrimitiveIO::m_CacheBytes=0;
+unsigned int PrimitiveIO::m_CacheReads=0;
+unsigned int PrimitiveIO::m_CacheHits=0;
+unsigned int PrimitiveIO::m_CacheMisses=0;
+unsigned int PrimitiveIO::m_CacheEvictions=0;
+
+static unsigned long PrimitiveBytes(const Primitive *prim)
+{
+	unsigned long bytes=0;
+	vector<string> names;
+	prim->GetDataNames(names);
+	for (vector<string>::iterator i=names.begin(); i!=names.end(); ++i)
+	{
+		const PData *pd=prim->GetDataRawConst(*i);
+		if (pd) bytes+=pd->Size()*pd->ElementSize();
+	}
+	
+	const PolyPrimitive *pp=dynamic_cast<const PolyPrimitive*>(prim);
+	if (pp) bytes+=pp->GetIndexConst().size()*sizeof(unsigned int);
+	return bytes;
+}
 
 PrimitiveIO::PrimitiveIO()
 {
@@ -28,28 +53,53 @@ PrimitiveIO::PrimitiveIO()
 
 PrimitiveIO::~PrimitiveIO()
 {	
-	ClearGeometryCache();
 }
 	
 Primitive *PrimitiveIO::Read(const string &filename, bool cache)
 {
 	// look in the cache, and copy it if it is there
-	map<string, Primitive*>::iterator i = m_GeometryCache.find(filename);
-	if (i!=m_GeometryCache.end()) return i->second->Clone();
+	map<string, CacheEntry>::iterator i = m_GeometryCache.find(filename);
+	if (i!=m_GeometryCache.end()) 
+	{
+		m_CacheHits++;
+		i->second.LastUsed=++m_CacheReads;
+		return i->second.Prim->Clone();
+	}
+	m_CacheMisses++;
 	
 	// otherwise, we need to load it...
 	string extension = filename.substr(filename.find_last_of('.')+1,filename.size());
 	PrimitiveIO *pio = GetFromExtension(extension);
+	if (pio==NULL) return NULL;
+	
 	Primitive *prim = NULL;
-	if (pio!=NULL)
+	string cachename;
+	if (pio->BinaryCacheable())
+	{
+		cachename = GetCacheFilename(filename);
+		prim = BinaryPrimitiveIO::ReadCache(cachename,filename);
+	}
+	
+	if (prim==NULL)
 	{
 		prim = pio->FormatRead(filename);
+		// failing to write the cache is fine, we'll parse it again next time
+		if (prim!=NULL && cachename!="") 
+		{
+			BinaryPrimitiveIO::WriteCache(cachename,filename,prim);
+		}
 	}
 	delete pio;
 	
 	if (prim==NULL) return NULL;
 	if (!cache) return prim;
-	m_GeometryCache[filename]=prim;
+	
+	CacheEntry &entry=m_GeometryCache[filename];
+	entry.Prim=prim;
+	entry.Bytes=PrimitiveBytes(prim);
+	entry.LastUsed=++m_CacheReads;
+	m_CacheBytes+=entry.Bytes;
+	if (m_CacheBudget>0 && m_CacheBytes>m_CacheBudget) EvictGeometry(filename);
 	return prim->Clone();
 }
 
@@ -71,24 +121,86 @@ PrimitiveIO *PrimitiveIO::GetFromExtension(const string &extension)
 {
 	if (extension=="obj") return new OBJPrimitiveIO;
 	else if (extension=="png") return new PixelPrimitiveIO;
+	else if (extension=="fxm") return new BinaryPrimitiveIO;
 	return NULL;
 }
 
+string PrimitiveIO::GetCacheFilename(const string &filename)
+{
+	if (m_CacheDirectory=="") return filename+".fxm";
+	
+	// in a shared directory, the hash of the full path 
+	// keeps files with the same name apart
+	unsigned int hash=2166136261u;
+	for (unsigned int i=0; i<filename.size(); i++)
+	{
+		hash=(hash^(unsigned char)filename[i])*16777619u;
+	}
+	
+	char hex[16];
+	sprintf(hex,"-%08x",hash);
+	string base = filename.substr(filename.find_last_of("/\\")+1);
+	return m_CacheDirectory+"/"+base+hex+".fxm";
+}
+
 void PrimitiveIO::ClearGeometryCache()
 {
-	for (map<string, Primitive*>::iterator i=m_GeometryCache.begin();
+	for (map<string, CacheEntry>::iterator i=m_GeometryCache.begin();
 		i!=m_GeometryCache.end(); ++i)
 	{
-		delete i->second;
+		delete i->second.Prim;
 	}
 	m_GeometryCache.clear();
+	m_CacheBytes=0;
+}
+
+void PrimitiveIO::SetCacheBudget(unsigned long bytes)
+{
+	m_CacheBudget=bytes;
+	if (m_CacheBudget>0 && m_CacheBytes>m_CacheBudget) EvictGeometry("");
+}
+
+void PrimitiveIO::EvictGeometry(const string &keep)
+{
+	// the cache is small, so just look for the oldest each time
+	while (m_CacheBytes>m_CacheBudget)
+	{
+		map<string, CacheEntry>::iterator oldest=m_GeometryCache.end();
+		for (map<string, CacheEntry>::iterator i=m_GeometryCache.begin();
+			i!=m_GeometryCache.end(); ++i)
+		{
+			if (i->first!=keep && (oldest==m_GeometryCache.end() || 
+				i->second.LastUsed<oldest->second.LastUsed))
+			{
+				oldest=i;
+			}
+		}
+		
+		if (oldest==m_GeometryCache.end()) return;
+		m_CacheBytes-=oldest->second.Bytes;
+		delete oldest->second.Prim;
+		m_GeometryCache.erase(oldest);
+		m_CacheEvictions++;
+	}
+}
+
+void PrimitiveIO::GetCacheStats(unsigned long &bytes, unsigned int &hits, unsigned int &misses, unsigned int &evictions)
+{
+	bytes=m_CacheBytes;
+	hits=m_CacheHits;
+	misses=m_CacheMisses;
+	evictions=m_CacheEvictions;
 }
 
 void PrimitiveIO::Dump()
 {
-	for (map<string, Primitive*>::iterator i=m_GeometryCache.begin();
+	for (map<string, CacheEntry>::iterator i=m_GeometryCache.begin();
 		i!=m_GeometryCache.end(); ++i)
 	{
-		Trace::Stream<<i->first<<endl;
+		Trace::Stream<<i->first<<" "<<i->second.Bytes<<" bytes"<<endl;
 	}
+	
+	Trace::Stream<<"cached: "<<m_CacheBytes<<" bytes";
+	if (m_CacheBudget>0) Trace::Stream<<" of "<<m_CacheBudget;
+	Trace::Stream<<", hits: "<<m_CacheHits<<" misses: "<<m_CacheMisses<<" evictions: "<<m_CacheEvictions<<endl;
 }
@@ -32,14 +32,52 @@ public:
 	virtual Primitive *FormatRead(const std::string &filename)=0;
 	virtual bool FormatWrite(const std::string &filename, const Primitive *ob)=0;
 	
+	/// Formats which are slow to parse return true, so they 
+	/// get cached on disk in the binary format
+	virtual bool BinaryCacheable() { return false; }
+	
+	/// Reads a primitive, from memory if it's been read before. Slow 
+	/// formats are read from a binary cache file if it's newer than 
+	/// the source, or it is written after they are parsed
 	static Primitive *Read(const std::string &filename, bool cache=true);
 	static bool Write(const std::string &filename, const Primitive *ob);
 	static void ClearGeometryCache();
 	static void Dump();
 	
+	/// Where binary cache files go, an empty string (the default) 
+	/// puts them next to the source files
+	static void SetCacheDirectory(const std::string &dir) { m_CacheDirectory=dir; }
+	
+	/// The memory budget in bytes for the geometry cache, 0 for no 
+	/// limit (the default). Least recently read primitives are 
+	/// removed to keep inside it, and get read from disk next time
+	static void SetCacheBudget(unsigned long bytes);
+	
+	/// Bytes of pdata in the geometry cache, reads which found it 
+	/// there (hits) and didn't (misses), and how many have been removed 
+	static void GetCacheStats(unsigned long &bytes, unsigned int &hits, unsigned int &misses, unsigned int &evictions);
+	
 private:
+	class CacheEntry
+	{
+	public:
+		CacheEntry() : Prim(NULL), Bytes(0), LastUsed(0) {}
+		Primitive *Prim;
+		unsigned long Bytes;
+		unsigned int LastUsed;
+	};
+
 	static PrimitiveIO *GetFromExtension(const std::string &extension);
-	static std::map<std::string, Primitive*> m_GeometryCache;
+	static std::string GetCacheFilename(const std::string &filename);
+	static void EvictGeometry(const std::string &keep);
+	static std::map<std::string, CacheEntry> m_GeometryCache;
+	static std::string m_CacheDirectory;
+	static unsigned long m_CacheBudget;
+	static unsigned long m_CacheBytes;
+	static unsigned int m_CacheReads;
+	static unsigned int m_CacheHits;
+	static unsigned int m_CacheMisses;
+	static unsigned int m_CacheEvictions;
 };
 
 }
@@ -25,6 +25,8 @@
 #include "GLSLShader.h"
 #include "Trace.h"
 #include "FFGLManager.h"
+#include "WorkerPool.h"
+#include "FrameDumper.h"
 #include <sys/time.h>
 #include <stdio.h>
 #include <unistd.h>
@@ -44,6 +46,9 @@ static timeval StartTime;
 static float FPS;
 
 static const int MAXLIGHTS = 8;
+// each one takes a stencil bit, and the lighting passes
+// double with each light added
+static const unsigned int MAX_SHADOW_MAP_LIGHTS = 4;
 
 Renderer::Renderer(bool main /* = false */) :
 m_Initialised(false),
@@ -61,6 +66,7 @@ m_FogDensity(0),
 m_FogStart(0),
 m_FogEnd(100),
 m_ShadowLight(0),
+m_ShadowMode(stencilShadows),
 m_StereoMode(noStereo),
 m_MaskRed(true),
 m_MaskGreen(true),
@@ -84,9 +90,11 @@ Renderer::~Renderer()
 {
 	if (m_MainRenderer)
 	{
+		FrameDumper::Shutdown();
 		TexturePainter::Shutdown();
 		SearchPaths::Shutdown();
 		FFGLManager::Shutdown();
+		WorkerPool::Shutdown();
 	}
 }
 
@@ -108,6 +116,15 @@ void Renderer::Clear()
 
 void Renderer::Render()
 {
+	// finish off any textures which have loaded in the background,
+	// and keep them inside the memory budget, then pass on any 
+	// frames that have been read back for saving
+	if (m_MainRenderer)
+	{
+		TexturePainter::Get()->Update();
+		FrameDumper::Get()->Update();
+	}
+
 	///\todo collapse all these clears into one call with the bitfield
 	if (m_ClearFrame && !m_MotionBlur)
 	{
@@ -134,7 +151,11 @@ void Renderer::Render()
 		// needs to be reinitialised for each one
 		if (m_CameraVec.size()>1) Reinitialise();
 
-		if (m_ShadowLight!=0)
+		if (m_ShadowMode==mapShadows && (m_ShadowLight!=0 || !m_ShadowMapLights.empty()))
+		{
+			RenderShadowMaps(cam);
+		}
+		else if (m_ShadowLight!=0)
 		{
 			RenderStencilShadows(cam);
 		}
@@ -188,6 +209,9 @@ void Renderer::RenderStencilShadows(unsigned int CamIndex)
 	glDisable(GL_LIGHT0+m_ShadowLight); 
 	m_World.Render(&m_ShadowVolumeGen,CamIndex);
 	m_ImmediateMode.Render(CamIndex,&m_ShadowVolumeGen);
+	// make the volume now, before the stencil state is set up, as 
+	// this is when the debug silhouettes are drawn
+	m_ShadowVolumeGen.GetVolume();
 
 	glClear(GL_STENCIL_BUFFER_BIT);
 	glEnable(GL_STENCIL_TEST);
@@ -236,6 +260,77 @@ void Renderer::RenderStencilShadows(unsigned int CamIndex)
 	PostRender();
 }
 
+void Renderer::RenderShadowMaps(unsigned int CamIndex)
+{
+	vector<unsigned int> lights;
+	if (m_ShadowMapLights.empty()) lights.push_back(m_ShadowLight);
+	for (vector<unsigned int>::iterator i=m_ShadowMapLights.begin(); 
+		i!=m_ShadowMapLights.end() && lights.size()<MAX_SHADOW_MAP_LIGHTS; ++i)
+	{
+		lights.push_back(*i);
+	}
+	
+	PreRender(CamIndex);
+	
+	// without shadow maps, just render the scene normally
+	vector<unsigned int> shadowlights;
+	if (m_ShadowMapper.Init())
+	{
+		for (vector<unsigned int>::iterator i=lights.begin(); i!=lights.end(); ++i)
+		{
+			if (*i<m_LightVec.size() && *i<(unsigned int)MAXLIGHTS) 
+			{
+				shadowlights.push_back(*i);
+				glDisable(GL_LIGHT0+*i);
+			}
+		}
+	}
+	
+	// first everything as if it was in the shadow of all the lights, 
+	// which fills in the depth buffer for the shadow maps
+	m_World.Render(NULL,CamIndex);
+	m_ImmediateMode.Render(CamIndex);
+
+	if (!shadowlights.empty())
+	{
+		m_ShadowMapper.CopyDepth();
+		glClear(GL_STENCIL_BUFFER_BIT);
+		for (unsigned int n=0; n<shadowlights.size(); n++)
+		{
+			m_ShadowMapper.Mark(m_World,m_ImmediateMode,m_LightVec[shadowlights[n]],CamIndex,1<<n);
+		}
+		
+		glColorMask(m_MaskRed,m_MaskGreen,m_MaskBlue,m_MaskAlpha);
+		glDepthMask(GL_FALSE);
+		glDepthFunc(GL_EQUAL);
+		glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
+		
+		// then once for each combination of lights, over the pixels 
+		// which are only shadowed by the ones that are left out
+		unsigned int all=(1<<shadowlights.size())-1;
+		for (unsigned int lit=1; lit<=all; lit++)
+		{
+			for (unsigned int n=0; n<shadowlights.size(); n++)
+			{
+				GLenum light=GL_LIGHT0+shadowlights[n];
+				if (lit&(1<<n)) glEnable(light);
+				else glDisable(light);
+			}
+			
+			glStencilFunc(GL_EQUAL, all&~lit, all);
+			m_World.Render(NULL,CamIndex);
+			m_ImmediateMode.Render(CamIndex);
+		}
+		
+		glDepthMask(GL_TRUE);
+		glDepthFunc(GL_LEQUAL);
+		glStencilFunc(GL_ALWAYS, 0, ~0);
+		glDisable(GL_STENCIL_TEST);
+	}
+	
+	PostRender();
+}
+
 void Renderer::PreRender(unsigned int CamIndex, bool PickMode)
 {
 	Camera &Cam = m_CameraVec[CamIndex];
@@ -731,4 +826,6 @@ void Renderer::PrintInfo()
 	m_World.Dump();	
 	Trace::Stream<<"NumRendered:"<<m_World.GetNumRendered()<<endl;
 	Trace::Stream<<"HighWater:"<<m_World.GetHighWater()<<endl;
+	Trace::Stream<<"NumVisited:"<<m_World.GetNumVisited()<<endl;
+	Trace::Stream<<"NumCulled:"<<m_World.GetNumCulled()<<endl;
 }
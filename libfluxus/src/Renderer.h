@@ -28,6 +28,7 @@
 #include "ImmediateMode.h"
 #include "Light.h"
 #include "TexturePainter.h"
+#include "ShadowMapper.h"
 
 // TODO: check this works for Apple's OpenGL
 #ifndef GL_POLYGON_OFFSET_EXT
@@ -123,6 +124,7 @@ public:
 	///@}
 
 	enum stereo_mode_t {noStereo, crystalEyes, colourStereo};
+	enum shadow_mode_t {stencilShadows, mapShadows};
 
 	////////////////////////////////////////////////////////////////////////
 	///@name Global state control
@@ -145,6 +147,13 @@ public:
 	void ShadowLight(unsigned int s)		 { m_ShadowLight=s; }
 	void DebugShadows(bool s)				 { m_ShadowVolumeGen.SetDebug(s); }
 	void ShadowLength(float s)				 { m_ShadowVolumeGen.SetLength(s); }
+	void SetShadowMode(shadow_mode_t s)      { m_ShadowMode=s; }
+	/// The lights to use in shadow map mode, if empty the shadow light is used
+	void ShadowMapLights(const vector<unsigned int> &s) { m_ShadowMapLights=s; }
+	void ShadowMapSize(unsigned int s)       { m_ShadowMapper.SetSize(s); }
+	void ShadowMapCascades(unsigned int s)   { m_ShadowMapper.SetCascades(s); }
+	void ShadowMapBias(float s)              { m_ShadowMapper.SetBias(s); }
+	void ShadowMapDistance(float s)          { m_ShadowMapper.SetDistance(s); }
 	double GetTime()                         { return m_Time; }
 	double GetDelta()                        { return m_Delta; }
 	bool SetStereoMode(stereo_mode_t mode);
@@ -167,6 +176,7 @@ private:
 	void PostRender();
 	void RenderLights(bool camera);
 	void RenderStencilShadows(unsigned int CamIndex);
+	void RenderShadowMaps(unsigned int CamIndex);
 
 	bool  m_MainRenderer;
 	bool  m_Initialised;
@@ -185,6 +195,8 @@ private:
 	float m_FogStart;
 	float m_FogEnd;
 	unsigned int m_ShadowLight;
+	shadow_mode_t m_ShadowMode;
+	vector<unsigned int> m_ShadowMapLights;
 
     deque<State> m_StateStack;
     SceneGraph m_World;
@@ -192,6 +204,7 @@ private:
 	vector<Camera> m_CameraVec;
 	ImmediateMode m_ImmediateMode;
 	ShadowVolumeGen m_ShadowVolumeGen;
+	ShadowMapper m_ShadowMapper;
 
 	// info for picking mode
 	struct SelectInfo
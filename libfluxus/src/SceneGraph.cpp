@@ -14,6 +14,7 @@
 // along with this program; if not, write to the Free Software
 // Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
 
+#include <string.h>
 #include "SceneGraph.h"
 #include "PolyPrimitive.h"
 #include "PixelPrimitive.h"
@@ -21,8 +22,12 @@
 using namespace Fluxus;
 
 SceneGraph::SceneGraph() :
+m_FlatDirty(true),
+m_BoundsDirty(true),
 m_NumRendered(0),
-m_HighWater(0)
+m_HighWater(0),
+m_NumVisited(0),
+m_NumCulled(0)
 {
 	// need to reset to having a root node present
 	Clear();
@@ -45,13 +50,88 @@ void SceneGraph::Render(ShadowVolumeGen *shadowgen, unsigned int camera, Mode re
 	unsigned int cameracode = 1<<camera;
 
 	m_NumRendered=0;
-
-	// render all the children of the root
-	for (vector<Node*>::iterator i=m_Root->Children.begin(); i!=m_Root->Children.end(); ++i)
+	m_NumVisited=0;
+	m_NumCulled=0;
+	
+	UpdateTransforms();
+	UpdateBounds();
+
+	// the flat array is in depth first order, so a scan through
+	// it is the same as walking the tree - skipping a subtree 
+	// means jumping to the end of it
+	unsigned int i=0;
+	while (i<m_Flat.size())
 	{
-		RenderWalk((SceneNode*)*i,0,cameracode,shadowgen,rendermode);
+		FlatNode &flat=m_Flat[i];
+		SceneNode *node=flat.Node;
+		m_NumVisited++;
+		
+		// start with the planes our parent's subtree wasn't 
+		// completely inside of
+		flat.PlaneMask=(flat.Parent==-1)?0x3f:m_Flat[flat.Parent].PlaneMask;
+		
+		if ((node->Prim->GetVisibility()&cameracode)==0 ||
+			(rendermode==SELECT && !node->Prim->IsSelectable()))
+		{
+			i=flat.End;
+			continue;
+		}
+
+		// if we are a lazy parent then we need to ignore
+		// the effects of the heirachical transform - we
+		// treat their transform as a world space one
+		dMatrix parent(m_TopTransform);
+		if (flat.Parent!=-1 && !flat.Lazy)
+		{
+			parent*=m_Flat[flat.Parent].World;
+		}
+		glLoadMatrixf(parent.arr());
+
+		node->Prim->ApplyState();
+		
+		bool visible=!(node->Prim->GetState()->Hints & HINT_FRUSTUM_CULL) ||
+			FrustumClip(flat.SubtreeAABB,flat.PlaneMask);
+		// depth maps only need the casters, but their children may still cast
+		bool draw=rendermode!=SHADOW || (node->Prim->GetState()->Hints & HINT_CAST_SHADOW);
+		if (visible && draw)
+		{
+			if (rendermode!=SHADOW && node->Prim->GetState()->Hints & HINT_DEPTH_SORT)
+			{
+				// render it later, and after depth sorting
+				m_DepthSorter.Add(parent,node->Prim,node->ID);
+			}
+			else
+			{
+				glPushName(node->ID);
+				node->Prim->Prerender();
+				node->Prim->Render();
+				glPopName();
+			}
+
+			m_NumRendered++;
+		}
+
+		node->Prim->UnapplyState();
+
+		if (shadowgen!=NULL && node->Prim->GetState()->Hints & HINT_CAST_SHADOW)
+		{
+			shadowgen->Generate(node->Prim);
+		}
+		
+		// culled nodes take their children with them
+		if (visible) 
+		{
+			i++;
+		}
+		else 
+		{
+			m_NumCulled+=flat.End-i;
+			i=flat.End;
+		}
 	}
 
+	glLoadMatrixf(m_TopTransform.arr());
+
 	// now render the depth sorted primitives:
 	m_DepthSorter.Render();
 	m_DepthSorter.Clear();
@@ -59,68 +139,93 @@ void SceneGraph::Render(ShadowVolumeGen *shadowgen, unsigned int camera, Mode re
 	if (m_NumRendered>m_HighWater) m_HighWater=m_NumRendered;
 }
 
-void SceneGraph::RenderWalk(SceneNode *node,  int depth, unsigned int cameracode, ShadowVolumeGen *shadowgen, Mode rendermode)
+int SceneGraph::AddNode(int ParentID, Node *node)
 {
-	// max gl matrix stack is 32
-	/*if (depth>=30)
-	{
-		Trace::Stream<<"SceneGraph::RenderWalk: max stack reached"<<endl;
-		return;
-	}*/
+	m_FlatDirty=true;
+	return Tree::AddNode(ParentID,node);
+}
 
-	if ((node->Prim->GetVisibility()&cameracode)==0) return;
-	if (rendermode==SELECT && !node->Prim->IsSelectable()) return;
+void SceneGraph::RemoveNode(Node *node)
+{
+	m_FlatDirty=true;
+	Tree::RemoveNode(node);
+}
+
+void SceneGraph::ReparentNode(int NodeID, int NewParentID)
+{
+	m_FlatDirty=true;
+	Tree::ReparentNode(NodeID,NewParentID);
+}
 
-	dMatrix parent;
-	// see if we need the parent (result of all the parents) transform
-	if (node->Prim->GetState()->Hints & HINT_DEPTH_SORT)
+void SceneGraph::BuildFlat()
+{
+	m_Flat.clear();
+	if (m_Root!=NULL)
 	{
-		glGetFloatv(GL_MODELVIEW_MATRIX,parent.arr());
+		for (vector<Node*>::iterator i=m_Root->Children.begin(); i!=m_Root->Children.end(); ++i)
+		{
+			BuildFlatWalk(static_cast<SceneNode*>(*i),-1);
+		}
 	}
+	m_FlatDirty=false;
+	m_BoundsDirty=true;
+}
 
-	glPushMatrix();
+void SceneGraph::BuildFlatWalk(SceneNode *node, int parent)
+{
+	int index=m_Flat.size();
+	node->FlatIndex=index;
+
+	FlatNode flat;
+	flat.Node=node;
+	flat.Parent=parent;
+	flat.Lazy=node->Prim->GetState()->Hints & HINT_LAZY_PARENT;
+	flat.Local=node->Prim->GetState()->Transform;
+	flat.World=flat.Local;
+	if (parent!=-1 && !flat.Lazy) flat.World=m_Flat[parent].World*flat.Local;
+	flat.Changed=true;
+	flat.PlaneMask=0x3f;
+	m_Flat.push_back(flat);
 
-	// if we are a lazy parent then we need to ignore
-	// the effects of the heirachical transform - we
-	// treat their transform as a world space one
-	if (node->Prim->GetState()->Hints & HINT_LAZY_PARENT)
+	for (vector<Node*>::iterator i=node->Children.begin(); i!=node->Children.end(); ++i)
 	{
-		glLoadMatrixf(m_TopTransform.arr());
+		BuildFlatWalk(static_cast<SceneNode*>(*i),index);
 	}
 
+	m_Flat[index].End=m_Flat.size();
+}
 
-	node->Prim->ApplyState();
+bool SceneGraph::FlatNodeCurrent(const FlatNode &flat) const
+{
+	const State *state=flat.Node->Prim->GetState();
+	return memcmp(flat.Local.m,state->Transform.m,sizeof(flat.Local.m))==0 &&
+		flat.Lazy==((state->Hints & HINT_LAZY_PARENT)!=0);
+}
 
-	if (!(node->Prim->GetState()->Hints & HINT_FRUSTUM_CULL) || FrustumClip(node))
+void SceneGraph::UpdateTransforms()
+{
+	if (m_FlatDirty)
 	{
-		if (node->Prim->GetState()->Hints & HINT_DEPTH_SORT)
-		{
-			// render it later, and after depth sorting
-			m_DepthSorter.Add(parent,node->Prim,node->ID);
-		}
-		else
-		{
-			glPushName(node->ID);
-			node->Prim->Prerender();
-			node->Prim->Render();
-			glPopName();
-		}
-
-		m_NumRendered++;
-		depth++;
-
-		for (vector<Node*>::iterator i=node->Children.begin(); i!=node->Children.end(); ++i)
-		{
-			RenderWalk((SceneNode*)*i,depth,cameracode,shadowgen,rendermode);
-		}
+		BuildFlat();
+		return;
 	}
 
-	node->Prim->UnapplyState();
-	glPopMatrix();
-
-	if (node->Prim->GetState()->Hints & HINT_CAST_SHADOW)
+	// parents always come before their children, so one pass 
+	// is enough to push changes down the tree
+	for (vector<FlatNode>::iterator i=m_Flat.begin(); i!=m_Flat.end(); ++i)
 	{
-		shadowgen->Generate(node->Prim);
+		bool parentchanged=i->Parent!=-1 && m_Flat[i->Parent].Changed;
+		i->Changed=false;
+		
+		if (!FlatNodeCurrent(*i) || parentchanged)
+		{
+			const State *state=i->Node->Prim->GetState();
+			i->Local=state->Transform;
+			i->Lazy=state->Hints & HINT_LAZY_PARENT;
+			if (i->Parent!=-1 && !i->Lazy) i->World=m_Flat[i->Parent].World*i->Local;
+			else i->World=i->Local;
+			i->Changed=true;
+		}
 	}
 }
 
@@ -172,19 +277,6 @@ void SceneGraph::GetFrustumPlanes(dPlane *planes, dMatrix m, bool normalise)
 }
 
 
-bool SceneGraph::FrustumClip(SceneNode *node)
-{
-	// do the frustum clip
-  	for (int n=0; n<6; n++)
-	{	
-		if (!Intersect(m_FrustumPlanes[n], node, 0))
-		{
-			return false;
-		}
-	}
-	return true;
-}
-
 void SceneGraph::CohenSutherland(const dVector &p, char &cs)
 {
 	char t=0;
@@ -216,39 +308,47 @@ void SceneGraph::Detach(SceneNode *node)
 		node->Parent->RemoveChild(node->ID);
 		m_Root->Children.push_back(node);
 		node->Parent=m_Root;
+		m_FlatDirty=true;
 	}
 }
 
 dMatrix SceneGraph::GetGlobalTransform(const SceneNode *node) const
 {
-	dMatrix Mat,Ret;
+	// use the cached transform if it, and all the ones it 
+	// depends on are still the same
+	if (!m_FlatDirty && node->FlatIndex>=0 && node->FlatIndex<(int)m_Flat.size() &&
+		m_Flat[node->FlatIndex].Node==node)
+	{
+		int current=node->FlatIndex;
+		bool valid=true;
+		while (current!=-1 && valid)
+		{
+			const FlatNode &flat=m_Flat[current];
+			valid=FlatNodeCurrent(flat);
+			current=flat.Lazy?-1:flat.Parent;
+		}
 
-	list<const SceneNode*> Path;
+		if (valid) return m_Flat[node->FlatIndex].World;
+	}
 
-	const SceneNode* current=node;
+	return CalculateGlobalTransform(node);
+}
 
-	// iterate back up the tree storing parents...
+dMatrix SceneGraph::CalculateGlobalTransform(const SceneNode *node) const
+{
+	// iterate back up the tree...
 	// lazy parent objects are treated as non-heirachical,
 	// so we can stop if we find one of them - and
 	// use it's transform as world space
-	bool foundlazy=false;
-	while(current!=NULL && !foundlazy)
-	{
-		if (current && current->Prim)
-		{
-			Path.push_front(current);
-			foundlazy = current->Prim->GetState()->Hints & HINT_LAZY_PARENT;
-		}
-		current=(const SceneNode*)current->Parent;
-	}
+	if (node==NULL || node->Prim==NULL) return dMatrix();
 
-	// concatenate the matrices together to get the global
-	for (list<const SceneNode*>::iterator i=Path.begin(); i!=Path.end(); ++i)
+	if (node->Parent==NULL || (node->Prim->GetState()->Hints & HINT_LAZY_PARENT))
 	{
-		Mat*=(*i)->Prim->GetState()->Transform;
+		return node->Prim->GetState()->Transform;
 	}
 
-	return Mat;
+	return CalculateGlobalTransform(static_cast<const SceneNode*>(node->Parent))*
+		node->Prim->GetState()->Transform;
 }
 
 void SceneGraph::GetBoundingBox(SceneNode *node, dBoundingBox &result)
@@ -308,6 +408,54 @@ void SceneGraph::Clear()
 void SceneGraph::RecalcAABB(SceneNode *node)
 {
 	node->m_GlobalAABB=node->Prim->GetBoundingBox(GetGlobalTransform(node));
+	m_BoundsDirty=true;
+}
+
+void SceneGraph::UpdateBounds()
+{
+	if (!m_BoundsDirty) return;
+
+	// children always come after their parents, so going 
+	// backwards we can expand parents by finished subtrees
+	for (unsigned int i=0; i<m_Flat.size(); i++)
+	{
+		m_Flat[i].SubtreeAABB=m_Flat[i].Node->m_GlobalAABB;
+	}
+
+	for (int i=m_Flat.size()-1; i>=0; i--)
+	{
+		const FlatNode &flat=m_Flat[i];
+		if (flat.Parent!=-1 && !flat.SubtreeAABB.empty())
+		{
+			m_Flat[flat.Parent].SubtreeAABB.expand(flat.SubtreeAABB);
+		}
+	}
+
+	m_BoundsDirty=false;
+}
+
+bool SceneGraph::FrustumClip(const dBoundingBox &box, unsigned char &mask)
+{
+	for (int n=0; n<6; n++)
+	{
+		if (mask & (1<<n))
+		{
+			const dPlane &plane=m_FrustumPlanes[n];
+			// the corners furthest along and against the plane normal
+			dVector pos(plane.a>0?box.max.x:box.min.x,
+			            plane.b>0?box.max.y:box.min.y,
+			            plane.c>0?box.max.z:box.min.z);
+			dVector neg(plane.a>0?box.min.x:box.max.x,
+			            plane.b>0?box.min.y:box.max.y,
+			            plane.c>0?box.min.z:box.max.z);
+
+			// completely outside
+			if (plane.pointdistance(pos)<=0) return false;
+			// completely inside, so children needn't check this plane
+			if (plane.pointdistance(neg)>0) mask&=~(1<<n);
+		}
+	}
+	return true;
 }
 
 bool SceneGraph::Intersect(const SceneNode *a, const SceneNode *b, float threshold)
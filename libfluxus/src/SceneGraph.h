@@ -36,10 +36,12 @@ namespace Fluxus
 class SceneNode : public Node
 {
 public:
-	SceneNode(Primitive *p) : Prim(p) {}
+	SceneNode(Primitive *p) : Prim(p), FlatIndex(-1) {}
 	virtual ~SceneNode() { if (Prim) delete Prim; }
 	Primitive *Prim;
 	dBoundingBox m_GlobalAABB;
+	/// Position in the scenegraph's flattened node array
+	int FlatIndex;
 };
 
 istream &operator>>(istream &s, SceneNode &o);
@@ -47,29 +49,55 @@ ostream &operator<<(ostream &s, SceneNode &o);
 
 /////////////////////////////////////
 /// A scene graph
+/// As well as the tree, the graph keeps a flat
+/// depth first ordered copy of the nodes with their
+/// world transforms cached. This is rebuilt when the
+/// tree changes shape, and a node's world transform 
+/// is only recalculated when its own or a parent's
+/// transform has changed. Rendering is then a linear 
+/// scan of this array.
+/// Each flat node also stores the bounds of its whole
+/// subtree, so frustum culled nodes which are outside
+/// the view take their children with them in one test.
+/// Planes which a parent's subtree is found to be
+/// completely inside are not tested again for children.
 class SceneGraph : public Tree
 {
 public:
 	SceneGraph();
 	~SceneGraph();
 
-	enum Mode{RENDER,SELECT};
+	enum Mode{RENDER,SELECT,SHADOW};
 
 	/// Traverses the graph depth first, rendering
-	/// all nodes
+	/// all nodes. SHADOW mode only draws the shadow 
+	/// casters, for rendering depth maps. The shadow 
+	/// volume generator can be NULL
 	void Render(ShadowVolumeGen *shadowgen, unsigned int camera, Mode rendermode=RENDER);
 
 	/// Clears the graph of all primitives
 	virtual void Clear();
 
+	///@name Tree overrides, to keep track of changes
+	///@{
+	virtual int AddNode(int ParentID, Node *node);
+	virtual void RemoveNode(Node *node);
+	virtual void ReparentNode(int NodeID, int NewParentID);
+	///@}
+
 	/// Parents the node to the root, and sets its
 	/// transform to keep it physically in the same
 	/// place in the world.
 	///\todo make the maintain transform optional
 	void Detach(SceneNode *node);
 
-	/// Gets the world space transfrom of the node
+	/// Gets the world space transfrom of the node, uses the
+	/// cached version if none of the transforms have changed
 	dMatrix GetGlobalTransform(const SceneNode *node) const;
+	
+	/// Brings the cached world transforms up to date, this 
+	/// is done automatically at the start of rendering
+	void UpdateTransforms();
 
 	/// Gets the bounding box of the node, and all
 	/// its children too
@@ -82,6 +110,8 @@ public:
 	void GetConnections(const Node *node,
 		vector<pair<const SceneNode*,const SceneNode*> > &connections) const;
 
+	/// Updates the node's world space bounding box (m_GlobalAABB)
+	/// for frustum culling and intersection tests
 	void RecalcAABB(SceneNode *node);
 
 	///Bounding box intersections, for higher accuracy, see the evaluators
@@ -93,11 +123,47 @@ public:
 	/// Some statistics
 	unsigned int GetNumRendered() { return m_NumRendered; }
 	unsigned int GetHighWater() { return m_HighWater; }
+	/// Nodes looked at in the last render, and frustum culled
+	/// nodes, including the ones culled along with their parent
+	unsigned int GetNumVisited() { return m_NumVisited; }
+	unsigned int GetNumCulled() { return m_NumCulled; }
 
 private:
-	void RenderWalk(SceneNode *node, int depth, unsigned int cameracode, ShadowVolumeGen *shadowgen, Mode rendermode);
+	/// A node in the flattened graph
+	class FlatNode
+	{
+	public:
+		SceneNode *Node;
+		/// Index of the parent, or -1 for children of the root
+		int Parent;
+		/// Index of the next node which is not in this subtree
+		unsigned int End;
+		/// The transform and lazy parent hint the world transform 
+		/// was calculated from, for spotting changes
+		dMatrix Local;
+		bool Lazy;
+		dMatrix World;
+		/// Whether the world transform changed in the last update
+		bool Changed;
+		/// The world space bounds of the node and all it's children
+		dBoundingBox SubtreeAABB;
+		/// Bitmask of frustum planes this subtree is not 
+		/// known to be completely inside, set while rendering
+		unsigned char PlaneMask;
+	};
+	
+	void BuildFlat();
+	void BuildFlatWalk(SceneNode *node, int parent);
+	bool FlatNodeCurrent(const FlatNode &flat) const;
+	void UpdateBounds();
+	bool FrustumClip(const dBoundingBox &box, unsigned char &mask);
+	dMatrix CalculateGlobalTransform(const SceneNode *node) const;
+	
+	vector<FlatNode> m_Flat;
+	bool m_FlatDirty;
+	bool m_BoundsDirty;
+	
 	void GetBoundingBox(SceneNode *node, dMatrix mat, dBoundingBox &result);
-	bool FrustumClip(SceneNode *node);
 	void CohenSutherland(const dVector &p, char &cs);
 	void GetFrustumPlanes(dPlane *planes, dMatrix m, bool normalise);
 
@@ -107,6 +173,8 @@ private:
 	
 	unsigned int m_NumRendered;
 	unsigned int m_HighWater;
+	unsigned int m_NumVisited;
+	unsigned int m_NumCulled;
 };
 
 }
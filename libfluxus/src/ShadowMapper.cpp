@@ -0,0 +1,488 @@
+// Copyright (C) 2005 Dave Griffiths
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+
+#include <math.h>
+#include "OpenGL.h"
+#include "ShadowMapper.h"
+#include "Trace.h"
+
+using namespace Fluxus;
+
+// how much the cascade splits follow a logarithmic rather
+// than an even spread over the view distance
+static const float SPLIT_LOG_WEIGHT = 0.75f;
+// the widest field of view used for point and spot lights
+static const float MAX_FOV = 150.0f;
+
+// looks up the scene depth under each pixel, works out where it
+// is from the light, and keeps the ones the depth map says are
+// shadowed so the stencil is set for them
+static const string VertexSource =
+"varying vec2 Coord;\n"
+"void main()\n"
+"{\n"
+"	Coord = gl_MultiTexCoord0.xy;\n"
+"	gl_Position = gl_Vertex;\n"
+"}\n";
+
+static const string FragmentSource =
+"uniform sampler2D SceneDepth;\n"
+"uniform sampler2DShadow DepthMap;\n"
+"uniform vec3 DepthScale;\n"
+"uniform float Near;\n"
+"uniform float Far;\n"
+"uniform float Bias;\n"
+"uniform vec4 InvProjection[4];\n"
+"uniform vec4 ShadowMatrix[4];\n"
+"varying vec2 Coord;\n"
+"void main()\n"
+"{\n"
+"	float depth = texture2D(SceneDepth, Coord*DepthScale.xy).r;\n"
+"	if (depth==1.0) discard;\n"
+"	vec4 view = mat4(InvProjection[0],InvProjection[1],InvProjection[2],InvProjection[3])*\n"
+"		vec4(Coord*2.0-1.0, depth*2.0-1.0, 1.0);\n"
+"	view /= view.w;\n"
+"	if (-view.z<Near || -view.z>=Far) discard;\n"
+"	vec4 light = mat4(ShadowMatrix[0],ShadowMatrix[1],ShadowMatrix[2],ShadowMatrix[3])*view;\n"
+"	if (light.w<=0.0) discard;\n"
+"	light.z -= Bias*light.w;\n"
+"	if (shadow2DProj(DepthMap, light).r>0.5) discard;\n"
+"	gl_FragColor = vec4(0.0);\n"
+"}\n";
+
+// the general inverse, as the camera projection isn't affine
+static dMatrix Invert(const dMatrix &m)
+{
+	const float *a=&m.m[0][0];
+	float inv[16];
+
+	inv[0]  =  a[5]*a[10]*a[15]-a[5]*a[11]*a[14]-a[9]*a[6]*a[15]+a[9]*a[7]*a[14]+a[13]*a[6]*a[11]-a[13]*a[7]*a[10];
+	inv[4]  = -a[4]*a[10]*a[15]+a[4]*a[11]*a[14]+a[8]*a[6]*a[15]-a[8]*a[7]*a[14]-a[12]*a[6]*a[11]+a[12]*a[7]*a[10];
+	inv[8]  =  a[4]*a[9]*a[15]-a[4]*a[11]*a[13]-a[8]*a[5]*a[15]+a[8]*a[7]*a[13]+a[12]*a[5]*a[11]-a[12]*a[7]*a[9];
+	inv[12] = -a[4]*a[9]*a[14]+a[4]*a[10]*a[13]+a[8]*a[5]*a[14]-a[8]*a[6]*a[13]-a[12]*a[5]*a[10]+a[12]*a[6]*a[9];
+	inv[1]  = -a[1]*a[10]*a[15]+a[1]*a[11]*a[14]+a[9]*a[2]*a[15]-a[9]*a[3]*a[14]-a[13]*a[2]*a[11]+a[13]*a[3]*a[10];
+	inv[5]  =  a[0]*a[10]*a[15]-a[0]*a[11]*a[14]-a[8]*a[2]*a[15]+a[8]*a[3]*a[14]+a[12]*a[2]*a[11]-a[12]*a[3]*a[10];
+	inv[9]  = -a[0]*a[9]*a[15]+a[0]*a[11]*a[13]+a[8]*a[1]*a[15]-a[8]*a[3]*a[13]-a[12]*a[1]*a[11]+a[12]*a[3]*a[9];
+	inv[13] =  a[0]*a[9]*a[14]-a[0]*a[10]*a[13]-a[8]*a[1]*a[14]+a[8]*a[2]*a[13]+a[12]*a[1]*a[10]-a[12]*a[2]*a[9];
+	inv[2]  =  a[1]*a[6]*a[15]-a[1]*a[7]*a[14]-a[5]*a[2]*a[15]+a[5]*a[3]*a[14]+a[13]*a[2]*a[7]-a[13]*a[3]*a[6];
+	inv[6]  = -a[0]*a[6]*a[15]+a[0]*a[7]*a[14]+a[4]*a[2]*a[15]-a[4]*a[3]*a[14]-a[12]*a[2]*a[7]+a[12]*a[3]*a[6];
+	inv[10] =  a[0]*a[5]*a[15]-a[0]*a[7]*a[13]-a[4]*a[1]*a[15]+a[4]*a[3]*a[13]+a[12]*a[1]*a[7]-a[12]*a[3]*a[5];
+	inv[14] = -a[0]*a[5]*a[14]+a[0]*a[6]*a[13]+a[4]*a[1]*a[14]-a[4]*a[2]*a[13]-a[12]*a[1]*a[6]+a[12]*a[2]*a[5];
+	inv[3]  = -a[1]*a[6]*a[11]+a[1]*a[7]*a[10]+a[5]*a[2]*a[11]-a[5]*a[3]*a[10]-a[9]*a[2]*a[7]+a[9]*a[3]*a[6];
+	inv[7]  =  a[0]*a[6]*a[11]-a[0]*a[7]*a[10]-a[4]*a[2]*a[11]+a[4]*a[3]*a[10]+a[8]*a[2]*a[7]-a[8]*a[3]*a[6];
+	inv[11] = -a[0]*a[5]*a[11]+a[0]*a[7]*a[9]+a[4]*a[1]*a[11]-a[4]*a[3]*a[9]-a[8]*a[1]*a[7]+a[8]*a[3]*a[5];
+	inv[15] =  a[0]*a[5]*a[10]-a[0]*a[6]*a[9]-a[4]*a[1]*a[10]+a[4]*a[2]*a[9]+a[8]*a[1]*a[6]-a[8]*a[2]*a[5];
+
+	float det=a[0]*inv[0]+a[1]*inv[4]+a[2]*inv[8]+a[3]*inv[12];
+	dMatrix ret;
+	if (det==0) return ret;
+	float *r=&ret.m[0][0];
+	for (int i=0; i<16; i++) r[i]=inv[i]/det;
+	return ret;
+}
+
+// the same as gluLookAt
+static dMatrix LookAt(const dVector &eye, const dVector &target)
+{
+	dVector f=target-eye;
+	f.normalise();
+	dVector up(0,1,0);
+	if (fabs(f.dot(up))>0.99f) up=dVector(1,0,0);
+	dVector s=f.cross(up);
+	s.normalise();
+	dVector u=s.cross(f);
+
+	return dMatrix( s.x, s.y, s.z,-s.dot(eye),
+	                u.x, u.y, u.z,-u.dot(eye),
+	               -f.x,-f.y,-f.z, f.dot(eye),
+	                  0,   0,   0, 1);
+}
+
+static dMatrix Ortho(float l, float r, float b, float t, float n, float f)
+{
+	return dMatrix(2/(r-l),      0,       0, -(r+l)/(r-l),
+	                     0, 2/(t-b),      0, -(t+b)/(t-b),
+	                     0,       0, -2/(f-n), -(f+n)/(f-n),
+	                     0,       0,       0, 1);
+}
+
+static dMatrix Perspective(float fovy, float n, float f)
+{
+	float c=1/tan(fovy*0.5f*M_PI/180.0f);
+	return dMatrix(c, 0,            0,              0,
+	               0, c,            0,              0,
+	               0, 0, -(f+n)/(f-n), -2*f*n/(f-n),
+	               0, 0,           -1,              0);
+}
+
+static void MatrixToColours(const dMatrix &m, vector<dColour> &out)
+{
+	out.clear();
+	for (int c=0; c<4; c++)
+	{
+		out.push_back(dColour(m.m[c][0],m.m[c][1],m.m[c][2],m.m[c][3]));
+	}
+}
+
+ShadowMapper::ShadowMapper() :
+m_Initialised(false),
+m_Supported(false),
+m_Size(1024),
+m_NumCascades(3),
+m_Bias(0.002f),
+m_Distance(100),
+m_FBO(0),
+m_DepthMap(0),
+m_SceneDepth(0),
+m_SceneDepthWidth(0),
+m_SceneDepthHeight(0),
+m_Shader(NULL)
+{
+	for (int i=0; i<4; i++) m_Viewport[i]=0;
+}
+
+ShadowMapper::~ShadowMapper()
+{
+	FreeTextures();
+	if (m_FBO!=0) glDeleteFramebuffersEXT(1,(GLuint*)&m_FBO);
+	if (m_Shader!=NULL) delete m_Shader;
+}
+
+void ShadowMapper::SetSize(unsigned int s)
+{
+	if (s==0 || s==m_Size) return;
+	m_Size=s;
+	// remade at the new size on the next Init()
+	FreeTextures();
+}
+
+void ShadowMapper::SetCascades(unsigned int s)
+{
+	if (s<1) s=1;
+	if (s>MAX_CASCADES) s=MAX_CASCADES;
+	m_NumCascades=s;
+}
+
+void ShadowMapper::FreeTextures()
+{
+	if (m_DepthMap!=0) glDeleteTextures(1,(GLuint*)&m_DepthMap);
+	if (m_SceneDepth!=0) glDeleteTextures(1,(GLuint*)&m_SceneDepth);
+	m_DepthMap=0;
+	m_SceneDepth=0;
+	m_SceneDepthWidth=0;
+	m_SceneDepthHeight=0;
+}
+
+bool ShadowMapper::Init()
+{
+	if (!m_Initialised)
+	{
+		m_Initialised=true;
+		#ifdef GLSL
+		m_Supported=GLSLShader::m_Enabled &&
+			glewIsSupported("GL_EXT_framebuffer_object") &&
+			glewIsSupported("GL_ARB_depth_texture") &&
+			glewIsSupported("GL_ARB_shadow");
+		#endif
+
+		if (!m_Supported)
+		{
+			Trace::Stream<<"Warning: Can't do shadow maps (needs glsl, frame buffer objects and depth textures)"<<endl;
+			return false;
+		}
+
+		GLSLShaderPair pair(false,VertexSource,FragmentSource);
+		m_Shader=new GLSLShader(pair);
+		if (!m_Shader->IsValid())
+		{
+			Trace::Stream<<"Warning: Shadow map shader didn't build"<<endl;
+			m_Supported=false;
+			return false;
+		}
+		m_Shader->SetInt("SceneDepth",0);
+		m_Shader->SetInt("DepthMap",1);
+
+		glGenFramebuffersEXT(1,(GLuint*)&m_FBO);
+	}
+
+	if (!m_Supported) return false;
+
+	if (m_DepthMap==0)
+	{
+		glGenTextures(1,(GLuint*)&m_DepthMap);
+		glBindTexture(GL_TEXTURE_2D,m_DepthMap);
+		glTexImage2D(GL_TEXTURE_2D,0,GL_DEPTH_COMPONENT24,m_Size,m_Size,0,GL_DEPTH_COMPONENT,GL_UNSIGNED_INT,NULL);
+		// linear filtering gets the card to blend the four nearest comparisons
+		glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_LINEAR);
+		// outside of the map is never shadowed
+		float border[4]={1,1,1,1};
+		glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_S,GL_CLAMP_TO_BORDER);
+		glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_T,GL_CLAMP_TO_BORDER);
+		glTexParameterfv(GL_TEXTURE_2D,GL_TEXTURE_BORDER_COLOR,border);
+		glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_COMPARE_MODE,GL_COMPARE_R_TO_TEXTURE);
+		glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_COMPARE_FUNC,GL_LEQUAL);
+		glBindTexture(GL_TEXTURE_2D,0);
+
+		glBindFramebufferEXT(GL_FRAMEBUFFER_EXT,m_FBO);
+		glFramebufferTexture2DEXT(GL_FRAMEBUFFER_EXT,GL_DEPTH_ATTACHMENT_EXT,GL_TEXTURE_2D,m_DepthMap,0);
+		glDrawBuffer(GL_NONE);
+		glReadBuffer(GL_NONE);
+		GLenum status=glCheckFramebufferStatusEXT(GL_FRAMEBUFFER_EXT);
+		glBindFramebufferEXT(GL_FRAMEBUFFER_EXT,0);
+
+		if (status!=GL_FRAMEBUFFER_COMPLETE_EXT)
+		{
+			Trace::Stream<<"Warning: Shadow map frame buffer incomplete ("<<status<<")"<<endl;
+			FreeTextures();
+			m_Supported=false;
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void ShadowMapper::CopyDepth()
+{
+	glGetFloatv(GL_MODELVIEW_MATRIX,m_CameraView.arr());
+	glGetFloatv(GL_PROJECTION_MATRIX,m_CameraProjection.arr());
+	glGetIntegerv(GL_VIEWPORT,m_Viewport);
+	m_InvCameraView=Invert(m_CameraView);
+	m_InvCameraProjection=Invert(m_CameraProjection);
+
+	// power of two sizes, like the pixel primitive
+	unsigned int w=1, h=1;
+	while (w<(unsigned int)m_Viewport[2]) w<<=1;
+	while (h<(unsigned int)m_Viewport[3]) h<<=1;
+
+	if (m_SceneDepth==0 || w!=m_SceneDepthWidth || h!=m_SceneDepthHeight)
+	{
+		if (m_SceneDepth==0) glGenTextures(1,(GLuint*)&m_SceneDepth);
+		glBindTexture(GL_TEXTURE_2D,m_SceneDepth);
+		glTexImage2D(GL_TEXTURE_2D,0,GL_DEPTH_COMPONENT,w,h,0,GL_DEPTH_COMPONENT,GL_UNSIGNED_INT,NULL);
+		glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_COMPARE_MODE,GL_NONE);
+		m_SceneDepthWidth=w;
+		m_SceneDepthHeight=h;
+	}
+	else
+	{
+		glBindTexture(GL_TEXTURE_2D,m_SceneDepth);
+	}
+
+	glCopyTexSubImage2D(GL_TEXTURE_2D,0,0,0,m_Viewport[0],m_Viewport[1],m_Viewport[2],m_Viewport[3]);
+	glBindTexture(GL_TEXTURE_2D,0);
+
+	m_Shader->SetVector("DepthScale",dVector(m_Viewport[2]/(float)w,m_Viewport[3]/(float)h,0));
+	vector<dColour> columns;
+	MatrixToColours(m_InvCameraProjection,columns);
+	m_Shader->SetColourArray("InvProjection",columns);
+	m_Shader->SetFloat("Bias",m_Bias);
+}
+
+void ShadowMapper::Mark(SceneGraph &world, ImmediateMode &immediate, Light *light, unsigned int camera, unsigned int bit)
+{
+	vector<Cascade> cascades;
+	MakeCascades(light,cascades);
+
+	for (vector<Cascade>::iterator i=cascades.begin(); i!=cascades.end(); ++i)
+	{
+		RenderDepth(world,immediate,*i,camera);
+		MarkCascade(*i,bit);
+	}
+
+	// put the camera back
+	glViewport(m_Viewport[0],m_Viewport[1],m_Viewport[2],m_Viewport[3]);
+	glMatrixMode(GL_PROJECTION);
+	glLoadMatrixf(m_CameraProjection.arr());
+	glMatrixMode(GL_MODELVIEW);
+	glLoadMatrixf(m_CameraView.arr());
+}
+
+void ShadowMapper::MakeCascades(Light *light, vector<Cascade> &cascades)
+{
+	// the corners of the view, near and far, in camera space
+	dVector nearcorner[4], farcorner[4];
+	static const float cx[4]={-1,1,1,-1};
+	static const float cy[4]={-1,-1,1,1};
+	for (int c=0; c<4; c++)
+	{
+		nearcorner[c]=m_InvCameraProjection.transform_persp(dVector(cx[c],cy[c],-1));
+		farcorner[c]=m_InvCameraProjection.transform_persp(dVector(cx[c],cy[c],1));
+	}
+	float camnear=-nearcorner[0].z;
+	float camfar=-farcorner[0].z;
+	float viewfar=min(camfar,camnear+m_Distance);
+	if (viewfar<=camnear) return;
+
+	dVector position=light->GetPosition();
+	dVector direction=light->GetDirection();
+	if (light->GetCameraLock())
+	{
+		position=m_InvCameraView.transform(position);
+		direction=m_InvCameraView.transform_no_trans(direction);
+	}
+
+	// directional and spot lights need a direction to point the map along
+	if (light->GetType()!=Light::POINT && direction.mag()==0) return;
+
+	unsigned int count=1;
+	if (light->GetType()==Light::DIRECTIONAL) count=m_NumCascades;
+
+	for (unsigned int n=0; n<count; n++)
+	{
+		Cascade cascade;
+		cascade.Near=camnear;
+		cascade.Far=viewfar;
+		if (count>1)
+		{
+			float s=n/(float)count, e=(n+1)/(float)count;
+			if (n>0) cascade.Near=SPLIT_LOG_WEIGHT*camnear*pow(viewfar/camnear,s)+
+				(1-SPLIT_LOG_WEIGHT)*(camnear+(viewfar-camnear)*s);
+			if (n<count-1) cascade.Far=SPLIT_LOG_WEIGHT*camnear*pow(viewfar/camnear,e)+
+				(1-SPLIT_LOG_WEIGHT)*(camnear+(viewfar-camnear)*e);
+		}
+
+		// the bounding sphere of this part of the view, in world space
+		dVector corners[8];
+		dVector centre(0,0,0);
+		for (int c=0; c<4; c++)
+		{
+			float depth=-farcorner[c].z+nearcorner[c].z;
+			float t0=(cascade.Near+nearcorner[c].z)/depth;
+			float t1=(cascade.Far+nearcorner[c].z)/depth;
+			corners[c]=m_InvCameraView.transform(nearcorner[c]+(farcorner[c]-nearcorner[c])*t0);
+			corners[c+4]=m_InvCameraView.transform(nearcorner[c]+(farcorner[c]-nearcorner[c])*t1);
+			centre+=corners[c]+corners[c+4];
+		}
+		centre/=8.0f;
+		float radius=0;
+		for (int c=0; c<8; c++)
+		{
+			radius=max(radius,(corners[c]-centre).mag());
+		}
+
+		if (light->GetType()==Light::DIRECTIONAL)
+		{
+			// the light's direction is towards the light, like gl, and the
+			// view is from the origin so the map only moves in whole texels
+			// as the camera moves, which stops the edges crawling
+			cascade.View=LookAt(dVector(0,0,0),-direction);
+			dVector c=cascade.View.transform(centre);
+			float texel=2*radius/m_Size;
+			c.x=floor(c.x/texel)*texel;
+			c.y=floor(c.y/texel)*texel;
+			// anything up to the shadow distance towards the light can cast into it
+			cascade.Projection=Ortho(c.x-radius,c.x+radius,c.y-radius,c.y+radius,
+				-c.z-radius-m_Distance,-c.z+radius);
+		}
+		else
+		{
+			float fov=MAX_FOV;
+			float spot=light->GetSpotAngle();
+			dVector target=centre;
+			float distance=(centre-position).mag();
+			if (light->GetType()==Light::SPOT && spot<MAX_FOV*0.5f)
+			{
+				target=position+direction;
+				fov=spot*2;
+			}
+			else if (distance>radius)
+			{
+				fov=min(MAX_FOV,2*asin(radius/distance)*180.0f/(float)M_PI);
+			}
+			cascade.View=LookAt(position,target);
+			float range=distance+radius;
+			cascade.Projection=Perspective(fov,max(range*0.001f,0.01f),range);
+		}
+
+		cascades.push_back(cascade);
+	}
+}
+
+void ShadowMapper::RenderDepth(SceneGraph &world, ImmediateMode &immediate, const Cascade &cascade, unsigned int camera)
+{
+	glBindFramebufferEXT(GL_FRAMEBUFFER_EXT,m_FBO);
+	glViewport(0,0,m_Size,m_Size);
+	glDepthMask(GL_TRUE);
+	glClear(GL_DEPTH_BUFFER_BIT);
+	glColorMask(GL_FALSE,GL_FALSE,GL_FALSE,GL_FALSE);
+	glEnable(GL_DEPTH_TEST);
+	glDepthFunc(GL_LESS);
+
+	glMatrixMode(GL_PROJECTION);
+	glLoadMatrixf(&cascade.Projection.m[0][0]);
+	glMatrixMode(GL_MODELVIEW);
+	glLoadMatrixf(&cascade.View.m[0][0]);
+
+	world.Render(NULL,camera,SceneGraph::SHADOW);
+	immediate.RenderCasters(camera);
+
+	glBindFramebufferEXT(GL_FRAMEBUFFER_EXT,0);
+	glDepthFunc(GL_LEQUAL);
+}
+
+void ShadowMapper::MarkCascade(const Cascade &cascade, unsigned int bit)
+{
+	// bias the light's clip space into texture coordinates
+	dMatrix bias(0.5f,0,0,0.5f,
+	             0,0.5f,0,0.5f,
+	             0,0,0.5f,0.5f,
+	             0,0,0,1);
+	vector<dColour> columns;
+	MatrixToColours(bias*cascade.Projection*cascade.View*m_InvCameraView,columns);
+	m_Shader->SetColourArray("ShadowMatrix",columns);
+	m_Shader->SetFloat("Near",cascade.Near);
+	m_Shader->SetFloat("Far",cascade.Far);
+	m_Shader->Apply();
+
+	glViewport(m_Viewport[0],m_Viewport[1],m_Viewport[2],m_Viewport[3]);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D,m_SceneDepth);
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_2D,m_DepthMap);
+
+	glDisable(GL_DEPTH_TEST);
+	glDepthMask(GL_FALSE);
+	glDisable(GL_CULL_FACE);
+	glEnable(GL_STENCIL_TEST);
+	glStencilFunc(GL_ALWAYS,bit,~0);
+	glStencilOp(GL_KEEP,GL_KEEP,GL_REPLACE);
+	glStencilMask(bit);
+
+	glMatrixMode(GL_PROJECTION);
+	glLoadIdentity();
+	glMatrixMode(GL_MODELVIEW);
+	glLoadIdentity();
+	glBegin(GL_QUADS);
+		glTexCoord2f(0,0); glVertex3f(-1,-1,0);
+		glTexCoord2f(1,0); glVertex3f(1,-1,0);
+		glTexCoord2f(1,1); glVertex3f(1,1,0);
+		glTexCoord2f(0,1); glVertex3f(-1,1,0);
+	glEnd();
+
+	glBindTexture(GL_TEXTURE_2D,0);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D,0);
+	GLSLShader::Unapply();
+
+	glStencilMask(~0);
+	glEnable(GL_DEPTH_TEST);
+	glDepthMask(GL_TRUE);
+	glEnable(GL_CULL_FACE);
+}
@@ -0,0 +1,115 @@
+// Copyright (C) 2005 Dave Griffiths
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+
+// Renders depth maps from the lights into a frame buffer object,
+// and marks the pixels they show to be in shadow in the stencil
+// buffer, so the renderer can leave them out of the light's pass.
+
+// The casters are drawn on the card each frame, so unlike the shadow
+// volumes nothing is done on the cpu for each triangle.
+
+#ifndef N_SHADOWMAPPER
+#define N_SHADOWMAPPER
+
+#include "dada.h"
+#include "Light.h"
+#include "SceneGraph.h"
+#include "ImmediateMode.h"
+#include "GLSLShader.h"
+
+namespace Fluxus
+{
+
+/////////////////////////////////////
+/// Shadow maps for the renderer. For each
+/// light the camera's view is split into
+/// depth ranges (more than one only for
+/// directional lights), a depth map is
+/// rendered for each from the light, and a
+/// screen sized pass compares the scene's
+/// depth against it, setting the stencil
+/// buffer where it's shadowed.
+class ShadowMapper
+{
+public:
+	ShadowMapper();
+	~ShadowMapper();
+
+	static const unsigned int MAX_CASCADES = 4;
+
+	/// The width and height of the depth maps
+	void SetSize(unsigned int s);
+	/// How many depth maps directional lights are split into
+	void SetCascades(unsigned int s);
+	/// Offset for the depth comparison, in the depth map's 0-1 range
+	void SetBias(float s)               { m_Bias=s; }
+	/// How far from the camera shadows are drawn
+	void SetDistance(float s)           { m_Distance=s; }
+
+	/// Checks for the extensions and makes the frame buffer,
+	/// returns false if shadow maps can't be done on this card
+	bool Init();
+
+	/// Copies the scene's depth buffer for the current viewport, and
+	/// reads the camera's matrices, needs to be called after the scene 
+	/// has been drawn and before Mark()
+	void CopyDepth();
+
+	/// Sets the stencil bit where the light is shadowed by primitives
+	/// (retained and immediate mode) with the cast shadow hint, leaving 
+	/// the other bits alone. The camera's matrices are put back afterwards
+	void Mark(SceneGraph &world, ImmediateMode &immediate, Light *light, unsigned int camera, unsigned int bit);
+
+private:
+	/// A part of the camera's view and the light's matrices for it
+	class Cascade
+	{
+	public:
+		float Near,Far;
+		dMatrix View;
+		dMatrix Projection;
+	};
+
+	void MakeCascades(Light *light, vector<Cascade> &cascades);
+	void RenderDepth(SceneGraph &world, ImmediateMode &immediate, const Cascade &cascade, unsigned int camera);
+	void MarkCascade(const Cascade &cascade, unsigned int bit);
+	void FreeTextures();
+
+	bool m_Initialised;
+	bool m_Supported;
+	unsigned int m_Size;
+	unsigned int m_NumCascades;
+	float m_Bias;
+	float m_Distance;
+
+	unsigned int m_FBO;
+	unsigned int m_DepthMap;
+	unsigned int m_SceneDepth;
+	unsigned int m_SceneDepthWidth;
+	unsigned int m_SceneDepthHeight;
+	GLSLShader *m_Shader;
+
+	/// The camera's matrices and viewport, read at the start of Mark()
+	dMatrix m_CameraView;
+	dMatrix m_CameraProjection;
+	dMatrix m_InvCameraView;
+	dMatrix m_InvCameraProjection;
+	int m_Viewport[4];
+};
+
+};
+
+#endif
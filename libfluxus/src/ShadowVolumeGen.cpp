@@ -17,9 +17,15 @@
 #include <algorithm>
 #include "ShadowVolumeGen.h"
 
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
 using namespace Fluxus;
 
 ShadowVolumeGen::ShadowVolumeGen() :
+m_NumCasters(0),
+m_Built(false),
 m_ShadowVolume(PolyPrimitive::QUADS),
 m_LightPosition(5,5,0),
 m_Length(10),
@@ -33,10 +39,22 @@ ShadowVolumeGen::~ShadowVolumeGen()
 
 void ShadowVolumeGen::Generate(Primitive *prim)
 {	
+	// the volume has already been made this frame
+	if (m_Built) return;
+
 	PolyPrimitive *poly = dynamic_cast<PolyPrimitive*>(prim);
 	if (poly)
 	{
-		PolyGen(poly);
+		if (poly->GetFaceStride()==0) return;
+		
+		// just remember it for now, the work is done in GetVolume()
+		if (m_NumCasters==m_Casters.size()) m_Casters.push_back(Caster());
+		Caster &caster=m_Casters[m_NumCasters++];
+		caster.Prim=poly;
+		// the topology isn't thread safe, so it's made here if needed
+		caster.Edges=&poly->GetFaceEdges();
+		caster.Transform=poly->GetState()->Transform;
+		caster.Light=caster.Transform.inverse().transform(m_LightPosition);
 	}
 	else
 	{		
@@ -51,155 +69,187 @@ void ShadowVolumeGen::Generate(Primitive *prim)
 void ShadowVolumeGen::Clear()
 { 
 	m_ShadowVolume.Clear();
-	
+	m_NumCasters=0;
+	m_Built=false;
 }
 
 PolyPrimitive *ShadowVolumeGen::GetVolume() 
 { 
+	Build();
 	return &m_ShadowVolume; 
 }
 
-void ShadowVolumeGen::PolyGen(PolyPrimitive *src)
+void ShadowVolumeGen::Build()
+{
+	if (m_Built) return;
+	m_Built=true;
+	if (m_NumCasters==0) return;
+
+	SilhouetteJob silhouettes(*this);
+	WorkerPool::Get()->Run(silhouettes,m_NumCasters,1);
+
+	// now we know how big each part is, make room for them all
+	unsigned int quads=0;
+	for (unsigned int i=0; i<m_NumCasters; i++)
+	{
+		m_Casters[i].Offset=quads;
+		quads+=m_Casters[i].Silhouette.size();
+	}
+
+	unsigned int start=m_ShadowVolume.Size();
+	m_ShadowVolume.Resize(start+quads*4);
+	m_ShadowVolume.SetDataDirty("p");
+	TypedPData<dVector> *points = dynamic_cast<TypedPData<dVector>*>(m_ShadowVolume.GetDataRaw("p"));
+	if (quads>0 && points!=NULL)
+	{
+		ExtrudeJob extrude(*this,&points->m_Data[start]);
+		WorkerPool::Get()->Run(extrude,m_NumCasters,1);
+	}
+
+	if (m_Debug) DrawSilhouettes(start);
+}
+
+void ShadowVolumeGen::SilhouetteJob::Run(unsigned int start, unsigned int end)
+{
+	for (unsigned int i=start; i<end; i++)
+	{
+		m_Gen.FindSilhouette(m_Gen.m_Casters[i]);
+	}
+}
+
+void ShadowVolumeGen::ExtrudeJob::Run(unsigned int start, unsigned int end)
+{
+	for (unsigned int i=start; i<end; i++)
+	{
+		const Caster &caster=m_Gen.m_Casters[i];
+		m_Gen.Extrude(caster,m_Dest+caster.Offset*4);
+	}
+}
+
+void ShadowVolumeGen::FindSilhouette(Caster &caster) const
 {	
-	TypedPData<dVector> *points = dynamic_cast<TypedPData<dVector>* >(src->GetDataRaw("p"));
+	caster.Silhouette.clear();
+
+	const TypedPData<dVector> *pdata = dynamic_cast<const TypedPData<dVector>* >(caster.Prim->GetDataRawConst("p"));
+	if (pdata==NULL) return;
+	const vector<dVector> &points=pdata->m_Data;
+	const vector<unsigned int> &index=caster.Prim->GetIndexConst();
+	bool indexed=caster.Prim->IsIndexed();
+	unsigned int stride=caster.Prim->GetFaceStride();
+	unsigned int count=indexed?index.size():points.size();
 	
-	///\todo using geometric normals, as we need them to be non smoothed
-	/// to tell the difference between faces, but this doesn't update with
-	/// n (from things like skinning and user deformation). recalc-normals
-	/// is ok though as it regenerates them... not sure what the answer is.
-	const vector<dVector> &normals = src->GetGeometricNormals();
-	const vector<vector<int> > &connected=src->GetConnectedVerts();
-	
-	dMatrix &transform = src->GetState()->Transform;
+	// faces need three verts for a plane, the same as the geometric normals
+	unsigned int faces=count>=3?(count-3)/stride+1:0;
+	caster.Planes.resize(faces*4);
+	float *nx=faces>0?&caster.Planes[0]:NULL;
+	float *ny=nx+faces;
+	float *nz=ny+faces;
+	float *d=nz+faces;
+
+	// the planes are made from the current positions, so they follow 
+	// any deformation
+	for (unsigned int f=0; f<faces; f++)
+	{
+		unsigned int v=f*stride;
+		const dVector &p0=points[indexed?index[v]:v];
+		const dVector &p1=points[indexed?index[v+1]:v+1];
+		const dVector &p2=points[indexed?index[v+2]:v+2];
+		dVector normal=(p0-p1).cross(p1-p2);
+		nx[f]=normal.x;
+		ny[f]=normal.y;
+		nz[f]=normal.z;
+		d[f]=normal.dot(p0);
+	}
 	
-	int stride=0;
-	if (src->GetType()==PolyPrimitive::TRISTRIP) stride=2;
-	if (src->GetType()==PolyPrimitive::QUADS) stride=4;
-	if (src->GetType()==PolyPrimitive::TRILIST) stride=3;
-	if (stride>0)
+	// faces pointing away from the light - the planes are tested 
+	// in object space, so this is correct for any transform
+	caster.Facing.assign(count/stride+1,0);
+	unsigned char *facing=&caster.Facing[0];
+	const dVector &light=caster.Light;
+	unsigned int f=0;
+#ifdef __SSE__
+	__m128 lx=_mm_set1_ps(light.x);
+	__m128 ly=_mm_set1_ps(light.y);
+	__m128 lz=_mm_set1_ps(light.z);
+	for (; f+4<=faces; f+=4)
 	{
-		SharedEdgeContainer edges = src->GetUniqueEdges();
-		vector<pair<dVector,dVector> > silhouette;
-			
-		if (src->IsIndexed())
-		{
-			vector<unsigned int> index = src->GetIndex();
-			// loop over all the edges
-			for (SharedEdgeContainer::iterator i=edges.begin(); i!=edges.end(); ++i)
-			{
-				EdgeContainer sharededges = *i;
-
-				dVector lightdir = transform.transform(points->m_Data[index[sharededges.begin()->first]])-m_LightPosition;
-				lightdir.normalise();
-
-				if (sharededges.size()==2)
-				{
-					bool backface=false;
-					bool frontface=false;
-
-					EdgeContainer::iterator frontedge;
-
-					// loop over the edges shared by this one
-					for (EdgeContainer::iterator edge=sharededges.begin(); edge!=sharededges.end(); ++edge)
-					{			
-						// only check the first vert, as they should have 
-						// the same geometric normal if the poly is planar..
-						if (lightdir.dot(transform.transform_no_trans(normals[edge->first]))>0) 
-						{
-							frontedge=edge;
-							frontface=true;
-						}
-						else backface=true;
-					}
-
-					// if we contain both front and back facing normals (from the light's pov) 
-					if (backface && frontface) 
-					{			
-						silhouette.push_back(pair<dVector,dVector>(transform.transform(points->m_Data[index[frontedge->first]]),
-					                                    		   transform.transform(points->m_Data[index[frontedge->second]])));
-					}
-				}
-			}
-		}
-		else
-		{
-			// loop over all the edges
-			for (SharedEdgeContainer::iterator i=edges.begin(); i!=edges.end(); ++i)
-			{
-				EdgeContainer sharededges = *i;
-
-				dVector lightdir = transform.transform(points->m_Data[sharededges.begin()->first])-m_LightPosition;
-				lightdir.normalise();
-
-
-				if (sharededges.size()==2)
-				{
-					bool backface=false;
-					bool frontface=false;
-
-					EdgeContainer::iterator frontedge;
-
-					// loop over the edges shared by this one
-					for (EdgeContainer::iterator edge=sharededges.begin(); edge!=sharededges.end(); ++edge)
-					{			
-						// only check the first vert, as they should have 
-						// the same geometric normal if the poly is planar..
-						if (lightdir.dot(transform.transform_no_trans(normals[edge->first]))>0) 
-						{
-							frontedge=edge;
-							frontface=true;
-						}
-						else backface=true;
-					}
-
-					// if we contain both front and back facing normals (from the light's pov) 
-					if (backface && frontface) 
-					{			
-						silhouette.push_back(pair<dVector,dVector>(transform.transform(points->m_Data[frontedge->first]),
-					                                    		   transform.transform(points->m_Data[frontedge->second])));
-					}
-				}
-			}
-		}
-		
-		for (vector<pair<dVector,dVector> >::iterator i=silhouette.begin();
-		     i!=silhouette.end(); i++)
+		__m128 t=_mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(nx+f),lx),
+		                               _mm_mul_ps(_mm_loadu_ps(ny+f),ly)),
+		                    _mm_mul_ps(_mm_loadu_ps(nz+f),lz));
+		int mask=_mm_movemask_ps(_mm_cmpgt_ps(_mm_loadu_ps(d+f),t));
+		facing[f]=mask&1;
+		facing[f+1]=(mask>>1)&1;
+		facing[f+2]=(mask>>2)&1;
+		facing[f+3]=(mask>>3)&1;
+	}
+#endif
+	for (; f<faces; f++)
+	{
+		facing[f]=d[f]>nx[f]*light.x+ny[f]*light.y+nz[f]*light.z;
+	}
+
+	// the silhouette is made of the edges between a face pointing 
+	// towards the light and one pointing away, in the winding of 
+	// the one pointing away
+	const vector<PolyPrimitive::FaceEdge> &edges=*caster.Edges;
+	unsigned int numfaces=caster.Facing.size();
+	for (unsigned int e=0; e<edges.size(); e++)
+	{
+		const PolyPrimitive::FaceEdge &edge=edges[e];
+		if (edge.Face[0]>=numfaces || edge.Face[1]>=numfaces) continue;
+		unsigned char a=facing[edge.Face[0]];
+		if (a!=facing[edge.Face[1]])
 		{
-			AddEdge(i->first,i->second);
+			caster.Silhouette.push_back(e*2+(a?0:1));
 		}
 	}
 }
 
-void ShadowVolumeGen::AddEdge(dVector start, dVector end)
+void ShadowVolumeGen::Extrude(const Caster &caster, dVector *dest) const
 {
-	if (m_Debug)
+	const TypedPData<dVector> *pdata = dynamic_cast<const TypedPData<dVector>* >(caster.Prim->GetDataRawConst("p"));
+	const vector<dVector> &points=pdata->m_Data;
+	const vector<PolyPrimitive::FaceEdge> &edges=*caster.Edges;
+
+	for (vector<unsigned int>::const_iterator i=caster.Silhouette.begin(); 
+		i!=caster.Silhouette.end(); ++i)
 	{
-		glDisable(GL_LIGHTING);
-		glLineWidth(3);
-		glBegin(GL_LINES);					
-			glColor3f(1,0,0);
-			glVertex3fv(start.arr());
-			glColor3f(0,0,1);
-			glVertex3fv(end.arr());
-		glEnd();
-		glEnable(GL_LIGHTING);
+		const PolyPrimitive::FaceEdge &edge=edges[*i/2];
+		unsigned int side=*i%2;
+		dVector start=caster.Transform.transform(points[edge.Start[side]]);
+		dVector end=caster.Transform.transform(points[edge.End[side]]);
+
+		*dest++=start;
+		*dest++=end;
+		*dest++=end+(end-m_LightPosition)*m_Length;
+		*dest++=start+(start-m_LightPosition)*m_Length;
 	}
+}
 
-	m_ShadowVolume.AddVertex(dVertex(start,dVector(0,0,0),0,0));
-	m_ShadowVolume.AddVertex(dVertex(end,dVector(0,0,0),0,0));
-
-	dVector proj = end-m_LightPosition;
-	m_ShadowVolume.AddVertex(dVertex(end+proj*m_Length,dVector(0,0,0),0,0));
+void ShadowVolumeGen::DrawSilhouettes(unsigned int start)
+{
+	const TypedPData<dVector> *points = dynamic_cast<const TypedPData<dVector>* >(m_ShadowVolume.GetDataRawConst("p"));
+	if (points==NULL) return;
 
-	proj = start-m_LightPosition;
-	m_ShadowVolume.AddVertex(dVertex(start+proj*m_Length,dVector(0,0,0),0,0));
+	glDisable(GL_LIGHTING);
+	glLineWidth(3);
+	glBegin(GL_LINES);					
+	for (unsigned int i=start; i+3<points->m_Data.size(); i+=4)
+	{
+		glColor3f(1,0,0);
+		glVertex3fv(&points->m_Data[i].x);
+		glColor3f(0,0,1);
+		glVertex3fv(&points->m_Data[i+1].x);
+	}
+	glEnd();
+	glEnable(GL_LIGHTING);
 }
 
 ///\todo shadow volumes for nurbs
 void ShadowVolumeGen::NURBSGen(NURBSPrimitive *src)
 {	
-	TypedPData<dVector> *points = static_cast<TypedPData<dVector>* >(src->GetDataRaw("p"));
-	TypedPData<dVector> *normals = dynamic_cast<TypedPData<dVector>* >(src->GetDataRaw("n"));
+	const TypedPData<dVector> *points = static_cast<const TypedPData<dVector>* >(src->GetDataRawConst("p"));
+	const TypedPData<dVector> *normals = dynamic_cast<const TypedPData<dVector>* >(src->GetDataRawConst("n"));
 	
 	dMatrix &transform = src->GetState()->Transform;
 	
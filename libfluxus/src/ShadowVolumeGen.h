@@ -18,8 +18,9 @@
 // Generates a shadow volume poly primitive for the supplied 
 // primitives and light position
 
-// Can we accelerate the process by caching as much as possible, and 
-// changing only when light positions/primitive transforms/deform?
+// The edges shared by each pair of faces are cached by the primitives,
+// and the volumes are made on the worker threads when they are first 
+// needed in a frame.
 
 #ifndef N_SHADOWGEN
 #define N_SHADOWGEN
@@ -27,6 +28,7 @@
 #include "Primitive.h"
 #include "PolyPrimitive.h"
 #include "NURBSPrimitive.h"
+#include "WorkerPool.h"
 
 namespace Fluxus
 {
@@ -53,10 +55,13 @@ public:
 	void Clear();
 	
 	/// Adds the volumes for a primitive to the polygon 
-	/// primitive
+	/// primitive. The primitive needs to stay around until
+	/// the volume has been made by GetVolume()
 	void Generate(Primitive *prim);
 	
-	/// Gets the volume generated so far
+	/// Gets the volume for the primitives generated so far, 
+	/// once this has been called primitives are ignored until 
+	/// the volume is cleared
 	PolyPrimitive *GetVolume();
 	
 	/// Sets the length to extrude the volume by, in world space
@@ -75,16 +80,59 @@ public:
 	///@}
 	
 private:
+	/// A primitive casting a shadow, with the 
+	/// working space for its part of the volume
+	class Caster
+	{
+	public:
+		Caster() : Prim(NULL), Edges(NULL), Offset(0) {}
+		PolyPrimitive *Prim;
+		const vector<PolyPrimitive::FaceEdge> *Edges;
+		dMatrix Transform;
+		/// The light in object space
+		dVector Light;
+		/// Face planes, as blocks of x, y and z normals and distances
+		vector<float> Planes;
+		vector<unsigned char> Facing;
+		/// Face edge indices times two, plus which face's winding to use
+		vector<unsigned int> Silhouette;
+		/// Where this caster's quads start in the volume
+		unsigned int Offset;
+	};
 
-	typedef pair<int,int> EdgeType;
-	typedef vector<EdgeType> EdgeContainer;
-	typedef vector<EdgeContainer> SharedEdgeContainer;
+	class SilhouetteJob : public WorkerPool::Job
+	{
+	public:
+		SilhouetteJob(ShadowVolumeGen &gen) : m_Gen(gen) {}
+		virtual void Run(unsigned int start, unsigned int end);
+	private:
+		ShadowVolumeGen &m_Gen;
+	};
 
-	void PolyGen(PolyPrimitive *src);
+	class ExtrudeJob : public WorkerPool::Job
+	{
+	public:
+		ExtrudeJob(ShadowVolumeGen &gen, dVector *dest) : m_Gen(gen), m_Dest(dest) {}
+		virtual void Run(unsigned int start, unsigned int end);
+	private:
+		ShadowVolumeGen &m_Gen;
+		dVector *m_Dest;
+	};
+
+	friend class SilhouetteJob;
+	friend class ExtrudeJob;
+
+	/// Makes the volume from the casters
+	void Build();
+	void FindSilhouette(Caster &caster) const;
+	void Extrude(const Caster &caster, dVector *dest) const;
 	void NURBSGen(NURBSPrimitive *src);
-	
-	void AddEdge(dVector start, dVector end);
-	int FindNextEdge(unsigned int index, vector<pair<dVector,dVector> > &silhouette, bool &flip);
+	/// Draws the edges of the volume's quads from start on
+	void DrawSilhouettes(unsigned int start);
+
+	vector<Caster> m_Casters;
+	unsigned int m_NumCasters;
+	bool m_Built;
 
 	PolyPrimitive m_ShadowVolume;
 	dVector m_LightPosition;
@@ -178,8 +178,8 @@ float SimplexNoise::noise(float x) {
 // 2D simplex noise
 float SimplexNoise::noise(float x, float y) {
 
-#define F2 0.366025403 // F2 = 0.5*(sqrt(3.0)-1.0)
-#define G2 0.211324865 // G2 = (3.0-Math.sqrt(3.0))/6.0
+#define F2 0.366025403f // F2 = 0.5*(sqrt(3.0)-1.0)
+#define G2 0.211324865f // G2 = (3.0-Math.sqrt(3.0))/6.0
 
     float n0, n1, n2; // Noise contributions from the three corners
 
@@ -212,8 +212,8 @@ float SimplexNoise::noise(float x, float y) {
     float y2 = y0 - 1.0f + 2.0f * G2;
 
     // Wrap the integer indices at 256, to avoid indexing perm[] out of bounds
-    int ii = i % 256;
-    int jj = j % 256;
+    int ii = i & 255;
+    int jj = j & 255;
 
     // Calculate the contribution from the three corners
     float t0 = 0.5f - x0*x0-y0*y0;
@@ -246,8 +246,8 @@ float SimplexNoise::noise(float x, float y) {
 float SimplexNoise::noise(float x, float y, float z) {
 
 // Simple skewing factors for the 3D case
-#define F3 0.333333333
-#define G3 0.166666667
+#define F3 0.333333333f
+#define G3 0.166666667f
 
     float n0, n1, n2, n3; // Noise contributions from the four corners
 
@@ -302,9 +302,9 @@ float SimplexNoise::noise(float x, float y, float z) {
     float z3 = z0 - 1.0f + 3.0f*G3;
 
     // Wrap the integer indices at 256, to avoid indexing perm[] out of bounds
-    int ii = i % 256;
-    int jj = j % 256;
-    int kk = k % 256;
+    int ii = i & 255;
+    int jj = j & 255;
+    int kk = k & 255;
 
     // Calculate the contribution from the four corners
     float t0 = 0.6f - x0*x0 - y0*y0 - z0*z0;
@@ -345,8 +345,8 @@ float SimplexNoise::noise(float x, float y, float z) {
 float SimplexNoise::noise(float x, float y, float z, float w) {
 
   // The skewing and unskewing factors are hairy again for the 4D case
-#define F4 0.309016994 // F4 = (Math.sqrt(5.0)-1.0)/4.0
-#define G4 0.138196601 // G4 = (5.0-Math.sqrt(5.0))/20.0
+#define F4 0.309016994f // F4 = (Math.sqrt(5.0)-1.0)/4.0
+#define G4 0.138196601f // G4 = (5.0-Math.sqrt(5.0))/20.0
 
     float n0, n1, n2, n3, n4; // Noise contributions from the five corners
 
@@ -431,10 +431,10 @@ float SimplexNoise::noise(float x, float y, float z, float w) {
     float w4 = w0 - 1.0f + 4.0f*G4;
 
     // Wrap the integer indices at 256, to avoid indexing perm[] out of bounds
-    int ii = i % 256;
-    int jj = j % 256;
-    int kk = k % 256;
-    int ll = l % 256;
+    int ii = i & 255;
+    int jj = j & 255;
+    int kk = k & 255;
+    int ll = l & 255;
 
     // Calculate the contribution from the five corners
     float t0 = 0.6f - x0*x0 - y0*y0 - z0*z0 - w0*w0;
@@ -18,9 +18,17 @@
 #include "SkinningPrimFunc.h"
 #include "Primitive.h"
 #include "SceneGraph.h"
+#include "WorkerPool.h"
+
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
 
 using namespace Fluxus;
 
+// vertices per chunk handed to each worker thread
+static const unsigned int SKINNING_GRAIN = 1024;
+
 SkinningPrimFunc::SkinningPrimFunc()
 {
 }
@@ -92,36 +100,93 @@ void SkinningPrimFunc::Run(Primitive &prim, const SceneGraph &world)
 							 world.GetGlobalTransform(bindposeskeleton[i]).inverse());
 	}
 
+	// use the compact bone influences if we have them and no per bone 
+	// weights, which may have been changed since the compact ones were made
+	const TypedPData<dColour> *boneindices = dynamic_cast<const TypedPData<dColour>*>(prim.GetDataRawConst("bi"));
+	const TypedPData<dColour> *boneweights = dynamic_cast<const TypedPData<dColour>*>(prim.GetDataRawConst("bw"));
+	if (boneindices && boneweights && !prim.GetDataRawConst("w0"))
+	{
+		SparseSkinJob job(transforms, boneindices->m_Data, boneweights->m_Data, *pref, *p, nref, n);
+		WorkerPool::Get()->Run(job, prim.Size(), SKINNING_GRAIN);
+		return;
+	}
+
 	// get pointers to all the weights
-	vector<vector<float>*> weights;
+	vector<const vector<float>*> weights;
 	for (unsigned int bone=0; bone<skeleton.size(); bone++)
 	{
 		char wname[256];
 		snprintf(wname,256,"w%d",bone);
-		vector<float> *w = prim.GetDataVec<float>(wname);
+		const TypedPData<float> *w = dynamic_cast<const TypedPData<float>*>(prim.GetDataRawConst(wname));
 		if (w==NULL)
 		{
 			Trace::Stream<<"SkinningPrimFunc::Run: can't find weights, aborting"<<endl;
 			return;
 		}
-		weights.push_back(w);
+		weights.push_back(&w->m_Data);
 	}
 
-	for (unsigned int i=0; i<prim.Size(); i++)
+	DenseSkinJob job(transforms, weights, *pref, *p, nref, n);
+	WorkerPool::Get()->Run(job, prim.Size(), SKINNING_GRAIN);
+}
+
+// adds the matrix scaled by the weight to the blended matrix
+static inline void BlendMatrix(dMatrix &mat, const dMatrix &bone, float weight)
+{
+#ifdef __SSE__
+	__m128 w=_mm_set1_ps(weight);
+	for (int r=0; r<4; r++)
+	{
+		_mm_storeu_ps(mat.m[r],_mm_add_ps(_mm_loadu_ps(mat.m[r]),_mm_mul_ps(_mm_loadu_ps(bone.m[r]),w)));
+	}
+#else
+	mat+=bone*weight;
+#endif
+}
+
+void SkinningPrimFunc::SkinJob::Skin(unsigned int i, const dMatrix &mat)
+{
+	m_P[i]=mat.transform(m_PRef[i]);
+	if (m_N) (*m_N)[i]=mat.transform_no_trans((*m_NRef)[i]);
+}
+
+void SkinningPrimFunc::SparseSkinJob::Run(unsigned int start, unsigned int end)
+{
+	unsigned int numbones=m_Transforms.size();
+	for (unsigned int i=start; i<end; i++)
 	{
 		dMatrix mat;
 		mat.zero();
-		for	(unsigned int bone=0; bone<skeleton.size(); bone++)
+		
+		// colours are used to store 4 influences per vertex
+		const float *indices=&m_BoneIndices[i].r;
+		const float *weights=&m_BoneWeights[i].r;
+		for (int k=0; k<4; k++)
 		{
-			mat+=(transforms[bone]*(*weights[bone])[i]);
+			unsigned int bone=(unsigned int)indices[k];
+			float weight=weights[k];
+			if (weight!=0 && bone<numbones)
+			{
+				BlendMatrix(mat,m_Transforms[bone],weight);
+			}
 		}
 
-		(*p)[i]=mat.transform((*pref)[i]);
+		Skin(i,mat);
+	}
+}
 
-		if (skinnormals)
+void SkinningPrimFunc::DenseSkinJob::Run(unsigned int start, unsigned int end)
+{
+	for (unsigned int i=start; i<end; i++)
+	{
+		dMatrix mat;
+		mat.zero();
+		for	(unsigned int bone=0; bone<m_Transforms.size(); bone++)
 		{
-			(*n)[i]=mat.transform_no_trans((*nref)[i]);
+			float weight=(*m_Weights[bone])[i];
+			if (weight!=0) BlendMatrix(mat,m_Transforms[bone],weight);
 		}
+
+		Skin(i,mat);
 	}
 }
-
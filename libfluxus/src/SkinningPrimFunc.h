@@ -20,6 +20,7 @@
 #include "PrimitiveFunction.h"
 #include "Primitive.h"
 #include "SceneGraph.h"
+#include "WorkerPool.h"
 
 using namespace std;
 
@@ -27,7 +28,11 @@ namespace Fluxus
 {
 
 //////////////////////////////////////////////////
-/// A primitive function for debugging skin weights
+/// A primitive function for skinning a primitive to a 
+/// skeleton. Uses the compact "bi" and "bw" pdata (up to 
+/// 4 bone indices and weights per vertex, stored as colours)
+/// if they exist, otherwise the dense "w0".."wN" arrays. 
+/// The vertices are split up over the worker pool.
 class SkinningPrimFunc : public PrimitiveFunction
 {
 public:
@@ -38,6 +43,53 @@ public:
 
 private:
 	
+	/// Skins a range of vertices, normals are only 
+	/// written if n is not NULL
+	class SkinJob : public WorkerPool::Job
+	{
+	public:
+		SkinJob(const vector<dMatrix> &transforms, const vector<dVector> &pref, 
+				vector<dVector> &p, const vector<dVector> *nref, vector<dVector> *n) :
+			m_Transforms(transforms), m_PRef(pref), m_P(p), m_NRef(nref), m_N(n) {}
+		
+	protected:
+		void Skin(unsigned int i, const dMatrix &mat);
+
+		const vector<dMatrix> &m_Transforms;
+		const vector<dVector> &m_PRef;
+		vector<dVector> &m_P;
+		const vector<dVector> *m_NRef;
+		vector<dVector> *m_N;
+	};
+	
+	class SparseSkinJob : public SkinJob
+	{
+	public:
+		SparseSkinJob(const vector<dMatrix> &transforms, const vector<dColour> &boneindices,
+				const vector<dColour> &boneweights, const vector<dVector> &pref, 
+				vector<dVector> &p, const vector<dVector> *nref, vector<dVector> *n) :
+			SkinJob(transforms,pref,p,nref,n), m_BoneIndices(boneindices), m_BoneWeights(boneweights) {}
+		
+		virtual void Run(unsigned int start, unsigned int end);
+
+	private:
+		const vector<dColour> &m_BoneIndices;
+		const vector<dColour> &m_BoneWeights;
+	};
+
+	class DenseSkinJob : public SkinJob
+	{
+	public:
+		DenseSkinJob(const vector<dMatrix> &transforms, const vector<const vector<float>*> &weights,
+				const vector<dVector> &pref, vector<dVector> &p, 
+				const vector<dVector> *nref, vector<dVector> *n) :
+			SkinJob(transforms,pref,p,nref,n), m_Weights(weights) {}
+		
+		virtual void Run(unsigned int start, unsigned int end);
+
+	private:
+		const vector<const vector<float>*> &m_Weights;
+	};
 };
 
 
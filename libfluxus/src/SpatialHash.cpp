@@ -0,0 +1,111 @@
+// Copyright (C) 2010 Dave Griffiths
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+
+#include <algorithm>
+#include <math.h>
+#include "SpatialHash.h"
+
+using namespace Fluxus;
+
+// bits per axis packed into a key, the cell coordinates
+// wrap around - which is fine as all candidates are checked
+static const int KEY_BITS=21;
+static const unsigned long long KEY_MASK=(1ULL<<KEY_BITS)-1;
+static const double MAX_CELL=4e18;
+
+SpatialHash::SpatialHash(float epsilon) :
+m_Epsilon(epsilon),
+m_Points(NULL)
+{
+}
+
+long long SpatialHash::Cell(float v) const
+{
+	double c=floor(v/m_Epsilon);
+	if (c>MAX_CELL) c=MAX_CELL;
+	if (c<-MAX_CELL) c=-MAX_CELL;
+	return (long long)c;
+}
+
+SpatialHash::Key SpatialHash::MakeKey(long long x, long long y, long long z) const
+{
+	return ((Key)x&KEY_MASK) |
+	       (((Key)y&KEY_MASK)<<KEY_BITS) |
+	       (((Key)z&KEY_MASK)<<(KEY_BITS*2));
+}
+
+void SpatialHash::Build(const vector<dVector> &points)
+{
+	m_Points=&points;
+	m_Entries.resize(points.size());
+	for (unsigned int i=0; i<points.size(); i++)
+	{
+		m_Entries[i].CellKey=MakeKey(Cell(points[i].x),Cell(points[i].y),Cell(points[i].z));
+		m_Entries[i].Index=i;
+	}
+	sort(m_Entries.begin(),m_Entries.end());
+}
+
+void SpatialHash::Find(const dVector &pos, vector<int> &result) const
+{
+	if (m_Points==NULL) return;
+
+	unsigned int start=result.size();
+	long long cx=Cell(pos.x);
+	long long cy=Cell(pos.y);
+	long long cz=Cell(pos.z);
+	dVector p(pos);
+
+	// anything within epsilon must be in this or a neighbouring cell
+	for (long long z=cz-1; z<=cz+1; z++)
+	{
+		for (long long y=cy-1; y<=cy+1; y++)
+		{
+			for (long long x=cx-1; x<=cx+1; x++)
+			{
+				Entry search;
+				search.CellKey=MakeKey(x,y,z);
+				search.Index=-1;
+				for (vector<Entry>::const_iterator i=lower_bound(m_Entries.begin(),m_Entries.end(),search);
+					i!=m_Entries.end() && i->CellKey==search.CellKey; ++i)
+				{
+					if (p.feq((*m_Points)[i->Index],m_Epsilon))
+					{
+						result.push_back(i->Index);
+					}
+				}
+			}
+		}
+	}
+
+	// cells may alias when the coordinates wrap, so remove duplicates
+	sort(result.begin()+start,result.end());
+	result.erase(unique(result.begin()+start,result.end()),result.end());
+}
+
+void SpatialHash::Connected(vector<vector<int> > &connected) const
+{
+	if (m_Points==NULL) return;
+
+	connected.resize(m_Points->size());
+	for (unsigned int i=0; i<m_Points->size(); i++)
+	{
+		vector<int> &c=connected[i];
+		c.clear();
+		Find((*m_Points)[i],c);
+		c.erase(remove(c.begin(),c.end(),(int)i),c.end());
+	}
+}
@@ -0,0 +1,77 @@
+// Copyright (C) 2010 Dave Griffiths
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+
+#ifndef N_SPATIALHASH
+#define N_SPATIALHASH
+
+#include <vector>
+#include "dada.h"
+
+using namespace std;
+
+namespace Fluxus
+{
+
+//////////////////////////////////////////////////////
+/// Finds points which are coincident (using the same
+/// test as dVector::feq) without comparing every point
+/// with every other one. The points are binned into a
+/// grid of epsilon sized cells, and the cells are kept
+/// sorted so a point only needs checking against the
+/// points in its own and neighbouring cells.
+class SpatialHash
+{
+public:
+	SpatialHash(float epsilon=0.001);
+
+	/// Bins the points, the vector needs to stay valid
+	/// while the hash is being used
+	void Build(const vector<dVector> &points);
+
+	/// Appends the indices of all the points coincident with
+	/// the given position to result, in ascending order
+	void Find(const dVector &pos, vector<int> &result) const;
+
+	/// For every point, fills in the (ascending) list of
+	/// other points which are coincident with it
+	void Connected(vector<vector<int> > &connected) const;
+
+private:
+	typedef unsigned long long Key;
+
+	Key MakeKey(long long x, long long y, long long z) const;
+	long long Cell(float v) const;
+
+	class Entry
+	{
+	public:
+		Key CellKey;
+		int Index;
+		bool operator<(const Entry &other) const
+		{
+			if (CellKey!=other.CellKey) return CellKey<other.CellKey;
+			return Index<other.Index;
+		}
+	};
+
+	float m_Epsilon;
+	const vector<dVector> *m_Points;
+	vector<Entry> m_Entries;
+};
+
+};
+
+#endif
@@ -48,7 +48,8 @@ Target(NULL)
 	}
 }
 
-State::State(const State &other) 
+State::State(const State &other) :
+Shader(NULL)
 {
 	*this=other;
 }
@@ -75,14 +76,17 @@ const State &State::operator=(const State &other)
 	WireOpacity=other.WireOpacity;
 	ColourMode=other.ColourMode;
 	Transform=other.Transform;
-	Shader=other.Shader;
 	Cull=other.Cull;
 	Target=other.Target;
 
-	if (Shader!=NULL)
+	// take the new reference before dropping the old one, in case 
+	// they are the same shader
+	if (other.Shader!=NULL)
 	{
-		Shader->IncRef();
+		other.Shader->IncRef();
 	}
+	if (Shader!=NULL && Shader->DecRef()) delete Shader;
+	Shader=other.Shader;
 	for (int n=0; n<MAX_TEXTURES; n++)
 	{
 		Textures[n]=other.Textures[n];
@@ -133,6 +137,52 @@ void State::Apply()
 	else GLSLShader::Unapply();
 }
 
+void State::ApplyInstance()
+{
+	glMultMatrixf(Transform.arr());
+	if (Opacity != 1.0f) Colour.a=Opacity;
+	glColor4f(Colour.r,Colour.g,Colour.b,Colour.a);
+	glMaterialfv(GL_FRONT_AND_BACK,GL_DIFFUSE,Colour.arr());
+}
+
+bool State::IsCompatible(const State &other) const
+{
+	if (Hints!=other.Hints ||
+		Shader!=other.Shader ||
+		Target!=other.Target ||
+		Cull!=other.Cull ||
+		ColourMode!=other.ColourMode ||
+		!(Specular==other.Specular) ||
+		!(Emissive==other.Emissive) ||
+		!(Ambient==other.Ambient) ||
+		!(WireColour==other.WireColour) ||
+		!(NormalColour==other.NormalColour) ||
+		Shinyness!=other.Shinyness ||
+		Opacity!=other.Opacity ||
+		WireOpacity!=other.WireOpacity ||
+		LineWidth!=other.LineWidth ||
+		PointWidth!=other.PointWidth ||
+		StippledLines!=other.StippledLines ||
+		StippleFactor!=other.StippleFactor ||
+		StipplePattern!=other.StipplePattern ||
+		SourceBlend!=other.SourceBlend ||
+		DestinationBlend!=other.DestinationBlend)
+	{
+		return false;
+	}
+
+	for (int n=0; n<MAX_TEXTURES; n++)
+	{
+		if (Textures[n]!=other.Textures[n] ||
+			!(TextureStates[n]==other.TextureStates[n]))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
 void State::Unapply()
 {
 	if (Hints & HINT_NORMALISE)
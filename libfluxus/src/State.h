@@ -49,6 +49,8 @@ namespace Fluxus
 #define HINT_NORMALISE      0x00020000
 #define HINT_NOBLEND        0x00040000
 #define HINT_NOZWRITE       0x00080000
+#define HINT_VBO            0x00100000
+#define HINT_SPRITES        0x00200000
 
 #define MAX_TEXTURES  8
 
@@ -71,6 +73,13 @@ public:
 	void Apply();
 	void Unapply();
 	void Spew();
+	
+	/// Applies just the transform and colour, for drawing a run of
+	/// primitives which are compatible with one that's been Apply()ed 
+	void ApplyInstance();
+	
+	/// Whether the states only differ by transform and colour
+	bool IsCompatible(const State &other) const;
 
 	dColour Colour;
 	dColour Specular;
@@ -21,16 +21,52 @@
 #include "DDSLoader.h"
 #include "SearchPaths.h"
 #include <assert.h>
+#include <algorithm>
+#include <cstring>
+#include <sys/time.h>
+#include <unistd.h>
 
 using namespace Fluxus;
 
 TexturePainter *TexturePainter::m_Singleton=NULL;
 
+// how much of a texture to copy into the pixel buffer before 
+// checking if we've run out of time for this frame
+static const unsigned int STAGING_CHUNK=256*1024;
+static const unsigned int MAX_LOADER_THREADS=4;
+
+static double TimeMS()
+{
+	timeval t;
+	gettimeofday(&t,NULL);
+	return t.tv_sec*1000.0+t.tv_usec/1000.0;
+}
+
+static bool IsPowerOfTwo(unsigned int n)
+{
+	return n!=0 && (n&(n-1))==0;
+}
+
 TexturePainter::TexturePainter() :
 m_MultitexturingEnabled(true),
 m_TextureCompressionEnabled(true),
-m_SGISGenerateMipmap(true)
+m_SGISGenerateMipmap(true),
+m_LoaderQuit(false),
+m_UploadBudget(2),
+m_PixelBuffersSupported(false),
+m_NPOTSupported(false),
+m_GenerateMipmapSupported(false),
+m_TextureBudget(0),
+m_ResidentBytes(0),
+m_Frame(0),
+m_Hits(0),
+m_Misses(0),
+m_Evictions(0)
 {
+	pthread_mutex_init(&m_LoadMutex,NULL);
+	pthread_cond_init(&m_LoadCond,NULL);
+	pthread_cond_init(&m_DecodedCond,NULL);
+
 	if (glewInit() != GLEW_OK)
 	{
 		cerr << "ERROR Unable to check OpenGL extensions" << endl;
@@ -57,11 +93,26 @@ m_SGISGenerateMipmap(true)
 		Trace::Stream << "Warning: Automatic mipmap generation disabled." << endl;
 		m_SGISGenerateMipmap = false;
 	}
+
+	// for streaming background loads to the card
+	m_PixelBuffersSupported = glewIsSupported("GL_VERSION_2_1") && glMapBuffer!=NULL;
+	m_NPOTSupported = glewIsSupported("GL_ARB_texture_non_power_of_two");
+	m_GenerateMipmapSupported = glewIsSupported("GL_EXT_framebuffer_object") && glGenerateMipmapEXT!=NULL;
 }
 
 TexturePainter::~TexturePainter()
 {
 	///\todo Shouldn't we delete all textures here?
+	StopLoaderThreads();
+
+	for (vector<AsyncLoad*>::iterator i=m_AsyncLoads.begin(); i!=m_AsyncLoads.end(); ++i)
+	{
+		DeleteAsyncLoad(*i);
+	}
+
+	pthread_cond_destroy(&m_DecodedCond);
+	pthread_cond_destroy(&m_LoadCond);
+	pthread_mutex_destroy(&m_LoadMutex);
 }
 
 void TexturePainter::Initialise()
@@ -87,13 +138,19 @@ void TexturePainter::Initialise()
 
 void TexturePainter::ClearCache()
 {
+	// don't let loads in progress finish into the cleared cache
+	CancelAsyncLoads();
 	m_TextureMap.clear();
 	m_LoadedMap.clear();
 	m_LoadedCubeMap.clear();
+	m_Residency.clear();
+	m_ResidentBytes=0;
 }
 
 unsigned int TexturePainter::LoadTexture(const string &Filename, CreateParams &params)
 {
+	if (params.Async) return LoadTextureAsync(Filename, params);
+
 	string Fullpath = SearchPaths::Get()->GetFullPath(Filename);
 	if (params.Type==GL_TEXTURE_CUBE_MAP_POSITIVE_X || params.Type==GL_TEXTURE_CUBE_MAP_NEGATIVE_X ||
 		params.Type==GL_TEXTURE_CUBE_MAP_POSITIVE_Y || params.Type==GL_TEXTURE_CUBE_MAP_NEGATIVE_Y ||
@@ -106,6 +163,8 @@ unsigned int TexturePainter::LoadTexture(const string &Filename, CreateParams &p
 	map<string,int>::iterator i=m_LoadedMap.find(Fullpath);
 	if (i!=m_LoadedMap.end())
 	{
+		// it may still be loading in the background
+		FinishAsyncLoad(i->second);
 		return i->second;
 	}
 
@@ -126,6 +185,7 @@ unsigned int TexturePainter::LoadTexture(const string &Filename, CreateParams &p
 		// upload to card...
 		glEnable(params.Type);
 
+		bool created=false;
 		if (params.ID==-1) // is this a new texture?
 		{
 			GLuint id;
@@ -134,19 +194,14 @@ unsigned int TexturePainter::LoadTexture(const string &Filename, CreateParams &p
 			//\todo this means mipmap levels won't be cached
 			m_TextureMap[params.ID]=desc;
 			m_LoadedMap[Fullpath]=params.ID;
+			created=true;
 		}
 
-		UploadTexture(desc,params);
+		UploadMipmaps(desc,mipmaps,params);
 
-		// upload mipmaps from compressed textures
-		if (!mipmaps.empty() && params.GenerateMipmaps)
-		{
-			for (unsigned i = 0; i < mipmaps.size(); i++)
-			{
-				params.MipLevel = i + 1;
-				UploadTexture(mipmaps[i], params);
-			}
-		}
+		// we can only reload textures which come from one file
+		if (created) TrackTexture(Fullpath,params,desc,mipmaps);
+		else UntrackTexture(params.ID);
 
 		delete [] desc.ImageData;
 		for (unsigned i = 0; i < mipmaps.size(); i++)
@@ -234,6 +289,475 @@ unsigned int TexturePainter::LoadCubeMap(const string &Fullpath, CreateParams &p
 	return 0;
 }
 
+void TexturePainter::UploadMipmaps(const TextureDesc &desc, const vector<TextureDesc> &mipmaps, CreateParams params)
+{
+	UploadTexture(desc,params);
+
+	// upload mipmaps from compressed textures
+	if (!mipmaps.empty() && params.GenerateMipmaps)
+	{
+		for (unsigned i = 0; i < mipmaps.size(); i++)
+		{
+			params.MipLevel = i + 1;
+			UploadTexture(mipmaps[i], params);
+		}
+	}
+}
+
+unsigned int TexturePainter::LoadTextureAsync(const string &Filename, CreateParams &params)
+{
+	string Fullpath = SearchPaths::Get()->GetFullPath(Filename);
+	
+	// cubemap faces are small enough to just load
+	if (params.Type!=GL_TEXTURE_2D)
+	{
+		params.Async=false;
+		return LoadTexture(Filename, params);
+	}
+
+	map<string,int>::iterator i=m_LoadedMap.find(Fullpath);
+	if (i!=m_LoadedMap.end())
+	{
+		return i->second;
+	}
+
+	// check the file is there now, so the usual error turns up 
+	// straight away, and in the right thread
+	FILE *file = fopen(Fullpath.c_str(),"rb");
+	if (file==NULL)
+	{
+		Trace::Stream<<"Couldn't open image ["<<Fullpath<<"]"<<endl;
+		m_LoadedMap[Fullpath]=0;
+		return 0;
+	}
+	fclose(file);
+
+	if (params.ID==-1) // is this a new texture?
+	{
+		GLuint id;
+		glGenTextures(1,&id);
+		params.ID=id;
+		m_LoadedMap[Fullpath]=params.ID;
+
+		// a blank texture to use while we're loading
+		unsigned char white[4]={255,255,255,255};
+		glBindTexture(GL_TEXTURE_2D,params.ID);
+		glTexImage2D(GL_TEXTURE_2D,0,GL_RGBA,1,1,0,GL_RGBA,GL_UNSIGNED_BYTE,white);
+		QueueAsyncLoad(Fullpath,params)->Track=true;
+	}
+	else
+	{
+		UntrackTexture(params.ID);
+		QueueAsyncLoad(Fullpath,params);
+	}
+
+	return params.ID;
+}
+
+TexturePainter::AsyncLoad *TexturePainter::QueueAsyncLoad(const string &Fullpath, const CreateParams &params)
+{
+	AsyncLoad *load = new AsyncLoad;
+	load->Fullpath = Fullpath;
+	load->Extension = Fullpath.substr(Fullpath.find_last_of('.') + 1, Fullpath.size());
+	load->Params = params;
+	m_AsyncLoads.push_back(load);
+
+	StartLoaderThreads();
+	pthread_mutex_lock(&m_LoadMutex);
+	m_DecodeQueue.push_back(load);
+	pthread_cond_signal(&m_LoadCond);
+	pthread_mutex_unlock(&m_LoadMutex);
+	return load;
+}
+
+bool TexturePainter::IsLoading(unsigned int id)
+{
+	for (vector<AsyncLoad*>::iterator i=m_AsyncLoads.begin(); i!=m_AsyncLoads.end(); ++i)
+	{
+		if ((unsigned int)(*i)->Params.ID==id) return true;
+	}
+	return false;
+}
+
+void TexturePainter::Update()
+{
+	m_Frame++;
+	UploadPending();
+	if (m_TextureBudget>0 && m_ResidentBytes>m_TextureBudget) EvictTextures();
+}
+
+void TexturePainter::UploadPending()
+{
+	if (m_AsyncLoads.empty()) return;
+
+	double deadline = TimeMS()+m_UploadBudget;
+	vector<AsyncLoad*>::iterator i=m_AsyncLoads.begin();
+	while (i!=m_AsyncLoads.end())
+	{
+		pthread_mutex_lock(&m_LoadMutex);
+		bool decoded = (*i)->Decoded;
+		pthread_mutex_unlock(&m_LoadMutex);
+
+		if (decoded && StreamAsyncLoad(*i,deadline))
+		{
+			CompleteAsyncLoad(*i);
+			i=m_AsyncLoads.erase(i);
+		}
+		else
+		{
+			++i;
+		}
+
+		if (TimeMS()>deadline) break;
+	}
+}
+
+void TexturePainter::FinishAsyncLoad(unsigned int id)
+{
+	vector<AsyncLoad*>::iterator i=m_AsyncLoads.begin();
+	while (i!=m_AsyncLoads.end() && (unsigned int)(*i)->Params.ID!=id) ++i;
+	if (i==m_AsyncLoads.end()) return;
+
+	AsyncLoad *load=*i;
+	pthread_mutex_lock(&m_LoadMutex);
+	while (!load->Decoded)
+	{
+		// quicker to do it ourselves than wait for it to come up
+		deque<AsyncLoad*>::iterator q=find(m_DecodeQueue.begin(),m_DecodeQueue.end(),load);
+		if (q!=m_DecodeQueue.end())
+		{
+			m_DecodeQueue.erase(q);
+			pthread_mutex_unlock(&m_LoadMutex);
+			Decode(load);
+			pthread_mutex_lock(&m_LoadMutex);
+			load->Decoded=true;
+		}
+		else
+		{
+			pthread_cond_wait(&m_DecodedCond,&m_LoadMutex);
+		}
+	}
+	pthread_mutex_unlock(&m_LoadMutex);
+
+	StreamAsyncLoad(load,1e300);
+	CompleteAsyncLoad(load);
+	m_AsyncLoads.erase(i);
+}
+
+bool TexturePainter::CanStream(const AsyncLoad *load)
+{
+	const TextureDesc &desc=load->Desc;
+	const CreateParams &params=load->Params;
+	return m_PixelBuffersSupported && 
+		   !params.Compress && load->Mipmaps.empty() &&
+		   (desc.InternalFormat==GL_RGB || desc.InternalFormat==GL_RGBA) &&
+		   (!params.GenerateMipmaps || m_SGISGenerateMipmap || m_GenerateMipmapSupported) &&
+		   (m_NPOTSupported || (IsPowerOfTwo(desc.Width) && IsPowerOfTwo(desc.Height)));
+}
+
+bool TexturePainter::StreamAsyncLoad(AsyncLoad *load, double deadline)
+{
+	TextureDesc &desc=load->Desc;
+	CreateParams &params=load->Params;
+
+	// failed to load, leave the blank texture
+	if (desc.ImageData==NULL) return true;
+
+	if (load->Buffer==0)
+	{
+		if (CanStream(load))
+		{
+			glGenBuffers(1,&load->Buffer);
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER,load->Buffer);
+			glBufferData(GL_PIXEL_UNPACK_BUFFER,desc.Size,NULL,GL_STREAM_DRAW);
+			load->Mapped=static_cast<unsigned char*>(glMapBuffer(GL_PIXEL_UNPACK_BUFFER,GL_WRITE_ONLY));
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER,0);
+		}
+
+		if (load->Mapped==NULL)
+		{
+			// do it the usual way, in one go
+			if (load->Buffer!=0) glDeleteBuffers(1,&load->Buffer);
+			load->Buffer=0;
+			UploadMipmaps(desc,load->Mipmaps,params);
+			return true;
+		}
+	}
+
+	// copy into the pixel buffer until we run out of time, the 
+	// buffer stays mapped between frames until it's full
+	while (load->Copied<(unsigned int)desc.Size)
+	{
+		unsigned int size=desc.Size-load->Copied;
+		if (size>STAGING_CHUNK) size=STAGING_CHUNK;
+		memcpy(load->Mapped+load->Copied,desc.ImageData+load->Copied,size);
+		load->Copied+=size;
+		if (TimeMS()>deadline && load->Copied<(unsigned int)desc.Size) return false;
+	}
+
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER,load->Buffer);
+	bool intact = glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+	load->Mapped=NULL;
+
+	if (intact)
+	{
+		// the card can pull the pixels from the buffer without 
+		// holding us up
+		glBindTexture(params.Type,params.ID);
+		if (params.GenerateMipmaps && m_SGISGenerateMipmap)
+		{
+			glTexParameteri(params.Type, GL_GENERATE_MIPMAP_SGIS, 1);
+		}
+		glPixelStorei(GL_UNPACK_ALIGNMENT,1);
+		glTexImage2D(params.Type, params.MipLevel, desc.InternalFormat, desc.Width, desc.Height, 
+				params.Border, desc.Format, GL_UNSIGNED_BYTE, NULL);
+		glPixelStorei(GL_UNPACK_ALIGNMENT,4);
+		if (params.GenerateMipmaps && !m_SGISGenerateMipmap)
+		{
+			glGenerateMipmapEXT(params.Type);
+		}
+	}
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER,0);
+	glDeleteBuffers(1,&load->Buffer);
+	load->Buffer=0;
+
+	// the buffer contents can be lost, so try again the slow way
+	if (!intact) UploadMipmaps(desc,load->Mipmaps,params);
+	return true;
+}
+
+void TexturePainter::CompleteAsyncLoad(AsyncLoad *load)
+{
+	Trace::Stream<<load->Errors;
+
+	if (load->Desc.ImageData!=NULL)
+	{
+		TextureDesc info=load->Desc;
+		info.ImageData=NULL;
+		m_TextureMap[load->Params.ID]=info;
+		if (load->Track) TrackTexture(load->Fullpath,load->Params,load->Desc,load->Mipmaps);
+	}
+
+	DeleteAsyncLoad(load);
+}
+
+void TexturePainter::DeleteAsyncLoad(AsyncLoad *load)
+{
+	delete[] load->Desc.ImageData;
+	for (unsigned int i=0; i<load->Mipmaps.size(); i++)
+	{
+		delete[] load->Mipmaps[i].ImageData;
+	}
+	delete load;
+}
+
+void TexturePainter::CancelAsyncLoads()
+{
+	if (m_AsyncLoads.empty()) return;
+
+	pthread_mutex_lock(&m_LoadMutex);
+	// the queued ones haven't been started, so there's nothing to wait for
+	for (deque<AsyncLoad*>::iterator i=m_DecodeQueue.begin(); i!=m_DecodeQueue.end(); ++i)
+	{
+		(*i)->Decoded=true;
+	}
+	m_DecodeQueue.clear();
+
+	// the rest are being decoded by the loader threads
+	for (vector<AsyncLoad*>::iterator i=m_AsyncLoads.begin(); i!=m_AsyncLoads.end(); ++i)
+	{
+		while (!(*i)->Decoded) pthread_cond_wait(&m_DecodedCond,&m_LoadMutex);
+	}
+	pthread_mutex_unlock(&m_LoadMutex);
+
+	for (vector<AsyncLoad*>::iterator i=m_AsyncLoads.begin(); i!=m_AsyncLoads.end(); ++i)
+	{
+		AsyncLoad *load=*i;
+		Trace::Stream<<load->Errors;
+		if (load->Buffer!=0)
+		{
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER,load->Buffer);
+			if (load->Mapped!=NULL) glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER,0);
+			glDeleteBuffers(1,&load->Buffer);
+		}
+		DeleteAsyncLoad(load);
+	}
+	m_AsyncLoads.clear();
+}
+
+void TexturePainter::TrackTexture(const string &Fullpath, const CreateParams &params, 
+	const TextureDesc &desc, const vector<TextureDesc> &mipmaps)
+{
+	if (params.Type!=GL_TEXTURE_2D) return;
+
+	// roughly what the card will need, assuming it pads RGB to RGBA
+	unsigned long bytes=0;
+	if (desc.InternalFormat==GL_RGB || desc.InternalFormat==GL_RGBA)
+	{
+		bytes=desc.Width*desc.Height*4;
+		if (params.Compress && m_TextureCompressionEnabled) bytes/=4;
+		if (params.GenerateMipmaps) bytes=bytes*4/3;
+	}
+	else
+	{
+		bytes=desc.Size;
+		for (unsigned int i=0; i<mipmaps.size(); i++) bytes+=mipmaps[i].Size;
+	}
+
+	UntrackTexture(params.ID);
+	Residency &r=m_Residency[params.ID];
+	r.Fullpath=Fullpath;
+	r.Params=params;
+	r.Params.Async=false;
+	r.Bytes=bytes;
+	r.LastUsed=m_Frame;
+	m_ResidentBytes+=bytes;
+}
+
+void TexturePainter::UntrackTexture(unsigned int id)
+{
+	map<unsigned int,Residency>::iterator i=m_Residency.find(id);
+	if (i==m_Residency.end()) return;
+	if (!i->second.Evicted) m_ResidentBytes-=i->second.Bytes;
+	m_Residency.erase(i);
+}
+
+void TexturePainter::TouchTexture(unsigned int id)
+{
+	map<unsigned int,Residency>::iterator i=m_Residency.find(id);
+	if (i==m_Residency.end()) return;
+
+	Residency &r=i->second;
+	r.LastUsed=m_Frame;
+	if (r.Evicted)
+	{
+		// it's counted again once it's been uploaded
+		m_Misses++;
+		r.Evicted=false;
+		r.Bytes=0;
+		QueueAsyncLoad(r.Fullpath,r.Params)->Track=true;
+	}
+	else
+	{
+		m_Hits++;
+	}
+}
+
+static bool OlderResidency(const pair<unsigned int,unsigned int> &a, const pair<unsigned int,unsigned int> &b)
+{
+	return a.first<b.first;
+}
+
+void TexturePainter::EvictTextures()
+{
+	// candidates are anything not used last frame, oldest first
+	vector<pair<unsigned int,unsigned int> > candidates;
+	for (map<unsigned int,Residency>::iterator i=m_Residency.begin(); i!=m_Residency.end(); ++i)
+	{
+		if (!i->second.Evicted && i->second.Bytes>0 && i->second.LastUsed+1<m_Frame)
+		{
+			candidates.push_back(pair<unsigned int,unsigned int>(i->second.LastUsed,i->first));
+		}
+	}
+	sort(candidates.begin(),candidates.end(),OlderResidency);
+
+	unsigned char white[4]={255,255,255,255};
+	for (unsigned int c=0; c<candidates.size() && m_ResidentBytes>m_TextureBudget; c++)
+	{
+		GLuint id=candidates[c].second;
+		if (IsLoading(id)) continue;
+
+		// deleting frees all the mip levels, binding the name again straight 
+		// away keeps it from being given out by glGenTextures
+		glDeleteTextures(1,&id);
+		glBindTexture(GL_TEXTURE_2D,id);
+		glTexImage2D(GL_TEXTURE_2D,0,GL_RGBA,1,1,0,GL_RGBA,GL_UNSIGNED_BYTE,white);
+
+		Residency &r=m_Residency[id];
+		m_ResidentBytes-=r.Bytes;
+		r.Evicted=true;
+		m_Evictions++;
+	}
+	glBindTexture(GL_TEXTURE_2D,0);
+}
+
+void TexturePainter::GetCacheStats(unsigned long &bytes, unsigned int &hits, unsigned int &misses, unsigned int &evictions) const
+{
+	bytes=m_ResidentBytes;
+	hits=m_Hits;
+	misses=m_Misses;
+	evictions=m_Evictions;
+}
+
+void TexturePainter::Decode(AsyncLoad *load)
+{
+	ostringstream errors;
+	if (load->Extension == "dds")
+		DDSLoader::Load(load->Fullpath, load->Desc, load->Mipmaps, errors);
+	else
+		PNGLoader::Load(load->Fullpath, load->Desc, errors);
+	load->Errors=errors.str();
+}
+
+void TexturePainter::StartLoaderThreads()
+{
+	if (!m_LoaderThreads.empty()) return;
+
+	// leave a core for the render thread
+	long cores=sysconf(_SC_NPROCESSORS_ONLN)-1;
+	if (cores<1) cores=1;
+	if (cores>(long)MAX_LOADER_THREADS) cores=MAX_LOADER_THREADS;
+
+	for (long i=0; i<cores; i++)
+	{
+		pthread_t thread;
+		if (pthread_create(&thread,NULL,LoaderThread,this)!=0) break;
+		m_LoaderThreads.push_back(thread);
+	}
+}
+
+void TexturePainter::StopLoaderThreads()
+{
+	pthread_mutex_lock(&m_LoadMutex);
+	m_LoaderQuit=true;
+	pthread_cond_broadcast(&m_LoadCond);
+	pthread_mutex_unlock(&m_LoadMutex);
+
+	for (vector<pthread_t>::iterator i=m_LoaderThreads.begin(); i!=m_LoaderThreads.end(); ++i)
+	{
+		pthread_join(*i,NULL);
+	}
+	m_LoaderThreads.clear();
+}
+
+void *TexturePainter::LoaderThread(void *p)
+{
+	TexturePainter *painter=static_cast<TexturePainter*>(p);
+
+	pthread_mutex_lock(&painter->m_LoadMutex);
+	while (!painter->m_LoaderQuit)
+	{
+		if (painter->m_DecodeQueue.empty())
+		{
+			pthread_cond_wait(&painter->m_LoadCond,&painter->m_LoadMutex);
+			continue;
+		}
+
+		AsyncLoad *load=painter->m_DecodeQueue.front();
+		painter->m_DecodeQueue.pop_front();
+		pthread_mutex_unlock(&painter->m_LoadMutex);
+
+		Decode(load);
+
+		pthread_mutex_lock(&painter->m_LoadMutex);
+		load->Decoded=true;
+		pthread_cond_broadcast(&painter->m_DecodedCond);
+	}
+	pthread_mutex_unlock(&painter->m_LoadMutex);
+	return NULL;
+}
+
 void TexturePainter::UploadTexture(TextureDesc desc, CreateParams params)
 {
 	glBindTexture(params.Type,params.ID);
@@ -386,6 +910,8 @@ bool TexturePainter::SetCurrent(unsigned int *ids, TextureState *states)
 
 		if (ids[c]!=0)
 		{
+			if (!m_Residency.empty()) TouchTexture(ids[c]);
+
 			map<unsigned int,CubeMapDesc>::iterator i=m_CubeMapMap.find(ids[c]);
 
 			if (i!=m_CubeMapMap.end()) // cubemap texture path
@@ -468,9 +994,16 @@ void TexturePainter::Dump()
 	{
 		TextureDesc info = m_TextureMap[i->second];
 		Trace::Stream<<i->first<<" "<<info.Width<<"X"<<info.Height<<" ";
+		map<unsigned int,Residency>::iterator r=m_Residency.find(i->second);
+		if (r!=m_Residency.end() && r->second.Evicted) Trace::Stream<<"(evicted) ";
 		if (info.Format==GL_RGB) Trace::Stream<<"RGB"<<endl;
 		else if (info.Format==GL_RGBA) Trace::Stream<<"RGBA"<<endl;
+		else Trace::Stream<<endl;
 	}
+
+	Trace::Stream<<"resident: "<<m_ResidentBytes<<" bytes";
+	if (m_TextureBudget>0) Trace::Stream<<" of "<<m_TextureBudget;
+	Trace::Stream<<", hits: "<<m_Hits<<" misses: "<<m_Misses<<" evictions: "<<m_Evictions<<endl;
 }
 
 bool TexturePainter::IsResident(unsigned int id)
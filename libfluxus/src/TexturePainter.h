@@ -20,6 +20,9 @@
 #include <iostream>
 #include <string>
 #include <map>
+#include <vector>
+#include <deque>
+#include <pthread.h>
 #include "OpenGL.h"
 #include "PData.h"
 
@@ -40,6 +43,14 @@ public:
 	Mag(GL_LINEAR), WrapS(GL_REPEAT), WrapT(GL_REPEAT), WrapR(GL_REPEAT),
 	Priority(1), MinLOD(-1000), MaxLOD(1000) {}
 
+	bool operator==(const TextureState &other) const
+	{
+		return TexEnv==other.TexEnv && Min==other.Min && Mag==other.Mag &&
+			WrapS==other.WrapS && WrapT==other.WrapT && WrapR==other.WrapR &&
+			BorderColour==other.BorderColour && Priority==other.Priority &&
+			EnvColour==other.EnvColour && MinLOD==other.MinLOD && MaxLOD==other.MaxLOD;
+	}
+
 	int TexEnv;
 	int Min;
 	int Mag;
@@ -60,7 +71,10 @@ public:
 /// them ready for use. The TexturePainter also contains
 /// a cache, so it knows which filenames map to which
 /// texture ID's - so it won't load and upload files
-/// which are already on the graphics card.
+/// which are already on the graphics card. Textures
+/// can also be loaded in the background, where they are 
+/// decoded by loader threads and uploaded a bit at a 
+/// time each frame, see LoadTextureAsync().
 class TexturePainter
 {
 	friend class PNGLoader;
@@ -90,7 +104,7 @@ public:
 	class CreateParams
 	{
 		public:
-		CreateParams(): ID(-1), Type(GL_TEXTURE_2D), GenerateMipmaps(true), MipLevel(0), Border(0), Compress(false) {}
+		CreateParams(): ID(-1), Type(GL_TEXTURE_2D), GenerateMipmaps(true), MipLevel(0), Border(0), Compress(false), Async(false) {}
 
 		int ID;
 		int Type;
@@ -98,15 +112,56 @@ public:
 		int MipLevel;
 		int Border;
 		bool Compress;
+		bool Async;
 	};
 
 	////////////////////////////////////
 	///@name Texture Generation/Conversion
 	///@{
 
-	/// Loads a texture returns the OpenGL ID number
+	/// Loads a texture returns the OpenGL ID number, or 
+	/// calls LoadTextureAsync() if params.Async is set
 	unsigned int LoadTexture(const string &Filename, CreateParams &params);
 
+	/// Starts loading a texture in the background and returns the 
+	/// OpenGL ID number straight away. New textures are blank until 
+	/// the image is decoded and uploaded by UploadPending(). Loading 
+	/// the same file with LoadTexture() finishes it immediately.
+	unsigned int LoadTextureAsync(const string &Filename, CreateParams &params);
+
+	/// Returns true while a texture from LoadTextureAsync() is still 
+	/// being loaded
+	bool IsLoading(unsigned int id);
+
+	/// Uploads textures which have been decoded in the background, 
+	/// called once a frame. Stops when the upload budget is used up, 
+	/// but always makes some progress
+	void UploadPending();
+
+	/// The time UploadPending() is allowed each frame in milliseconds
+	void SetUploadBudget(float ms) { m_UploadBudget=ms; }
+	///@}
+
+	////////////////////////////////////
+	///@name Residency
+	/// 2D textures loaded from files can be taken off the card 
+	/// when they go over a memory budget, least recently used 
+	/// first. They are loaded again in the background when they 
+	/// are next used, and are blank until then.
+	///@{
+
+	/// Called once a frame, uploads background loads and evicts 
+	/// textures if we're over the budget
+	void Update();
+
+	/// The memory budget in bytes, 0 for no limit (the default)
+	void SetTextureBudget(unsigned long bytes) { m_TextureBudget=bytes; }
+
+	/// Bytes of evictable textures on the card, uses of them in 
+	/// SetCurrent() which were resident (hits) or had to be reloaded 
+	/// (misses), and how many times textures have been evicted
+	void GetCacheStats(unsigned long &bytes, unsigned int &hits, unsigned int &misses, unsigned int &evictions) const;
+
 	/// Loads texture information into a pdata array of colour type
 	bool LoadPData(const string &Filename, unsigned int &w, unsigned int &h, TypedPData<dColour> &pixels);
 
@@ -170,13 +225,83 @@ private:
 		unsigned int Negative[3];
 	};
 
+	//////////////////////////////////////////////////////
+	/// A texture being loaded in the background. The loader
+	/// threads fill in the image data and set Decoded, after 
+	/// that it belongs to the render thread, which copies it 
+	/// into a mapped pixel buffer bit by bit and uploads it
+	class AsyncLoad
+	{
+	public:
+		AsyncLoad() : Track(false), Decoded(false), Buffer(0), Mapped(NULL), Copied(0) {}
+
+		string Fullpath;
+		string Extension;
+		CreateParams Params;
+		bool Track;
+		TextureDesc Desc;
+		vector<TextureDesc> Mipmaps;
+		bool Decoded;
+		/// Problems found by the loader thread, they are written to 
+		/// Trace::Stream by the render thread as it's not thread safe
+		string Errors;
+
+		unsigned int Buffer;
+		unsigned char *Mapped;
+		unsigned int Copied;
+	};
+
+	//////////////////////////////////////////////////////
+	/// What we need to know to evict and reload a texture
+	class Residency
+	{
+	public:
+		Residency() : Bytes(0), LastUsed(0), Evicted(false) {}
+
+		string Fullpath;
+		CreateParams Params;
+		unsigned long Bytes;
+		unsigned int LastUsed;
+		bool Evicted;
+	};
+
 	TexturePainter();
 	~TexturePainter();
 	void ApplyState(int type, TextureState &state, bool cubemap);
 	unsigned int LoadCubeMap(const string &Fullpath, CreateParams &params);
 	void UploadTexture(TextureDesc desc, CreateParams params);
+	void UploadMipmaps(const TextureDesc &desc, const vector<TextureDesc> &mipmaps, CreateParams params);
 	static TexturePainter *m_Singleton;
 
+	///@name Background loading
+	///@{
+	static void *LoaderThread(void *painter);
+	static void Decode(AsyncLoad *load);
+	void StartLoaderThreads();
+	void StopLoaderThreads();
+	/// Waits for the load to be decoded and uploads all of it
+	void FinishAsyncLoad(unsigned int id);
+	/// Copies and uploads as much as it can before the deadline, returns 
+	/// true when the texture is complete
+	bool StreamAsyncLoad(AsyncLoad *load, double deadline);
+	bool CanStream(const AsyncLoad *load);
+	void CompleteAsyncLoad(AsyncLoad *load);
+	/// Drops the loads waiting to be decoded, and waits for the rest
+	void CancelAsyncLoads();
+	static void DeleteAsyncLoad(AsyncLoad *load);
+	AsyncLoad *QueueAsyncLoad(const string &Fullpath, const CreateParams &params);
+	///@}
+
+	///@name Residency
+	///@{
+	void TrackTexture(const string &Fullpath, const CreateParams &params, 
+		const TextureDesc &desc, const vector<TextureDesc> &mipmaps);
+	void UntrackTexture(unsigned int id);
+	/// Records the texture being used, and reloads it if it was evicted
+	void TouchTexture(unsigned int id);
+	void EvictTextures();
+	///@}
+
 	map<string,int> m_LoadedMap;
 	map<string,int> m_LoadedCubeMap;
 	map<unsigned int,TextureDesc> m_TextureMap;
@@ -184,6 +309,28 @@ private:
 	bool m_MultitexturingEnabled;
 	bool m_TextureCompressionEnabled;
 	bool m_SGISGenerateMipmap;
+
+	// background loading
+	vector<pthread_t> m_LoaderThreads;
+	pthread_mutex_t m_LoadMutex;
+	pthread_cond_t m_LoadCond;
+	pthread_cond_t m_DecodedCond;
+	deque<AsyncLoad*> m_DecodeQueue;
+	vector<AsyncLoad*> m_AsyncLoads; // all the loads in progress, oldest first
+	bool m_LoaderQuit;
+	float m_UploadBudget;
+	bool m_PixelBuffersSupported;
+	bool m_NPOTSupported;
+	bool m_GenerateMipmapSupported;
+
+	// residency
+	map<unsigned int,Residency> m_Residency;
+	unsigned long m_TextureBudget;
+	unsigned long m_ResidentBytes;
+	unsigned int m_Frame;
+	unsigned int m_Hits;
+	unsigned int m_Misses;
+	unsigned int m_Evictions;
 };
 
 }
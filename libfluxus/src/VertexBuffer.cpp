@@ -0,0 +1,119 @@
+// Copyright (C) 2010 Dave Griffiths
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+
+#include "VertexBuffer.h"
+#include "Trace.h"
+
+using namespace Fluxus;
+
+bool VertexBuffer::m_Checked(false);
+bool VertexBuffer::m_Supported(false);
+
+VertexBuffer::VertexBuffer()
+{
+}
+
+VertexBuffer::VertexBuffer(const VertexBuffer &other)
+{
+}
+
+VertexBuffer::~VertexBuffer()
+{
+	Clear();
+}
+
+bool VertexBuffer::IsSupported()
+{
+	if (!m_Checked)
+	{
+		m_Supported=glewIsSupported("GL_VERSION_1_5") && glGenBuffers!=NULL;
+		if (!m_Supported)
+		{
+			Trace::Stream<<"Warning: Can't use vertex buffer objects (needs OpenGL 1.5)"<<endl;
+		}
+		m_Checked=true;
+	}
+	return m_Supported;
+}
+
+void VertexBuffer::BindArray(const string &name, PData *data)
+{
+	Buffer &b=m_Arrays[name];
+	if (b.ID==0) glGenBuffers(1,&b.ID);
+	glBindBuffer(GL_ARRAY_BUFFER,b.ID);
+
+	unsigned int elemsize=data->ElementSize();
+	unsigned int bytes=data->Size()*elemsize;
+
+	if (b.Source!=data || b.Bytes!=bytes)
+	{
+		// a new or resized array, so send it all
+		glBufferData(GL_ARRAY_BUFFER,bytes,data->RawData(),GL_STATIC_DRAW);
+		b.Source=data;
+		b.Bytes=bytes;
+	}
+	else if (data->IsDirty())
+	{
+		unsigned int start,end;
+		data->GetDirtyRange(start,end);
+		if (end>start)
+		{
+			glBufferSubData(GL_ARRAY_BUFFER,start*elemsize,(end-start)*elemsize,
+				static_cast<const char*>(data->RawData())+start*elemsize);
+		}
+	}
+
+	data->ClearDirty();
+}
+
+void VertexBuffer::BindIndex(const vector<unsigned int> &index, bool dirty)
+{
+	if (m_Index.ID==0)
+	{
+		glGenBuffers(1,&m_Index.ID);
+		dirty=true;
+	}
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER,m_Index.ID);
+
+	if (dirty && !index.empty())
+	{
+		unsigned int bytes=index.size()*sizeof(unsigned int);
+		if (bytes==m_Index.Bytes) glBufferSubData(GL_ELEMENT_ARRAY_BUFFER,0,bytes,&index[0]);
+		else glBufferData(GL_ELEMENT_ARRAY_BUFFER,bytes,&index[0],GL_STATIC_DRAW);
+		m_Index.Bytes=bytes;
+	}
+}
+
+void VertexBuffer::Unbind()
+{
+	glBindBuffer(GL_ARRAY_BUFFER,0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER,0);
+}
+
+void VertexBuffer::Clear()
+{
+	for (map<string,Buffer>::iterator i=m_Arrays.begin(); i!=m_Arrays.end(); ++i)
+	{
+		glDeleteBuffers(1,&i->second.ID);
+	}
+	m_Arrays.clear();
+
+	if (m_Index.ID!=0)
+	{
+		glDeleteBuffers(1,&m_Index.ID);
+		m_Index=Buffer();
+	}
+}
@@ -0,0 +1,80 @@
+// Copyright (C) 2010 Dave Griffiths
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+
+#ifndef N_VERTEXBUFFER
+#define N_VERTEXBUFFER
+
+#include <map>
+#include <string>
+#include <vector>
+#include "OpenGL.h"
+#include "PData.h"
+
+namespace Fluxus
+{
+
+//////////////////////////////////////////////////////
+/// Keeps copies of pdata arrays on the graphics card
+/// in vertex buffer objects, so static geometry doesn't
+/// need sending every frame. The pdata dirty ranges are
+/// used to decide what needs to be uploaded again.
+class VertexBuffer
+{
+public:
+	VertexBuffer();
+	/// Copies don't share buffers, they get their own when first bound
+	VertexBuffer(const VertexBuffer &other);
+	~VertexBuffer();
+
+	/// Whether the hardware supports buffer objects
+	static bool IsSupported();
+
+	/// Makes sure the buffer for this pdata array is up to date
+	/// and binds it to GL_ARRAY_BUFFER, ready for the gl*Pointer
+	/// calls (which should be given an offset of 0)
+	void BindArray(const string &name, PData *data);
+
+	/// The same for an index array, which is bound to
+	/// GL_ELEMENT_ARRAY_BUFFER - the index has no dirty range
+	/// so it's all sent again if dirty is set
+	void BindIndex(const vector<unsigned int> &index, bool dirty);
+
+	/// Go back to client side arrays
+	static void Unbind();
+
+	/// Deletes the buffers from the graphics card
+	void Clear();
+
+private:
+	class Buffer
+	{
+	public:
+		Buffer() : ID(0), Source(NULL), Bytes(0) {}
+		GLuint ID;
+		const PData *Source;
+		unsigned int Bytes;
+	};
+
+	map<string,Buffer> m_Arrays;
+	Buffer m_Index;
+
+	static bool m_Checked;
+	static bool m_Supported;
+};
+
+};
+
+#endif
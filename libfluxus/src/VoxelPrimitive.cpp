@@ -74,71 +74,121 @@ dColour VoxelPrimitive::SafeRef(unsigned int x, unsigned int y, unsigned int z)
 	return dColour(0,0,0);
 }
 
+// voxels per chunk of work for the threads
+static const unsigned int VOXEL_GRAIN=4096;
+
+void VoxelPrimitive::RunOp(OpJob &job)
+{
+	WorkerPool::Get()->Run(job,m_Width*m_Height*m_Depth,VOXEL_GRAIN);
+}
+
 void VoxelPrimitive::CalcGradient()
 {
-	for (unsigned int x=0; x<m_Width; x++)
-	{
-		for (unsigned int y=0; y<m_Height; y++)
-		{
-			for (unsigned int z=0; z<m_Depth; z++)
-			{
-				(*m_GradData)[Index(x,y,z)]=dColour(SafeRef(x-1,y,z).r-SafeRef(x+1,y,z).r,
-					SafeRef(x,y-1,z).g-SafeRef(x,y+1,z).g,
-					SafeRef(x,y,z-1).b-SafeRef(x,y,z+1).b);
-			}	
-		}
-	}
+	OpJob job(*this,OpJob::GRADIENT);
+	RunOp(job);
 }
 
 void VoxelPrimitive::SphereInfluence(const dVector &pos, const dColour &col, float pow)
 {
-	for (unsigned int i=0; i<m_Width*m_Height*m_Depth; i++)
-	{
-		(*m_ColData)[i]+=col*powf(1/Position(i).dist(pos),pow);
-	}
+	OpJob job(*this,OpJob::SPHERE_INFLUENCE);
+	job.m_Pos=pos;
+	job.m_Col=col;
+	job.m_Value=pow;
+	RunOp(job);
 }
 
 void VoxelPrimitive::SphereSolid(const dVector &pos, const dColour &col, float radius)
 {
-	for (unsigned int i=0; i<m_Width*m_Height*m_Depth; i++)
-	{
-		if (Position(i).dist(pos)<radius) (*m_ColData)[i]=col;
-	}
+	OpJob job(*this,OpJob::SPHERE_SOLID);
+	job.m_Pos=pos;
+	job.m_Col=col;
+	job.m_Value=radius;
+	RunOp(job);
 }
 
 void VoxelPrimitive::BoxSolid(const dVector &topleft, const dVector &botright, const dColour &col)
 {
-	for (unsigned int i=0; i<m_Width*m_Height*m_Depth; i++)
-	{
-		dVector pos=Position(i);
-		if (pos>topleft && pos<botright) (*m_ColData)[i]=col;
-	}
+	OpJob job(*this,OpJob::BOX_SOLID);
+	job.m_Pos=topleft;
+	job.m_Pos2=botright;
+	job.m_Col=col;
+	RunOp(job);
 }
 
 void VoxelPrimitive::Threshold(float value)
 {
-	for (unsigned int i=0; i<m_Width*m_Height*m_Depth; i++)
-	{
-		if ((*m_ColData)[i].mag()<value)
-		{
-			(*m_ColData)[i]=dColour(0,0,0,0);
-		}
-		else
-		{
-			(*m_ColData)[i]=dColour(1,1,1,1);
-		}
-	}
+	OpJob job(*this,OpJob::THRESHOLD);
+	job.m_Value=value;
+	RunOp(job);
 }
 
 void VoxelPrimitive::PointLight(dVector lightpos, dColour col)
 {
-	for (unsigned int i=0; i<m_Width*m_Height*m_Depth; i++)
+	OpJob job(*this,OpJob::POINT_LIGHT);
+	job.m_Pos=lightpos;
+	job.m_Col=col;
+	RunOp(job);
+}
+
+void VoxelPrimitive::OpJob::Run(unsigned int start, unsigned int end)
+{
+	vector<dColour> &c=*m_Voxels.m_ColData;
+	vector<dColour> &g=*m_Voxels.m_GradData;
+	
+	switch (m_Op)
 	{
-		dVector *n=reinterpret_cast<dVector*>(&(*m_GradData)[i]);
-		float lambert = n->dot(lightpos-Position(i));
-		if (lambert>0) (*m_ColData)[i]+=col*lambert;
-		else (*m_ColData)[i]*=0.1; // ambient...
-	}	
+		case SPHERE_INFLUENCE:
+			for (unsigned int i=start; i<end; i++)
+			{
+				c[i]+=m_Col*powf(1/m_Voxels.Position(i).dist(m_Pos),m_Value);
+			}
+		break;
+		
+		case SPHERE_SOLID:
+			for (unsigned int i=start; i<end; i++)
+			{
+				if (m_Voxels.Position(i).dist(m_Pos)<m_Value) c[i]=m_Col;
+			}
+		break;
+		
+		case BOX_SOLID:
+			for (unsigned int i=start; i<end; i++)
+			{
+				dVector pos=m_Voxels.Position(i);
+				if (pos>m_Pos && pos<m_Pos2) c[i]=m_Col;
+			}
+		break;
+		
+		case THRESHOLD:
+			for (unsigned int i=start; i<end; i++)
+			{
+				if (c[i].mag()<m_Value) c[i]=dColour(0,0,0,0);
+				else c[i]=dColour(1,1,1,1);
+			}
+		break;
+		
+		case GRADIENT:
+			for (unsigned int i=start; i<end; i++)
+			{
+				unsigned int x=i%m_Voxels.m_Width;
+				unsigned int y=(i/m_Voxels.m_Width)%m_Voxels.m_Height;
+				unsigned int z=i/(m_Voxels.m_Width*m_Voxels.m_Height);
+				g[i]=dColour(m_Voxels.SafeRef(x-1,y,z).r-m_Voxels.SafeRef(x+1,y,z).r,
+					m_Voxels.SafeRef(x,y-1,z).g-m_Voxels.SafeRef(x,y+1,z).g,
+					m_Voxels.SafeRef(x,y,z-1).b-m_Voxels.SafeRef(x,y,z+1).b);
+			}
+		break;
+		
+		case POINT_LIGHT:
+			for (unsigned int i=start; i<end; i++)
+			{
+				dVector *n=reinterpret_cast<dVector*>(&g[i]);
+				float lambert = n->dot(m_Pos-m_Voxels.Position(i));
+				if (lambert>0) c[i]+=m_Col*lambert;
+				else c[i]*=0.1; // ambient...
+			}
+		break;
+	}
 }
 	
 void VoxelPrimitive::Render()
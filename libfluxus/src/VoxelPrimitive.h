@@ -18,6 +18,7 @@
 #define N_VOXELPRIM
 
 #include "Primitive.h"
+#include "WorkerPool.h"
 
 namespace Fluxus
 {
@@ -67,6 +68,28 @@ protected:
 
 private:
 
+	/// The voxel operations are all independant per voxel, 
+	/// so they are split up between the worker threads
+	class OpJob : public WorkerPool::Job
+	{
+	public:
+		enum Op { SPHERE_INFLUENCE, SPHERE_SOLID, BOX_SOLID, THRESHOLD, GRADIENT, POINT_LIGHT };
+		
+		OpJob(VoxelPrimitive &voxels, Op op) : m_Voxels(voxels), m_Op(op), m_Value(0) {}
+		virtual void Run(unsigned int start, unsigned int end);
+		
+		VoxelPrimitive &m_Voxels;
+		Op m_Op;
+		dVector m_Pos;
+		dVector m_Pos2;
+		dColour m_Col;
+		float m_Value;
+	};
+	
+	friend class OpJob;
+
+	void RunOp(OpJob &job);
+
 	vector<dColour> *m_ColData;
 	vector<dColour> *m_GradData;
 	unsigned int m_Width;
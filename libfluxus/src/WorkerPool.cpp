@@ -0,0 +1,150 @@
+// Copyright (C) 2010 Dave Griffiths
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+
+
+#include <unistd.h>
+#include "WorkerPool.h"
+
+using namespace Fluxus;
+
+WorkerPool *WorkerPool::m_Singleton=NULL;
+
+WorkerPool::WorkerPool() :
+m_Job(NULL),
+m_Size(0),
+m_Grain(1),
+m_Next(0),
+m_Working(0),
+m_Generation(0),
+m_Quit(false)
+{
+	pthread_mutex_init(&m_RunMutex,NULL);
+	pthread_mutex_init(&m_Mutex,NULL);
+	pthread_cond_init(&m_StartCond,NULL);
+	pthread_cond_init(&m_DoneCond,NULL);
+
+	// one thread per core, the caller counts as one
+	long cores=sysconf(_SC_NPROCESSORS_ONLN);
+	for (long i=1; i<cores; i++)
+	{
+		pthread_t thread;
+		if (pthread_create(&thread,NULL,WorkerThread,this)!=0) break;
+		m_Threads.push_back(thread);
+	}
+}
+
+WorkerPool::~WorkerPool()
+{
+	pthread_mutex_lock(&m_Mutex);
+	m_Quit=true;
+	pthread_cond_broadcast(&m_StartCond);
+	pthread_mutex_unlock(&m_Mutex);
+
+	for (vector<pthread_t>::iterator i=m_Threads.begin(); i!=m_Threads.end(); ++i)
+	{
+		pthread_join(*i,NULL);
+	}
+
+	pthread_cond_destroy(&m_DoneCond);
+	pthread_cond_destroy(&m_StartCond);
+	pthread_mutex_destroy(&m_Mutex);
+	pthread_mutex_destroy(&m_RunMutex);
+}
+
+void WorkerPool::Run(Job &job, unsigned int size, unsigned int grain)
+{
+	if (size==0) return;
+	if (grain==0) grain=1;
+
+	// not worth waking anyone up for, or we're already busy
+	if (m_Threads.empty() || size<=grain || pthread_mutex_trylock(&m_RunMutex)!=0)
+	{
+		job.Run(0,size);
+		return;
+	}
+
+	pthread_mutex_lock(&m_Mutex);
+	m_Job=&job;
+	m_Size=size;
+	m_Grain=grain;
+	m_Next=0;
+	m_Working=0;
+	m_Generation++;
+	pthread_cond_broadcast(&m_StartCond);
+	pthread_mutex_unlock(&m_Mutex);
+
+	DoChunks();
+
+	// wait for the chunks other threads are still working on
+	pthread_mutex_lock(&m_Mutex);
+	while (m_Working>0 || m_Next<m_Size)
+	{
+		pthread_cond_wait(&m_DoneCond,&m_Mutex);
+	}
+	m_Job=NULL;
+	pthread_mutex_unlock(&m_Mutex);
+
+	pthread_mutex_unlock(&m_RunMutex);
+}
+
+void WorkerPool::DoChunks()
+{
+	pthread_mutex_lock(&m_Mutex);
+	while (m_Job && m_Next<m_Size)
+	{
+		unsigned int start=m_Next;
+		unsigned int end=start+m_Grain;
+		if (end>m_Size) end=m_Size;
+		m_Next=end;
+		m_Working++;
+		Job *job=m_Job;
+		pthread_mutex_unlock(&m_Mutex);
+
+		job->Run(start,end);
+
+		pthread_mutex_lock(&m_Mutex);
+		m_Working--;
+		if (m_Working==0 && m_Next>=m_Size)
+		{
+			pthread_cond_signal(&m_DoneCond);
+		}
+	}
+	pthread_mutex_unlock(&m_Mutex);
+}
+
+void *WorkerPool::WorkerThread(void *p)
+{
+	WorkerPool *pool=static_cast<WorkerPool*>(p);
+	unsigned int generation=0;
+
+	pthread_mutex_lock(&pool->m_Mutex);
+	while (!pool->m_Quit)
+	{
+		if (pool->m_Job && pool->m_Generation!=generation)
+		{
+			generation=pool->m_Generation;
+			pthread_mutex_unlock(&pool->m_Mutex);
+			pool->DoChunks();
+			pthread_mutex_lock(&pool->m_Mutex);
+		}
+		else
+		{
+			pthread_cond_wait(&pool->m_StartCond,&pool->m_Mutex);
+		}
+	}
+	pthread_mutex_unlock(&pool->m_Mutex);
+	return NULL;
+}
@@ -0,0 +1,95 @@
+// Copyright (C) 2010 Dave Griffiths
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+
+
+#ifndef N_WORKER_POOL
+#define N_WORKER_POOL
+
+#include <vector>
+#include <pthread.h>
+
+using namespace std;
+
+namespace Fluxus
+{
+
+//////////////////////////////////////////////////////
+/// A pool of threads for splitting up big loops over
+/// pdata arrays. Threads are started once and wait 
+/// between jobs. The calling thread works on the job 
+/// too, and Run() only returns when it's all done, so 
+/// jobs can safely use data owned by the caller.
+class WorkerPool
+{
+public:
+	///\todo stop this being a singleton...
+	static WorkerPool* Get()
+	{
+		if (m_Singleton==NULL) m_Singleton=new WorkerPool;
+		return m_Singleton;
+	}
+
+	static void Shutdown()
+	{
+		if (m_Singleton!=NULL) delete m_Singleton;
+		m_Singleton=NULL;
+	}
+
+	/// A loop to be split up between the threads 
+	class Job
+	{
+	public:
+		virtual ~Job() {}
+		/// Do the work for elements start to end-1, this is called 
+		/// from several threads at once with different ranges
+		virtual void Run(unsigned int start, unsigned int end)=0;
+	};
+
+	/// Runs the job over elements 0 to size-1 in chunks of at least 
+	/// grain elements. If the pool is already busy (a job calling Run, 
+	/// or another thread) the job is just run on the calling thread
+	void Run(Job &job, unsigned int size, unsigned int grain=1024);
+
+	/// Including the calling thread
+	unsigned int GetNumThreads() { return m_Threads.size()+1; }
+
+private:
+	WorkerPool();
+	~WorkerPool();
+
+	static void *WorkerThread(void *pool);
+	void DoChunks();
+
+	static WorkerPool *m_Singleton;
+
+	vector<pthread_t> m_Threads;
+	pthread_mutex_t m_RunMutex;
+	pthread_mutex_t m_Mutex;
+	pthread_cond_t m_StartCond;
+	pthread_cond_t m_DoneCond;
+
+	Job *m_Job;
+	unsigned int m_Size;
+	unsigned int m_Grain;
+	unsigned int m_Next;
+	unsigned int m_Working;
+	unsigned int m_Generation;
+	bool m_Quit;
+};
+
+}
+
+#endif
@@ -250,6 +250,11 @@ public:
 
 		float *arr() { return &r; }
 
+		inline bool operator==(dColour const &rhs) const
+		{
+			return r==rhs.r && g==rhs.g && b==rhs.b && a==rhs.a;
+		}
+
 		inline dColour &operator=(dColour const &rhs)
 		{
 			r=rhs.r; g=rhs.g; b=rhs.b; a=rhs.a;
@@ -990,7 +995,7 @@ public:
 	dBoundingBox(const dVector &cmin, const dVector &cmax) : min(cmin), max(cmax) {}
 	virtual ~dBoundingBox() {}
 	
-	bool empty() { return m_Empty; }
+	bool empty() const { return m_Empty; }
 	void getvertices(dVector *out) const;
 	void expand(dVector v);
 	void expand(dBoundingBox v);
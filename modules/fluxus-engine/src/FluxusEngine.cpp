@@ -212,7 +212,8 @@ Scheme_Object *fluxus_render(int argc, Scheme_Object **argv)
 // tick-physics
 // Returns: void
 // Description:
-// Update the physics system.
+// Update the physics system. In 'fixed step mode this uses the time
+// since the last frame, see physics-step-mode.
 // Example:
 // (tick-physics)
 // EndFunctionDoc
@@ -237,7 +238,7 @@ Scheme_Object *fluxus_render(int argc, Scheme_Object **argv)
 
 Scheme_Object *tick_physics(int argc, Scheme_Object **argv)
 {
-  Engine::Get()->Physics()->Tick();
+  Engine::Get()->Physics()->Tick(Engine::Get()->Renderer()->GetDelta());
   return scheme_void;
 }
 
@@ -478,6 +478,7 @@ Scheme_Object *camera_lag(int argc, Scheme_Object **argv)
 // ; mip-level: exact integer
 // ; border: exact integer
 // ; compress: exact integer, 0 or 1
+// ; async: exact integer, 0 or 1 (load in the background, see texture-loaded?)
 //
 // ; setup an environment cube map
 // (define t (load-texture "cube-left.png" (list 'type 'cube-map-positive-x)))
@@ -681,6 +682,14 @@ Scheme_Object *load_texture(int argc, Scheme_Object **argv)
             createparams.Compress = IntFromScheme(SCHEME_VEC_ELS(paramvec)[n+1]);
           }
         }
+        else if (param=="async")
+        {
+          if (SCHEME_NUMBERP(SCHEME_VEC_ELS(paramvec)[n+1]) &&
+              SCHEME_EXACT_INTEGERP(SCHEME_VEC_ELS(paramvec)[n+1]))
+          {
+            createparams.Async = IntFromScheme(SCHEME_VEC_ELS(paramvec)[n+1]);
+          }
+        }
         else Trace::Stream<<"load-texture: unknown parameter "<<param<<endl;
       }
     }
@@ -691,6 +700,106 @@ Scheme_Object *load_texture(int argc, Scheme_Object **argv)
     return scheme_make_integer_value(ret);
 }
 
+// StartFunctionDoc-en
+// texture-loaded? textureid-number
+// Returns: boolean
+// Description:
+// Textures loaded with the 'async option are decoded in the background 
+// and uploaded a bit each frame, and are blank until then. This returns 
+// #f while the texture is still loading, and #t afterwards (even if it 
+// failed to load).
+// Example:
+// (define t (load-texture "mytexture.png" (list 'async 1)))
+// (every-frame 
+//     (when (texture-loaded? t)
+//         (with-state (texture t) (draw-cube))))
+// EndFunctionDoc
+
+Scheme_Object *texture_loaded(int argc, Scheme_Object **argv)
+{
+  DECL_ARGV();
+  ArgCheck("texture-loaded?", "i", argc, argv);
+  bool loading=Engine::Get()->Renderer()->GetTexturePainter()->IsLoading(IntFromScheme(argv[0]));
+  MZ_GC_UNREG();
+  return loading?scheme_false:scheme_true;
+}
+
+// StartFunctionDoc-en
+// texture-upload-budget milliseconds-number
+// Returns: void
+// Description:
+// Sets how much time each frame can be spent sending textures loaded with
+// the 'async option to the graphics card. Big textures are spread over 
+// several frames. The default is 2 milliseconds.
+// Example:
+// (texture-upload-budget 4)
+// EndFunctionDoc
+
+Scheme_Object *texture_upload_budget(int argc, Scheme_Object **argv)
+{
+  DECL_ARGV();
+  ArgCheck("texture-upload-budget", "f", argc, argv);
+  Engine::Get()->Renderer()->GetTexturePainter()->SetUploadBudget(FloatFromScheme(argv[0]));
+  MZ_GC_UNREG();
+  return scheme_void;
+}
+
+// StartFunctionDoc-en
+// texture-cache-budget megabytes-number
+// Returns: void
+// Description:
+// Sets how much graphics card memory textures loaded from files can use, 
+// 0 turns the limit off (the default). When there are more than this, the
+// textures which haven't been used for the longest are taken off the card, 
+// and are loaded again in the background when they're next used.
+// Example:
+// (texture-cache-budget 256)
+// EndFunctionDoc
+
+Scheme_Object *texture_cache_budget(int argc, Scheme_Object **argv)
+{
+  DECL_ARGV();
+  ArgCheck("texture-cache-budget", "f", argc, argv);
+  float mb=FloatFromScheme(argv[0]);
+  Engine::Get()->Renderer()->GetTexturePainter()->SetTextureBudget(mb>0?(unsigned long)(mb*1024*1024):0);
+  MZ_GC_UNREG();
+  return scheme_void;
+}
+
+// StartFunctionDoc-en
+// texture-cache-stats
+// Returns: list of numbers
+// Description:
+// Returns the bytes used by textures loaded from files, the number of times 
+// they were used while on the card (hits) and had to be loaded again (misses),
+// and the number of times textures have been taken off the card.
+// Example:
+// (display (texture-cache-stats)) ; (resident-bytes hits misses evictions)
+// EndFunctionDoc
+
+Scheme_Object *texture_cache_stats(int argc, Scheme_Object **argv)
+{
+  Scheme_Object *stats[4];
+  Scheme_Object *ret = NULL;
+  MZ_GC_DECL_REG(5);
+  MZ_GC_ARRAY_VAR_IN_REG(0, stats, 4);
+  MZ_GC_VAR_IN_REG(3, ret);
+  MZ_GC_REG();
+
+  for (int n=0; n<4; n++) stats[n]=NULL;
+  unsigned long bytes;
+  unsigned int hits, misses, evictions;
+  Engine::Get()->Renderer()->GetTexturePainter()->GetCacheStats(bytes,hits,misses,evictions);
+  stats[0] = scheme_make_integer_value(bytes);
+  stats[1] = scheme_make_integer_value(hits);
+  stats[2] = scheme_make_integer_value(misses);
+  stats[3] = scheme_make_integer_value(evictions);
+  ret = scheme_build_list(4, stats);
+
+  MZ_GC_UNREG();
+  return ret;
+}
+
 // StartFunctionDoc-en
 // clear-texture-cache
 // Returns: void
@@ -2336,6 +2445,152 @@ Scheme_Object *shadow_debug(int argc, Scheme_Object **argv)
   return scheme_void;
 }
 
+// StartFunctionDoc-en
+// shadow-mode mode-symbol
+// Returns: void
+// Description:
+// Chooses how shadows are rendered, with 'stencil (the default) shadow
+// volumes are made on the cpu from the primitives with the cast-shadow
+// hint, with 'map depth maps are rendered from the lights on the graphics
+// card instead, so complex casters don't slow things down. Shadow maps need
+// glsl and frame buffer object support, and several lights can be used with
+// shadow-map-lights. The lighting is done by the usual fixed function
+// lights, and primitives with their own shaders are still masked by the
+// shadows, but don't get the shadow maps to use themselves.
+// Example:
+// (shadow-mode 'map)
+// (shadow-light 1)
+// EndFunctionDoc
+
+Scheme_Object *shadow_mode(int argc, Scheme_Object **argv)
+{
+  DECL_ARGV();
+  ArgCheck("shadow-mode", "S", argc, argv);
+  if (IsSymbol(argv[0], "map"))
+    Engine::Get()->Renderer()->SetShadowMode(Renderer::mapShadows);
+  else if (IsSymbol(argv[0], "stencil"))
+    Engine::Get()->Renderer()->SetShadowMode(Renderer::stencilShadows);
+  else
+    Trace::Stream<<"shadow-mode: unknown mode "<<SymbolName(argv[0])<<endl;
+  MZ_GC_UNREG();
+  return scheme_void;
+}
+
+// StartFunctionDoc-en
+// shadow-map-lights light-list
+// Returns: void
+// Description:
+// Sets the lights which cast shadows in shadow map mode, up to 4 of them. 
+// Each light added doubles the number of times the scene is drawn for the
+// lighting. With an empty list the shadow-light is used.
+// Example:
+// (shadow-mode 'map)
+// (define l1 (make-light 'spot 'free))
+// (light-position l1 (vector 0 10 0))
+// (light-direction l1 (vector 0 -1 0))
+// (light-spot-angle l1 30)
+// (define l2 (make-light 'directional 'free))
+// (light-direction l2 (vector 1 1 0))
+// (shadow-map-lights (list l1 l2))
+// EndFunctionDoc
+
+Scheme_Object *shadow_map_lights(int argc, Scheme_Object **argv)
+{
+  Scheme_Object *lightvec = NULL;
+  MZ_GC_DECL_REG(2);
+  MZ_GC_VAR_IN_REG(0, argv);
+  MZ_GC_VAR_IN_REG(1, lightvec);
+  MZ_GC_REG();
+  ArgCheck("shadow-map-lights", "l", argc, argv);
+  lightvec = scheme_list_to_vector(argv[0]);
+  vector<int> ids = IntVectorFromScheme(lightvec);
+  vector<unsigned int> lights;
+  for (vector<int>::iterator i=ids.begin(); i!=ids.end(); ++i)
+  {
+    if (*i>=0) lights.push_back(*i);
+  }
+  Engine::Get()->Renderer()->ShadowMapLights(lights);
+  MZ_GC_UNREG();
+  return scheme_void;
+}
+
+// StartFunctionDoc-en
+// shadow-map-size size-number
+// Returns: void
+// Description:
+// Sets the width and height of the shadow maps, the default is 1024.
+// Example:
+// (shadow-map-size 2048)
+// EndFunctionDoc
+
+Scheme_Object *shadow_map_size(int argc, Scheme_Object **argv)
+{
+  DECL_ARGV();
+  ArgCheck("shadow-map-size", "i", argc, argv);
+  Engine::Get()->Renderer()->ShadowMapSize(IntFromScheme(argv[0]));
+  MZ_GC_UNREG();
+  return scheme_void;
+}
+
+// StartFunctionDoc-en
+// shadow-map-cascades count-number
+// Returns: void
+// Description:
+// Sets how many shadow maps the view is split into for directional lights,
+// from 1 to 4, the default is 3. Nearer maps cover less of the view, so
+// close up shadows are sharper.
+// Example:
+// (shadow-map-cascades 4)
+// EndFunctionDoc
+
+Scheme_Object *shadow_map_cascades(int argc, Scheme_Object **argv)
+{
+  DECL_ARGV();
+  ArgCheck("shadow-map-cascades", "i", argc, argv);
+  Engine::Get()->Renderer()->ShadowMapCascades(IntFromScheme(argv[0]));
+  MZ_GC_UNREG();
+  return scheme_void;
+}
+
+// StartFunctionDoc-en
+// shadow-map-bias bias-number
+// Returns: void
+// Description:
+// Sets how much the depth is offset when comparing against the shadow 
+// maps, turn it up if surfaces shadow themselves, the default is 0.002.
+// Example:
+// (shadow-map-bias 0.005)
+// EndFunctionDoc
+
+Scheme_Object *shadow_map_bias(int argc, Scheme_Object **argv)
+{
+  DECL_ARGV();
+  ArgCheck("shadow-map-bias", "f", argc, argv);
+  Engine::Get()->Renderer()->ShadowMapBias(FloatFromScheme(argv[0]));
+  MZ_GC_UNREG();
+  return scheme_void;
+}
+
+// StartFunctionDoc-en
+// shadow-map-distance distance-number
+// Returns: void
+// Description:
+// Sets how far from the camera shadow maps are drawn, the default is 100.
+// The maps are spread over this distance, so the shorter it is the sharper
+// the shadows are.
+// Example:
+// (shadow-map-distance 50)
+// EndFunctionDoc
+
+Scheme_Object *shadow_map_distance(int argc, Scheme_Object **argv)
+{
+  DECL_ARGV();
+  ArgCheck("shadow-map-distance", "f", argc, argv);
+  Engine::Get()->Renderer()->ShadowMapDistance(FloatFromScheme(argv[0]));
+  MZ_GC_UNREG();
+  return scheme_void;
+}
+
 // StartFunctionDoc-en
 // accum mode-symbol value-number
 // Returns: void
@@ -2566,6 +2821,10 @@ void GlobalStateFunctions::AddGlobals(Scheme_Env *env)
   scheme_add_global("camera-lag", scheme_make_prim_w_arity(camera_lag, "camera-lag", 1, 1), env);
   scheme_add_global("load-texture", scheme_make_prim_w_arity(load_texture, "load-texture", 1, 2), env);
   scheme_add_global("clear-texture-cache", scheme_make_prim_w_arity(clear_texture_cache, "clear-texture-cache", 0, 0), env);
+  scheme_add_global("texture-loaded?", scheme_make_prim_w_arity(texture_loaded, "texture-loaded?", 1, 1), env);
+  scheme_add_global("texture-upload-budget", scheme_make_prim_w_arity(texture_upload_budget, "texture-upload-budget", 1, 1), env);
+  scheme_add_global("texture-cache-budget", scheme_make_prim_w_arity(texture_cache_budget, "texture-cache-budget", 1, 1), env);
+  scheme_add_global("texture-cache-stats", scheme_make_prim_w_arity(texture_cache_stats, "texture-cache-stats", 0, 0), env);
   scheme_add_global("frustum", scheme_make_prim_w_arity(frustum, "frustum", 4, 4), env);
   scheme_add_global("clip", scheme_make_prim_w_arity(clip, "clip", 2, 2), env);
   scheme_add_global("ortho", scheme_make_prim_w_arity(ortho, "ortho", 0, 0), env);
@@ -2596,6 +2855,12 @@ void GlobalStateFunctions::AddGlobals(Scheme_Env *env)
   scheme_add_global("shadow-light", scheme_make_prim_w_arity(shadow_light, "shadow-light", 1, 1), env);
   scheme_add_global("shadow-length", scheme_make_prim_w_arity(shadow_length, "shadow-length", 1, 1), env);
   scheme_add_global("shadow-debug", scheme_make_prim_w_arity(shadow_debug, "shadow-ldebug", 1, 1), env);
+  scheme_add_global("shadow-mode", scheme_make_prim_w_arity(shadow_mode, "shadow-mode", 1, 1), env);
+  scheme_add_global("shadow-map-lights", scheme_make_prim_w_arity(shadow_map_lights, "shadow-map-lights", 1, 1), env);
+  scheme_add_global("shadow-map-size", scheme_make_prim_w_arity(shadow_map_size, "shadow-map-size", 1, 1), env);
+  scheme_add_global("shadow-map-cascades", scheme_make_prim_w_arity(shadow_map_cascades, "shadow-map-cascades", 1, 1), env);
+  scheme_add_global("shadow-map-bias", scheme_make_prim_w_arity(shadow_map_bias, "shadow-map-bias", 1, 1), env);
+  scheme_add_global("shadow-map-distance", scheme_make_prim_w_arity(shadow_map_distance, "shadow-map-distance", 1, 1), env);
   scheme_add_global("accum", scheme_make_prim_w_arity(accum, "accum", 2, 2), env);
   scheme_add_global("print-info", scheme_make_prim_w_arity(print_info, "print-info", 0, 0), env);
   scheme_add_global("set-cursor",scheme_make_prim_w_arity(set_cursor,"set-cursor",1,1), env);
@@ -1336,7 +1336,14 @@ Scheme_Object *blend_mode(int argc, Scheme_Object **argv)
 // 'zwrite - Enables/disables z writes. Useful to disable for sometimes hacking
 //    transparency.
 // 'lit - turn on lighting
-// 'all - all of the hints above
+// 'vbo - keep the primitive data on the graphics card, only the pdata which
+//    has been changed is sent again. Speeds up rendering of big static or
+//    rarely changed meshes (only poly primitives support this at present).
+// 'sprites - draw solid particles as hardware point sprites, which is much
+//    faster for big particle systems. The particles are square, and sized by
+//    the x of their "s" pdata.
+// 'all - all of the hints above, apart from 'vbo and 'sprites which change
+//    how the primitive is stored and drawn rather than what's drawn
 //
 // Example:
 // (clear)
@@ -1365,7 +1372,7 @@ Scheme_Object *hints(int argc, Scheme_Object **argv, int on)
 		string s = SymbolName(argv[n]);
 		if (s == "all")
 		{
-			flags = ~0;
+			flags = ~(HINT_SPRITES|HINT_VBO);
 			neg_flags = 0;
 		}
 		else if (s == "solid")
@@ -1452,6 +1459,14 @@ Scheme_Object *hints(int argc, Scheme_Object **argv, int on)
 		{
 			neg_flags |= HINT_CULL_CCW;
 		}
+		else if (s == "vbo")
+		{
+			flags |= HINT_VBO;
+		}
+		else if (s == "sprites")
+		{
+			flags |= HINT_SPRITES;
+		}
 		else
 		{
 			Trace::Stream << "hint symbol not recognised: " << s << endl;
@@ -2851,162 +2866,212 @@ Scheme_Object *clear_shader_cache(int argc, Scheme_Object **argv)
 // (every-frame (animate))
 // EndFunctionDoc
 
-Scheme_Object *shader_set(int argc, Scheme_Object **argv)
+// converts a scheme argument to a uniform value, returns false if it couldn't
+static bool UniformFromScheme(Scheme_Object *arg, UniformValue &value)
 {
-  Scheme_Object *paramvec = NULL;
   Scheme_Object *listvec = NULL;
-  MZ_GC_DECL_REG(3);
-  MZ_GC_VAR_IN_REG(0, argv);
-  MZ_GC_VAR_IN_REG(1, paramvec);
-  MZ_GC_VAR_IN_REG(2, listvec);
+  MZ_GC_DECL_REG(2);
+  MZ_GC_VAR_IN_REG(0, arg);
+  MZ_GC_VAR_IN_REG(1, listvec);
   MZ_GC_REG();
 
-    ArgCheck("shader-set!", "l", argc, argv);
-
-  if (Engine::Get()->State()->Shader!=NULL)
+  bool ok=false;
+  if (SCHEME_NUMBERP(arg))
   {
-    GLSLShader *shader=Engine::Get()->State()->Shader;
-
-    // vectors seem easier to handle than lists with this api
-    paramvec = scheme_list_to_vector(argv[0]);
-
-    // apply to set parameters
-    shader->Apply();
-
-    for (int n=0; n<SCHEME_VEC_SIZE(paramvec); n+=2)
+    if (SCHEME_EXACT_INTEGERP(arg))
+    {
+      value=UniformValue(IntFromScheme(arg));
+      ok=true;
+    }
+    else
+    {
+      value=UniformValue((float)FloatFromScheme(arg));
+      ok=true;
+    }
+  }
+  else if (SCHEME_VECTORP(arg))
+  {
+    if (SCHEME_VEC_SIZE(arg) == 3)
+    {
+      dVector vec;
+      FloatsFromScheme(arg,vec.arr(),3);
+      value=UniformValue(vec);
+      ok=true;
+    }
+    else if (SCHEME_VEC_SIZE(arg) == 4)
+    {
+      dColour vec;
+      FloatsFromScheme(arg,vec.arr(),4);
+      value=UniformValue(vec);
+      ok=true;
+    }
+    else
+    {
+      Trace::Stream<<"shader has found an argument vector of a strange size"<<endl;
+    }
+  }
+  else if (SCHEME_LISTP(arg))
+  {
+    listvec = scheme_list_to_vector(arg);
+    unsigned int sz = SCHEME_VEC_SIZE(listvec);
+    if (sz>0)
     {
-      if (SCHEME_CHAR_STRINGP(SCHEME_VEC_ELS(paramvec)[n]) && SCHEME_VEC_SIZE(paramvec)>n+1)
+      if (SCHEME_NUMBERP(SCHEME_VEC_ELS(listvec)[0]))
       {
-        // get the parameter name
-        string param = StringFromScheme(SCHEME_VEC_ELS(paramvec)[n]);
-
-        if (SCHEME_NUMBERP(SCHEME_VEC_ELS(paramvec)[n+1]))
+        if (SCHEME_EXACT_INTEGERP(SCHEME_VEC_ELS(listvec)[0]))
         {
-          if (SCHEME_EXACT_INTEGERP(SCHEME_VEC_ELS(paramvec)[n+1]))
+          vector<int> array;
+          for (unsigned int i=0; i<sz; i++)
           {
-            shader->SetInt(param,IntFromScheme(SCHEME_VEC_ELS(paramvec)[n+1]));
+            if (!SCHEME_EXACT_INTEGERP(SCHEME_VEC_ELS(listvec)[i]))
+            {
+              Trace::Stream<<"found a dodgy element in a uniform array"<<endl;
+              break;
+            }
+            array.push_back(IntFromScheme(SCHEME_VEC_ELS(listvec)[i]));
           }
-          else
+          value=UniformValue(array);
+          ok=true;
+        }
+        else
+        {
+          vector<float> array;
+          for (unsigned int i=0; i<sz; i++)
           {
-            shader->SetFloat(param,(float)FloatFromScheme(SCHEME_VEC_ELS(paramvec)[n+1]));
+            if (!SCHEME_NUMBERP(SCHEME_VEC_ELS(listvec)[i]))
+            {
+              Trace::Stream<<"found a dodgy element in a uniform array"<<endl;
+              break;
+            }
+            array.push_back(FloatFromScheme(SCHEME_VEC_ELS(listvec)[i]));
           }
+          value=UniformValue(array);
+          ok=true;
         }
-        else if (SCHEME_VECTORP(SCHEME_VEC_ELS(paramvec)[n+1]))
+      }
+      else if (SCHEME_VECTORP(SCHEME_VEC_ELS(listvec)[0]))
+      {
+        if (SCHEME_VEC_SIZE(SCHEME_VEC_ELS(listvec)[0]) == 3)
         {
-          if (SCHEME_VEC_SIZE(SCHEME_VEC_ELS(paramvec)[n+1]) == 3)
+          vector<dVector> array;
+          for (unsigned int i=0; i<sz; i++)
           {
+            if (!SCHEME_VECTORP(SCHEME_VEC_ELS(listvec)[i]) ||
+              SCHEME_VEC_SIZE(SCHEME_VEC_ELS(listvec)[i]) != 3)
+            {
+              Trace::Stream<<"found a dodgy element in a uniform array"<<endl;
+              break;
+            }
             dVector vec;
-            FloatsFromScheme(SCHEME_VEC_ELS(paramvec)[n+1],vec.arr(),3);
-            shader->SetVector(param,vec);
-          }
-          else if (SCHEME_VEC_SIZE(SCHEME_VEC_ELS(paramvec)[n+1]) == 4)
-          {
-            dColour vec;
-            FloatsFromScheme(SCHEME_VEC_ELS(paramvec)[n+1],vec.arr(),4);
-            shader->SetColour(param,vec);
-          }
-          else
-          {
-            Trace::Stream<<"shader has found an argument vector of a strange size"<<endl;
+            FloatsFromScheme(SCHEME_VEC_ELS(listvec)[i],vec.arr(),3);
+            array.push_back(vec);
           }
+          value=UniformValue(array);
+          ok=true;
         }
-        else if (SCHEME_LISTP(SCHEME_VEC_ELS(paramvec)[n+1]))
+        else if (SCHEME_VEC_SIZE(SCHEME_VEC_ELS(listvec)[0]) == 4)
         {
-          listvec = scheme_list_to_vector(SCHEME_VEC_ELS(paramvec)[n+1]);
-          unsigned int sz = SCHEME_VEC_SIZE(listvec);
-          if (sz>0)
+          vector<dColour> array;
+          for (unsigned int i=0; i<sz; i++)
           {
-            if (SCHEME_NUMBERP(SCHEME_VEC_ELS(listvec)[0]))
-            {
-              if (SCHEME_EXACT_INTEGERP(SCHEME_VEC_ELS(listvec)[0]))
-              {
-                vector<int> array;
-                for (unsigned int i=0; i<sz; i++)
-                {
-                  if (!SCHEME_EXACT_INTEGERP(SCHEME_VEC_ELS(listvec)[i]))
-                  {
-                    Trace::Stream<<"found a dodgy element in a uniform array"<<endl;
-                    break;
-                  }
-                  array.push_back(IntFromScheme(SCHEME_VEC_ELS(listvec)[i]));
-                }
-                shader->SetIntArray(param,array);
-              }
-              else
-              {
-                vector<float> array;
-                for (unsigned int i=0; i<sz; i++)
-                {
-                  if (!SCHEME_NUMBERP(SCHEME_VEC_ELS(listvec)[i]))
-                  {
-                    Trace::Stream<<"found a dodgy element in a uniform array"<<endl;
-                    break;
-                  }
-                  array.push_back(FloatFromScheme(SCHEME_VEC_ELS(listvec)[i]));
-                }
-                shader->SetFloatArray(param,array);
-              }
-            }
-            else if (SCHEME_VECTORP(SCHEME_VEC_ELS(listvec)[0]))
+            if (!SCHEME_VECTORP(SCHEME_VEC_ELS(listvec)[i]) ||
+              SCHEME_VEC_SIZE(SCHEME_VEC_ELS(listvec)[i]) != 4)
             {
-              if (SCHEME_VEC_SIZE(SCHEME_VEC_ELS(listvec)[0]) == 3)
-              {
-                vector<dVector> array;
-                for (unsigned int i=0; i<sz; i++)
-                {
-                  if (!SCHEME_VECTORP(SCHEME_VEC_ELS(listvec)[i]) ||
-                    SCHEME_VEC_SIZE(SCHEME_VEC_ELS(listvec)[i]) != 3)
-                  {
-                    Trace::Stream<<"found a dodgy element in a uniform array"<<endl;
-                    break;
-                  }
-                  dVector vec;
-                  FloatsFromScheme(SCHEME_VEC_ELS(listvec)[i],vec.arr(),3);
-                  array.push_back(vec);
-                }
-                shader->SetVectorArray(param,array);
-              }
-              else if (SCHEME_VEC_SIZE(SCHEME_VEC_ELS(listvec)[0]) == 4)
-              {
-                vector<dColour> array;
-                for (unsigned int i=0; i<sz; i++)
-                {
-                  if (!SCHEME_VECTORP(SCHEME_VEC_ELS(listvec)[i]) ||
-                    SCHEME_VEC_SIZE(SCHEME_VEC_ELS(listvec)[i]) != 4)
-                  {
-                    Trace::Stream<<"found a dodgy element in a uniform array"<<endl;
-                    break;
-                  }
-                  dColour vec;
-                  FloatsFromScheme(SCHEME_VEC_ELS(listvec)[i],vec.arr(),4);
-                  array.push_back(vec);
-                }
-                shader->SetColourArray(param,array);
-              }
-              else
-              {
-                Trace::Stream<<"shader has found a vector argument list of a strange size"<<endl;
-              }
+              Trace::Stream<<"found a dodgy element in a uniform array"<<endl;
+              break;
             }
+            dColour vec;
+            FloatsFromScheme(SCHEME_VEC_ELS(listvec)[i],vec.arr(),4);
+            array.push_back(vec);
           }
+          value=UniformValue(array);
+          ok=true;
         }
         else
         {
-          Trace::Stream<<"shader has found an argument type it can't send, numbers and vectors, or lists of them only"<<endl;
+          Trace::Stream<<"shader has found a vector argument list of a strange size"<<endl;
         }
       }
-      else
+    }
+  }
+  else
+  {
+    Trace::Stream<<"shader has found an argument type it can't send, numbers and vectors, or lists of them only"<<endl;
+  }
+
+  MZ_GC_UNREG();
+  return ok;
+}
+
+// sends a parameter list to a shader, or to all of them if shader is NULL
+static void ShaderSetFromScheme(const char *function, GLSLShader *shader, Scheme_Object *paramlist)
+{
+  Scheme_Object *paramvec = NULL;
+  MZ_GC_DECL_REG(2);
+  MZ_GC_VAR_IN_REG(0, paramlist);
+  MZ_GC_VAR_IN_REG(1, paramvec);
+  MZ_GC_REG();
+
+  // vectors seem easier to handle than lists with this api
+  paramvec = scheme_list_to_vector(paramlist);
+
+  for (int n=0; n<SCHEME_VEC_SIZE(paramvec); n+=2)
+  {
+    if (SCHEME_CHAR_STRINGP(SCHEME_VEC_ELS(paramvec)[n]) && SCHEME_VEC_SIZE(paramvec)>n+1)
+    {
+      // get the parameter name
+      string param = StringFromScheme(SCHEME_VEC_ELS(paramvec)[n]);
+      UniformValue value;
+      if (UniformFromScheme(SCHEME_VEC_ELS(paramvec)[n+1],value))
       {
-        Trace::Stream<<"shader has found a mal-formed parameter list"<<endl;
+        if (shader!=NULL) shader->SetUniform(param,value);
+        else GLSLShader::SetSharedUniform(param,value);
       }
     }
-    GLSLShader::Unapply();
+    else
+    {
+      Trace::Stream<<function<<" has found a mal-formed parameter list"<<endl;
+    }
+  }
+
+  MZ_GC_UNREG();
+}
+
+Scheme_Object *shader_set(int argc, Scheme_Object **argv)
+{
+  DECL_ARGV();
+  ArgCheck("shader-set!", "l", argc, argv);
+
+  // the values are sent when the shader is next applied
+  if (Engine::Get()->State()->Shader!=NULL)
+  {
+    ShaderSetFromScheme("shader-set!",Engine::Get()->State()->Shader,argv[0]);
   }
 
   MZ_GC_UNREG();
   return scheme_void;
 }
 
+// StartFunctionDoc-en
+// shader-shared-set! argument-list
+// Returns: void
+// Description:
+// Sets uniform parameters for every shader with a variable of that name, in the 
+// same way as shader-set!. This is much quicker than setting the same values on 
+// lots of objects, as each shader picks up the changes once when it's next used.
+// Example:
+// (shader-shared-set! (list "lightpos" (vector 0 10 0) "time" (time)))
+// EndFunctionDoc
+
+Scheme_Object *shader_shared_set(int argc, Scheme_Object **argv)
+{
+  DECL_ARGV();
+  ArgCheck("shader-shared-set!", "l", argc, argv);
+  ShaderSetFromScheme("shader-shared-set!",NULL,argv[0]);
+  MZ_GC_UNREG();
+  return scheme_void;
+}
+
 // StartFunctionDoc-en
 // texture-params texture-unit-number parameter-list
 // Returns: void
@@ -3284,6 +3349,7 @@ void LocalStateFunctions::AddGlobals(Scheme_Env *env)
 	scheme_add_global("shader-source",scheme_make_prim_w_arity(shader_source,"shader-source",2,2), env);
 	scheme_add_global("clear-shader-cache",scheme_make_prim_w_arity(clear_shader_cache,"clear-shader-cache",0,0), env);
 	scheme_add_global("shader-set!",scheme_make_prim_w_arity(shader_set,"shader-set!",1,1), env);
+	scheme_add_global("shader-shared-set!",scheme_make_prim_w_arity(shader_shared_set,"shader-shared-set!",1,1), env);
 	scheme_add_global("texture-params",scheme_make_prim_w_arity(texture_params,"texture-params",2,2), env);
 	scheme_add_global("backfacecull",scheme_make_prim_w_arity(backfacecull,"backfacecull",1,1), env);
 	MZ_GC_UNREG();
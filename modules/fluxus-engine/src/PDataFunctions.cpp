@@ -83,11 +83,77 @@ using namespace Fluxus;
 // (ungrab)
 // EndSectionDoc
 
+// pdata handles are interned pdata names, which remember the array 
+// they were last resolved to. They are only looked up again when the 
+// grabbed primitive changes, or it's arrays are added or removed.
+struct PDataHandle
+{
+	string Name;
+	const Primitive *Prim;
+	unsigned int Version;
+	PData *Data;
+	char Type;
+};
+
+static vector<PDataHandle> Handles;
+static map<string,int> HandleIDs;
+
+// finds a pdata array on the primitive from a name string or a handle,
+// returns NULL if it doesn't exist. Nothing is marked dirty, callers 
+// need to mark what they write. The name is only filled in if asked for
+static PData *FindPData(Primitive *prim, Scheme_Object *arg, char &type, string *name=NULL)
+{
+	if (SCHEME_CHAR_STRINGP(arg))
+	{
+		string n=StringFromScheme(arg);
+		PData *pd=prim->GetDataRawUnmarked(n);
+		if (pd) type=PDataContainer::GetDataType(pd);
+		if (name) *name=n;
+		return pd;
+	}
+	
+	if (SCHEME_INTP(arg))
+	{
+		int id=SCHEME_INT_VAL(arg);
+		if (id>=0 && id<(int)Handles.size())
+		{
+			PDataHandle &h=Handles[id];
+			if (h.Prim!=prim || h.Version!=prim->GetDataVersion())
+			{
+				h.Prim=prim;
+				h.Version=prim->GetDataVersion();
+				h.Data=prim->GetDataRawUnmarked(h.Name);
+				h.Type=h.Data?PDataContainer::GetDataType(h.Data):0;
+			}
+			type=h.Type;
+			if (name) *name=h.Name;
+			return h.Data;
+		}
+	}
+	
+	Trace::Stream<<"expected a pdata name or handle"<<endl;
+	return NULL;
+}
+
+// number of floats in each element of a pdata type
+static unsigned int PDataWidth(char type)
+{
+	switch (type)
+	{
+		case 'f': return 1;
+		case 'v': return 3;
+		case 'c': return 4;
+		case 'm': return 16;
+	}
+	return 0;
+}
+
 // StartFunctionDoc-en
-// pdata-ref type-string index-number
+// pdata-ref type-string/handle-number index-number
 // Returns: value-vector/colour/matrix/number
 // Description:
-// Returns the corresponding pdata element.
+// Returns the corresponding pdata element. The pdata can be named by a
+// string, or a handle from pdata-handle.
 // Example:
 // (pdata-ref "p" 1)
 // EndFunctionDoc
@@ -109,33 +175,33 @@ Scheme_Object *pdata_ref(int argc, Scheme_Object **argv)
 	MZ_GC_VAR_IN_REG(0, argv);
 	MZ_GC_VAR_IN_REG(1, ret);
 	MZ_GC_REG();	
-	ArgCheck("pdata-ref", "si", argc, argv);		
+	ArgCheck("pdata-ref", "?i", argc, argv);		
 	
 	Primitive *Grabbed=Engine::Get()->Renderer()->Grabbed();    
 	if (Grabbed) 
 	{
-		string name=StringFromScheme(argv[0]);
 		unsigned int index=IntFromScheme(argv[1]);
-		unsigned int size=0;
-		char type;
+		char type=0;
+		PData *pd=FindPData(Grabbed,argv[0],type);
 		
-		if (Grabbed->GetDataInfo(name,type,size))
+		if (pd && pd->Size()>0)
 		{
+			unsigned int size=pd->Size();
 			if (type=='f')	
 			{
-				ret=scheme_make_double(Grabbed->GetData<float>(name,index%size)); 
+				ret=scheme_make_double(static_cast<TypedPData<float>*>(pd)->m_Data[index%size]); 
 			}
 			else if (type=='v')	
 			{
-				ret=FloatsToScheme(Grabbed->GetData<dVector>(name,index%size).arr(),3); 
+				ret=FloatsToScheme(static_cast<TypedPData<dVector>*>(pd)->m_Data[index%size].arr(),3); 
 			}
 			else if (type=='c')	
 			{
-				ret=FloatsToScheme(Grabbed->GetData<dColour>(name,index%size).arr(),4); 
+				ret=FloatsToScheme(static_cast<TypedPData<dColour>*>(pd)->m_Data[index%size].arr(),4); 
 			}
 			else if (type=='m')	
 			{
-				ret=FloatsToScheme(Grabbed->GetData<dMatrix>(name,index%size).arr(),16); 
+				ret=FloatsToScheme(static_cast<TypedPData<dMatrix>*>(pd)->m_Data[index%size].arr(),16); 
 			}
 			else
 			{
@@ -165,10 +231,11 @@ Scheme_Object *pdata_ref(int argc, Scheme_Object **argv)
 }
 
 // StartFunctionDoc-en
-// pdata-set! type-string index-number value-vector/colour/matrix/number
+// pdata-set! type-string/handle-number index-number value-vector/colour/matrix/number
 // Returns: void
 // Description:
-// Writes to the corresponding pdata element.
+// Writes to the corresponding pdata element. The pdata can be named by a
+// string, or a handle from pdata-handle.
 // Example:
 // (pdata-set! "p" 1 (vector 0 100 0))
 // EndFunctionDoc
@@ -187,21 +254,25 @@ Scheme_Object *pdata_set(int argc, Scheme_Object **argv)
 	MZ_GC_DECL_REG(1);
 	MZ_GC_VAR_IN_REG(0, argv);
 	MZ_GC_REG();
-	ArgCheck("pdata-set!", "si?", argc, argv);
+	ArgCheck("pdata-set!", "?i?", argc, argv);
     Primitive *Grabbed=Engine::Get()->Renderer()->Grabbed();
 	if (Grabbed)
 	{
-		size_t ssize=0;
-		string name=StringFromScheme(argv[0]);
+		string name;
 		unsigned int index=IntFromScheme(argv[1]);
-		unsigned int size;
-		char type;
+		char type=0;
+		PData *pd=FindPData(Grabbed,argv[0],type,&name);
 
-		if (Grabbed->GetDataInfo(name,type,size))
+		if (pd && pd->Size()>0)
 		{
+			index%=pd->Size();
 			if (type=='f')
 			{
-				if (SCHEME_NUMBERP(argv[2])) Grabbed->SetData<float>(name,index%size,FloatFromScheme(argv[2]));
+				if (SCHEME_NUMBERP(argv[2])) 
+				{
+					static_cast<TypedPData<float>*>(pd)->m_Data[index]=FloatFromScheme(argv[2]);
+					pd->SetDirty(index);
+				}
 				else Trace::Stream<<"expected number value in pdata-set"<<endl;
 			}
 			else if (type=='v')
@@ -210,7 +281,8 @@ Scheme_Object *pdata_set(int argc, Scheme_Object **argv)
 				{
 					dVector v;
 					FloatsFromScheme(argv[2],v.arr(),3);
-					Grabbed->SetData<dVector>(name,index%size,v);
+					static_cast<TypedPData<dVector>*>(pd)->m_Data[index]=v;
+					pd->SetDirty(index);
 				}
 				else if (name.compare("s")==0) // one value scale
 				{
@@ -218,7 +290,8 @@ Scheme_Object *pdata_set(int argc, Scheme_Object **argv)
 					{
 						float t=FloatFromScheme(argv[2]);
 						dVector v(t,t,t);
-						Grabbed->SetData<dVector>(name,index%size,v);
+						static_cast<TypedPData<dVector>*>(pd)->m_Data[index]=v;
+						pd->SetDirty(index);
 					}
 					else Trace::Stream<<"expected number or vector (size 3) value in pdata-set"<<endl;
 				}
@@ -228,22 +301,8 @@ Scheme_Object *pdata_set(int argc, Scheme_Object **argv)
 			{
 				ArgCheck("pdata-set!", "c", 1, &argv[2]);
 				dColour c=ColourFromScheme(argv[2],Grabbed->GetState()->ColourMode);
-				Grabbed->SetData<dColour>(name,index%size,c);
-				/*
-				if (SCHEME_VECTORP(argv[2]) && SCHEME_VEC_SIZE(argv[2])>=3 && SCHEME_VEC_SIZE(argv[2])<=4)
-				{
-					dColour c;
-					if (SCHEME_VEC_SIZE(argv[2])==3) FloatsFromScheme(argv[2],c.arr(),3);
-					else FloatsFromScheme(argv[2],c.arr(),4);
-					if (Grabbed->GetState()->ColourMode==MODE_HSV)
-					{
-						c = c.HSVtoRGB();
-					}
-
-					Grabbed->SetData<dColour>(name,index%size,c);
-				}
-				else Trace::Stream<<"expected colour vector (size 3 or 4) value in pdata-set"<<endl;
-				*/
+				static_cast<TypedPData<dColour>*>(pd)->m_Data[index]=c;
+				pd->SetDirty(index);
 			}
 			else if (type=='m')
 			{
@@ -251,7 +310,8 @@ Scheme_Object *pdata_set(int argc, Scheme_Object **argv)
 				{
 					dMatrix m;
 					FloatsFromScheme(argv[2],m.arr(),16);
-					Grabbed->SetData<dMatrix>(name,index%size,m);
+					static_cast<TypedPData<dMatrix>*>(pd)->m_Data[index]=m;
+					pd->SetDirty(index);
 				}
 				else Trace::Stream<<"expected matrix vector (size 16) value in pdata-set"<<endl;
 			}
@@ -261,6 +321,164 @@ Scheme_Object *pdata_set(int argc, Scheme_Object **argv)
     return scheme_void;
 }
 
+// StartFunctionDoc-en
+// pdata-handle type-string
+// Returns: handle-number
+// Description:
+// Returns a handle for a pdata name, which can be used instead of the name 
+// string in pdata-ref, pdata-set!, pdata->flvector and flvector->pdata!. 
+// The array is looked up once and remembered, so this saves the string 
+// conversion and lookup on every call when you are accessing lots of elements.
+// Handles work with any primitive, the lookup is only done again when the 
+// grabbed primitive changes.
+// Example:
+// (define p-handle (pdata-handle "p"))
+// (with-primitive (build-sphere 10 10)
+//     (for ((i (in-range 0 (pdata-size))))
+//         (pdata-set! p-handle i (vmul (pdata-ref p-handle i) 1.5))))
+// EndFunctionDoc
+
+Scheme_Object *pdata_handle(int argc, Scheme_Object **argv)
+{
+	DECL_ARGV();
+	ArgCheck("pdata-handle", "s", argc, argv);
+	string name=StringFromScheme(argv[0]);
+	
+	map<string,int>::iterator i=HandleIDs.find(name);
+	if (i!=HandleIDs.end())
+	{
+		MZ_GC_UNREG();
+		return scheme_make_integer(i->second);
+	}
+	
+	PDataHandle h;
+	h.Name=name;
+	h.Prim=NULL;
+	h.Version=0;
+	h.Data=NULL;
+	h.Type=0;
+	int id=Handles.size();
+	Handles.push_back(h);
+	HandleIDs[name]=id;
+	
+	MZ_GC_UNREG();
+	return scheme_make_integer(id);
+}
+
+// StartFunctionDoc-en
+// pdata->flvector type-string/handle-number flvector(optional)
+// Returns: flvector
+// Description:
+// Copies a whole pdata array into an flvector in one go, each element 
+// takes 1 (floats), 3 (vectors), 4 (colours) or 16 (matrices) numbers. 
+// If you pass an flvector of the right size it's filled in and returned, 
+// so you can reuse the same one every frame without creating garbage.
+// Example:
+// (require racket/flonum)
+// (define s (build-sphere 10 10))
+// (define buf (with-primitive s (pdata->flvector "p")))
+// (every-frame 
+//     (with-primitive s 
+//         (pdata->flvector "p" buf)
+//         (for ((i (in-range 1 (flvector-length buf) 3)))
+//             (flvector-set! buf i (* (flvector-ref buf i) 1.01)))
+//         (flvector->pdata! "p" buf)))
+// EndFunctionDoc
+
+Scheme_Object *pdata_to_flvector(int argc, Scheme_Object **argv)
+{
+	Scheme_Object *ret=NULL;
+	MZ_GC_DECL_REG(2);
+	MZ_GC_VAR_IN_REG(0, argv);
+	MZ_GC_VAR_IN_REG(1, ret);
+	MZ_GC_REG();
+	
+	Primitive *Grabbed=Engine::Get()->Renderer()->Grabbed();
+	if (Grabbed)
+	{
+		char type=0;
+		const PData *pd=FindPData(Grabbed,argv[0],type);
+		unsigned int width=PDataWidth(type);
+		if (pd && width>0)
+		{
+			unsigned int count=pd->Size()*width;
+			if (argc>1 && SCHEME_FLVECTORP(argv[1]) && SCHEME_FLVEC_SIZE(argv[1])==(int)count)
+			{
+				ret=argv[1];
+			}
+			else
+			{
+				ret=scheme_alloc_flvector(count);
+			}
+			
+			// every pdata type is packed floats, with vectors padded to 4
+			const float *src=static_cast<const float*>(pd->RawData());
+			unsigned int stride=pd->ElementSize()/sizeof(float);
+			double *dst=SCHEME_FLVEC_ELS(ret);
+			for (unsigned int i=0; i<pd->Size(); i++)
+			{
+				for (unsigned int j=0; j<width; j++) *dst++=src[j];
+				src+=stride;
+			}
+			
+			MZ_GC_UNREG();
+			return ret;
+		}
+		Trace::Stream<<"pdata->flvector: couldn't find pdata"<<endl;
+	}
+	MZ_GC_UNREG();
+	return scheme_void;
+}
+
+// StartFunctionDoc-en
+// flvector->pdata! type-string/handle-number flvector
+// Returns: void
+// Description:
+// Copies an flvector into a whole pdata array in one go, laid out as 
+// returned by pdata->flvector. Colours are copied as they are, so are 
+// always RGB. 
+// Example:
+// (require racket/flonum)
+// (with-primitive (build-cube)
+//     (flvector->pdata! "p" (for/flvector ((i (in-range 0 (* 3 (pdata-size))))) (crndf))))
+// EndFunctionDoc
+
+Scheme_Object *flvector_to_pdata(int argc, Scheme_Object **argv)
+{
+	DECL_ARGV();
+	if (!SCHEME_FLVECTORP(argv[1])) scheme_wrong_type("flvector->pdata!", "flvector", 1, argc, argv);
+	
+	Primitive *Grabbed=Engine::Get()->Renderer()->Grabbed();
+	if (Grabbed)
+	{
+		char type=0;
+		PData *pd=FindPData(Grabbed,argv[0],type);
+		unsigned int width=PDataWidth(type);
+		if (pd && width>0)
+		{
+			unsigned int count=pd->Size();
+			if ((unsigned int)SCHEME_FLVEC_SIZE(argv[1])!=count*width)
+			{
+				Trace::Stream<<"flvector->pdata!: flvector is the wrong size for the pdata"<<endl;
+				if ((unsigned int)SCHEME_FLVEC_SIZE(argv[1])<count*width) count=SCHEME_FLVEC_SIZE(argv[1])/width;
+			}
+			
+			float *dst=static_cast<float*>(pd->RawData());
+			unsigned int stride=pd->ElementSize()/sizeof(float);
+			const double *src=SCHEME_FLVEC_ELS(argv[1]);
+			for (unsigned int i=0; i<count; i++)
+			{
+				for (unsigned int j=0; j<width; j++) dst[j]=*src++;
+				dst+=stride;
+			}
+			pd->SetAllDirty();
+		}
+		else Trace::Stream<<"flvector->pdata!: couldn't find pdata"<<endl;
+	}
+	MZ_GC_UNREG();
+	return scheme_void;
+}
+
 // StartFunctionDoc-en
 // pdata-add name-string type-string
 // Returns: void
@@ -422,14 +640,21 @@ Scheme_Object *pdata_names(int argc, Scheme_Object **argv)
 
 
 // StartFunctionDoc-en
-// pdata-op funcname-string pdataname-string operator
+// pdata-op funcname-string pdataname-string operator extra-arguments ...
 // Returns: void
 // Description:
 // This is an experimental feature allowing you to do operations on pdata very quickly,
 // for instance adding element for element one array of pdata to another. You can 
 // implement this in Scheme as a loop over each element, but this is slow as the 
 // interpreter is doing all the work. It's much faster if you can use a pdata-op as
-// the same operation will only be one Scheme call.
+// the same operation will only be one Scheme call. Some operators take extra 
+// arguments after the operand, which can be numbers, vectors or pdata names.
+// The operators are: "+", "*", "closest", "sin", "cos", "lerp" (blend amount), 
+// "clamp" (low, high), "normalise" (length), "cross", "dot" (writes to a float 
+// pdata, from a vector pdata and another vector pdata or vector), "transform" and 
+// "rotate" (by a matrix, rotate ignores translation), "sine-displace" (wave vector, 
+// amplitude, phase, optional direction pdata) and "noise-displace" (noise scale 
+// vector, amplitude, noise offset, optional direction pdata).
 // Example:
 // (clear)
 // (define t (build-torus 1 4 10 10))
@@ -447,8 +672,23 @@ Scheme_Object *pdata_names(int argc, Scheme_Object **argv)
 //     ; can't think of a good example for these...
 //     ;(pdata-op "sin" "mydata" "myotherdata")  ; sine of one float pdata to another
 //     ;(pdata-op "cos" "mydata" "myotherdata")  ; cosine of one float pdata to another
+//     (pdata-op "lerp" "p" "pref" 0.1)  ; move a tenth of the way back to pref
+//     (pdata-op "clamp" "c" 0 1)  ; clamp colours between 0 and 1
+//     (pdata-op "normalise" "n" 1)  ; set all the normals to length 1
+//     (pdata-add "d" "f")
+//     (pdata-op "dot" "d" "n" (vector 0 1 0))  ; how much each normal points up
+//     (pdata-op "rotate" "n" (mrotate (vector 0 45 0)))  ; rotate the normals
 //     )
 // 
+// ; animating a mesh with displacement, copying from a reference each frame
+// (define s (build-sphere 20 20))
+// (with-primitive s (pdata-copy "p" "pref"))
+// 
+// (every-frame (with-primitive s
+//     (pdata-copy "pref" "p")
+//     (pdata-op "sine-displace" "p" (vector 0 5 0) 0.1 (* 4 (time)) "n")
+//     (pdata-op "noise-displace" "p" (vector 2 2 2) 0.1 (time) "n")))
+// 
 // ; most common example of pdata op is for particles
 // (define p (with-state
 //     (hint-points)
@@ -533,6 +773,27 @@ Scheme_Object *pdata_op(int argc, Scheme_Object **argv)
 		string op=StringFromScheme(argv[0]);
 		string pd=StringFromScheme(argv[1]);
 		
+		// collect any extra arguments for operators which need them
+		PDataArgs args;
+		for (int n=3; n<argc; n++)
+		{
+			if (SCHEME_NUMBERP(argv[n])) 
+			{
+				args.Floats.push_back(FloatFromScheme(argv[n]));
+			}
+			else if (SCHEME_VECTORP(argv[n]))
+			{
+				for (int i=0; i<SCHEME_VEC_SIZE(argv[n]); i++)
+				{
+					args.Floats.push_back(FloatFromScheme(SCHEME_VEC_ELS(argv[n])[i]));
+				}
+			}
+			else if (SCHEME_CHAR_STRINGP(argv[n]))
+			{
+				args.Data=Grabbed->GetDataRawConst(StringFromScheme(argv[n]));
+			}
+		}
+		
 		// find out what the inputs are, and call the corresponding function
 		if (SCHEME_CHAR_STRINGP(argv[2]))
 		{
@@ -541,26 +802,26 @@ Scheme_Object *pdata_op(int argc, Scheme_Object **argv)
 			PData* pd2 = Grabbed->GetDataRaw(operand);
 			
 			TypedPData<dVector> *data = dynamic_cast<TypedPData<dVector>*>(pd2);	
-			if (data) ret = Grabbed->DataOp(op, pd, data);
+			if (data) ret = Grabbed->DataOp(op, pd, data, args);
 			else
 			{
 				TypedPData<dColour> *data = dynamic_cast<TypedPData<dColour>*>(pd2);
-				if (data) ret = Grabbed->DataOp(op, pd, data);
+				if (data) ret = Grabbed->DataOp(op, pd, data, args);
 				else 
 				{
 					TypedPData<float> *data = dynamic_cast<TypedPData<float>*>(pd2);
-					if (data) ret = Grabbed->DataOp(op, pd, data);
+					if (data) ret = Grabbed->DataOp(op, pd, data, args);
 					else 
 					{
 						TypedPData<dMatrix> *data = dynamic_cast<TypedPData<dMatrix>*>(pd2);
-						if (data) ret = Grabbed->DataOp(op, pd, data);
+						if (data) ret = Grabbed->DataOp(op, pd, data, args);
 					}
 				}
 			}
 		}
 		else if (SCHEME_NUMBERP(argv[2]))
 		{
-			ret = Grabbed->DataOp(op, pd, (float)FloatFromScheme(argv[2]));
+			ret = Grabbed->DataOp(op, pd, (float)FloatFromScheme(argv[2]), args);
 		}
 		else if (SCHEME_VECTORP(argv[2]))
 		{
@@ -570,21 +831,21 @@ Scheme_Object *pdata_op(int argc, Scheme_Object **argv)
 				{
 					dVector v;
 					FloatsFromScheme(argv[2],v.arr(),3);
-					ret = Grabbed->DataOp(op, pd, v);
+					ret = Grabbed->DataOp(op, pd, v, args);
 				}
 				break;
 				case 4:
 				{
 					dColour v;
 					FloatsFromScheme(argv[2],v.arr(),4);
-					ret = Grabbed->DataOp(op, pd, v);
+					ret = Grabbed->DataOp(op, pd, v, args);
 				}
 				break;
 				case 16:
 				{
 					dMatrix v;
 					FloatsFromScheme(argv[2],v.arr(),16);
-					ret = Grabbed->DataOp(op, pd, v);
+					ret = Grabbed->DataOp(op, pd, v, args);
 				}
 				break;	
 			}
@@ -768,10 +1029,13 @@ void PDataFunctions::AddGlobals(Scheme_Env *env)
 	MZ_GC_REG();
 	scheme_add_global("pdata-ref", scheme_make_prim_w_arity(pdata_ref, "pdata-ref", 2, 2), env);
 	scheme_add_global("pdata-set!", scheme_make_prim_w_arity(pdata_set, "pdata-set!", 3, 3), env);
+	scheme_add_global("pdata-handle", scheme_make_prim_w_arity(pdata_handle, "pdata-handle", 1, 1), env);
+	scheme_add_global("pdata->flvector", scheme_make_prim_w_arity(pdata_to_flvector, "pdata->flvector", 1, 2), env);
+	scheme_add_global("flvector->pdata!", scheme_make_prim_w_arity(flvector_to_pdata, "flvector->pdata!", 2, 2), env);
 	scheme_add_global("pdata-add", scheme_make_prim_w_arity(pdata_add, "pdata-add", 2, 2), env);
 	scheme_add_global("pdata-exists?", scheme_make_prim_w_arity(pdata_exists, "pdata-exists?", 1, 1), env);
 	scheme_add_global("pdata-names", scheme_make_prim_w_arity(pdata_names, "pdata-names", 0, 0), env);
-	scheme_add_global("pdata-op", scheme_make_prim_w_arity(pdata_op, "pdata-op", 3, 3), env);
+	scheme_add_global("pdata-op", scheme_make_prim_w_arity(pdata_op, "pdata-op", 3, -1), env);
 	scheme_add_global("pdata-copy", scheme_make_prim_w_arity(pdata_copy, "pdata-copy", 2, 2), env);
 	scheme_add_global("pdata-size", scheme_make_prim_w_arity(pdata_size, "pdata-size", 0, 0), env);
 	scheme_add_global("recalc-normals", scheme_make_prim_w_arity(recalc_normals, "recalc-normals", 1, 1), env);
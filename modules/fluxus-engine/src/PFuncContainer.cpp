@@ -19,6 +19,7 @@
 #include "GenSkinWeightsPrimFunc.h"
 #include "SkinWeightsToVertColsPrimFunc.h"
 #include "SkinningPrimFunc.h"
+#include "ParticlesPrimFunc.h"
 
 using namespace Fluxus;
 
@@ -52,6 +53,11 @@ unsigned int PFuncContainer::Make(const string &name)
 		m_PFuncVec.push_back(new SkinningPrimFunc);
 		return m_PFuncVec.size()-1;
 	}
+	else if (name=="particles")
+	{
+		m_PFuncVec.push_back(new ParticlesPrimFunc);
+		return m_PFuncVec.size()-1;
+	}
 	return 0;
 }
 
@@ -89,6 +89,121 @@ Scheme_Object *collisions(int argc, Scheme_Object **argv)
 	return scheme_void;
 }
 
+// StartFunctionDoc-en
+// physics-broadphase type-symbol [parameter-list]
+// Returns: void
+// Description:
+// Sets how the objects which might be touching are found, before they are
+// tested properly. The types are 'hash (the default), 'sap (sweep and prune)
+// and 'quadtree. The hash takes 'min-level and 'max-level parameters, the
+// range of cell sizes as powers of two (-3 and 10 by default). The quadtree
+// takes a 'centre and 'extents vector for the area it covers, and the 'depth
+// it's split to. Sweep and prune is good for lots of objects spread out
+// along x and z, the quadtree for objects spread over a known area.
+// Example:
+// (physics-broadphase 'sap)
+// (physics-broadphase 'hash (list 'min-level -2 'max-level 6))
+// (physics-broadphase 'quadtree (list 'centre (vector 0 0 0) 
+//                                     'extents (vector 50 50 50) 'depth 5))
+// EndFunctionDoc
+
+Scheme_Object *physics_broadphase(int argc, Scheme_Object **argv)
+{
+	Scheme_Object *paramvec = NULL;
+	MZ_GC_DECL_REG(2);
+	MZ_GC_VAR_IN_REG(0, argv);
+	MZ_GC_VAR_IN_REG(1, paramvec);
+	MZ_GC_REG();
+
+	if (argc==2) ArgCheck("physics-broadphase", "Sl", argc, argv);
+	else ArgCheck("physics-broadphase", "S", argc, argv);
+
+	Physics::BroadphaseType type;
+	if (IsSymbol(argv[0], "hash")) type=Physics::HASH;
+	else if (IsSymbol(argv[0], "sap")) type=Physics::SAP;
+	else if (IsSymbol(argv[0], "quadtree")) type=Physics::QUADTREE;
+	else
+	{
+		Trace::Stream<<"physics-broadphase: unknown type "<<SymbolName(argv[0])<<endl;
+		MZ_GC_UNREG();
+		return scheme_void;
+	}
+
+	Physics::BroadphaseParams params;
+
+	if (argc==2)
+	{
+		paramvec = scheme_list_to_vector(argv[1]);
+
+		for (int n=0; n<SCHEME_VEC_SIZE(paramvec); n+=2)
+		{
+			if (SCHEME_SYMBOLP(SCHEME_VEC_ELS(paramvec)[n]) && SCHEME_VEC_SIZE(paramvec)>n+1)
+			{
+				string param = SymbolName(SCHEME_VEC_ELS(paramvec)[n]);
+				bool isint = SCHEME_EXACT_INTEGERP(SCHEME_VEC_ELS(paramvec)[n+1]);
+				bool isvec = SCHEME_VECTORP(SCHEME_VEC_ELS(paramvec)[n+1]);
+				if (param=="min-level" && isint) params.MinLevel = IntFromScheme(SCHEME_VEC_ELS(paramvec)[n+1]);
+				else if (param=="max-level" && isint) params.MaxLevel = IntFromScheme(SCHEME_VEC_ELS(paramvec)[n+1]);
+				else if (param=="depth" && isint) params.Depth = IntFromScheme(SCHEME_VEC_ELS(paramvec)[n+1]);
+				else if (param=="centre" && isvec) params.Centre = VectorFromScheme(SCHEME_VEC_ELS(paramvec)[n+1]);
+				else if (param=="extents" && isvec) params.Extents = VectorFromScheme(SCHEME_VEC_ELS(paramvec)[n+1]);
+				else Trace::Stream<<"physics-broadphase: unknown parameter or wrong type: "<<param<<endl;
+			}
+		}
+	}
+
+	Engine::Get()->Physics()->SetBroadphase(type,params);
+	MZ_GC_UNREG();
+	return scheme_void;
+}
+
+// StartFunctionDoc-en
+// physics-group primitiveid-number group-number
+// Returns: void
+// Description:
+// Puts an object in a group. The objects in each group are only tested 
+// against other groups when the group's bounds are touching, so grouping
+// objects that are near each other, like a pile or a stack, can make 
+// finding collisions quicker. A group less than 0 takes the object out
+// of its group.
+// Example:
+// (collisions 1)
+// (for ([i (in-range 10)])
+//     (let ((ob (with-state (translate (vector 0 i 0)) (build-cube))))
+//         (active-box ob)
+//         (physics-group ob 1)))
+// EndFunctionDoc
+
+Scheme_Object *physics_group(int argc, Scheme_Object **argv)
+{
+	DECL_ARGV();
+	ArgCheck("physics-group", "ii", argc, argv);
+	Engine::Get()->Physics()->SetGroup(IntFromScheme(argv[0]),IntFromScheme(argv[1]));
+	MZ_GC_UNREG();
+	return scheme_void;
+}
+
+// StartFunctionDoc-en
+// physics-max-contacts contacts-number
+// Returns: void
+// Description:
+// Sets the most contact points made between each pair of touching objects,
+// the default is 10. Fewer contacts are quicker to solve, but objects 
+// resting on each other can wobble.
+// Example:
+// (physics-max-contacts 4)
+// EndFunctionDoc
+
+Scheme_Object *physics_max_contacts(int argc, Scheme_Object **argv)
+{
+	DECL_ARGV();
+	ArgCheck("physics-max-contacts", "i", argc, argv);
+	int s=IntFromScheme(argv[0]);
+	Engine::Get()->Physics()->SetMaxContacts(s>0?s:1);
+	MZ_GC_UNREG();
+	return scheme_void;
+}
+
 // StartFunctionDoc-en
 // ground-plane plane-vector offset-number
 // Returns: void
@@ -1214,6 +1329,189 @@ Scheme_Object *set_max_physical(int argc, Scheme_Object **argv)
 	return scheme_void;
 }
 
+// StartFunctionDoc-en
+// physics-step-mode mode-symbol
+// Returns: void
+// Description:
+// Sets how the simulation is stepped. In 'frame mode (the default) it 
+// is stepped once every frame, so it runs faster or slower with the frame
+// rate. In 'fixed mode it is stepped as many times as the time since the 
+// last frame needs, so it runs at the same speed whatever the frame rate.
+// Example:
+// (physics-step-mode 'fixed)
+// (physics-step-size 1/60)
+// EndFunctionDoc
+
+Scheme_Object *physics_step_mode(int argc, Scheme_Object **argv)
+{
+	DECL_ARGV();
+	ArgCheck("physics-step-mode", "S", argc, argv);
+	if (IsSymbol(argv[0], "fixed"))
+		Engine::Get()->Physics()->SetStepMode(Physics::FIXED);
+	else if (IsSymbol(argv[0], "frame"))
+		Engine::Get()->Physics()->SetStepMode(Physics::FRAME);
+	else
+		Trace::Stream<<"physics-step-mode: unknown mode "<<SymbolName(argv[0])<<endl;
+	MZ_GC_UNREG();
+	return scheme_void;
+}
+
+// StartFunctionDoc-en
+// physics-step-size seconds-number
+// Returns: void
+// Description:
+// Sets the time each step of the simulation moves on by, the default
+// is 0.05. Smaller steps are more accurate, but in 'fixed step mode 
+// more of them are needed each frame.
+// Example:
+// (physics-step-size 0.02)
+// EndFunctionDoc
+
+Scheme_Object *physics_step_size(int argc, Scheme_Object **argv)
+{
+	DECL_ARGV();
+	ArgCheck("physics-step-size", "f", argc, argv);
+	Engine::Get()->Physics()->SetStepSize(FloatFromScheme(argv[0]));
+	MZ_GC_UNREG();
+	return scheme_void;
+}
+
+// StartFunctionDoc-en
+// physics-iterations iterations-number
+// Returns: void
+// Description:
+// Sets the number of iterations the solver makes each step, the default 
+// is 20. Fewer are quicker, but piles of objects get more springy.
+// Example:
+// (physics-iterations 10)
+// EndFunctionDoc
+
+Scheme_Object *physics_iterations(int argc, Scheme_Object **argv)
+{
+	DECL_ARGV();
+	ArgCheck("physics-iterations", "i", argc, argv);
+	Engine::Get()->Physics()->SetIterations(IntFromScheme(argv[0]));
+	MZ_GC_UNREG();
+	return scheme_void;
+}
+
+// StartFunctionDoc-en
+// physics-max-substeps steps-number
+// Returns: void
+// Description:
+// Sets the most steps made in one frame in 'fixed step mode, the default
+// is 5. If the frame rate drops too low for this the simulation slows 
+// down, rather than taking longer and longer to catch up.
+// Example:
+// (physics-max-substeps 3)
+// EndFunctionDoc
+
+Scheme_Object *physics_max_substeps(int argc, Scheme_Object **argv)
+{
+	DECL_ARGV();
+	ArgCheck("physics-max-substeps", "i", argc, argv);
+	int s=IntFromScheme(argv[0]);
+	Engine::Get()->Physics()->SetMaxSubSteps(s>0?s:1);
+	MZ_GC_UNREG();
+	return scheme_void;
+}
+
+// StartFunctionDoc-en
+// physics-interpolate on-boolean
+// Returns: void
+// Description:
+// In 'fixed step mode the objects are normally drawn between the 
+// last two steps, by how far the frame is through the next one, so they
+// move smoothly when the steps don't match the frames. This turns that 
+// off, so they are drawn where the last step left them.
+// Example:
+// (physics-interpolate #f)
+// EndFunctionDoc
+
+Scheme_Object *physics_interpolate(int argc, Scheme_Object **argv)
+{
+	DECL_ARGV();
+	ArgCheck("physics-interpolate", "b", argc, argv);
+	Engine::Get()->Physics()->SetInterpolate(BoolFromScheme(argv[0]));
+	MZ_GC_UNREG();
+	return scheme_void;
+}
+
+// StartFunctionDoc-en
+// physics-auto-disable on-boolean linear-threshold-number angular-threshold-number steps-number
+// Returns: void
+// Description:
+// Active objects which move slower than the thresholds for the number of
+// steps are put to sleep, and take no time to simulate until something 
+// hits them. This is on by default, with thresholds of 0.01 and 10 steps.
+// Example:
+// (physics-auto-disable #t 0.05 0.05 5)
+// EndFunctionDoc
+
+Scheme_Object *physics_auto_disable(int argc, Scheme_Object **argv)
+{
+	DECL_ARGV();
+	ArgCheck("physics-auto-disable", "bffi", argc, argv);
+	Engine::Get()->Physics()->SetAutoDisable(BoolFromScheme(argv[0]),FloatFromScheme(argv[1]),
+		FloatFromScheme(argv[2]),IntFromScheme(argv[3]));
+	MZ_GC_UNREG();
+	return scheme_void;
+}
+
+// StartFunctionDoc-en
+// physics-threads threads-number
+// Returns: void
+// Description:
+// Steps separate groups of touching or jointed objects on this many 
+// threads at once. Needs the ODE library built with threading support.
+// Example:
+// (physics-threads 4)
+// EndFunctionDoc
+
+Scheme_Object *physics_threads(int argc, Scheme_Object **argv)
+{
+	DECL_ARGV();
+	ArgCheck("physics-threads", "i", argc, argv);
+	int s=IntFromScheme(argv[0]);
+	Engine::Get()->Physics()->SetThreads(s>0?s:1);
+	MZ_GC_UNREG();
+	return scheme_void;
+}
+
+// StartFunctionDoc-en
+// physics-timings
+// Returns: list
+// Description:
+// Returns the milliseconds the last frame spent finding collisions, 
+// stepping the simulation and updating the primitives, and the 
+// number of steps it made.
+// Example:
+// (every-frame (display (physics-timings))(newline)) ; (collide step writeback steps)
+// EndFunctionDoc
+
+Scheme_Object *physics_timings(int argc, Scheme_Object **argv)
+{
+	Scheme_Object *timings[4];
+	Scheme_Object *ret = NULL;
+	MZ_GC_DECL_REG(5);
+	MZ_GC_ARRAY_VAR_IN_REG(0, timings, 4);
+	MZ_GC_VAR_IN_REG(3, ret);
+	MZ_GC_REG();
+
+	for (int n=0; n<4; n++) timings[n]=NULL;
+	float collide, step, writeback;
+	unsigned int steps;
+	Engine::Get()->Physics()->GetTimings(collide,step,writeback,steps);
+	timings[0] = scheme_make_double(collide);
+	timings[1] = scheme_make_double(step);
+	timings[2] = scheme_make_double(writeback);
+	timings[3] = scheme_make_integer_value(steps);
+	ret = scheme_build_list(4, timings);
+
+	MZ_GC_UNREG();
+	return ret;
+}
+
 // StartFunctionDoc-en
 // set-mass primitiveid-number mass-number 
 // Returns: void
@@ -1536,6 +1834,168 @@ Scheme_Object *add_torque(int argc, Scheme_Object **argv)
 	return scheme_void;
 }
 
+// reads the primitive id list and the vector, or list of vectors,
+// which the batched physics functions take
+static void BatchFromScheme(const char *funcname, int argc, Scheme_Object **argv, 
+	vector<int> &ids, vector<dVector> &v)
+{
+	Scheme_Object *idvec = NULL;
+	Scheme_Object *vecs = NULL;
+	MZ_GC_DECL_REG(3);
+	MZ_GC_VAR_IN_REG(0, argv);
+	MZ_GC_VAR_IN_REG(1, idvec);
+	MZ_GC_VAR_IN_REG(2, vecs);
+	MZ_GC_REG();
+	ArgCheck(funcname, "l?", argc, argv);
+	idvec = scheme_list_to_vector(argv[0]);
+	ids = IntVectorFromScheme(idvec);
+
+	float vec[3];
+	if (SCHEME_VECTORP(argv[1]))
+	{
+		FloatsFromScheme(argv[1],vec,3);
+		v.push_back(dVector(vec[0],vec[1],vec[2]));
+	}
+	else if (SCHEME_LISTP(argv[1]))
+	{
+		vecs = scheme_list_to_vector(argv[1]);
+		for (int n=0; n<SCHEME_VEC_SIZE(vecs); n++)
+		{
+			if (!SCHEME_VECTORP(SCHEME_VEC_ELS(vecs)[n]))
+			{
+				MZ_GC_UNREG();
+				scheme_wrong_type(funcname, "list of vectors", 1, argc, argv);
+			}
+			FloatsFromScheme(SCHEME_VEC_ELS(vecs)[n],vec,3);
+			v.push_back(dVector(vec[0],vec[1],vec[2]));
+		}
+	}
+	else
+	{
+		MZ_GC_UNREG();
+		scheme_wrong_type(funcname, "vector or list of vectors", 1, argc, argv);
+	}
+	MZ_GC_UNREG();
+}
+
+// StartFunctionDoc-en
+// kick-list primitiveid-list kick-vector-or-list
+// Returns: void
+// Description:
+// Applies translation force to a list of objects in one go, which is
+// quicker than kicking them one at a time. Takes one vector for all 
+// of them, or a list with a vector for each one.
+// Example:
+// (clear)
+// (collisions 1)
+// (gravity (vector 0 0 0))
+// (define obs (build-list 50 (lambda (i) 
+//     (with-state
+//         (translate (vmul (srndvec) 10))
+//         (build-cube)))))
+// (for-each active-box obs)
+// (kick-list obs (map (lambda (ob) (vmul (srndvec) 3)) obs))
+// EndFunctionDoc
+
+Scheme_Object *kick_list(int argc, Scheme_Object **argv)
+{
+	DECL_ARGV();
+	vector<int> ids;
+	vector<dVector> v;
+	BatchFromScheme("kick-list",argc,argv,ids,v);
+	Engine::Get()->Physics()->Kick(ids,v);
+	MZ_GC_UNREG();
+	return scheme_void;
+}
+
+// StartFunctionDoc-en
+// twist-list primitiveid-list spin-vector-or-list
+// Returns: void
+// Description:
+// Applies rotational force to a list of objects in one go. Takes one 
+// vector for all of them, or a list with a vector for each one.
+// Example:
+// (clear)
+// (collisions 1)
+// (gravity (vector 0 0 0))
+// (define obs (build-list 50 (lambda (i) 
+//     (with-state
+//         (translate (vmul (srndvec) 10))
+//         (build-cube)))))
+// (for-each active-box obs)
+// (twist-list obs (vector 0 2 0))
+// EndFunctionDoc
+
+Scheme_Object *twist_list(int argc, Scheme_Object **argv)
+{
+	DECL_ARGV();
+	vector<int> ids;
+	vector<dVector> v;
+	BatchFromScheme("twist-list",argc,argv,ids,v);
+	Engine::Get()->Physics()->Twist(ids,v);
+	MZ_GC_UNREG();
+	return scheme_void;
+}
+
+// StartFunctionDoc-en
+// add-force-list primitiveid-list force-vector-or-list
+// Returns: void
+// Description:
+// Applies force to a list of objects in one go. Takes one vector for 
+// all of them, or a list with a vector for each one.
+// Example:
+// (clear)
+// (collisions 1)
+// (gravity (vector 0 0 0))
+// (define obs (build-list 50 (lambda (i) 
+//     (with-state
+//         (translate (vmul (srndvec) 10))
+//         (build-cube)))))
+// (for-each active-box obs)
+// (every-frame 
+//     (add-force-list obs (map 
+//         (lambda (ob) (vmul (vtransform (vector 0 0 0) (get-transform ob)) -1)) 
+//         obs)))
+// EndFunctionDoc
+
+Scheme_Object *add_force_list(int argc, Scheme_Object **argv)
+{
+	DECL_ARGV();
+	vector<int> ids;
+	vector<dVector> v;
+	BatchFromScheme("add-force-list",argc,argv,ids,v);
+	Engine::Get()->Physics()->AddForce(ids,v);
+	MZ_GC_UNREG();
+	return scheme_void;
+}
+
+// StartFunctionDoc-en
+// add-torque-list primitiveid-list torque-vector-or-list
+// Returns: void
+// Description:
+// Adds torque to a list of objects in one go. Takes one vector for 
+// all of them, or a list with a vector for each one.
+// Example:
+// (clear)
+// (define obs (build-list 10 (lambda (i) 
+//     (with-state
+//         (translate (vector i 0 0))
+//         (build-cube)))))
+// (for-each active-box obs)
+// (add-torque-list obs #(10 0 0))
+// EndFunctionDoc
+
+Scheme_Object *add_torque_list(int argc, Scheme_Object **argv)
+{
+	DECL_ARGV();
+	vector<int> ids;
+	vector<dVector> v;
+	BatchFromScheme("add-torque-list",argc,argv,ids,v);
+	Engine::Get()->Physics()->AddTorque(ids,v);
+	MZ_GC_UNREG();
+	return scheme_void;
+}
+
 // StartFunctionDoc-en
 // set-gravity-mode primitiveid-number mode-boolean
 // Returns: void
@@ -1676,7 +2136,22 @@ void PhysicsFunctions::AddGlobals(Scheme_Env *env)
 	scheme_add_global("twist", scheme_make_prim_w_arity(twist, "twist", 2, 2), env);
 	scheme_add_global("add-force", scheme_make_prim_w_arity(add_force, "add-force", 2, 2), env);
 	scheme_add_global("add-torque", scheme_make_prim_w_arity(add_torque, "add-torque", 2, 2), env);
+	scheme_add_global("kick-list", scheme_make_prim_w_arity(kick_list, "kick-list", 2, 2), env);
+	scheme_add_global("twist-list", scheme_make_prim_w_arity(twist_list, "twist-list", 2, 2), env);
+	scheme_add_global("add-force-list", scheme_make_prim_w_arity(add_force_list, "add-force-list", 2, 2), env);
+	scheme_add_global("add-torque-list", scheme_make_prim_w_arity(add_torque_list, "add-torque-list", 2, 2), env);
 	scheme_add_global("set-gravity-mode", scheme_make_prim_w_arity(set_gravity_mode, "set-gravity-mode", 2, 2), env);
 	scheme_add_global("has-collided", scheme_make_prim_w_arity(has_collided, "has-collided", 1, 1), env);
+	scheme_add_global("physics-step-mode", scheme_make_prim_w_arity(physics_step_mode, "physics-step-mode", 1, 1), env);
+	scheme_add_global("physics-step-size", scheme_make_prim_w_arity(physics_step_size, "physics-step-size", 1, 1), env);
+	scheme_add_global("physics-iterations", scheme_make_prim_w_arity(physics_iterations, "physics-iterations", 1, 1), env);
+	scheme_add_global("physics-max-substeps", scheme_make_prim_w_arity(physics_max_substeps, "physics-max-substeps", 1, 1), env);
+	scheme_add_global("physics-interpolate", scheme_make_prim_w_arity(physics_interpolate, "physics-interpolate", 1, 1), env);
+	scheme_add_global("physics-auto-disable", scheme_make_prim_w_arity(physics_auto_disable, "physics-auto-disable", 4, 4), env);
+	scheme_add_global("physics-threads", scheme_make_prim_w_arity(physics_threads, "physics-threads", 1, 1), env);
+	scheme_add_global("physics-timings", scheme_make_prim_w_arity(physics_timings, "physics-timings", 0, 0), env);
+	scheme_add_global("physics-broadphase", scheme_make_prim_w_arity(physics_broadphase, "physics-broadphase", 1, 2), env);
+	scheme_add_global("physics-group", scheme_make_prim_w_arity(physics_group, "physics-group", 2, 2), env);
+	scheme_add_global("physics-max-contacts", scheme_make_prim_w_arity(physics_max_contacts, "physics-max-contacts", 1, 1), env);
 	MZ_GC_UNREG();
 }
@@ -1357,7 +1357,10 @@ Scheme_Object *locator_bounding_radius(int argc, Scheme_Object **argv)
 // load-primitive
 // Returns: primitiveid-number
 // Description:
-// Loads a primitive from disk
+// Loads a primitive from disk. Obj files are cached in the binary fluxus 
+// mesh format (.fxm) the first time they are loaded, next to the file or
+// in the directory given by (geometry-cache-directory), and this is used 
+// instead until the obj file changes.
 // Example:
 // (define mynewshape (load-primitive "octopus.obj"))
 // EndFunctionDoc
@@ -1407,14 +1410,93 @@ Scheme_Object *clear_geometry_cache(int argc, Scheme_Object **argv)
 	return scheme_void;
 }
 
+// StartFunctionDoc-en
+// geometry-cache-directory path-string
+// Returns: void
+// Description:
+// Sets the directory binary cache files of loaded meshes are written to, 
+// an empty string puts them next to the meshes, which is the default.
+// Example:
+// (geometry-cache-directory "/tmp")
+// (define mynewshape (load-primitive "octopus.obj"))
+// EndFunctionDoc
+
+Scheme_Object *geometry_cache_directory(int argc, Scheme_Object **argv)
+{
+	DECL_ARGV();
+	ArgCheck("geometry-cache-directory", "s", argc, argv);
+	PrimitiveIO::SetCacheDirectory(StringFromScheme(argv[0]));
+	MZ_GC_UNREG();
+	return scheme_void;
+}
+
+// StartFunctionDoc-en
+// geometry-cache-budget megabytes-number
+// Returns: void
+// Description:
+// Sets how much memory loaded primitives can take up in the geometry cache,
+// 0 turns the limit off (the default). When there are more than this, the 
+// ones which haven't been loaded for the longest are dropped, and are read 
+// from disk again if they're loaded later on.
+// Example:
+// (geometry-cache-budget 64)
+// EndFunctionDoc
+
+Scheme_Object *geometry_cache_budget(int argc, Scheme_Object **argv)
+{
+	DECL_ARGV();
+	ArgCheck("geometry-cache-budget", "f", argc, argv);
+	float mb=FloatFromScheme(argv[0]);
+	PrimitiveIO::SetCacheBudget(mb>0?(unsigned long)(mb*1024*1024):0);
+	MZ_GC_UNREG();
+	return scheme_void;
+}
+
+// StartFunctionDoc-en
+// geometry-cache-stats
+// Returns: list of numbers
+// Description:
+// Returns the bytes used by the geometry cache, the number of loads which 
+// found the primitive there (hits) or had to read it (misses), and the 
+// number of primitives dropped to keep inside the budget.
+// Example:
+// (display (geometry-cache-stats)) ; (bytes hits misses evictions)
+// EndFunctionDoc
+
+Scheme_Object *geometry_cache_stats(int argc, Scheme_Object **argv)
+{
+	Scheme_Object *stats[4];
+	Scheme_Object *ret = NULL;
+	MZ_GC_DECL_REG(5);
+	MZ_GC_ARRAY_VAR_IN_REG(0, stats, 4);
+	MZ_GC_VAR_IN_REG(3, ret);
+	MZ_GC_REG();
+
+	for (int n=0; n<4; n++) stats[n]=NULL;
+	unsigned long bytes;
+	unsigned int hits, misses, evictions;
+	PrimitiveIO::GetCacheStats(bytes,hits,misses,evictions);
+	stats[0] = scheme_make_integer_value(bytes);
+	stats[1] = scheme_make_integer_value(hits);
+	stats[2] = scheme_make_integer_value(misses);
+	stats[3] = scheme_make_integer_value(evictions);
+	ret = scheme_build_list(4, stats);
+
+	MZ_GC_UNREG();
+	return ret;
+}
+
 // StartFunctionDoc-en
 // save-primitive
 // Returns: void
 // Description:
-// Saves the current primitive to disk
+// Saves the current primitive to disk. The format comes from the 
+// extension, obj files or the binary fluxus mesh format (.fxm), which 
+// keeps all the pdata and loads much faster. 
 // Example:
 // (with-primitive (build-sphere 10 10)
-//     (save-primitive "mymesh.obj"))
+//     (save-primitive "mymesh.obj")
+//     (save-primitive "mymesh.fxm"))
 // EndFunctionDoc
 
 // StartFunctionDoc-pt
@@ -1514,11 +1596,12 @@ Scheme_Object *build_pixels(int argc, Scheme_Object **argv)
 }
 
 // StartFunctionDoc-en
-// pixels-upload
+// pixels-upload [x-number y-number width-number height-number]
 // Returns: void
 // Description:
 // Uploads the texture data, you need to call this when you've finished writing to the
-// pixelprim, and while it's grabbed.
+// pixelprim, and while it's grabbed. If you've only changed part of the pixels, give the
+// rectangle as x y width height and only that part is sent.
 // Example:
 // (define mynewshape (build-pixels 100 100))
 // (with-primitive mynewshape
@@ -1527,6 +1610,9 @@ Scheme_Object *build_pixels(int argc, Scheme_Object **argv)
 //             (rndvec))
 //         "c")
 //     (pixels-upload)) ; call pixels upload to see the results
+// (with-primitive mynewshape
+//     (pdata-set! "c" 0 (vector 1 0 0))
+//     (pixels-upload 0 0 1 1)) ; just the first pixel
 // EndFunctionDoc
 
 // StartFunctionDoc-pt
@@ -1547,6 +1633,8 @@ Scheme_Object *build_pixels(int argc, Scheme_Object **argv)
 
 Scheme_Object *pixels_upload(int argc, Scheme_Object **argv)
 {
+	DECL_ARGV();
+	if (argc>0) ArgCheck("pixels-upload", "iiii", argc, argv);
 	Primitive *Grabbed=Engine::Get()->Renderer()->Grabbed();
 	if (Grabbed)
 	{
@@ -1554,20 +1642,27 @@ Scheme_Object *pixels_upload(int argc, Scheme_Object **argv)
 		PixelPrimitive *pp = dynamic_cast<PixelPrimitive *>(Grabbed);
 		if (pp)
 		{
-			pp->Upload();
+			if (argc>0) pp->Upload(IntFromScheme(argv[0]),IntFromScheme(argv[1]),
+						IntFromScheme(argv[2]),IntFromScheme(argv[3]));
+			else pp->Upload();
+			MZ_GC_UNREG();
 		    return scheme_void;
 		}
 	}
 
 	Trace::Stream<<"pixels-upload can only be called while a pixelprimitive is grabbed"<<endl;
+	MZ_GC_UNREG();
     return scheme_void;
 }
 
 // StartFunctionDoc-en
-// pixels-download
+// pixels-download [x-number y-number width-number height-number]
 // Returns: void
 // Description:
-// Downloads the texture data from the GPU to the PData array.
+// Downloads the texture data from the GPU to the PData array, at the end of this
+// frame. This waits for the card to finish drawing, so use pixels-download-async 
+// if you are downloading every frame. An optional rectangle given as x y width 
+// height only downloads that part.
 // Example:
 // (clear)
 // 
@@ -1597,6 +1692,8 @@ Scheme_Object *pixels_upload(int argc, Scheme_Object **argv)
 // EndFunctionDoc
 Scheme_Object *pixels_download(int argc, Scheme_Object **argv)
 {
+	DECL_ARGV();
+	if (argc>0) ArgCheck("pixels-download", "iiii", argc, argv);
 	Primitive *Grabbed=Engine::Get()->Renderer()->Grabbed();
 	if (Grabbed)
 	{
@@ -1604,12 +1701,124 @@ Scheme_Object *pixels_download(int argc, Scheme_Object **argv)
 		PixelPrimitive *pp = dynamic_cast<PixelPrimitive *>(Grabbed);
 		if (pp)
 		{
-			pp->Download();
+			if (argc>0) pp->Download(IntFromScheme(argv[0]),IntFromScheme(argv[1]),
+						IntFromScheme(argv[2]),IntFromScheme(argv[3]));
+			else pp->Download();
+			MZ_GC_UNREG();
 		    return scheme_void;
 		}
 	}
 
 	Trace::Stream<<"pixels-download can only be called while a pixelprimitive is grabbed"<<endl;
+	MZ_GC_UNREG();
+    return scheme_void;
+}
+
+// StartFunctionDoc-en
+// pixels-download-async [x-number y-number width-number height-number]
+// Returns: void
+// Description:
+// Starts downloading the texture data from the GPU without waiting for it. The 
+// pixels arrive in the PData array a frame later, when pixels-download-ready? 
+// returns #t. Call it every frame for a continuous feed of pixels, which 
+// will be a frame behind the texture. An optional rectangle given as 
+// x y width height only downloads that part.
+// Example:
+// (define p (build-pixels 256 256 #t))
+// 
+// (every-frame
+//     (with-primitive p 
+//         (when (pixels-download-ready?)
+//             (display (pdata-ref "c" 0))(newline))
+//         (pixels-download-async)))
+// EndFunctionDoc
+
+Scheme_Object *pixels_download_async(int argc, Scheme_Object **argv)
+{
+	DECL_ARGV();
+	if (argc>0) ArgCheck("pixels-download-async", "iiii", argc, argv);
+	Primitive *Grabbed=Engine::Get()->Renderer()->Grabbed();
+	if (Grabbed)
+	{
+		// only if this is a pixel primitive
+		PixelPrimitive *pp = dynamic_cast<PixelPrimitive *>(Grabbed);
+		if (pp)
+		{
+			if (argc>0) pp->DownloadAsync(IntFromScheme(argv[0]),IntFromScheme(argv[1]),
+						IntFromScheme(argv[2]),IntFromScheme(argv[3]));
+			else pp->DownloadAsync(0,0,pp->GetWidth(),pp->GetHeight());
+			MZ_GC_UNREG();
+		    return scheme_void;
+		}
+	}
+
+	Trace::Stream<<"pixels-download-async can only be called while a pixelprimitive is grabbed"<<endl;
+	MZ_GC_UNREG();
+    return scheme_void;
+}
+
+// StartFunctionDoc-en
+// pixels-download-ready?
+// Returns: boolean
+// Description:
+// Returns #t if pixels from pixels-download-async have arrived in the PData since
+// the last time it was called.
+// Example:
+// (with-primitive p 
+//     (when (pixels-download-ready?)
+//         (display (pdata-ref "c" 0))(newline)))
+// EndFunctionDoc
+
+Scheme_Object *pixels_download_ready(int argc, Scheme_Object **argv)
+{
+	Primitive *Grabbed=Engine::Get()->Renderer()->Grabbed();
+	if (Grabbed)
+	{
+		// only if this is a pixel primitive
+		PixelPrimitive *pp = dynamic_cast<PixelPrimitive *>(Grabbed);
+		if (pp)
+		{
+		    return pp->DownloadReady()?scheme_true:scheme_false;
+		}
+	}
+
+	Trace::Stream<<"pixels-download-ready? can only be called while a pixelprimitive is grabbed"<<endl;
+    return scheme_false;
+}
+
+// StartFunctionDoc-en
+// pixels-transfer-format format-symbol
+// Returns: void
+// Description:
+// Sets how pixels are sent between the PData and the card, either 'float, the default,
+// or 'byte. Bytes are a quarter of the size so they upload and download faster, and 
+// are what the texture is stored as anyway, but the colours are rounded to 256 levels
+// on the way through.
+// Example:
+// (with-primitive p 
+//     (pixels-transfer-format 'byte))
+// EndFunctionDoc
+
+Scheme_Object *pixels_transfer_format(int argc, Scheme_Object **argv)
+{
+	DECL_ARGV();
+	Primitive *Grabbed=Engine::Get()->Renderer()->Grabbed();
+	if (Grabbed)
+	{
+		// only if this is a pixel primitive
+		PixelPrimitive *pp = dynamic_cast<PixelPrimitive *>(Grabbed);
+		if (pp)
+		{
+			if (IsSymbol(argv[0],"byte")) pp->SetTransferFormat(PixelPrimitive::TRANSFER_BYTE);
+			else if (IsSymbol(argv[0],"float")) pp->SetTransferFormat(PixelPrimitive::TRANSFER_FLOAT);
+			else Trace::Stream<<"pixels-transfer-format: unknown format, use 'float or 'byte"<<endl;
+			MZ_GC_UNREG();
+		    return scheme_void;
+		}
+	}
+
+	Trace::Stream<<"pixels-transfer-format can only be called while a pixelprimitive is grabbed"<<endl;
+	MZ_GC_UNREG();
     return scheme_void;
 }
 
@@ -2610,6 +2819,11 @@ Scheme_Object *build_copy(int argc, Scheme_Object **argv)
 //
 //     skeleton-root primid-number : the root of the bindpose skeleton for skinning
 //     sharpness float : a control of how sharp the creasing will be when skinned 
+//     dense number : whether to add the per bone pdata (default 1)
+//     compact number : whether to add the 4 biggest influences for each vertex as colour 
+//         pdata (default 0), "bi" for the bone numbers and "bw" for their weights - these 
+//         are much faster to skin with, but are only used when there are no per bone 
+//         weights, so set dense to 0 as well
 //
 // skinweights->vertcols
 //     A utility for visualising skinweights for debugging. 
@@ -2618,14 +2832,52 @@ Scheme_Object *build_copy(int argc, Scheme_Object **argv)
 // skinning 
 //     Skins a primitive - deforms it to follow a skeleton's movements. Primitives we want to run
 //     this on have to contain extra pdata - copies of the starting vert positions called "pref" and
-//     the same for normals, if normals are being skinned, called "nref". 
+//     the same for normals, if normals are being skinned, called "nref". The per bone weights 
+//     are used if they exist, otherwise the compact "bi" and "bw" influences. The work is split
+//     up over all the processor cores.
 //    
 //     skeleton-root primid-number : the root primitive of the animating skeleton
 //     bindpose-root primid-number : the root primitive of the bindpose skeleton
 //     skin-normals number : whether to skin the normals as well as the positions
+//
+// particles
+//     Simulates particles, moving the "p" pdata by a velocity pdata which is accelerated
+//     by the forces below. Any of the forces can be left out. The work is split up over 
+//     all the processor cores, so it's much faster than doing it with pdata-map!
+//
+//     vel string : the velocity pdata (default "vel")
+//     age string : a float pdata which is increased by the timestep (default "age", optional)
+//     timestep float : seconds to move the particles on by, eg (delta) (default 0.02)
+//     gravity vector : constant acceleration
+//     drag float : how much the particles are slowed down by
+//     attractors list : x y z strength for each point attracting the particles
+//     noise float : strength of the simplex noise turbulence
+//     noise-scale float : size of the turbulence (default 1)
+//     noise-time float : animates the turbulence, eg (time)
+//     plane-pos vector : a point on the plane the particles bounce off
+//     plane-normal vector : the direction the plane faces, the bounce is off without this
+//     restitution float : how bouncy the plane is (default 0.5)
+//     lifetime float : particles older than this are respawned (needs the age pdata)
+//     emitter vector : where respawned particles start
+//     emit-vel vector : starting velocity of respawned particles
+//     emit-spread float : random amount added to the starting velocity
 //     
 // Example:
 // (define mypfunc (make-pfunc 'arithmetic))
+//
+// (clear)
+// (define p (build-particles 10000))
+// (with-primitive p
+//     (pdata-add "vel" "v")
+//     (pdata-add "age" "f")
+//     (pdata-map! (lambda (age) (* (rndf) 3)) "age"))
+// (define sim (make-pfunc 'particles))
+// (every-frame
+//     (with-primitive p
+//         (pfunc-set! sim (list 'timestep (delta) 'gravity (vector 0 -2 0)
+//                               'lifetime 3.0 'emit-vel (vector 0 4 0) 'emit-spread 2.0
+//                               'plane-normal (vector 0 1 0) 'plane-pos (vector 0 -2 0)))
+//         (pfunc-run sim)))
 // EndFunctionDoc
 
 // StartFunctionDoc-pt
@@ -3279,8 +3531,14 @@ void PrimitiveFunctions::AddGlobals(Scheme_Env *env)
 	scheme_add_global("load-primitive", scheme_make_prim_w_arity(load_primitive, "load-primitive", 1, 1), env);
 	scheme_add_global("save-primitive", scheme_make_prim_w_arity(save_primitive, "save-primitive", 1, 1), env);
 	scheme_add_global("clear-geometry-cache", scheme_make_prim_w_arity(clear_geometry_cache, "clear-geometry-cache", 0, 0), env);
-	scheme_add_global("pixels-upload", scheme_make_prim_w_arity(pixels_upload, "pixels-upload", 0, 0), env);
-	scheme_add_global("pixels-download", scheme_make_prim_w_arity(pixels_download, "pixels-download", 0, 0), env);
+	scheme_add_global("geometry-cache-directory", scheme_make_prim_w_arity(geometry_cache_directory, "geometry-cache-directory", 1, 1), env);
+	scheme_add_global("geometry-cache-budget", scheme_make_prim_w_arity(geometry_cache_budget, "geometry-cache-budget", 1, 1), env);
+	scheme_add_global("geometry-cache-stats", scheme_make_prim_w_arity(geometry_cache_stats, "geometry-cache-stats", 0, 0), env);
+	scheme_add_global("pixels-upload", scheme_make_prim_w_arity(pixels_upload, "pixels-upload", 0, 4), env);
+	scheme_add_global("pixels-download", scheme_make_prim_w_arity(pixels_download, "pixels-download", 0, 4), env);
+	scheme_add_global("pixels-download-async", scheme_make_prim_w_arity(pixels_download_async, "pixels-download-async", 0, 4), env);
+	scheme_add_global("pixels-download-ready?", scheme_make_prim_w_arity(pixels_download_ready, "pixels-download-ready?", 0, 0), env);
+	scheme_add_global("pixels-transfer-format", scheme_make_prim_w_arity(pixels_transfer_format, "pixels-transfer-format", 1, 1), env);
 	scheme_add_global("pixels-load", scheme_make_prim_w_arity(pixels_load, "pixels-load", 1, 1), env);
 	scheme_add_global("pixels-width", scheme_make_prim_w_arity(pixels_width, "pixels-width", 0, 0), env);
 	scheme_add_global("pixels-height", scheme_make_prim_w_arity(pixels_height, "pixels-height", 0, 0), env);
@@ -22,6 +22,7 @@
 #include "Utils.h"
 #include "SearchPaths.h"
 #include "TiledRender.h"
+#include "FrameDumper.h"
 
 using namespace UtilFunctions;
 using namespace SchemeHelper;
@@ -290,6 +291,8 @@ Scheme_Object *fullpath(int argc, Scheme_Object **argv)
 // Saves out the current OpenGL front buffer to disk. Reads the filename extension to 
 // decide on the format used for saving, "tif", "jpg" or "ppm" are supported. This is the 
 // low level form of the frame dumping, use start-framedump and end-framedump instead.
+// The frame is read back and written in the background, so the file will appear a 
+// few frames later - use framedump-flush if you need to wait for it.
 // Example:
 // (framedump "picture.jpg")
 // EndFunctionDoc
@@ -313,32 +316,82 @@ Scheme_Object *framedump(int argc, Scheme_Object **argv)
 	
 	int w=0,h=0;
 	Engine::Get()->Renderer()->GetResolution(w,h);
+	FrameDumper::Get()->Capture(StringFromScheme(argv[0]),w,h);
 	
-	string filename=StringFromScheme(argv[0]);
-	if (strlen(filename.c_str())>3)
-	{
-		if (!strcmp(filename.c_str()+strlen(filename.c_str())-3,"tif"))
-		{
-			ScreenCapTiff(filename.c_str(), "made in fluxus", 0, 0, w, h, 1);
-		}
-		else if (!strcmp(filename.c_str()+strlen(filename.c_str())-3,"jpg"))
-		{
-			ScreenCapJPG(filename.c_str(), "made in fluxus", 0, 0, w, h, 80);
-		}
-		else if (!strcmp(filename.c_str()+strlen(filename.c_str())-3,"ppm"))
-		{
-			ScreenCapPPM(filename.c_str(), "made in fluxus", 0, 0, w, h, 1);
-		}
-		else
-		{
-			Trace::Stream<<"framedump: Unknown image extension "<<filename.c_str()+strlen(filename.c_str())-3<<endl;
-		}
-	}
-	
 	MZ_GC_UNREG(); 
 	return scheme_void;
 }
 
+// StartFunctionDoc-en
+// framedump-flush
+// Returns: void
+// Description:
+// Waits until all the frames saved with framedump have been written to disk.
+// Example:
+// (framedump "picture.jpg")
+// (framedump-flush)
+// EndFunctionDoc
+
+Scheme_Object *framedump_flush(int argc, Scheme_Object **argv)
+{
+	FrameDumper::Get()->Flush();
+	return scheme_void;
+}
+
+// StartFunctionDoc-en
+// framedump-pipe command-string
+// Returns: boolean
+// Description:
+// Runs a program that is sent frames from framedump-pipe-frame on its standard 
+// input, as raw 8 bit BGRA pixels at the screen resolution, top row first. This 
+// is a quick way to record video with an external encoder, as nothing is written 
+// to disk. Returns #f if the program couldn't be started.
+// Example:
+// (framedump-pipe "ffmpeg -f rawvideo -pix_fmt bgra -s 720x576 -r 25 -i - out.mp4")
+// EndFunctionDoc
+
+Scheme_Object *framedump_pipe(int argc, Scheme_Object **argv)
+{
+	DECL_ARGV();
+	ArgCheck("framedump-pipe", "s", argc, argv);
+	bool ret=FrameDumper::Get()->OpenPipe(StringFromScheme(argv[0]));
+	MZ_GC_UNREG(); 
+	return ret?scheme_true:scheme_false;
+}
+
+// StartFunctionDoc-en
+// framedump-pipe-frame
+// Returns: void
+// Description:
+// Sends the current frame to the program started with framedump-pipe.
+// Example:
+// (framedump-pipe-frame)
+// EndFunctionDoc
+
+Scheme_Object *framedump_pipe_frame(int argc, Scheme_Object **argv)
+{
+	int w=0,h=0;
+	Engine::Get()->Renderer()->GetResolution(w,h);
+	FrameDumper::Get()->CapturePipe(w,h);
+	return scheme_void;
+}
+
+// StartFunctionDoc-en
+// framedump-pipe-close
+// Returns: void
+// Description:
+// Waits for the frames to be sent, then closes the program started with 
+// framedump-pipe, which waits for it to finish.
+// Example:
+// (framedump-pipe-close)
+// EndFunctionDoc
+
+Scheme_Object *framedump_pipe_close(int argc, Scheme_Object **argv)
+{
+	FrameDumper::Get()->ClosePipe();
+	return scheme_void;
+}
+
 // StartFunctionDoc-en
 // tiled-framedump filename
 // Returns: void
@@ -413,6 +466,10 @@ void UtilFunctions::AddGlobals(Scheme_Env *env)
 	scheme_add_global("get-searchpaths",scheme_make_prim_w_arity(get_searchpaths,"get-searchpaths",0,0), env);	
 	scheme_add_global("fullpath",scheme_make_prim_w_arity(fullpath,"fullpath",1,1), env);	
 	scheme_add_global("framedump",scheme_make_prim_w_arity(framedump,"framedump",1,1), env);	
+	scheme_add_global("framedump-flush",scheme_make_prim_w_arity(framedump_flush,"framedump-flush",0,0), env);	
+	scheme_add_global("framedump-pipe",scheme_make_prim_w_arity(framedump_pipe,"framedump-pipe",1,1), env);	
+	scheme_add_global("framedump-pipe-frame",scheme_make_prim_w_arity(framedump_pipe_frame,"framedump-pipe-frame",0,0), env);	
+	scheme_add_global("framedump-pipe-close",scheme_make_prim_w_arity(framedump_pipe_close,"framedump-pipe-close",0,0), env);	
 	scheme_add_global("tiled-framedump",scheme_make_prim_w_arity(tiledframedump,"tiled-framedump",3,3), env);
  	MZ_GC_UNREG(); 
 }